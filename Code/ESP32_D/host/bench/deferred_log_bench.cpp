@@ -0,0 +1,63 @@
+// Хост-бенчмарк: запись в DeferredLog против форматирования на месте.
+//
+//   cmake -S host -B host/build && cmake --build host/build -j && ./host/build/deferred_log_bench
+//
+// Горячий путь - только DeferredLog::printf (запись в кольцо ядра); выбор
+// и форматирование (drain) идут между замерами, как в задаче вывода. Для
+// сравнения - snprintf того же сообщения в буфер: это нижняя граница для
+// Serial.printf, который еще ждет место в буфере USB-CDC.
+
+#include <chrono>
+#include <cstdio>
+
+#include "sim/SimHal.h"
+
+#include "core/DeferredLog.h"
+
+namespace {
+
+constexpr uint32_t kRounds = 200000;
+// Меньше емкости кольца: ни одна запись не теряется
+constexpr uint32_t kBurst = 64;
+
+template <typename Fn>
+double nsPerCall(Fn fn, bool drainBetween) {
+    double totalNs = 0.0;
+    for (uint32_t round = 0; round < kRounds / kBurst; ++round) {
+        const auto t0 = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < kBurst; ++i) {
+            fn(round * kBurst + i);
+        }
+        const auto t1 = std::chrono::steady_clock::now();
+        totalNs += std::chrono::duration<double, std::nano>(t1 - t0).count();
+        if (drainBetween) {
+            DeferredLog::drain();
+        }
+    }
+    return totalNs / (double)((kRounds / kBurst) * kBurst);
+}
+
+} // namespace
+
+int main() {
+    sim::reset();
+    std::printf("deferred log benchmark (%u records, bursts of %u)\n\n", kRounds, kBurst);
+
+    volatile int sink = 0;
+    char line[DeferredLog::kLineLength];
+
+    const double formatNs = nsPerCall([&](uint32_t i) {
+        sink = sink + std::snprintf(line, sizeof(line), "[EMS CH%d] ✅ Started on pin %d (%s) #%lu\n",
+                                    1, 2, "timer", (unsigned long)i);
+    }, false);
+
+    const uint32_t dropped0 = DeferredLog::getDropped();
+    const double deferredNs = nsPerCall([](uint32_t i) {
+        DeferredLog::printf("[EMS CH%d] ✅ Started on pin %d (%s) #%lu\n", 1, 2, "timer", (unsigned long)i);
+    }, true);
+    const uint32_t dropped = DeferredLog::getDropped() - dropped0;
+
+    std::printf("snprintf in place          %7.1f ns/record\n", formatNs);
+    std::printf("DeferredLog::printf        %7.1f ns/record, %lu dropped\n", deferredNs, (unsigned long)dropped);
+    return dropped == 0 ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+// Хост-бенчмарк EdgeScheduler: стоимость одного фронта при 1, 2, 4 и 8 каналах.
+//
+// Сборка и запуск (из Code/ESP32_D):
+//   g++ -O2 -std=c++17 -Iinclude host/bench/edge_scheduler_bench.cpp -o edge_bench && ./edge_bench
+//
+// Каналы моделируют цикл пачка/пауза EMSPulseGenerator (два фронта на цикл)
+// с немного разными длительностями, чтобы фронты не совпадали. Время
+// виртуальное: "прыгаем" сразу к вершине кучи, так что измеряется чистая
+// стоимость планировщика без ожидания.
+
+#include <chrono>
+#include <cstdio>
+#include <initializer_list>
+
+#include "core/EdgeScheduler.h"
+
+namespace {
+
+constexpr uint8_t kMaxChannels = 8;
+constexpr uint32_t kEventsPerRun = 20000000;
+
+struct SimChannel {
+    uint32_t burstUs;
+    uint32_t pauseUs;
+    uint64_t nextEdgeUs;
+    bool     inBurst;
+    uint32_t edges;
+
+    // Аналог EMSPulseGenerator::serviceEdge()
+    uint64_t serviceEdge() {
+        nextEdgeUs += inBurst ? pauseUs : burstUs;
+        inBurst = !inBurst;
+        edges++;
+        return nextEdgeUs;
+    }
+};
+
+double runHeap(uint8_t channels, uint32_t events, uint32_t& checksum) {
+    EdgeScheduler<kMaxChannels> schedule;
+    SimChannel sim[kMaxChannels];
+
+    for (uint8_t i = 0; i < channels; ++i) {
+        sim[i] = SimChannel{180544u + i * 137u, 235000u + i * 311u, 180544u + i * 137u, true, 0};
+        schedule.schedule(i, sim[i].nextEdgeUs);
+    }
+
+    const auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t n = 0; n < events; ++n) {
+        const uint8_t ch = schedule.topChannel();
+        schedule.schedule(ch, sim[ch].serviceEdge());
+    }
+    const auto t1 = std::chrono::steady_clock::now();
+
+    checksum = (uint32_t)schedule.topDueUs();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / events;
+}
+
+// Холостая проверка "есть ли наступивший фронт": куча - одно сравнение с вершиной,
+// опрос - сравнение по каждому каналу (как N вызовов update())
+double runIdleCheck(uint8_t channels, bool heap, uint32_t loops, uint32_t& checksum) {
+    EdgeScheduler<kMaxChannels> schedule;
+    uint64_t next[kMaxChannels];
+    for (uint8_t i = 0; i < channels; ++i) {
+        next[i] = 1000000u + i;
+        schedule.schedule(i, next[i]);
+    }
+
+    volatile uint64_t now = 0;
+    uint32_t due = 0;
+    const auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t n = 0; n < loops; ++n) {
+        const uint64_t t = now;
+        if (heap) {
+            due += !EdgeScheduler<kMaxChannels>::earlier(t, schedule.topDueUs());
+        } else {
+            for (uint8_t i = 0; i < channels; ++i) {
+                due += t >= next[i];
+            }
+        }
+    }
+    const auto t1 = std::chrono::steady_clock::now();
+
+    checksum = due;
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / loops;
+}
+
+}  // namespace
+
+int main() {
+    std::printf("EdgeScheduler benchmark (%u events per run)\n\n", kEventsPerRun);
+    std::printf("channels | ns/edge (heap) | ns/idle loop (heap) | ns/idle loop (N x update)\n");
+    std::printf("---------+----------------+---------------------+--------------------------\n");
+
+    uint32_t checksum = 0;
+    uint32_t sink = 0;
+    for (uint8_t channels : {1, 2, 4, 8}) {
+        const double perEdge = runHeap(channels, kEventsPerRun, checksum);
+        sink ^= checksum;
+        const double idleHeap = runIdleCheck(channels, true, kEventsPerRun, checksum);
+        sink ^= checksum;
+        const double idlePoll = runIdleCheck(channels, false, kEventsPerRun, checksum);
+        sink ^= checksum;
+
+        std::printf("%8u | %14.2f | %19.2f | %25.2f\n", channels, perEdge, idleHeap, idlePoll);
+    }
+
+    std::printf("\n(checksum %u)\n", sink);
+    return 0;
+}
@@ -0,0 +1,79 @@
+// Хост-бенчмарк: путь ISR энкодера - IEncoder (виртуальный) против StaticEncoder.
+//
+//   cmake -S host -B host/build && cmake --build host/build -j && ./host/build/encoder_isr_bench
+//
+// Обработчик прерывания вызывается по указателю, как его вызывает диспетчер GPIO:
+//  - IEncoder: isrThunk -> виртуальный handleIsr -> pushStep, update через std::function;
+//  - StaticEncoder: isrEntry с встроенным декодером, update с функтором.
+// Уровень CLK меняется перед каждым вызовом (digitalWrite не зовет ISR), так
+// что каждый второй вызов - щелчок; каждые 32 вызова - update(), его доля
+// входит в результат. digitalRead на хосте - вызов в sim, одинаковый для обоих.
+// Такты на устройстве - src/main_encoder_isr_bench.cpp_.
+
+#include <chrono>
+#include <cstdio>
+
+#include "sim/SimHal.h"
+
+#include "app/pins.h"
+#include "core/StaticEncoder.h"
+#include "drivers/EncoderEC12.h"
+
+namespace {
+
+constexpr uint32_t kCalls = 20000000;
+constexpr uint32_t kDrainEvery = 32;
+
+// Доступ к защищенному thunk'у - так его вызывает диспетчер
+class ProbeEC12 : public EncoderEC12 {
+public:
+    using EncoderEC12::EncoderEC12;
+    static void (*entry())(void*) { return &IEncoder::isrThunk; }
+};
+
+struct StepSum {
+    int32_t* sum;
+    void operator()(int8_t d) { *sum += d; }
+};
+
+template <typename Drain>
+double nsPerIsr(uint8_t clkPin, void (*volatile isr)(void*), void* arg, Drain drain) {
+    int level = HIGH;
+    const auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < kCalls; ++i) {
+        level = !level;
+        digitalWrite(clkPin, level);
+        isr(arg);
+        if ((i % kDrainEvery) == kDrainEvery - 1) {
+            drain();
+        }
+    }
+    const auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / kCalls;
+}
+
+} // namespace
+
+int main() {
+    std::printf("encoder ISR benchmark (%u calls, update() every %u)\n\n", kCalls, kDrainEvery);
+
+    int32_t virtualSum = 0;
+    int32_t staticSum = 0;
+
+    sim::reset();
+    ProbeEC12 ref(ENC_A_CLK_PIN, ENC_A_DT_PIN);
+    ref.onStep([&virtualSum](int8_t d) { virtualSum += d; });
+    ref.begin();
+    const double virtualNs = nsPerIsr(ENC_A_CLK_PIN, ProbeEC12::entry(), &ref, [&ref] { ref.update(); });
+
+    sim::reset();
+    StaticEncoder<EC12Decoder, StepSum> fast(ENC_A_CLK_PIN, ENC_A_DT_PIN, StepSum{&staticSum});
+    fast.begin();
+    const double staticNs = nsPerIsr(ENC_A_CLK_PIN, &StaticEncoder<EC12Decoder, StepSum>::isrEntry, &fast,
+                                     [&fast] { fast.update(); });
+
+    std::printf("IEncoder (virtual + std::function)  %6.2f ns/ISR, %ld steps\n", virtualNs, (long)virtualSum);
+    std::printf("StaticEncoder (inline)              %6.2f ns/ISR, %ld steps\n", staticNs, (long)staticSum);
+    std::printf("difference                          %6.2f ns/ISR\n", virtualNs - staticNs);
+    return virtualSum == staticSum ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+// Хост-бенчмарк SeqLock против std::mutex: писатель и читатель на двух потоках.
+//
+// Собирается в host/CMakeLists.txt:
+//   cmake -S host -B host/build && cmake --build host/build -j && ./host/build/seqlock_bench
+//
+// Заодно проверяет согласованность снимка: писатель кладет во все слова одно
+// число, читатель считает снимки с разными словами (должно быть 0).
+// Абсолютные цифры для ESP32-S3 дает src/main_appstate_bench.cpp_.
+//
+// Обе стороны крутятся без уступок, как задачи на двух ядрах устройства,
+// поэтому нужно не меньше двух аппаратных потоков: на одном ядре вытесненный
+// посреди записи писатель заставляет читателя крутиться весь квант, и цифры
+// ничего не говорят. Без двух потоков бенчмарк не меряет (--force - все равно).
+//
+// Отчет по сторонам: операций в секунду и повторов - у seqlock это повторы
+// копии читателем, у мьютекса - неудачные try_lock перед ожиданием.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include "core/SeqLock.h"
+
+namespace {
+
+// Размер как у AppStateSnapshot
+struct Snapshot {
+    uint32_t words[5];
+};
+
+constexpr auto kDuration = std::chrono::milliseconds(500);
+
+class MutexState {
+public:
+    Snapshot load(uint64_t& retries) {
+        lock(retries);
+        const Snapshot value = value_;
+        mutex_.unlock();
+        return value;
+    }
+    void store(const Snapshot& s, uint64_t& retries) {
+        lock(retries);
+        value_ = s;
+        mutex_.unlock();
+    }
+
+private:
+    void lock(uint64_t& retries) {
+        if (!mutex_.try_lock()) {
+            ++retries;
+            mutex_.lock();
+        }
+    }
+
+    std::mutex mutex_;
+    Snapshot value_ = {};
+};
+
+class SeqState {
+public:
+    Snapshot load(uint64_t& retries) {
+        uint32_t attempts = 0;
+        const Snapshot s = lock_.load(&attempts);
+        retries += attempts;
+        return s;
+    }
+    // Писатель seqlock не ждет читателей - повторов у него нет
+    void store(const Snapshot& s, uint64_t&) { lock_.store(s); }
+
+private:
+    SeqLock<Snapshot> lock_;
+};
+
+// Итоги стороны: поток копит локально и публикует один раз в конце
+struct SideResult {
+    std::atomic<uint64_t> ops{0};
+    std::atomic<uint64_t> retries{0};
+};
+
+template <typename State>
+void run(const char* name) {
+    State state;
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::atomic<bool> stop(false);
+    SideResult writer;
+    SideResult reader;
+    std::atomic<uint64_t> torn(0);
+
+    auto startLine = [&] {
+        ready.fetch_add(1, std::memory_order_acq_rel);
+        while (!go.load(std::memory_order_acquire)) {
+        }
+    };
+
+    std::thread writerThread([&] {
+        Snapshot s;
+        uint32_t v = 0;
+        uint64_t ops = 0;
+        uint64_t retries = 0;
+        startLine();
+        while (!stop.load(std::memory_order_relaxed)) {
+            ++v;
+            for (uint32_t& w : s.words) w = v;
+            state.store(s, retries);
+            ++ops;
+        }
+        writer.ops.store(ops, std::memory_order_relaxed);
+        writer.retries.store(retries, std::memory_order_relaxed);
+    });
+
+    std::thread readerThread([&] {
+        uint64_t ops = 0;
+        uint64_t retries = 0;
+        uint64_t bad = 0;
+        startLine();
+        while (!stop.load(std::memory_order_relaxed)) {
+            const Snapshot s = state.load(retries);
+            for (uint32_t w : s.words) {
+                if (w != s.words[0]) {
+                    ++bad;
+                    break;
+                }
+            }
+            ++ops;
+        }
+        reader.ops.store(ops, std::memory_order_relaxed);
+        reader.retries.store(retries, std::memory_order_relaxed);
+        torn.store(bad, std::memory_order_relaxed);
+    });
+
+    while (ready.load(std::memory_order_acquire) < 2) {
+    }
+    const auto begin = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(kDuration);
+    stop.store(true, std::memory_order_relaxed);
+    const auto end = std::chrono::steady_clock::now();
+    writerThread.join();
+    readerThread.join();
+
+    const double sec = std::chrono::duration<double>(end - begin).count();
+    std::printf("%-8s | %12.0f | %10llu | %12.0f | %10llu | %6llu\n", name,
+                reader.ops.load() / sec, (unsigned long long)reader.retries.load(),
+                writer.ops.load() / sec, (unsigned long long)writer.retries.load(),
+                (unsigned long long)torn.load());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const bool force = argc > 1 && !std::strcmp(argv[1], "--force");
+    const unsigned threads = std::thread::hardware_concurrency();
+    if (threads < 2) {
+        std::printf("seqlock_bench: %u hardware thread(s), need 2 - results are not representative;\n"
+                    "use src/main_appstate_bench.cpp_ on the device%s\n",
+                    threads, force ? " (running anyway: --force)" : " (--force to run anyway)");
+        if (!force) {
+            return 0;
+        }
+    }
+
+    std::printf("state    | reads/s      | rd retries | writes/s     | wr retries | torn\n");
+    std::printf("---------+--------------+------------+--------------+------------+-------\n");
+    run<MutexState>("mutex");
+    run<SeqState>("seqlock");
+    return 0;
+}
@@ -0,0 +1,155 @@
+// Хост-бенчмарк SpscRing против очереди на мьютексе (аналог xQueue:
+// критическая секция на каждую операцию) - на двух потоках ОС.
+//
+// Собирается в host/CMakeLists.txt:
+//   cmake -S host -B host/build && cmake --build host/build -j && ./host/build/spsc_ring_bench
+//
+// Цифры хоста показывают относительную разницу; абсолютные значения для
+// ESP32-S3 дает src/main_queue_bench.cpp_ на устройстве. Ожидания уступают
+// процессор (yield), чтобы прогон не зависел от числа ядер хоста.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "core/SpscRing.h"
+
+namespace {
+
+// Размер как у Command (тип, StimParams, timestamp)
+struct Item {
+    uint32_t words[4];
+};
+
+class MutexQueue {
+public:
+    explicit MutexQueue(size_t capacity) : capacity_(capacity) {}
+
+    bool push(const Item& item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (items_.size() >= capacity_) return false;
+        items_.push_back(item);
+        return true;
+    }
+
+    bool pop(Item& item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (items_.empty()) return false;
+        item = items_.front();
+        items_.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    std::deque<Item> items_;
+    size_t capacity_;
+};
+
+constexpr uint32_t kOps = 2000000;
+constexpr uint32_t kPings = 100000;
+
+using Clock = std::chrono::steady_clock;
+
+double nsSince(Clock::time_point t0) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+}
+
+// send+receive в одном потоке
+template <typename Q>
+double singleThreadNs(Q& q) {
+    Item item = {{0, 0, 0, 0}};
+    const auto t0 = Clock::now();
+    for (uint32_t i = 0; i < kOps; ++i) {
+        item.words[0] = i;
+        q.push(item);
+        q.pop(item);
+    }
+    return nsSince(t0) / kOps;
+}
+
+// Потоковая передача: писатель и читатель на разных потоках
+template <typename Q>
+double streamNs(Q& q) {
+    const auto t0 = Clock::now();
+    std::thread consumer([&q] {
+        Item item;
+        for (uint32_t i = 0; i < kOps; ++i) {
+            while (!q.pop(item)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    Item item = {{0, 0, 0, 0}};
+    for (uint32_t i = 0; i < kOps; ++i) {
+        item.words[0] = i;
+        while (!q.push(item)) {
+            std::this_thread::yield();
+        }
+    }
+    consumer.join();
+    return nsSince(t0) / kOps;
+}
+
+// Пинг-понг: половина кругового обхода = задержка в одну сторону
+template <typename Q>
+void pingPong(Q& request, Q& reply, double& avgNs, double& p99Ns) {
+    std::thread echo([&] {
+        Item item;
+        for (uint32_t i = 0; i < kPings; ++i) {
+            while (!request.pop(item)) {
+                std::this_thread::yield();
+            }
+            while (!reply.push(item)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::vector<double> samples;
+    samples.reserve(kPings);
+    Item item = {{0, 0, 0, 0}};
+    for (uint32_t i = 0; i < kPings; ++i) {
+        const auto t0 = Clock::now();
+        request.push(item);
+        while (!reply.pop(item)) {
+            std::this_thread::yield();
+        }
+        samples.push_back(nsSince(t0) / 2.0);
+    }
+    echo.join();
+
+    double sum = 0;
+    for (double s : samples) sum += s;
+    avgNs = sum / samples.size();
+    std::nth_element(samples.begin(), samples.begin() + samples.size() * 99 / 100, samples.end());
+    p99Ns = samples[samples.size() * 99 / 100];
+}
+
+template <typename Q>
+void run(const char* name) {
+    Q single(16);
+    Q stream(16);
+    Q request(16), reply(16);
+
+    double avg = 0, p99 = 0;
+    const double one = singleThreadNs(single);
+    const double two = streamNs(stream);
+    pingPong(request, reply, avg, p99);
+    std::printf("%-12s | %10.2f | %12.2f | %10.0f | %10.0f\n", name, one, two, avg, p99);
+}
+
+} // namespace
+
+int main() {
+    std::printf("queue        | 1 thread   | 2 threads    | one-way    | one-way\n");
+    std::printf("             | ns/op      | ns/item      | avg ns     | p99 ns\n");
+    std::printf("-------------+------------+--------------+------------+-----------\n");
+    run<MutexQueue>("mutex");
+    run<SpscRing<Item>>("SpscRing");
+    return 0;
+}
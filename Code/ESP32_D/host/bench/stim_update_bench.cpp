@@ -0,0 +1,74 @@
+// Хост-бенчмарк: стоимость update() генератора и банка каналов (режим Polling).
+//
+// Собирается в host/CMakeLists.txt против виртуального HAL (host/sim):
+//   cmake -S host -B host/build && cmake --build host/build -j && ./host/build/stim_update_bench
+//
+// Виртуальные часы сдвигаются на 1 мкс за вызов, поэтому в выборку попадают
+// и холостые проходы, и фронты - в той же пропорции, что и на устройстве при
+// опросе раз в микросекунду. Накладные расходы самих часов измеряются
+// отдельно и вычитаются.
+
+#include <chrono>
+#include <cstdio>
+
+#include "sim/SimHal.h"
+
+#include "app/StimChannelBank.h"
+#include "app/pins.h"
+#include "drivers/EMSPulseGenerator.h"
+
+namespace {
+
+constexpr uint32_t kCalls = 20000000;
+
+template <typename Fn>
+double nsPerCall(Fn fn) {
+    const auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < kCalls; ++i) {
+        fn();
+        sim::advance(1);
+    }
+    const auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / kCalls;
+}
+
+} // namespace
+
+int main() {
+    std::printf("update() benchmark (%u calls, 1 us virtual step)\n\n", kCalls);
+
+    sim::reset();
+    const double clockNs = nsPerCall([] {});
+
+    // Один генератор, опрос
+    sim::reset();
+    EMSPulseGenerator gen(0, PWM_CH_1_PIN, 144, 10, 70);
+    gen.begin();
+    gen.start();
+    const double genNs = nsPerCall([&gen] { gen.update(); }) - clockNs;
+
+    // Банк: 2 и 8 каналов, одна проверка вершины кучи за вызов
+    double bankNs[2] = {0, 0};
+    const uint8_t counts[2] = {2, 8};
+    for (int k = 0; k < 2; ++k) {
+        sim::reset();
+        EMSPulseGenerator* gens[StimChannelBank::kMaxChannels];
+        StimChannelBank bank;
+        for (uint8_t i = 0; i < counts[k]; ++i) {
+            gens[i] = new EMSPulseGenerator(i, PWM_CH_1_PIN, 144, 10, 70);
+            bank.addChannel(*gens[i]);
+        }
+        bank.begin();
+        bank.startAll();
+        bankNs[k] = nsPerCall([&bank] { bank.update(); }) - clockNs;
+        for (uint8_t i = 0; i < counts[k]; ++i) {
+            delete gens[i];
+        }
+    }
+
+    std::printf("virtual clock overhead      %6.2f ns/call (subtracted)\n", clockNs);
+    std::printf("EMSPulseGenerator::update   %6.2f ns/call\n", genNs);
+    std::printf("StimChannelBank::update x2  %6.2f ns/call\n", bankNs[0]);
+    std::printf("StimChannelBank::update x8  %6.2f ns/call\n", bankNs[1]);
+    return 0;
+}
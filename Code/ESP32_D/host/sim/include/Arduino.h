@@ -0,0 +1,92 @@
+#pragma once
+// Хостовый Arduino.h: подмножество API Arduino-ESP32, используемое прошивкой,
+// на виртуальном времени (см. sim/SimHal.h)
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+using std::max;
+using std::min;
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define INPUT_PULLUP 0x05
+
+#define RISING  0x01
+#define FALLING 0x02
+#define CHANGE  0x03
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+
+unsigned long micros();
+unsigned long millis();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+int  digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t level);
+
+#define digitalPinToInterrupt(p) (p)
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode);
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t pin);
+
+uint32_t ledcSetup(uint8_t channel, uint32_t freq, uint8_t resolutionBits);
+void     ledcAttachPin(uint8_t pin, uint8_t channel);
+void     ledcDetachPin(uint8_t pin);
+void     ledcWrite(uint8_t channel, uint32_t duty);
+uint32_t ledcRead(uint8_t channel);
+uint32_t ledcChangeFrequency(uint8_t channel, uint32_t freq, uint8_t resolutionBits);
+
+// Аппаратный таймер (APB 80 МГц / divider) поверх таймеров симуляции;
+// ISR вызывается из runUntil() как колбэк esp_timer
+typedef struct hw_timer_s hw_timer_t;
+hw_timer_t* timerBegin(uint8_t num, uint16_t divider, bool countUp);
+void        timerEnd(hw_timer_t* timer);
+void        timerAttachInterrupt(hw_timer_t* timer, void (*fn)(void), bool edge);
+void        timerAlarmWrite(hw_timer_t* timer, uint64_t alarmValue, bool autoreload);
+void        timerAlarmEnable(hw_timer_t* timer);
+void        timerAlarmDisable(hw_timer_t* timer);
+
+class SimSerial {
+public:
+    void   begin(unsigned long) {}
+    size_t printf(const char* format, ...);
+    size_t print(const char* text);
+    size_t print(long value);
+    size_t println(const char* text);
+    size_t println(long value);
+    size_t println();
+    operator bool() const { return true; }
+};
+
+extern SimSerial Serial;
+
+// Счетчик тактов - виртуальное время на 240 МГц (ISR в симуляции мгновенны)
+class SimEsp {
+public:
+    uint32_t getCycleCount();
+    uint32_t getCpuFreqMHz() { return 240; }
+};
+
+extern SimEsp ESP;
@@ -0,0 +1,24 @@
+#pragma once
+// Хостовый Preferences.h: NVS в памяти процесса (см. sim::nvsErase)
+// Записи переживают пересоздание объекта Preferences - как флеш при перезагрузке
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly = false, const char* partitionLabel = nullptr);
+    void end();
+
+    size_t getBytesLength(const char* key);
+    size_t getBytes(const char* key, void* buf, size_t maxLen);
+    size_t putBytes(const char* key, const void* value, size_t len);
+    bool   remove(const char* key);
+
+private:
+    std::string namespace_;
+    bool opened_ = false;
+    bool readOnly_ = false;
+};
@@ -0,0 +1,23 @@
+#pragma once
+// Хостовый driver/gpio.h: общий обработчик прерываний GPIO (модель - sim/src/SimHal.cpp)
+// Статус прерываний копится в GPIO_STATUS_REG/GPIO_STATUS1_REG, пока обработчик
+// его не сбросит; пока статус не пуст, обработчик вызывается снова.
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_intr_alloc.h"
+
+typedef int gpio_num_t;
+
+typedef enum {
+    GPIO_INTR_DISABLE = 0,
+    GPIO_INTR_POSEDGE = 1,
+    GPIO_INTR_NEGEDGE = 2,
+    GPIO_INTR_ANYEDGE = 3,
+} gpio_int_type_t;
+
+esp_err_t gpio_isr_register(void (*fn)(void*), void* arg, int intrAllocFlags, intr_handle_t* handle);
+esp_err_t gpio_set_intr_type(gpio_num_t gpio, gpio_int_type_t type);
+esp_err_t gpio_intr_enable(gpio_num_t gpio);
+esp_err_t gpio_intr_disable(gpio_num_t gpio);
@@ -0,0 +1,9 @@
+#pragma once
+// Хостовый esp_freertos_hooks.h: тиков нет, хуки принимаются и не вызываются
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef void (*esp_freertos_tick_cb_t)(void);
+
+esp_err_t esp_register_freertos_tick_hook_for_cpu(esp_freertos_tick_cb_t cb, UBaseType_t cpu);
@@ -0,0 +1,12 @@
+#pragma once
+// Хостовый esp_heap_caps.h: любая "память с возможностями" - обычная куча
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+void* heap_caps_malloc(size_t size, uint32_t caps);
+void  heap_caps_free(void* ptr);
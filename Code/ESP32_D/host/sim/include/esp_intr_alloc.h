@@ -0,0 +1,10 @@
+#pragma once
+// Хостовый esp_intr_alloc.h
+
+#include "esp_err.h"
+
+#define ESP_INTR_FLAG_IRAM (1 << 10)
+
+typedef struct intr_handle_data_t* intr_handle_t;
+
+esp_err_t esp_intr_free(intr_handle_t handle);
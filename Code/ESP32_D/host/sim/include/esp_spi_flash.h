@@ -0,0 +1,6 @@
+#pragma once
+// Хостовый esp_spi_flash.h: flash не пишется, кэш всегда включен
+
+#include <stdbool.h>
+
+inline bool spi_flash_cache_enabled() { return true; }
@@ -0,0 +1,56 @@
+#pragma once
+// Хостовый FreeRTOS.h: однопоточная модель, тик = 1 мс виртуального времени
+
+#include <stdint.h>
+
+typedef int      BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE  1
+#define pdFALSE 0
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+
+#define configTICK_RATE_HZ 1000
+#define portMAX_DELAY      ((TickType_t)0xFFFFFFFFUL)
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)  ((TickType_t)(ms))
+
+#define tskNO_AFFINITY 0x7FFFFFFF
+#define portNUM_PROCESSORS 2
+
+// Счетчики времени выполнения задач задает сценарий (sim::setRunTime):
+// Profiler собирается в режиме RunTimeStats
+#define configUSE_TRACE_FACILITY      1
+#define configGENERATE_RUN_TIME_STATS 1
+#define configMAX_TASK_NAME_LEN       16
+
+typedef uint8_t StackType_t;
+
+// Критические секции: симуляция однопоточная, ISR вызываются синхронно.
+// Исключения нет, только глубина вложенности - чтобы ловить вызовы,
+// недопустимые под spinlock (sim::lockedCalls)
+typedef struct {
+    uint32_t owner;
+    uint32_t count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0, 0}
+
+void simEnterCritical();
+void simExitCritical();
+
+#define portENTER_CRITICAL(mux)     ((void)(mux), simEnterCritical())
+#define portEXIT_CRITICAL(mux)      ((void)(mux), simExitCritical())
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)  portEXIT_CRITICAL(mux)
+#define portENTER_CRITICAL_SAFE(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_SAFE(mux)  portEXIT_CRITICAL(mux)
+#define taskENTER_CRITICAL(mux)     portENTER_CRITICAL(mux)
+#define taskEXIT_CRITICAL(mux)      portEXIT_CRITICAL(mux)
+
+// ISR вызываются синхронно - переключать некуда
+#define portYIELD_FROM_ISR(...) ((void)0)
+
+BaseType_t xPortGetCoreID();
@@ -0,0 +1,39 @@
+#pragma once
+// Хостовый task.h: задержки и ожидания продвигают виртуальное время (с запуском таймеров)
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct SimTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+// Задачи не моделируются: создание всегда неуспешно, код вызывает свой шаг напрямую
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stackDepth,
+                                   void* arg, UBaseType_t priority, TaskHandle_t* handle,
+                                   BaseType_t core);
+
+void       vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+
+// Уведомления: одна "текущая" задача с счетчиком уведомлений
+uint32_t   ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void       vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken);
+
+#define taskYIELD() ((void)0)
+
+// Снимок задач для Profiler: IDLE обоих ядер, текущая задача и sim::addTask()
+typedef struct {
+    TaskHandle_t xHandle;
+    const char*  pcTaskName;
+    uint32_t     ulRunTimeCounter;
+    BaseType_t   xCoreID;
+    uint32_t     usStackHighWaterMark;
+} TaskStatus_t;
+
+UBaseType_t  uxTaskGetNumberOfTasks();
+UBaseType_t  uxTaskGetSystemState(TaskStatus_t* tasks, UBaseType_t maxTasks, uint32_t* totalRunTime);
+TaskHandle_t xTaskGetIdleTaskHandleForCPU(UBaseType_t cpu);
+char*        pcTaskGetName(TaskHandle_t task);
+BaseType_t   xTaskGetAffinity(TaskHandle_t task);
+UBaseType_t  uxTaskGetStackHighWaterMark(TaskHandle_t task);
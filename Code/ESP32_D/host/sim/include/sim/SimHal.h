@@ -0,0 +1,94 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+
+#include "freertos/task.h"
+
+/**
+ * @brief Управление хостовым HAL: виртуальные часы, таймеры, GPIO, LEDC
+ *
+ * Прошивочные классы собираются на хосте без изменений: заголовки
+ * Arduino.h / esp_timer.h / freertos/... из host/sim/include реализуют тот же
+ * API поверх виртуального времени. Время идет только по команде
+ * (runUntil/advance) и "прыгает" сразу к ближайшему таймеру, поэтому
+ * миллионы циклов пачка/пауза моделируются за секунды.
+ *
+ * Симуляция однопоточная: критические секции только считают вложенность, ISR вызывается
+ * синхронно из setPin() (общий обработчик GPIO - пока статус не пуст) и
+ * pcntCount() (обработчик юнита PCNT), колбэки esp_timer - из runUntil().
+ */
+namespace sim {
+
+// Запись в LEDC (ledcWrite) с виртуальным временем
+struct LedcWrite {
+    uint64_t timeUs;
+    uint8_t  channel;
+    uint32_t duty;
+};
+
+using LedcSink = std::function<void(const LedcWrite&)>;
+
+// Сбросить часы в 0, снять все таймеры, GPIO и LEDC в исходное состояние
+void reset();
+
+uint64_t now();
+
+// Запустить все таймеры со сроком <= timeUs, затем выставить часы в timeUs
+void runUntil(uint64_t timeUs);
+void advance(uint64_t us);
+
+// Выполнить один ближайший таймер, если его срок <= limitUs
+bool runNextTimer(uint64_t limitUs);
+
+// Срок ближайшего взведенного таймера (UINT64_MAX - таймеров нет)
+uint64_t nextTimerDeadline();
+
+/**
+ * @brief Модель задержки колбэков esp_timer
+ * Колбэк вызывается в deadline + fixedUs + rand[0..jitterUs]
+ */
+void setTimerLatency(uint32_t fixedUs, uint32_t jitterUs, uint32_t seed = 1);
+
+// Приемник записей LEDC (nullptr - не записывать)
+void setLedcSink(LedcSink sink);
+uint32_t ledcDuty(uint8_t channel);
+uint32_t ledcFreq(uint8_t channel);
+
+// Внешнее воздействие на вход: меняет уровень и вызывает ISR, если фронт подходит
+void setPin(uint8_t pin, int level);
+int  pinLevel(uint8_t pin);
+
+// PCNT: сдвинуть счетчик юнита на delta отсчетов по одному - с обнулением на
+// h_lim/l_lim и вызовом обработчика юнита на включенных событиях
+void     pcntCount(uint8_t unit, int32_t delta);
+// Вызовы обработчика юнита с reset()
+uint32_t pcntInterrupts(uint8_t unit);
+
+// Прерывание GPIO (gpio_isr_register) замаскировано, как в критической секции:
+// фронты копятся в статусе, снятие маски вызывает обработчик
+void setGpioIrqMasked(bool masked);
+
+// Вызовы, запрещенные под spinlock (ledcChangeFrequency), сделанные внутри
+// критической секции; reset() обнуляет
+uint32_t lockedCalls();
+
+// Задачи для Profiler (run-time stats): ручка с именем и ядром; IDLE ядер
+// есть всегда. Счетчики времени выполнения и общий счетчик задает сценарий
+TaskHandle_t addTask(const char* name, BaseType_t core);
+void         setRunTime(TaskHandle_t task, uint32_t runTime);
+void         setTotalRunTime(uint32_t runTime);
+
+// Тик FreeRTOS на ядре core: вызывает хуки esp_register_freertos_tick_hook_for_cpu
+// (xPortGetCoreID() на время вызова - core). Хуки переживают reset()
+void tick(BaseType_t core);
+
+// NVS (Preferences): очистить "флеш" и число коммитов (putBytes)
+void     nvsErase();
+uint32_t nvsWriteCount();
+
+// Эхо Serial в stdout (по умолчанию выключено)
+void setSerialEcho(bool enabled);
+
+} // namespace sim
@@ -0,0 +1,11 @@
+#pragma once
+// Хостовый soc/gpio_reg.h: регистры входов GPIO собираются из уровней sim::setPin(),
+// статус прерываний - из фронтов на пинах с gpio_intr_enable()
+
+#define DR_REG_GPIO_BASE       0x60004000
+#define GPIO_IN_REG            (DR_REG_GPIO_BASE + 0x3C)   // GPIO 0-31
+#define GPIO_IN1_REG           (DR_REG_GPIO_BASE + 0x40)   // GPIO 32-63
+#define GPIO_STATUS_REG        (DR_REG_GPIO_BASE + 0x44)   // GPIO 0-31
+#define GPIO_STATUS_W1TC_REG   (DR_REG_GPIO_BASE + 0x4C)
+#define GPIO_STATUS1_REG       (DR_REG_GPIO_BASE + 0x50)   // GPIO 32-63
+#define GPIO_STATUS1_W1TC_REG  (DR_REG_GPIO_BASE + 0x58)
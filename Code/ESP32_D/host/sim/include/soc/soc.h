@@ -0,0 +1,10 @@
+#pragma once
+// Хостовый soc/soc.h: чтение и запись регистров периферии (модель - sim/src/SimHal.cpp)
+
+#include <stdint.h>
+
+uint32_t simRegRead(uint32_t reg);
+void     simRegWrite(uint32_t reg, uint32_t value);
+
+#define REG_READ(reg)         simRegRead((uint32_t)(reg))
+#define REG_WRITE(reg, value) simRegWrite((uint32_t)(reg), (uint32_t)(value))
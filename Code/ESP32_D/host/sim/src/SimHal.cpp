@@ -0,0 +1,1068 @@
+#include <stdarg.h>
+#include <stdlib.h>
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "Preferences.h"
+#include "esp_freertos_hooks.h"
+#include "esp_heap_caps.h"
+#include "driver/gpio.h"
+#include "driver/pcnt.h"
+#include "soc/gpio_reg.h"
+#include "soc/soc.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "sim/SimHal.h"
+
+// ============================================
+// Состояние симуляции
+// ============================================
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void*          arg;
+    const char*    name;
+    bool           active;
+    uint64_t       deadlineUs;
+    uint64_t       periodUs;       // 0 - one-shot
+    uint64_t       armSeq;         // порядок взвода: одинаковые сроки - FIFO
+};
+
+struct SimSemaphore {
+    int count;
+    int maxCount;
+};
+
+struct SimTask {
+    uint32_t    notifyValue;
+    const char* name;
+    BaseType_t  core;
+    uint32_t    runTime;
+};
+
+struct SimQueue {
+    size_t length;
+    size_t itemSize;
+    std::deque<std::vector<uint8_t>> items;
+};
+
+namespace {
+
+constexpr uint8_t kMaxPins = 64;
+constexpr uint8_t kMaxLedc = 16;
+
+struct PinState {
+    int   level = HIGH;
+    uint8_t mode = INPUT;
+    void (*isr)(void*) = nullptr;
+    void* isrArg = nullptr;
+    int   isrMode = 0;
+    // Общий обработчик GPIO (gpio_isr_register)
+    gpio_int_type_t intrType = GPIO_INTR_DISABLE;
+    bool  intrEnabled = false;
+};
+
+struct PcntUnit {
+    int16_t  count = 0;
+    int16_t  hLim = 0;
+    int16_t  lLim = 0;
+    int16_t  thres0 = 0;
+    int16_t  thres1 = 0;
+    uint32_t events = 0;        // включенные pcnt_evt_type_t
+    bool     paused = false;
+    void (*isr)(void*) = nullptr;
+    void* isrArg = nullptr;
+    uint32_t interrupts = 0;
+};
+
+struct State {
+    uint64_t nowUs = 0;
+    uint64_t armSeq = 0;
+    std::vector<esp_timer*> timers;
+
+    uint32_t latencyFixedUs = 0;
+    uint32_t latencyJitterUs = 0;
+    uint32_t rng = 1;
+
+    PinState pins[kMaxPins];
+    // Общий обработчик GPIO: статус по банкам, маскирование "критической секцией"
+    void (*gpioIsr)(void*) = nullptr;
+    void* gpioIsrArg = nullptr;
+    uint32_t gpioStatus[2] = {0, 0};
+    bool gpioMasked = false;
+    bool inGpioIsr = false;
+    PcntUnit pcnt[PCNT_UNIT_MAX];
+    bool pcntService = false;
+    uint32_t ledcDuty[kMaxLedc] = {};
+    uint32_t ledcFreq[kMaxLedc] = {};
+    sim::LedcSink ledcSink;
+
+    SimTask task = {0, "sim", tskNO_AFFINITY, 0};
+    SimTask idle[portNUM_PROCESSORS] = {{0, "IDLE0", 0, 0}, {0, "IDLE1", 1, 0}};
+    std::deque<SimTask> tasks;      // sim::addTask(): адреса не переезжают
+    uint32_t totalRunTime = 0;
+
+    // NVS: "пространство/ключ" -> значение; reset() не трогает (это флеш)
+    std::map<std::string, std::vector<uint8_t>> nvs;
+    uint32_t nvsWrites = 0;
+
+    // Хуки тика: begin() модулей регистрирует их один раз, reset() не трогает
+    std::vector<esp_freertos_tick_cb_t> tickHooks[portNUM_PROCESSORS];
+    BaseType_t core = 0;            // xPortGetCoreID(): не 0 только в sim::tick()
+
+    bool serialEcho = false;
+    bool inTimer = false;
+
+    // Глубина критических секций и запрещенные в них вызовы
+    uint32_t criticalDepth = 0;
+    uint32_t lockedCalls = 0;
+};
+
+State& state() {
+    static State s;
+    return s;
+}
+
+uint32_t nextRandom() {
+    // xorshift32: детерминированный джиттер для воспроизводимых прогонов
+    uint32_t x = state().rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    state().rng = x;
+    return x;
+}
+
+esp_timer* earliestTimer() {
+    esp_timer* best = nullptr;
+    for (esp_timer* t : state().timers) {
+        if (!t->active) continue;
+        if (best == nullptr || t->deadlineUs < best->deadlineUs ||
+            (t->deadlineUs == best->deadlineUs && t->armSeq < best->armSeq)) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+// Линия прерывания GPIO - уровень: пока статус не пуст, обработчик вызывается снова
+void deliverGpioIrq() {
+    State& s = state();
+    if (s.gpioIsr == nullptr || s.gpioMasked || s.inGpioIsr) return;
+    s.inGpioIsr = true;
+    for (int guard = 0; guard < 1000 && (s.gpioStatus[0] | s.gpioStatus[1]) != 0; ++guard) {
+        s.gpioIsr(s.gpioIsrArg);
+    }
+    s.inGpioIsr = false;
+}
+
+} // namespace
+
+// ============================================
+// Управление симуляцией
+// ============================================
+
+namespace sim {
+
+void reset() {
+    State& s = state();
+    for (esp_timer* t : s.timers) {
+        t->active = false;
+    }
+    s.nowUs = 0;
+    s.armSeq = 0;
+    s.latencyFixedUs = 0;
+    s.latencyJitterUs = 0;
+    s.rng = 1;
+    for (uint8_t i = 0; i < kMaxPins; ++i) {
+        s.pins[i] = PinState();
+    }
+    s.gpioIsr = nullptr;
+    s.gpioIsrArg = nullptr;
+    s.gpioStatus[0] = 0;
+    s.gpioStatus[1] = 0;
+    s.gpioMasked = false;
+    s.inGpioIsr = false;
+    for (uint8_t i = 0; i < PCNT_UNIT_MAX; ++i) {
+        s.pcnt[i] = PcntUnit();
+    }
+    s.pcntService = false;
+    for (uint8_t i = 0; i < kMaxLedc; ++i) {
+        s.ledcDuty[i] = 0;
+        s.ledcFreq[i] = 0;
+    }
+    s.ledcSink = nullptr;
+    s.task.notifyValue = 0;
+    s.task.runTime = 0;
+    for (SimTask& t : s.idle) {
+        t.runTime = 0;
+    }
+    s.tasks.clear();
+    s.totalRunTime = 0;
+    s.criticalDepth = 0;
+    s.lockedCalls = 0;
+}
+
+uint64_t now() {
+    return state().nowUs;
+}
+
+bool runNextTimer(uint64_t limitUs) {
+    State& s = state();
+    esp_timer* t = earliestTimer();
+    if (t == nullptr || t->deadlineUs > limitUs) {
+        return false;
+    }
+
+    // Колбэк приходит с задержкой модели, но не раньше текущего времени
+    uint64_t fireUs = t->deadlineUs + s.latencyFixedUs;
+    if (s.latencyJitterUs > 0) {
+        fireUs += nextRandom() % (s.latencyJitterUs + 1);
+    }
+    if (fireUs > s.nowUs) {
+        s.nowUs = fireUs;
+    }
+
+    if (t->periodUs > 0) {
+        t->deadlineUs += t->periodUs;
+        t->armSeq = ++s.armSeq;
+    } else {
+        t->active = false;
+    }
+
+    s.inTimer = true;
+    t->callback(t->arg);
+    s.inTimer = false;
+    return true;
+}
+
+void runUntil(uint64_t timeUs) {
+    while (runNextTimer(timeUs)) {
+    }
+    if (timeUs > state().nowUs) {
+        state().nowUs = timeUs;
+    }
+}
+
+void advance(uint64_t us) {
+    runUntil(state().nowUs + us);
+}
+
+uint64_t nextTimerDeadline() {
+    esp_timer* t = earliestTimer();
+    return (t != nullptr) ? t->deadlineUs : UINT64_MAX;
+}
+
+void setTimerLatency(uint32_t fixedUs, uint32_t jitterUs, uint32_t seed) {
+    state().latencyFixedUs = fixedUs;
+    state().latencyJitterUs = jitterUs;
+    state().rng = (seed != 0) ? seed : 1;
+}
+
+void setLedcSink(LedcSink sink) {
+    state().ledcSink = sink;
+}
+
+uint32_t ledcDuty(uint8_t channel) {
+    return (channel < kMaxLedc) ? state().ledcDuty[channel] : 0;
+}
+
+uint32_t ledcFreq(uint8_t channel) {
+    return (channel < kMaxLedc) ? state().ledcFreq[channel] : 0;
+}
+
+void setPin(uint8_t pin, int level) {
+    if (pin >= kMaxPins) return;
+    PinState& p = state().pins[pin];
+    const int old = p.level;
+    p.level = level ? HIGH : LOW;
+
+    if (old == p.level) return;
+    const bool rising = (p.level == HIGH);
+
+    if (p.intrEnabled && (p.intrType == GPIO_INTR_ANYEDGE ||
+                          (p.intrType == GPIO_INTR_POSEDGE && rising) ||
+                          (p.intrType == GPIO_INTR_NEGEDGE && !rising))) {
+        state().gpioStatus[pin >> 5] |= 1UL << (pin & 31);
+        deliverGpioIrq();
+    }
+
+    if (p.isr == nullptr) return;
+    if (p.isrMode == CHANGE || (p.isrMode == RISING && rising) || (p.isrMode == FALLING && !rising)) {
+        p.isr(p.isrArg);
+    }
+}
+
+void setGpioIrqMasked(bool masked) {
+    state().gpioMasked = masked;
+    if (!masked) {
+        deliverGpioIrq();
+    }
+}
+
+uint32_t lockedCalls() {
+    return state().lockedCalls;
+}
+
+void pcntCount(uint8_t unit, int32_t delta) {
+    if (unit >= PCNT_UNIT_MAX) return;
+    PcntUnit& u = state().pcnt[unit];
+    const int16_t dir = (delta > 0) ? 1 : -1;
+    for (int32_t n = (delta > 0) ? delta : -delta; n > 0; --n) {
+        if (u.paused) return;
+        u.count = (int16_t)(u.count + dir);
+
+        uint32_t fired = 0;
+        if (u.hLim > 0 && u.count >= u.hLim) {
+            fired |= PCNT_EVT_H_LIM;
+            u.count = 0;
+        } else if (u.lLim < 0 && u.count <= u.lLim) {
+            fired |= PCNT_EVT_L_LIM;
+            u.count = 0;
+        }
+        if (u.count == u.thres0) fired |= PCNT_EVT_THRES_0;
+        if (u.count == u.thres1) fired |= PCNT_EVT_THRES_1;
+
+        if ((fired & u.events) != 0 && u.isr != nullptr) {
+            u.interrupts++;
+            u.isr(u.isrArg);
+        }
+    }
+}
+
+uint32_t pcntInterrupts(uint8_t unit) {
+    return (unit < PCNT_UNIT_MAX) ? state().pcnt[unit].interrupts : 0;
+}
+
+int pinLevel(uint8_t pin) {
+    return (pin < kMaxPins) ? state().pins[pin].level : LOW;
+}
+
+void setSerialEcho(bool enabled) {
+    state().serialEcho = enabled;
+}
+
+TaskHandle_t addTask(const char* name, BaseType_t core) {
+    state().tasks.push_back(SimTask{0, name, core, 0});
+    return &state().tasks.back();
+}
+
+void setRunTime(TaskHandle_t task, uint32_t runTime) {
+    if (task != nullptr) {
+        task->runTime = runTime;
+    }
+}
+
+void setTotalRunTime(uint32_t runTime) {
+    state().totalRunTime = runTime;
+}
+
+void tick(BaseType_t core) {
+    if (core < 0 || core >= portNUM_PROCESSORS) return;
+    State& s = state();
+    s.core = core;
+    for (esp_freertos_tick_cb_t hook : s.tickHooks[core]) {
+        hook();
+    }
+    s.core = 0;
+}
+
+void nvsErase() {
+    state().nvs.clear();
+    state().nvsWrites = 0;
+}
+
+uint32_t nvsWriteCount() {
+    return state().nvsWrites;
+}
+
+} // namespace sim
+
+// ============================================
+// Arduino
+// ============================================
+
+SimSerial Serial;
+SimEsp ESP;
+
+uint32_t SimEsp::getCycleCount() {
+    return (uint32_t)(state().nowUs * 240ULL);
+}
+
+long map(long x, long inMin, long inMax, long outMin, long outMax) {
+    const long dividend = outMax - outMin;
+    const long divisor = inMax - inMin;
+    if (divisor == 0) {
+        return -1;
+    }
+    return (x - inMin) * dividend / divisor + outMin;
+}
+
+unsigned long micros() {
+    return (uint32_t)state().nowUs;   // как на ESP32: 32 бита
+}
+
+unsigned long millis() {
+    return (uint32_t)(state().nowUs / 1000ULL);
+}
+
+void delay(uint32_t ms) {
+    sim::advance((uint64_t)ms * 1000ULL);
+}
+
+void delayMicroseconds(uint32_t us) {
+    // Активное ожидание: таймеры за это время не обслуживаются
+    state().nowUs += us;
+}
+
+void yield() {
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin >= kMaxPins) return;
+    state().pins[pin].mode = mode;
+    if (mode == INPUT_PULLUP) {
+        state().pins[pin].level = HIGH;
+    }
+}
+
+int digitalRead(uint8_t pin) {
+    return sim::pinLevel(pin);
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+    if (pin < kMaxPins) {
+        state().pins[pin].level = level ? HIGH : LOW;
+    }
+}
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void*), void* arg, int mode) {
+    if (pin >= kMaxPins) return;
+    state().pins[pin].isr = handler;
+    state().pins[pin].isrArg = arg;
+    state().pins[pin].isrMode = mode;
+}
+
+static void callPlainIsr(void* arg) {
+    reinterpret_cast<void (*)(void)>(arg)();
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode) {
+    attachInterruptArg(pin, &callPlainIsr, reinterpret_cast<void*>(handler), mode);
+}
+
+esp_err_t gpio_isr_register(void (*fn)(void*), void* arg, int, intr_handle_t* handle) {
+    if (fn == nullptr || state().gpioIsr != nullptr) return ESP_ERR_INVALID_STATE;
+    state().gpioIsr = fn;
+    state().gpioIsrArg = arg;
+    if (handle != nullptr) {
+        *handle = reinterpret_cast<intr_handle_t>(&state().gpioIsr);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_intr_free(intr_handle_t handle) {
+    if (handle == nullptr) return ESP_ERR_INVALID_ARG;
+    state().gpioIsr = nullptr;
+    state().gpioIsrArg = nullptr;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio, gpio_int_type_t type) {
+    if (gpio < 0 || gpio >= kMaxPins) return ESP_ERR_INVALID_ARG;
+    state().pins[gpio].intrType = type;
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio) {
+    if (gpio < 0 || gpio >= kMaxPins) return ESP_ERR_INVALID_ARG;
+    state().pins[gpio].intrEnabled = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio) {
+    if (gpio < 0 || gpio >= kMaxPins) return ESP_ERR_INVALID_ARG;
+    state().pins[gpio].intrEnabled = false;
+    state().gpioStatus[gpio >> 5] &= ~(1UL << (gpio & 31));
+    return ESP_OK;
+}
+
+void detachInterrupt(uint8_t pin) {
+    if (pin < kMaxPins) {
+        state().pins[pin].isr = nullptr;
+    }
+}
+
+uint32_t ledcSetup(uint8_t channel, uint32_t freq, uint8_t) {
+    if (channel >= kMaxLedc) return 0;
+    state().ledcFreq[channel] = freq;
+    return freq;
+}
+
+void ledcAttachPin(uint8_t, uint8_t) {
+}
+
+void ledcDetachPin(uint8_t) {
+}
+
+void ledcWrite(uint8_t channel, uint32_t duty) {
+    if (channel >= kMaxLedc) return;
+    State& s = state();
+    s.ledcDuty[channel] = duty;
+    if (s.ledcSink) {
+        s.ledcSink(sim::LedcWrite{s.nowUs, channel, duty});
+    }
+}
+
+uint32_t ledcRead(uint8_t channel) {
+    return sim::ledcDuty(channel);
+}
+
+uint32_t ledcChangeFrequency(uint8_t channel, uint32_t freq, uint8_t resolutionBits) {
+    // Драйвер LEDC берет свою блокировку - под spinlock это ошибка
+    if (state().criticalDepth > 0) {
+        state().lockedCalls++;
+    }
+    return ledcSetup(channel, freq, resolutionBits);
+}
+
+// ============================================
+// PCNT
+// ============================================
+
+static PcntUnit* pcntUnit(pcnt_unit_t unit) {
+    return (unit >= 0 && unit < PCNT_UNIT_MAX) ? &state().pcnt[unit] : nullptr;
+}
+
+esp_err_t pcnt_unit_config(const pcnt_config_t* config) {
+    PcntUnit* u = (config != nullptr) ? pcntUnit(config->unit) : nullptr;
+    if (u == nullptr || config->counter_h_lim <= 0 || config->counter_l_lim >= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    u->hLim = config->counter_h_lim;
+    u->lLim = config->counter_l_lim;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_get_counter_value(pcnt_unit_t unit, int16_t* count) {
+    PcntUnit* u = pcntUnit(unit);
+    if (u == nullptr || count == nullptr) return ESP_ERR_INVALID_ARG;
+    *count = u->count;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_pause(pcnt_unit_t unit) {
+    PcntUnit* u = pcntUnit(unit);
+    if (u == nullptr) return ESP_ERR_INVALID_ARG;
+    u->paused = true;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_resume(pcnt_unit_t unit) {
+    PcntUnit* u = pcntUnit(unit);
+    if (u == nullptr) return ESP_ERR_INVALID_ARG;
+    u->paused = false;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_clear(pcnt_unit_t unit) {
+    PcntUnit* u = pcntUnit(unit);
+    if (u == nullptr) return ESP_ERR_INVALID_ARG;
+    u->count = 0;
+    return ESP_OK;
+}
+
+// Фильтр не моделируется: pcntCount() подает уже чистые отсчеты
+esp_err_t pcnt_set_filter_value(pcnt_unit_t unit, uint16_t) {
+    return pcntUnit(unit) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t pcnt_filter_enable(pcnt_unit_t unit) {
+    return pcntUnit(unit) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t pcnt_filter_disable(pcnt_unit_t unit) {
+    return pcntUnit(unit) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t pcnt_set_event_value(pcnt_unit_t unit, pcnt_evt_type_t evtType, int16_t value) {
+    PcntUnit* u = pcntUnit(unit);
+    if (u == nullptr) return ESP_ERR_INVALID_ARG;
+    if (evtType == PCNT_EVT_THRES_0) {
+        u->thres0 = value;
+    } else if (evtType == PCNT_EVT_THRES_1) {
+        u->thres1 = value;
+    } else {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+esp_err_t pcnt_event_enable(pcnt_unit_t unit, pcnt_evt_type_t evtType) {
+    PcntUnit* u = pcntUnit(unit);
+    if (u == nullptr) return ESP_ERR_INVALID_ARG;
+    u->events |= (uint32_t)evtType;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_isr_service_install(int) {
+    if (state().pcntService) return ESP_ERR_INVALID_STATE;
+    state().pcntService = true;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_isr_handler_add(pcnt_unit_t unit, void (*isrHandler)(void*), void* args) {
+    PcntUnit* u = pcntUnit(unit);
+    if (u == nullptr || isrHandler == nullptr) return ESP_ERR_INVALID_ARG;
+    if (!state().pcntService) return ESP_ERR_INVALID_STATE;
+    u->isr = isrHandler;
+    u->isrArg = args;
+    return ESP_OK;
+}
+
+// ============================================
+// Аппаратный таймер
+// ============================================
+
+struct hw_timer_s {
+    uint8_t  num;
+    uint16_t divider;
+    void   (*isr)(void);
+    uint64_t alarm;
+    bool     autoreload;
+    esp_timer_handle_t timer;
+};
+
+static void hwTimerThunk(void* arg) {
+    hw_timer_t* t = static_cast<hw_timer_t*>(arg);
+    if (t->isr != nullptr) {
+        t->isr();
+    }
+}
+
+hw_timer_t* timerBegin(uint8_t num, uint16_t divider, bool) {
+    if (divider == 0) return nullptr;
+    hw_timer_t* t = new hw_timer_t{num, divider, nullptr, 0, false, nullptr};
+    esp_timer_create_args_t args = {};
+    args.callback = &hwTimerThunk;
+    args.arg = t;
+    args.name = "hw_timer";
+    esp_timer_create(&args, &t->timer);
+    return t;
+}
+
+void timerEnd(hw_timer_t* timer) {
+    if (timer == nullptr) return;
+    esp_timer_stop(timer->timer);
+    esp_timer_delete(timer->timer);
+    delete timer;
+}
+
+void timerAttachInterrupt(hw_timer_t* timer, void (*fn)(void), bool) {
+    if (timer != nullptr) timer->isr = fn;
+}
+
+void timerAlarmWrite(hw_timer_t* timer, uint64_t alarmValue, bool autoreload) {
+    if (timer == nullptr) return;
+    timer->alarm = alarmValue;
+    timer->autoreload = autoreload;
+}
+
+void timerAlarmEnable(hw_timer_t* timer) {
+    if (timer == nullptr || timer->alarm == 0) return;
+    // Тик таймера = divider / 80 мкс
+    uint64_t periodUs = timer->alarm * timer->divider / 80;
+    if (periodUs == 0) periodUs = 1;
+    esp_timer_stop(timer->timer);
+    if (timer->autoreload) {
+        esp_timer_start_periodic(timer->timer, periodUs);
+    } else {
+        esp_timer_start_once(timer->timer, periodUs);
+    }
+}
+
+void timerAlarmDisable(hw_timer_t* timer) {
+    if (timer != nullptr) esp_timer_stop(timer->timer);
+}
+
+// ============================================
+// Регистры
+// ============================================
+
+uint32_t simRegRead(uint32_t reg) {
+    if (reg == GPIO_STATUS_REG) {
+        return state().gpioStatus[0];
+    }
+    if (reg == GPIO_STATUS1_REG) {
+        return state().gpioStatus[1];
+    }
+    uint8_t first = 0;
+    if (reg == GPIO_IN_REG) {
+        first = 0;
+    } else if (reg == GPIO_IN1_REG) {
+        first = 32;
+    } else {
+        return 0;
+    }
+    uint32_t value = 0;
+    for (uint8_t bit = 0; bit < 32 && first + bit < kMaxPins; ++bit) {
+        if (state().pins[first + bit].level == HIGH) {
+            value |= 1UL << bit;
+        }
+    }
+    return value;
+}
+
+void simRegWrite(uint32_t reg, uint32_t value) {
+    if (reg == GPIO_STATUS_W1TC_REG) {
+        state().gpioStatus[0] &= ~value;
+    } else if (reg == GPIO_STATUS1_W1TC_REG) {
+        state().gpioStatus[1] &= ~value;
+    }
+}
+
+size_t SimSerial::printf(const char* format, ...) {
+    if (!state().serialEcho) return 0;
+    va_list args;
+    va_start(args, format);
+    const int n = vprintf(format, args);
+    va_end(args);
+    return (n > 0) ? (size_t)n : 0;
+}
+
+size_t SimSerial::print(const char* text) {
+    return state().serialEcho ? (size_t)::printf("%s", text) : 0;
+}
+
+size_t SimSerial::print(long value) {
+    return state().serialEcho ? (size_t)::printf("%ld", value) : 0;
+}
+
+size_t SimSerial::println(const char* text) {
+    return state().serialEcho ? (size_t)::printf("%s\n", text) : 0;
+}
+
+size_t SimSerial::println(long value) {
+    return state().serialEcho ? (size_t)::printf("%ld\n", value) : 0;
+}
+
+size_t SimSerial::println() {
+    return state().serialEcho ? (size_t)::printf("\n") : 0;
+}
+
+// ============================================
+// esp_timer
+// ============================================
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out) {
+    if (args == nullptr || args->callback == nullptr || out == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_timer* t = new esp_timer{args->callback, args->arg, args->name, false, 0, 0, 0};
+    state().timers.push_back(t);
+    *out = t;
+    return ESP_OK;
+}
+
+static esp_err_t armTimer(esp_timer_handle_t timer, uint64_t timeoutUs, uint64_t periodUs) {
+    if (timer == nullptr) return ESP_ERR_INVALID_ARG;
+    if (timer->active) return ESP_ERR_INVALID_STATE;
+    timer->active = true;
+    timer->deadlineUs = state().nowUs + timeoutUs;
+    timer->periodUs = periodUs;
+    timer->armSeq = ++state().armSeq;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs) {
+    return armTimer(timer, timeoutUs, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs) {
+    return armTimer(timer, periodUs, periodUs);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (timer == nullptr) return ESP_ERR_INVALID_ARG;
+    if (!timer->active) return ESP_ERR_INVALID_STATE;
+    timer->active = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    if (timer == nullptr) return ESP_ERR_INVALID_ARG;
+    if (timer->active) return ESP_ERR_INVALID_STATE;
+    std::vector<esp_timer*>& timers = state().timers;
+    timers.erase(std::remove(timers.begin(), timers.end(), timer), timers.end());
+    delete timer;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+    return timer != nullptr && timer->active;
+}
+
+int64_t esp_timer_get_time() {
+    return (int64_t)state().nowUs;
+}
+
+// ============================================
+// FreeRTOS
+// ============================================
+
+BaseType_t xPortGetCoreID() {
+    return state().core;
+}
+
+void simEnterCritical() {
+    state().criticalDepth++;
+}
+
+void simExitCritical() {
+    if (state().criticalDepth > 0) {
+        state().criticalDepth--;
+    }
+}
+
+void vTaskDelay(TickType_t ticks) {
+    sim::advance((uint64_t)ticks * 1000ULL);
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)(state().nowUs / 1000ULL);
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t, const char*, uint32_t, void*, UBaseType_t,
+                                   TaskHandle_t* handle, BaseType_t) {
+    if (handle != nullptr) *handle = nullptr;
+    return pdFAIL;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return &state().task;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks() {
+    return (UBaseType_t)(3 + state().tasks.size());     // IDLE0, IDLE1, текущая
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t* tasks, UBaseType_t maxTasks, uint32_t* totalRunTime) {
+    State& s = state();
+    std::vector<SimTask*> all = {&s.idle[0], &s.idle[1], &s.task};
+    for (SimTask& t : s.tasks) {
+        all.push_back(&t);
+    }
+    if (tasks == nullptr || all.size() > maxTasks) return 0;
+
+    for (size_t i = 0; i < all.size(); ++i) {
+        tasks[i].xHandle = all[i];
+        tasks[i].pcTaskName = all[i]->name;
+        tasks[i].ulRunTimeCounter = all[i]->runTime;
+        tasks[i].xCoreID = all[i]->core;
+        tasks[i].usStackHighWaterMark = uxTaskGetStackHighWaterMark(all[i]);
+    }
+    if (totalRunTime != nullptr) {
+        *totalRunTime = s.totalRunTime;
+    }
+    return (UBaseType_t)all.size();
+}
+
+TaskHandle_t xTaskGetIdleTaskHandleForCPU(UBaseType_t cpu) {
+    return (cpu < portNUM_PROCESSORS) ? &state().idle[cpu] : nullptr;
+}
+
+char* pcTaskGetName(TaskHandle_t task) {
+    return const_cast<char*>((task != nullptr) ? task->name : state().task.name);
+}
+
+BaseType_t xTaskGetAffinity(TaskHandle_t task) {
+    return (task != nullptr) ? task->core : state().task.core;
+}
+
+// Стек не моделируется: запас постоянный
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t) {
+    return 4096;
+}
+
+// Ожидание: ready() проверяется, пока идет время (колбэки таймеров могут
+// освободить ресурс); portMAX_DELAY ограничен ближайшими таймерами
+template <typename Ready>
+static bool waitFor(TickType_t ticks, Ready ready) {
+    if (ready()) return true;
+    if (ticks == 0 || state().inTimer) return false;
+
+    const uint64_t limit = (ticks == portMAX_DELAY) ? UINT64_MAX
+                                                    : state().nowUs + (uint64_t)ticks * 1000ULL;
+    while (sim::runNextTimer(limit)) {
+        if (ready()) return true;
+    }
+    if (limit != UINT64_MAX) {
+        sim::runUntil(limit);
+    }
+    return ready();
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+    SimTask& task = state().task;
+    if (!waitFor(ticks, [&task] { return task.notifyValue > 0; })) return 0;
+    const uint32_t value = task.notifyValue;
+    task.notifyValue = clearOnExit ? 0 : value - 1;
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    if (task == nullptr) return pdFALSE;
+    task->notifyValue++;
+    return pdTRUE;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken) {
+    xTaskNotifyGive(task);
+    if (higherPriorityTaskWoken != nullptr) *higherPriorityTaskWoken = pdFALSE;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return new SimSemaphore{1, 1};
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return new SimSemaphore{0, 1};
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+    delete sem;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+    if (sem == nullptr) return pdFALSE;
+    if (!waitFor(ticks, [sem] { return sem->count > 0; })) return pdFALSE;
+    sem->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    if (sem == nullptr || sem->count >= sem->maxCount) return pdFALSE;
+    sem->count++;
+    return pdTRUE;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    if (length == 0 || itemSize == 0) return nullptr;
+    SimQueue* q = new SimQueue();
+    q->length = length;
+    q->itemSize = itemSize;
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks) {
+    if (queue == nullptr) return pdFALSE;
+    if (!waitFor(ticks, [queue] { return queue->items.size() < queue->length; })) return pdFALSE;
+    const uint8_t* bytes = static_cast<const uint8_t*>(item);
+    queue->items.emplace_back(bytes, bytes + queue->itemSize);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks) {
+    if (queue == nullptr) return pdFALSE;
+    if (!waitFor(ticks, [queue] { return !queue->items.empty(); })) return pdFALSE;
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    return (queue != nullptr) ? (UBaseType_t)queue->items.size() : 0;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+    if (queue != nullptr) {
+        queue->items.clear();
+    }
+    return pdTRUE;
+}
+
+// ============================================
+// Preferences (NVS)
+// ============================================
+
+bool Preferences::begin(const char* name, bool readOnly, const char*) {
+    if (name == nullptr || opened_) return false;
+    namespace_ = name;
+    opened_ = true;
+    readOnly_ = readOnly;
+    return true;
+}
+
+void Preferences::end() {
+    opened_ = false;
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+    if (!opened_ || key == nullptr) return 0;
+    auto it = state().nvs.find(namespace_ + "/" + key);
+    return (it != state().nvs.end()) ? it->second.size() : 0;
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t maxLen) {
+    if (!opened_ || key == nullptr || buf == nullptr) return 0;
+    auto it = state().nvs.find(namespace_ + "/" + key);
+    // Как в Arduino-ESP32: буфер меньше значения - ошибка, 0 байт
+    if (it == state().nvs.end() || it->second.size() > maxLen) return 0;
+    memcpy(buf, it->second.data(), it->second.size());
+    return it->second.size();
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len) {
+    if (!opened_ || readOnly_ || key == nullptr || value == nullptr || len == 0) return 0;
+    const uint8_t* bytes = static_cast<const uint8_t*>(value);
+    state().nvs[namespace_ + "/" + key].assign(bytes, bytes + len);
+    state().nvsWrites++;
+    return len;
+}
+
+bool Preferences::remove(const char* key) {
+    if (!opened_ || readOnly_ || key == nullptr) return false;
+    return state().nvs.erase(namespace_ + "/" + key) > 0;
+}
+
+// ============================================
+// esp_err
+// ============================================
+
+const char* esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK:                return "ESP_OK";
+        case ESP_FAIL:              return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:        return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:   return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_TIMEOUT:       return "ESP_ERR_TIMEOUT";
+        default:                    return "UNKNOWN ERROR";
+    }
+}
+
+// ============================================
+// Память и хуки FreeRTOS
+// ============================================
+
+void* heap_caps_malloc(size_t size, uint32_t) {
+    return malloc(size);
+}
+
+void heap_caps_free(void* ptr) {
+    free(ptr);
+}
+
+esp_err_t esp_register_freertos_tick_hook_for_cpu(esp_freertos_tick_cb_t cb, UBaseType_t cpu) {
+    if (cb == nullptr || cpu >= portNUM_PROCESSORS) return ESP_FAIL;
+    state().tickHooks[cpu].push_back(cb);
+    return ESP_OK;
+}
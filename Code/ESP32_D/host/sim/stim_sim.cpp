@@ -0,0 +1,1346 @@
+// Хостовая симуляция движка стимуляции на виртуальных часах.
+//
+// Сборка и запуск (из Code/ESP32_D/host):
+//   cmake -S . -B build && cmake --build build -j && ./build/stim_sim
+//
+// Каждый сценарий гоняет настоящие EMSPulseGenerator / StimChannelBank /
+// энкодеры / AppState / CommandQueue против host/sim и сверяет каждый фронт
+// LEDC с идеальной шкалой. Код возврата != 0 - хотя бы одна проверка упала.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "sim/SimHal.h"
+
+#include "app/AppState.h"
+#include "app/CommandQueue.h"
+#include "app/StimChannelBank.h"
+#include "app/StimCommandBus.h"
+#include "app/SettingsStore.h"
+#include "app/pins.h"
+#include "drivers/EMSPulseGenerator.h"
+#include "drivers/EncoderC14.h"
+#include "drivers/EncoderEC12.h"
+#include "drivers/EncoderGpioDispatcher.h"
+#include "drivers/EncoderPCNT.h"
+#include "drivers/EncoderSampler.h"
+#include "core/StaticEncoder.h"
+#include "core/DeferredLog.h"
+#include "core/LatencyHistogram.h"
+#include "core/Profiler.h"
+#include "core/TraceRecorder.h"
+
+namespace {
+
+int g_failures = 0;
+
+#define SIM_CHECK(cond, ...)                                               \
+    do {                                                                   \
+        if (!(cond)) {                                                     \
+            ++g_failures;                                                  \
+            std::printf("  FAIL %s:%d: %s: ", __FILE__, __LINE__, #cond);  \
+            std::printf(__VA_ARGS__);                                      \
+            std::printf("\n");                                             \
+            return;                                                        \
+        }                                                                  \
+    } while (0)
+
+// Сверка фронтов одного канала с идеальным циклом пачка/пауза
+struct EdgeChecker {
+    uint8_t  channel;
+    uint64_t originUs;
+    uint32_t burstUs;
+    uint32_t cycleUs;
+    uint32_t toleranceUs;      // допустимое опоздание фронта
+
+    uint64_t cycles = 0;
+    bool     on = false;
+    bool     ok = true;
+    int64_t  worstUs = 0;
+    uint64_t badTimeUs = 0;
+
+    void onWrite(const sim::LedcWrite& w) {
+        if (w.channel != channel || !ok) return;
+
+        const bool level = w.duty > 0;
+        if (level == on) return;   // повторная запись того же уровня
+        const uint64_t ideal = originUs + cycles * cycleUs + (level ? 0 : burstUs);
+        const int64_t err = (int64_t)(w.timeUs - ideal);
+        if (err > worstUs) worstUs = err;
+        if (err < 0 || err > (int64_t)toleranceUs) {
+            ok = false;
+            badTimeUs = w.timeUs;
+        }
+        if (!level) cycles++;
+        on = level;
+    }
+};
+
+double wallMs(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// --------------------------------------------
+// 1. Режим Timer: каждый фронт точно в срок на протяжении суток
+// --------------------------------------------
+void timerModeExact() {
+    sim::reset();
+    EMSPulseGenerator gen(0, PWM_CH_1_PIN, 144, 10, 70);
+    gen.setDriveMode(EMSPulseGenerator::DriveMode::Timer);
+    gen.begin();
+
+    const StimProfile& p = DefaultStimProfile::value;
+    sim::advance(1234);
+    EdgeChecker check{0, sim::now(), p.burstDurationUs, p.fullCycleUs, 0};
+    sim::setLedcSink([&check](const sim::LedcWrite& w) { check.onWrite(w); });
+
+    const auto t0 = std::chrono::steady_clock::now();
+    gen.start();
+    const uint64_t cycles = 250000;    // ~29 часов
+    sim::runUntil(check.originUs + cycles * p.fullCycleUs - 1);
+    const double ms = wallMs(t0);
+
+    SIM_CHECK(check.ok, "edge off by %lld us at t=%llu", (long long)check.worstUs,
+              (unsigned long long)check.badTimeUs);
+    SIM_CHECK(check.cycles == cycles, "cycles %llu", (unsigned long long)check.cycles);
+
+    const EdgeErrorStats::Snapshot s = gen.getEdgeStats();
+    SIM_CHECK(s.maxUs == 0 && s.minUs == 0, "stats min/max %d/%d", s.minUs, s.maxUs);
+
+    // Перезапуск при взведенном таймере: один фронт нового запуска, старый снят
+    sim::setLedcSink(nullptr);
+    sim::advance(p.burstDurationUs / 2);
+    gen.start();
+    SIM_CHECK(sim::nextTimerDeadline() == sim::now() + p.burstDurationUs, "restart deadline %llu",
+              (unsigned long long)(sim::nextTimerDeadline() - sim::now()));
+    gen.stop();
+    SIM_CHECK(sim::nextTimerDeadline() == UINT64_MAX, "timer left armed after stop");
+
+    std::printf("  timer mode: %llu cycles (%.1f h virtual) exact, %.0f ms wall\n",
+                (unsigned long long)cycles, cycles * p.fullCycleUs / 3.6e9, ms);
+}
+
+// --------------------------------------------
+// 2. Режим Timer с задержкой колбэков: ошибка ограничена, дрейфа нет
+// --------------------------------------------
+void timerModeJitterNoDrift() {
+    sim::reset();
+    EMSPulseGenerator gen(0, PWM_CH_1_PIN, 144, 10, 70);
+    gen.setDriveMode(EMSPulseGenerator::DriveMode::Timer);
+    gen.begin();
+    sim::setTimerLatency(20, 180, 7);
+
+    const StimProfile& p = DefaultStimProfile::value;
+    EdgeChecker check{0, sim::now(), p.burstDurationUs, p.fullCycleUs, 200};
+    sim::setLedcSink([&check](const sim::LedcWrite& w) { check.onWrite(w); });
+
+    gen.start();
+    const uint64_t cycles = 100000;
+    sim::runUntil(check.originUs + cycles * p.fullCycleUs - 1);
+
+    SIM_CHECK(check.ok, "edge late by %lld us at t=%llu", (long long)check.worstUs,
+              (unsigned long long)check.badTimeUs);
+    SIM_CHECK(check.cycles == cycles, "cycles %llu", (unsigned long long)check.cycles);
+
+    const EdgeErrorStats::Snapshot s = gen.getEdgeStats();
+    SIM_CHECK(s.minUs >= 20 && s.maxUs <= 200, "stats min/max %d/%d", s.minUs, s.maxUs);
+    std::printf("  timer jitter: %llu cycles, err min/mean/p99/max %d/%d/%d/%d us, no drift\n",
+                (unsigned long long)cycles, s.minUs, s.meanUs, s.p99Us, s.maxUs);
+}
+
+// --------------------------------------------
+// 3. Банк каналов: два профиля на одном таймере
+// --------------------------------------------
+void bankTwoProfiles() {
+    sim::reset();
+    typedef FixedStimProfile<100, 20, 300, 250> FastProfile;
+
+    EMSPulseGenerator a(0, PWM_CH_1_PIN, 144, 10, 70);
+    EMSPulseGenerator b(1, PWM_CH_2_PIN, 1245, 10, 110, FastProfile::value);
+    StimChannelBank bank;
+    bank.addChannel(a);
+    bank.addChannel(b);
+    bank.setWakeMode(StimChannelBank::WakeMode::Timer);
+    bank.begin();
+
+    const StimProfile& pa = DefaultStimProfile::value;
+    const StimProfile& pb = FastProfile::value;
+    EdgeChecker ca{0, sim::now(), pa.burstDurationUs, pa.fullCycleUs, 0};
+    EdgeChecker cb{1, sim::now(), pb.burstDurationUs, pb.fullCycleUs, 0};
+    sim::setLedcSink([&](const sim::LedcWrite& w) {
+        ca.onWrite(w);
+        cb.onWrite(w);
+    });
+
+    bank.startAll();
+    sim::runUntil(3600ULL * 1000000ULL);   // час
+
+    // Несущая канала банка меняется на границе пачки, но не под mux_ банка
+    StimParams params(10);
+    params.carrierHz = 2000;
+    TimingPlan plan;
+    SIM_CHECK(EMSPulseGenerator::buildPlan(params, plan), "build");
+    a.publishPlan(plan);
+    sim::runUntil(sim::now() + pa.fullCycleUs);
+    SIM_CHECK(sim::ledcFreq(0) == 2000, "bank carrier %u", sim::ledcFreq(0));
+    SIM_CHECK(sim::lockedCalls() == 0, "ledcChangeFrequency under spinlock x%u",
+              sim::lockedCalls());
+
+    // Перезапуск канала посреди длинной паузы другого: первый фронт - сразу,
+    // второй - через пачку, а не на фронте соседа
+    bank.stop(1);
+    sim::advance(pb.fullCycleUs / 3);
+    std::vector<uint64_t> restart;
+    sim::setLedcSink([&](const sim::LedcWrite& w) {
+        ca.onWrite(w);
+        if (w.channel == 1) restart.push_back(w.timeUs);
+    });
+    const uint64_t restartUs = sim::now();
+    bank.start(1);
+    sim::runUntil(restartUs + pb.burstDurationUs);
+    SIM_CHECK(restart.size() == 2 && restart[0] == restartUs &&
+              restart[1] == restartUs + pb.burstDurationUs, "restart edges %zu", restart.size());
+    SIM_CHECK(bank.getArmFailures() == 0, "timer arm failures %lu",
+              (unsigned long)bank.getArmFailures());
+
+    SIM_CHECK(ca.ok && cb.ok, "channel edges off (a %lld us, b %lld us)",
+              (long long)ca.worstUs, (long long)cb.worstUs);
+    SIM_CHECK(ca.cycles > 8000 && cb.cycles > 7000, "cycles %llu/%llu",
+              (unsigned long long)ca.cycles, (unsigned long long)cb.cycles);
+    std::printf("  bank: 1 h, %llu + %llu cycles exact, %lu edges\n",
+                (unsigned long long)ca.cycles, (unsigned long long)cb.cycles,
+                (unsigned long)bank.getEdgeCount());
+}
+
+// --------------------------------------------
+// 4. Режим Polling: опоздание опроса не накапливается
+// --------------------------------------------
+void pollingNoDrift() {
+    sim::reset();
+    EMSPulseGenerator gen(0, PWM_CH_1_PIN, 144, 10, 70);
+    gen.begin();
+
+    const StimProfile& p = DefaultStimProfile::value;
+    const uint32_t stepUs = 137;   // период опроса, не кратный циклу
+    EdgeChecker check{0, sim::now(), p.burstDurationUs, p.fullCycleUs, 2 * stepUs};
+    sim::setLedcSink([&check](const sim::LedcWrite& w) { check.onWrite(w); });
+
+    gen.start();
+    const uint64_t cycles = 20000;
+    const uint64_t endUs = check.originUs + cycles * p.fullCycleUs - 1;
+    while (sim::now() < endUs) {
+        gen.update();
+        sim::advance(stepUs);
+    }
+
+    SIM_CHECK(check.ok, "edge late by %lld us at t=%llu", (long long)check.worstUs,
+              (unsigned long long)check.badTimeUs);
+    SIM_CHECK(check.cycles == cycles, "cycles %llu", (unsigned long long)check.cycles);
+    std::printf("  polling: %llu cycles, worst lag %lld us (poll step %u us), no drift\n",
+                (unsigned long long)cycles, (long long)check.worstUs, stepUs);
+}
+
+// --------------------------------------------
+// 5. Программа: RAMP / BURST / PAUSE / LOOP / END
+// --------------------------------------------
+void programSegments() {
+    sim::reset();
+    EMSPulseGenerator gen(0, PWM_CH_1_PIN, 144, 10, 70);
+    gen.setDriveMode(EMSPulseGenerator::DriveMode::Timer);
+    gen.begin();
+
+    static const uint8_t code[] = {
+        'S', 'P', 1, 5,
+        0x03, 50, 0x00, 0x00, 0x00, 0x00,          // RAMP 50% 0 ms
+        0x01, 10, 0, 100, 0, 0x2C, 0x01,           // BURST 10 x 100 Hz, 300 us
+        0x02, 50, 0, 0, 0,                          // PAUSE 50 ms
+        0x04, 2, 0, 1,                              // LOOP 2 -> 1
+        0x00                                        // END
+    };
+    StimProgram program;
+    SIM_CHECK(program.load(code, sizeof(code)) == StimProgramError::None, "load");
+
+    // Проверка по графу переходов, а не по диапазону индексов: JUMP обходит BURST
+    static const uint8_t skipBurst[] = {
+        'S', 'P', 1, 3,
+        0x05, 2,                                    // JUMP 2
+        0x01, 10, 0, 100, 0, 0x2C, 0x01,           // BURST (не выполняется)
+        0x05, 0                                     // JUMP 0
+    };
+    StimProgram bad;
+    uint8_t badIndex = 0xFF;
+    SIM_CHECK(bad.load(skipBurst, sizeof(skipBurst), &badIndex) == StimProgramError::EmptyLoop &&
+              badIndex == 2, "skipped-burst loop accepted (index %u)", badIndex);
+    SIM_CHECK(gen.setProgram(&program), "setProgram");
+
+    std::vector<sim::LedcWrite> writes;
+    sim::setLedcSink([&writes](const sim::LedcWrite& w) { writes.push_back(w); });
+
+    // Смена программы посреди цикла откладывается до следующего start()
+    gen.start();
+    sim::advance(120000);
+    SIM_CHECK(gen.setProgram(nullptr), "setProgram(nullptr)");
+    SIM_CHECK(gen.getProgram() == &program, "program swapped mid-cycle");
+    sim::advance(10ULL * 1000000ULL);
+
+    const uint64_t expectTimes[] = {0, 100000, 150000, 250000, 300000, 400000, 450000};
+    const size_t expectCount = sizeof(expectTimes) / sizeof(expectTimes[0]);
+    SIM_CHECK(writes.size() == expectCount, "writes %zu", writes.size());
+    for (size_t i = 0; i < expectCount; ++i) {
+        const bool on = (i % 2 == 0) && i + 1 < expectCount;
+        SIM_CHECK(writes[i].timeUs == expectTimes[i], "write %zu at %llu", i,
+                  (unsigned long long)writes[i].timeUs);
+        SIM_CHECK((writes[i].duty > 0) == on, "write %zu duty %u", i, writes[i].duty);
+    }
+    // BURST 100 Гц / 300 мкс: несущая 100 Гц, скважность 300/10000 от полной,
+    // RAMP 50% - половина: 511 * 30 / 1023
+    SIM_CHECK(writes[0].duty == 14 && writes[2].duty == 14, "burst duty %u", writes[0].duty);
+    SIM_CHECK(sim::ledcFreq(0) == 100 && gen.getCarrierHz() == 100, "burst carrier %u",
+              sim::ledcFreq(0));
+    SIM_CHECK(!gen.isRunning(), "program should stop at END");
+    gen.start();
+    SIM_CHECK(gen.getProgram() == nullptr, "pending program not installed by start()");
+    gen.stop();
+    std::printf("  program: 3 bursts / 3 pauses / END at exact times, BURST rate/width on the carrier\n");
+}
+
+// --------------------------------------------
+// 6. Мягкий старт: скважность растет по пачкам до цели
+// --------------------------------------------
+void softStartRamp() {
+    sim::reset();
+    EMSPulseGenerator gen(0, PWM_CH_1_PIN, 144, 10, 70);
+    gen.setDriveMode(EMSPulseGenerator::DriveMode::Timer);
+    gen.setSoftStartMs(2000);
+    gen.begin();
+
+    std::vector<uint32_t> burstDuty;
+    sim::setLedcSink([&burstDuty](const sim::LedcWrite& w) {
+        if (w.duty > 0) burstDuty.push_back(w.duty);
+    });
+
+    gen.start();
+    sim::advance(5ULL * 1000000ULL);
+
+    SIM_CHECK(burstDuty.size() >= 8, "bursts %zu", burstDuty.size());
+    for (size_t i = 1; i < burstDuty.size(); ++i) {
+        SIM_CHECK(burstDuty[i] >= burstDuty[i - 1], "duty fell at burst %zu", i);
+    }
+    SIM_CHECK(burstDuty[0] < 70 && burstDuty.back() == 70, "duty %u -> %u",
+              burstDuty[0], burstDuty.back());
+    std::printf("  soft start: duty %u -> %u over %zu bursts\n",
+                burstDuty[0], burstDuty.back(), burstDuty.size());
+}
+
+// --------------------------------------------
+// 7. Энкодеры: квадратура на пинах -> шаги в update()
+// --------------------------------------------
+void encoders() {
+    sim::reset();
+    EncoderEC12 ec12(ENC_A_CLK_PIN, ENC_A_DT_PIN, 1000);
+    EncoderC14  c14(ENC_B_CLK_PIN, ENC_B_DT_PIN, 50);
+    int32_t ec12Sum = 0, c14Sum = 0;
+    ec12.onStep([&ec12Sum](int8_t d) { ec12Sum += d; });
+    c14.onStep([&c14Sum](int8_t d) { c14Sum += d; });
+    SIM_CHECK(ec12.begin() && c14.begin(), "begin");
+
+    // EC12: DT в LOW при спаде CLK = +1
+    for (int i = 0; i < 20; ++i) {
+        sim::setPin(ENC_A_DT_PIN, LOW);
+        sim::setPin(ENC_A_CLK_PIN, LOW);
+        sim::setPin(ENC_A_DT_PIN, HIGH);
+        sim::setPin(ENC_A_CLK_PIN, HIGH);
+        sim::advance(2000);
+    }
+    ec12.update();
+    SIM_CHECK(ec12Sum == 20, "EC12 steps %d", ec12Sum);
+
+    // C14: полный квадратурный цикл 11 -> 01 -> 00 -> 10 -> 11 = 4 шага
+    for (int i = 0; i < 10; ++i) {
+        sim::setPin(ENC_B_CLK_PIN, LOW);
+        sim::setPin(ENC_B_DT_PIN, LOW);
+        sim::setPin(ENC_B_CLK_PIN, HIGH);
+        sim::setPin(ENC_B_DT_PIN, HIGH);
+    }
+    c14.update();
+    SIM_CHECK(c14Sum == 40 || c14Sum == -40, "C14 steps %d", c14Sum);
+
+    // Скорость и задержка по меткам ISR: щелчок каждые 2 мс = 500/с
+    const int32_t velocity = ec12.getVelocity();
+    SIM_CHECK(velocity > 450 && velocity <= 500, "velocity %d", velocity);
+    const IEncoder::LatencyStats::Snapshot lat = ec12.getLatencyStats();
+    SIM_CHECK(lat.count == 20 && lat.minUs == 2000 && lat.maxUs == 40000, "latency %lu %d..%d",
+              (unsigned long)lat.count, lat.minUs, lat.maxUs);
+
+    // UI задержался: 300 щелчков без update() - больше кольца и больше int8_t
+    ec12Sum = 0;
+    for (int i = 0; i < 300; ++i) {
+        sim::setPin(ENC_A_DT_PIN, LOW);
+        sim::setPin(ENC_A_CLK_PIN, LOW);
+        sim::setPin(ENC_A_DT_PIN, HIGH);
+        sim::setPin(ENC_A_CLK_PIN, HIGH);
+    }
+    ec12.update();
+    SIM_CHECK(ec12Sum == 300, "lossless steps %d", ec12Sum);
+    SIM_CHECK(ec12.getDroppedEvents() == 300 - IEncoder::kEventCapacity, "dropped %lu",
+              (unsigned long)ec12.getDroppedEvents());
+    sim::advance(IEncoder::kVelocityTimeoutUs);
+    ec12.update();
+    SIM_CHECK(ec12.getVelocity() == 0, "velocity must decay");
+
+    std::printf("  encoders: EC12 %d steps, C14 %d steps, 300-step burst lossless, %d steps/s\n",
+                20, c14Sum, velocity);
+}
+
+// --------------------------------------------
+// 8. AppState + CommandQueue
+// --------------------------------------------
+void stateAndQueue(CommandQueue::Backend backend, const char* name) {
+    sim::reset();
+    AppState state;
+    CommandQueue queue(4, backend);
+
+    SIM_CHECK(state.adjustEncoderA(5) && state.getAmplitude() == 15, "amp %u", state.getAmplitude());
+    SIM_CHECK(state.adjustEncoderB(-3) && state.getAmplitude() == 15, "B must not move amp");
+    const AppStateSnapshot snap = state.getSnapshot();
+    SIM_CHECK(snap.encoderA.position == 5 && snap.encoderB.value == 7 && snap.params.stimDuty == 15,
+              "snapshot A%ld B%u amp %u", (long)snap.encoderA.position, snap.encoderB.value,
+              snap.params.stimDuty);
+    SIM_CHECK(queue.send(Command(CommandType::UPDATE_STIM_1_PARAMS, state.getStimParams())), "send");
+
+    Command cmd;
+    SIM_CHECK(queue.receive(cmd, 0) && cmd.params.stimDuty == 15, "receive");
+
+    // Пустая очередь с таймаутом "спит" ровно таймаут виртуального времени
+    const uint64_t t0 = sim::now();
+    SIM_CHECK(!queue.receive(cmd, 100), "receive on empty queue");
+    SIM_CHECK(sim::now() - t0 == 100000, "blocked %llu us", (unsigned long long)(sim::now() - t0));
+
+    // Команда из "другой задачи" (колбэк таймера) будит ждущего читателя сразу
+    esp_timer_handle_t sender = nullptr;
+    esp_timer_create_args_t args = {};
+    args.callback = [](void* arg) {
+        static_cast<CommandQueue*>(arg)->send(Command(CommandType::STOP_STIM));
+    };
+    args.arg = &queue;
+    args.name = "sender";
+    SIM_CHECK(esp_timer_create(&args, &sender) == ESP_OK, "timer");
+    esp_timer_start_once(sender, 30000);
+
+    const uint64_t t1 = sim::now();
+    SIM_CHECK(queue.receive(cmd, 100) && cmd.type == CommandType::STOP_STIM, "wake on send");
+    SIM_CHECK(sim::now() - t1 == 30000, "woke after %llu us", (unsigned long long)(sim::now() - t1));
+    esp_timer_delete(sender);
+
+    // Переполнение: четыре места, пятая команда без таймаута отклоняется
+    for (int i = 0; i < 4; ++i) {
+        SIM_CHECK(queue.send(Command(CommandType::GET_STATUS)), "send %d", i);
+    }
+    SIM_CHECK(!queue.send(Command(CommandType::GET_STATUS)) && queue.getCount() == 4, "overflow");
+    queue.clear();
+    SIM_CHECK(!queue.hasCommands(), "clear");
+    std::printf("  app state + command queue (%s): ok\n", name);
+}
+
+// --------------------------------------------
+// 9. StimCommandBus: уставки схлопываются, аварийная полоса первая
+// --------------------------------------------
+void commandBusLanes() {
+    sim::reset();
+    StimCommandBus bus;
+    SIM_CHECK(bus.isValid(), "bus");
+
+    // START/STOP в порядке отправки; уставки через очередь не принимаются
+    Command cmd;
+    SIM_CHECK(bus.send(Command(CommandType::START_STIM)), "send start");
+    SIM_CHECK(bus.send(Command(CommandType::STOP_STIM)), "send stop");
+    SIM_CHECK(!bus.send(Command(CommandType::UPDATE_STIM_1_PARAMS)), "params via queue");
+    SIM_CHECK(bus.receiveControl(cmd) && cmd.type == CommandType::START_STIM, "order 1");
+    SIM_CHECK(bus.receiveControl(cmd) && cmd.type == CommandType::STOP_STIM, "order 2");
+
+    // Аварийная остановка сбрасывает то, что стояло до нее
+    bus.send(Command(CommandType::START_STIM));
+    SIM_CHECK(bus.send(Command(CommandType::EMERGENCY_STOP)), "estop");
+    SIM_CHECK(bus.takeEmergencyStop(), "estop taken");
+    SIM_CHECK(!bus.takeEmergencyStop(), "estop once");
+    SIM_CHECK(!bus.receiveControl(cmd), "flushed");
+    SIM_CHECK(!bus.hasPending(), "nothing pending");
+
+    // Остановка из другой задачи будит спящий Stim_Task сразу
+    esp_timer_handle_t stopper = nullptr;
+    esp_timer_create_args_t args = {};
+    args.callback = [](void* arg) {
+        static_cast<StimCommandBus*>(arg)->emergencyStop();
+    };
+    args.arg = &bus;
+    args.name = "stopper";
+    SIM_CHECK(esp_timer_create(&args, &stopper) == ESP_OK, "timer");
+    esp_timer_start_once(stopper, 20000);
+    const uint64_t t0 = sim::now();
+    SIM_CHECK(bus.wait(100), "wait");
+    SIM_CHECK(sim::now() - t0 == 20000, "woke after %llu us", (unsigned long long)(sim::now() - t0));
+    SIM_CHECK(bus.takeEmergencyStop(), "woken estop");
+    esp_timer_delete(stopper);
+
+    std::printf("  command bus: control order kept, estop first and flushes, wake on estop\n");
+}
+
+// --------------------------------------------
+// 10. TimingPlan: публикация посреди пачки вступает с конца пачки
+// --------------------------------------------
+void planAtBurstEnd(EMSPulseGenerator::DriveMode mode, const char* name) {
+    sim::reset();
+    EMSPulseGenerator gen(0, PWM_CH_1_PIN, 144, 10, 70);
+    gen.setDriveMode(mode);
+    gen.begin();
+
+    std::vector<sim::LedcWrite> edges;
+    sim::setLedcSink([&edges](const sim::LedcWrite& w) {
+        if (edges.empty() || (edges.back().duty > 0) != (w.duty > 0)) edges.push_back(w);
+    });
+
+    const bool polling = (mode == EMSPulseGenerator::DriveMode::Polling);
+    const uint32_t stepUs = 10;
+    auto runTo = [&](uint64_t t) {
+        if (!polling) {
+            sim::runUntil(t);
+            return;
+        }
+        while (sim::now() < t) {
+            gen.update();
+            sim::advance(stepUs);
+        }
+    };
+
+    const StimProfile& old = DefaultStimProfile::value;
+    const uint64_t t0 = sim::now();
+    gen.start();
+    runTo(t0 + 50000);
+
+    // Быстрый поворот: десять планов до границы, вступает последний
+    StimParams params(10);
+    params.rateHz = 100;
+    params.pulsesPerBurst = 20;
+    params.pauseMs = 300;
+    params.pulseWidthUs = 250;
+    params.carrierHz = 2000;
+    TimingPlan plan;
+    for (uint8_t amp = 31; amp <= 40; ++amp) {
+        params.stimDuty = amp;
+        SIM_CHECK(EMSPulseGenerator::buildPlan(params, plan), "build");
+        gen.publishPlan(plan);
+    }
+    StimParams bad(10);
+    bad.rateHz = 0;
+    SIM_CHECK(!EMSPulseGenerator::buildPlan(bad, plan), "invalid params must not build");
+    // 1 Гц x 5000 импульсов: пачка 5000 с не влезает в 32 бита и не должна "завернуться"
+    StimParams huge(10);
+    huge.rateHz = 1;
+    huge.pulsesPerBurst = 5000;
+    huge.pauseMs = 100;
+    SIM_CHECK(!StimProfile::fromPause(1, 5000, 100, 200).isValid(), "wrapped burst accepted");
+    SIM_CHECK(!EMSPulseGenerator::buildPlan(huge, plan), "oversized burst must not build");
+
+    const uint32_t newBurst = 20 * 10000;
+    const uint64_t expect[] = {
+        t0,                                           // старая пачка
+        t0 + old.burstDurationUs,                     // ее конец - по старому плану
+        t0 + old.burstDurationUs + 300000,            // новая пауза
+        t0 + old.burstDurationUs + 300000 + newBurst, // новая пачка
+        t0 + old.burstDurationUs + 600000 + newBurst,
+    };
+    runTo(expect[4] + 1000);
+
+    const int64_t tol = polling ? 2 * stepUs : 0;
+    SIM_CHECK(edges.size() >= 5, "edges %zu", edges.size());
+    for (size_t i = 0; i < 5; ++i) {
+        const int64_t err = (int64_t)(edges[i].timeUs - expect[i]);
+        SIM_CHECK(err >= 0 && err <= tol, "edge %zu off by %lld us", i, (long long)err);
+    }
+    SIM_CHECK(edges[0].duty == 70, "old burst duty %u", edges[0].duty);
+    SIM_CHECK(edges[2].duty == 409 && edges[4].duty == 409, "new duty %u", edges[2].duty);
+    SIM_CHECK(sim::ledcFreq(0) == 2000 && gen.getCarrierHz() == 2000, "carrier %u",
+              sim::ledcFreq(0));
+    SIM_CHECK(gen.getPlansApplied() == 1, "plans applied %lu", (unsigned long)gen.getPlansApplied());
+    std::printf("  timing plan (%s): 10 posts -> 1 plan at burst end, duty/timing/carrier together\n",
+                name);
+}
+
+// --------------------------------------------
+// 11. SettingsStore: объединение записей, STOP, восстановление после "перезагрузки"
+// --------------------------------------------
+void settingsCoalesce() {
+    sim::reset();
+    sim::nvsErase();
+
+    StoredSettings settings;
+    uint32_t spinCommits = 0;
+    {
+        SettingsStore store;
+        SIM_CHECK(!store.begin() && !store.hasRestored(), "empty NVS must not restore");
+
+        // Минуту крутим ручку (шаг каждые 20 мс), писатель просыпается раз в 100 мс
+        const uint64_t spinUs = 60ULL * 1000000ULL;
+        const uint64_t end = sim::now() + spinUs;
+        uint32_t step = 0;
+        while (sim::now() < end) {
+            settings.app.encoderA.position = (int32_t)++step;
+            settings.app.encoderA.value = (uint8_t)(step % 101);
+            settings.app.params.stimDuty = settings.app.encoderA.value;
+            settings.channels[1] = settings.app.params;
+            settings.channelMask = 1U << 1;
+            store.save(settings);
+            if (step % 5 == 0) {
+                store.commit(false);
+            }
+            sim::advance(20000);
+        }
+        const uint32_t maxCommits = (uint32_t)(spinUs / 1000 / SettingsStore::kMinCommitIntervalMs) + 1;
+        SIM_CHECK(sim::nvsWriteCount() <= maxCommits, "%u commits for %u steps",
+                  sim::nvsWriteCount(), step);
+        SIM_CHECK(sim::nvsWriteCount() >= maxCommits - 1, "too few commits %u",
+                  sim::nvsWriteCount());
+        spinCommits = sim::nvsWriteCount();
+
+        // STOP: последний снимок пишется сразу, минуя интервал
+        settings.app.encoderB.value = 77;
+        store.save(settings);
+        const uint32_t before = sim::nvsWriteCount();
+        SIM_CHECK(!store.commit(false), "interval must hold");
+        SIM_CHECK(store.commit(true), "forced commit");
+        SIM_CHECK(sim::nvsWriteCount() == before + 1, "forced write");
+
+        // То же содержимое - флеш не трогаем
+        store.save(settings);
+        sim::advance(10ULL * 1000000ULL);
+        SIM_CHECK(!store.commit(true) && store.getSkippedCount() == 1, "unchanged must skip");
+        SIM_CHECK(sim::nvsWriteCount() == before + 1, "unchanged write");
+    }
+
+    // "Перезагрузка": новый объект, одно чтение
+    SettingsStore reboot;
+    SIM_CHECK(reboot.begin() && reboot.hasRestored(), "restore");
+    SIM_CHECK(reboot.restored() == settings, "restored differs");
+    SIM_CHECK(!reboot.isDirty(), "restored must be clean");
+
+    AppState state;
+    state.restore(reboot.restored().app);
+    SIM_CHECK(state.getEncoderBValue() == 77 && state.getAmplitude() == settings.app.params.stimDuty,
+              "app state B=%u amp=%u", state.getEncoderBValue(), state.getAmplitude());
+
+    // Битый blob (другой размер) - значения по умолчанию
+    Preferences prefs;
+    prefs.begin("stim");
+    const uint8_t junk[8] = {};
+    prefs.putBytes("settings", junk, sizeof(junk));
+    SettingsStore corrupt;
+    SIM_CHECK(!corrupt.begin(), "corrupt blob must not restore");
+
+    std::printf("  settings: 1 min of knob -> %u commits, STOP forces, reboot restores\n",
+                spinCommits);
+}
+
+// --------------------------------------------
+// 12. AppState: подписка на поля, пробуждение только по своим изменениям
+// --------------------------------------------
+void appStateSubscribe() {
+    sim::reset();
+    AppState state;
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+    const int8_t display = state.subscribe(self, AppState::kFieldEncoderA | AppState::kFieldParams);
+    const int8_t status = state.subscribe(self, AppState::kFieldStimRunning);
+    SIM_CHECK(display >= 0 && status >= 0, "subscribe");
+    ulTaskNotifyTake(pdTRUE, 0);
+
+    const uint32_t v0 = state.getVersion();
+    state.adjustEncoderB(3);
+    SIM_CHECK(state.takeChanges(display) == 0 && state.takeChanges(status) == 0, "B is not watched");
+    SIM_CHECK(ulTaskNotifyTake(pdTRUE, 0) == 0, "no wake for unwatched field");
+    SIM_CHECK(state.getVersion() == v0 + 1, "version %lu", (unsigned long)state.getVersion());
+
+    // Энкодер A меняет и амплитуду: оба бита одним уведомлением
+    state.adjustEncoderA(5);
+    SIM_CHECK(ulTaskNotifyTake(pdTRUE, 0) == 1, "wake on A");
+    SIM_CHECK(state.takeChanges(display) == (AppState::kFieldEncoderA | AppState::kFieldParams),
+              "display bits");
+    SIM_CHECK(state.takeChanges(display) == 0, "bits cleared");
+
+    // Повтор того же значения - не изменение
+    state.setStimRunning(true);
+    state.setStimRunning(true);
+    SIM_CHECK(state.takeChanges(status) == AppState::kFieldStimRunning, "running bit");
+    SIM_CHECK(ulTaskNotifyTake(pdTRUE, 0) == 1, "one wake for one change");
+    state.setAmplitude(state.getAmplitude());
+    SIM_CHECK(state.takeChanges(display) == 0, "same amplitude is not a change");
+
+    // Ожидание: изменение из колбэка таймера будит подписчика
+    esp_timer_handle_t writer = nullptr;
+    esp_timer_create_args_t args = {};
+    args.callback = [](void* arg) { static_cast<AppState*>(arg)->setAmplitude(42); };
+    args.arg = &state;
+    args.name = "writer";
+    SIM_CHECK(esp_timer_create(&args, &writer) == ESP_OK, "timer");
+    esp_timer_start_once(writer, 30000);
+    const uint64_t t0 = sim::now();
+    SIM_CHECK(state.waitChanges(display, 100) == AppState::kFieldParams, "wait bits");
+    SIM_CHECK(sim::now() - t0 == 30000, "woke after %llu us", (unsigned long long)(sim::now() - t0));
+    SIM_CHECK(state.waitChanges(display, 50) == 0, "timeout");
+    esp_timer_delete(writer);
+
+    for (uint8_t i = 2; i < AppState::kMaxSubscribers; ++i) {
+        state.subscribe(self, AppState::kFieldAll);
+    }
+    SIM_CHECK(state.subscribe(self, AppState::kFieldAll) < 0, "subscriber table must be bounded");
+
+    std::printf("  app state subscribe: wake only on watched fields, bits per subscriber\n");
+}
+
+// --------------------------------------------
+// 13. Опрос энкодеров таймером: дребезг не доходит до автомата, ISR - по часам
+// --------------------------------------------
+void sampledEncoders() {
+    sim::reset();
+    SampledEncoder a(ENC_A_CLK_PIN, ENC_A_DT_PIN, 4, false, 1000);
+    SampledEncoder b(ENC_B_CLK_PIN, ENC_B_DT_PIN, 1, false, 1000);
+    int32_t aSum = 0, bSum = 0;
+    a.onStep([&aSum](int8_t d) { aSum += d; });
+    b.onStep([&bSum](int8_t d) { bSum += d; });
+    SIM_CHECK(a.begin() && b.begin(), "begin");
+
+    EncoderSampler sampler(4000);
+    SIM_CHECK(sampler.add(a) && sampler.add(b), "add");
+    SIM_CHECK(sampler.begin(), "sampler begin");
+
+    // Смена уровня с дребезгом: bounces переключений по 20 мкс, потом 2 мс покоя
+    auto bouncyEdge = [](uint8_t pin, int level, int bounces) {
+        for (int i = 0; i < bounces; ++i) {
+            sim::setPin(pin, (i & 1) ? level : !level);
+            sim::advance(20);
+        }
+        sim::setPin(pin, level);
+        sim::advance(2000);
+    };
+
+    // 10 щелчков A (цикл 11 -> 10 -> 00 -> 01 -> 11 = +1) и B в обратную сторону
+    const uint64_t t0 = sim::now();
+    for (int i = 0; i < 10; ++i) {
+        bouncyEdge(ENC_A_DT_PIN, LOW, 7);
+        bouncyEdge(ENC_A_CLK_PIN, LOW, 7);
+        bouncyEdge(ENC_A_DT_PIN, HIGH, 7);
+        bouncyEdge(ENC_A_CLK_PIN, HIGH, 7);
+
+        bouncyEdge(ENC_B_CLK_PIN, LOW, 7);
+        bouncyEdge(ENC_B_DT_PIN, LOW, 7);
+        bouncyEdge(ENC_B_CLK_PIN, HIGH, 7);
+        bouncyEdge(ENC_B_DT_PIN, HIGH, 7);
+    }
+    a.update();
+    b.update();
+    SIM_CHECK(aSum == 10, "A steps %d", aSum);
+    SIM_CHECK(bSum == -40, "B steps %d", bSum);
+
+    // Шторм дребезга: 5000 переключений за 100 мс - число ISR не меняется
+    const uint32_t before = sampler.getSampleCount();
+    const uint64_t t1 = sim::now();
+    for (int i = 0; i < 5000; ++i) {
+        sim::setPin(ENC_A_CLK_PIN, (i & 1) ? HIGH : LOW);
+        sim::advance(20);
+    }
+    sim::setPin(ENC_A_CLK_PIN, HIGH);
+    sim::advance(2000);
+    const uint32_t samples = sampler.getSampleCount() - before;
+    const uint32_t expected = (uint32_t)((sim::now() - t1) / 250);
+    SIM_CHECK(samples >= expected - 1 && samples <= expected + 1, "samples %lu, expected %lu",
+              (unsigned long)samples, (unsigned long)expected);
+    a.update();
+    SIM_CHECK(aSum == 10, "storm must not step, A %d", aSum);
+    sampler.end();
+
+    std::printf("  sampled encoders: bouncy A %d / B %d steps, %lu samples in %.1f s regardless of bounce\n",
+                aSum, bSum, (unsigned long)sampler.getSampleCount(), (sim::now() - t0) / 1e6);
+}
+
+// --------------------------------------------
+// 14. Статический энкодер: те же шаги, что и виртуальный, на одной последовательности
+// --------------------------------------------
+struct StepSum {
+    int32_t* sum;
+    void operator()(int8_t d) { *sum += d; }
+};
+
+// Случайное блуждание по квадратуре (с откатами) сразу на двух парах пинов
+void walkBoth(uint32_t seed, int edges) {
+    uint8_t state = 0x03;   // [CLK, DT]
+    for (int i = 0; i < edges; ++i) {
+        seed = seed * 1664525UL + 1013904223UL;
+        // Соседние состояния кода Грея: 00 <-> 01 <-> 11 <-> 10 <-> 00
+        static const uint8_t kNext[4][2] = {{1, 2}, {3, 0}, {0, 3}, {2, 1}};
+        state = kNext[state][(seed >> 16) & 1];
+        const int clk = (state >> 1) & 1;
+        const int dt  = state & 1;
+        sim::setPin(ENC_A_CLK_PIN, clk);
+        sim::setPin(ENC_A_DT_PIN,  dt);
+        sim::setPin(ENC_B_CLK_PIN, clk);
+        sim::setPin(ENC_B_DT_PIN,  dt);
+        sim::advance(500);
+    }
+}
+
+template <class VirtualEnc, class Decoder>
+bool sameSteps(uint32_t seed, int32_t& virtualSum, int32_t& staticSum) {
+    sim::reset();
+    virtualSum = 0;
+    staticSum = 0;
+    VirtualEnc ref(ENC_A_CLK_PIN, ENC_A_DT_PIN, 50);
+    ref.onStep([&virtualSum](int8_t d) { virtualSum += d; });
+    StaticEncoder<Decoder, StepSum> fast(ENC_B_CLK_PIN, ENC_B_DT_PIN, StepSum{&staticSum});
+    if (!ref.begin() || !fast.begin()) {
+        return false;
+    }
+    for (int round = 0; round < 20; ++round) {
+        walkBoth(seed + round, 40);
+        ref.update();
+        fast.update();
+    }
+    return virtualSum == staticSum && fast.getDroppedEvents() == 0;
+}
+
+void staticEncoders() {
+    int32_t ec12Virtual = 0, ec12Static = 0, c14Virtual = 0, c14Static = 0;
+    SIM_CHECK((sameSteps<EncoderEC12, EC12Decoder>(7, ec12Virtual, ec12Static)),
+              "EC12 virtual %d / static %d", ec12Virtual, ec12Static);
+    SIM_CHECK((sameSteps<EncoderC14, C14Decoder>(11, c14Virtual, c14Static)),
+              "C14 virtual %d / static %d", c14Virtual, c14Static);
+
+    // Указатель на функцию как обработчик; пустой - щелчки просто выбираются
+    sim::reset();
+    StaticEncoder<EC12Decoder> bare(ENC_A_CLK_PIN, ENC_A_DT_PIN);
+    SIM_CHECK(bare.begin(), "begin");
+    walkBoth(3, 40);
+    bare.update();
+
+    std::printf("  static encoders: EC12 %d / %d, C14 %d / %d steps (virtual / static)\n",
+                ec12Virtual, ec12Static, c14Virtual, c14Static);
+}
+
+// --------------------------------------------
+// 15. Общий обработчик GPIO: 8 энкодеров, пачка фронтов - один вход в ISR
+// --------------------------------------------
+void gpioDispatcher() {
+    sim::reset();
+    // Пины в обоих банках статуса (0-31 и 32-48); нечетные - шаг на переход, обратные
+    static const uint8_t kPins[8][2] = {
+        {4, 5}, {6, 7}, {8, 9}, {10, 11}, {12, 13}, {14, 15}, {35, 36}, {37, 38}
+    };
+    DispatchedEncoder* enc[8];
+    int32_t sums[8] = {};
+    EncoderGpioDispatcher dispatcher;
+    IsrProfile isrProfile("gpio");
+    dispatcher.setIsrProfile(&isrProfile);
+    for (int i = 0; i < 8; ++i) {
+        enc[i] = new DispatchedEncoder(kPins[i][0], kPins[i][1], (i & 1) ? 1 : 4, (i & 1) != 0);
+        int32_t* sum = &sums[i];
+        enc[i]->onStep([sum](int8_t d) { *sum += d; });
+        SIM_CHECK(enc[i]->begin(), "begin %d", i);
+        SIM_CHECK(dispatcher.add(*enc[i]), "add %d", i);
+    }
+    DispatchedEncoder clash(5, 20);
+    SIM_CHECK(!dispatcher.add(clash), "shared pin must be rejected");
+    SIM_CHECK(dispatcher.begin(), "dispatcher begin");
+
+    // Цикл 11 -> 10 -> 00 -> 01 -> 11 (+4 перехода): по одному фронту на пин
+    const int kClkDt[4][2] = {{1, 0}, {0, 0}, {0, 1}, {1, 1}};
+
+    // По одному энкодеру: каждый фронт - свой вход в ISR
+    for (int t = 0; t < 4; ++t) {
+        sim::setPin(kPins[0][0], kClkDt[t][0]);
+        sim::setPin(kPins[0][1], kClkDt[t][1]);
+    }
+    enc[0]->update();
+    SIM_CHECK(sums[0] == 1, "single encoder %d", sums[0]);
+    SIM_CHECK(dispatcher.getIsrCount() == 4, "isr %lu", (unsigned long)dispatcher.getIsrCount());
+
+    // Все 8 крутятся одновременно: 10 циклов, переход всех - под маской
+    const uint32_t isrBefore = dispatcher.getIsrCount();
+    const uint32_t edgesBefore = dispatcher.getEdgeCount();
+    for (int cycle = 0; cycle < 10; ++cycle) {
+        for (int t = 0; t < 4; ++t) {
+            sim::setGpioIrqMasked(true);
+            for (int i = 0; i < 8; ++i) {
+                sim::setPin(kPins[i][0], kClkDt[t][0]);
+                sim::setPin(kPins[i][1], kClkDt[t][1]);
+            }
+            sim::setGpioIrqMasked(false);
+        }
+    }
+    for (int i = 0; i < 8; ++i) {
+        enc[i]->update();
+    }
+    const uint32_t isrs = dispatcher.getIsrCount() - isrBefore;
+    const uint32_t edges = dispatcher.getEdgeCount() - edgesBefore;
+    SIM_CHECK(isrs == 40, "burst isr entries %lu", (unsigned long)isrs);
+    SIM_CHECK(edges == 320, "burst edges %lu", (unsigned long)edges);
+    for (int i = 0; i < 8; ++i) {
+        const int32_t expected = (i == 0 ? 1 : 0) + ((i & 1) ? -40 : 10);
+        SIM_CHECK(sums[i] == expected, "encoder %d steps %d, expected %d", i, sums[i], expected);
+    }
+
+    dispatcher.end();
+    sim::setPin(kPins[0][0], 0);
+    SIM_CHECK(dispatcher.getIsrCount() - isrBefore == 40, "no ISR after end()");
+    // Профиль ISR видит каждый вход обработчика
+    const IsrProfile::Totals totals = isrProfile.takeTotals();
+    SIM_CHECK(totals.count == dispatcher.getIsrCount(), "profiled ISR entries %lu",
+              (unsigned long)totals.count);
+
+    std::printf("  gpio dispatcher: 8 encoders, %lu edges in %lu ISR entries (%.0f edges/entry)\n",
+                (unsigned long)edges, (unsigned long)isrs, (double)edges / isrs);
+    for (int i = 0; i < 8; ++i) {
+        delete enc[i];
+    }
+}
+
+// --------------------------------------------
+// 16. UI по событиям: в покое уведомлений нет, щелчок будит задачу сразу
+// --------------------------------------------
+void encoderWakeups() {
+    sim::reset();
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+    EncoderEC12 edge(ENC_A_CLK_PIN, ENC_A_DT_PIN, 1000);
+    SampledEncoder sampled(ENC_B_CLK_PIN, ENC_B_DT_PIN, 1, false, 500);
+    int32_t edgeSum = 0, sampledSum = 0;
+    edge.onStep([&edgeSum](int8_t d) { edgeSum += d; });
+    sampled.onStep([&sampledSum](int8_t d) { sampledSum += d; });
+    edge.setWakeTask(self);
+    sampled.setWakeTask(self);
+    SIM_CHECK(edge.begin() && sampled.begin(), "begin");
+    EncoderSampler sampler(4000);
+    SIM_CHECK(sampler.add(sampled) && sampler.begin(), "sampler");
+
+    // 1 с покоя: сэмплер тикает 4000 раз, но задачу не будит
+    ulTaskNotifyTake(pdTRUE, 0);
+    SIM_CHECK(ulTaskNotifyTake(pdTRUE, 1000) == 0, "idle wakeup");
+
+    // Щелчок EC12: уведомление в самом ISR
+    uint64_t t0 = sim::now();
+    sim::setPin(ENC_A_DT_PIN, LOW);
+    sim::setPin(ENC_A_CLK_PIN, LOW);
+    SIM_CHECK(ulTaskNotifyTake(pdTRUE, 100) > 0, "EC12 must wake");
+    const uint64_t edgeLatency = sim::now() - t0;
+    edge.update();
+    SIM_CHECK(edgeSum == 1 && edgeLatency == 0, "EC12 steps %d, wake after %llu us", edgeSum,
+              (unsigned long long)edgeLatency);
+    sim::setPin(ENC_A_DT_PIN, HIGH);
+    sim::setPin(ENC_A_CLK_PIN, HIGH);
+    ulTaskNotifyTake(pdTRUE, 0);
+
+    // Переход на опрашиваемом энкодере: будит после фильтра (2 отсчета по 250 мкс)
+    t0 = sim::now();
+    sim::setPin(ENC_B_DT_PIN, LOW);
+    SIM_CHECK(ulTaskNotifyTake(pdTRUE, 100) > 0, "sampled must wake");
+    const uint64_t sampledLatency = sim::now() - t0;
+    sampled.update();
+    SIM_CHECK(sampledSum == 1 && sampledLatency < 1000, "sampled steps %d, wake after %llu us",
+              sampledSum, (unsigned long long)sampledLatency);
+    sampler.end();
+
+    std::printf("  encoder wakeups: none in 1 s idle, wake after %llu us (edge) / %llu us (sampled)\n",
+                (unsigned long long)edgeLatency, (unsigned long long)sampledLatency);
+}
+
+// --------------------------------------------
+// 17. Отложенный лог: текст как у snprintf, переполнение - счетчик, а не ожидание
+// --------------------------------------------
+bool sameAsSnprintf(const LogRecord& record, const char* expected) {
+    char text[DeferredLog::kLineLength];
+    DeferredLog::format(record, text, sizeof(text));
+    if (strcmp(text, expected) != 0) {
+        std::printf("    got \"%s\", expected \"%s\"\n", text, expected);
+        return false;
+    }
+    return true;
+}
+
+void deferredLog() {
+    sim::reset();
+    DeferredLog::drain();   // записи прошлых сценариев (старт/стоп генераторов)
+
+    char expected[DeferredLog::kLineLength];
+    const int8_t delta = -3;
+    const uint32_t big = 4000000000UL;
+    const long neg = -123456;
+    snprintf(expected, sizeof(expected), "[UI] Enc A: Δ=%d\n", delta);
+    SIM_CHECK(sameAsSnprintf(DeferredLog::makeRecord("[UI] Enc A: Δ=%d\n", delta), expected), "int8");
+    snprintf(expected, sizeof(expected), "%lu %ld %08x|%-5u|%c 100%%", (unsigned long)big, neg,
+             0xBEEFu, 42u, 'z');
+    SIM_CHECK(sameAsSnprintf(DeferredLog::makeRecord("%lu %ld %08x|%-5u|%c 100%%", big, neg, 0xBEEFu,
+                                                     42u, 'z'), expected), "integers");
+    snprintf(expected, sizeof(expected), "[EMS CH%d] Started (%s) %.2f", 1, "timer", 2.5);
+    SIM_CHECK(sameAsSnprintf(DeferredLog::makeRecord("[EMS CH%d] Started (%s) %.2f", 1, "timer", 2.5f),
+                             expected), "string and float");
+    SIM_CHECK(sameAsSnprintf(DeferredLog::makeRecord("missing %d"), "missing <?>"), "missing arg");
+
+    // Без вывода кольцо ядра переполняется: лишнее отбрасывается и считается
+    const uint32_t written0 = DeferredLog::getWritten();
+    const uint32_t dropped0 = DeferredLog::getDropped();
+    const uint32_t kRecords = 200;
+    uint32_t accepted = 0;
+    for (uint32_t i = 0; i < kRecords; ++i) {
+        accepted += DeferredLog::printf("[Test] record %lu\n", (unsigned long)i) ? 1 : 0;
+        sim::advance(10);
+    }
+    const uint32_t written = DeferredLog::getWritten() - written0;
+    const uint32_t dropped = DeferredLog::getDropped() - dropped0;
+    SIM_CHECK(accepted == DeferredLog::kRingCapacity && written == accepted, "accepted %lu",
+              (unsigned long)accepted);
+    SIM_CHECK(dropped == kRecords - accepted, "dropped %lu", (unsigned long)dropped);
+
+    const size_t drained = DeferredLog::drain();
+    SIM_CHECK(drained == accepted, "drained %lu", (unsigned long)drained);
+    SIM_CHECK(DeferredLog::printf("[Test] after drain\n") && DeferredLog::drain() == 1, "ring reusable");
+
+    std::printf("  deferred log: %lu of %lu records kept in a full ring, %lu dropped, formatting matches snprintf\n",
+                (unsigned long)accepted, (unsigned long)kRecords, (unsigned long)dropped);
+}
+
+// --------------------------------------------
+// 18. Гистограмма длительностей: перцентили в пределах корзины, окно по reset()
+// --------------------------------------------
+bool withinBucket(uint32_t reported, uint32_t exact) {
+    // Верхняя граница корзины: не меньше точного и не дальше 1/8 сверху
+    return reported >= exact && reported <= exact + exact / 8 + 1;
+}
+
+void latencyHistogram() {
+    sim::reset();
+
+    // Границы корзин стыкуются без пропусков на всем диапазоне
+    bool contiguous = true;
+    for (uint16_t b = 1; b < LatencyHistogram::kBuckets; ++b) {
+        const uint32_t first = LatencyHistogram::bucketUpper(b - 1) + 1;
+        contiguous = contiguous && LatencyHistogram::bucketOf(first) == b &&
+                     LatencyHistogram::bucketOf(LatencyHistogram::bucketUpper(b)) == b;
+    }
+    SIM_CHECK(contiguous, "bucket boundaries");
+    SIM_CHECK(LatencyHistogram::bucketOf(0xFFFFFFFFUL) == LatencyHistogram::kBuckets - 1, "overflow bucket");
+
+    // 1..10000 по одному разу + один выброс: выброс виден только в max и p99.9
+    LatencyHistogram h;
+    for (uint32_t v = 1; v <= 10000; ++v) {
+        h.record(v);
+    }
+    h.record(250000);
+    const LatencyHistogram::Snapshot s = h.take();
+    SIM_CHECK(s.count == 10001, "count %lu", (unsigned long)s.count);
+    SIM_CHECK(withinBucket(s.p50, 5001) && withinBucket(s.p90, 9001) && withinBucket(s.p99, 9901),
+              "p50/p90/p99 %lu/%lu/%lu", (unsigned long)s.p50, (unsigned long)s.p90, (unsigned long)s.p99);
+    SIM_CHECK(withinBucket(s.p999, 9991), "p99.9 %lu", (unsigned long)s.p999);
+    SIM_CHECK(s.max == 250000, "max %lu", (unsigned long)s.max);
+
+    // После take() - новое окно: старые отсчеты и максимум не видны
+    const LatencyHistogram::Snapshot empty = h.snapshot();
+    SIM_CHECK(empty.count == 0 && empty.max == 0, "after reset %lu/%lu",
+              (unsigned long)empty.count, (unsigned long)empty.max);
+    for (int i = 0; i < 100; ++i) {
+        h.record(7);
+    }
+    const LatencyHistogram::Snapshot small = h.snapshot();
+    SIM_CHECK(small.count == 100 && small.p50 == 7 && small.p999 == 7 && small.max == 7 && small.mean == 7,
+              "second window p50 %lu max %lu", (unsigned long)small.p50, (unsigned long)small.max);
+
+    std::printf("  latency histogram: %u buckets, p50/p90/p99/p99.9/max of 1..10000+outlier = "
+                "%lu/%lu/%lu/%lu/%lu\n", (unsigned)LatencyHistogram::kBuckets,
+                (unsigned long)s.p50, (unsigned long)s.p90, (unsigned long)s.p99,
+                (unsigned long)s.p999, (unsigned long)s.max);
+}
+
+// --------------------------------------------
+// 19. Трасса: такты событий совпадают с фронтами LEDC, отрезки ISR парные,
+//     кольцо хранит последние события
+// --------------------------------------------
+bool traceName(const TraceEvent& e, const char* name) {
+    return e.name != nullptr && std::strcmp(e.name, name) == 0;
+}
+
+void traceRecorder() {
+    sim::reset();
+    SIM_CHECK(TraceRecorder::begin(1000), "begin");
+    SIM_CHECK(TraceRecorder::getCapacity() == 512, "capacity %lu", (unsigned long)TraceRecorder::getCapacity());
+
+    IsrProfile profile("edge_timer");
+    EMSPulseGenerator gen(0, PWM_CH_1_PIN, 144, 10, 70);
+    gen.setDriveMode(EMSPulseGenerator::DriveMode::Timer);
+    gen.setIsrProfile(&profile);
+    gen.begin();
+    StimCommandBus bus;
+    Command cmd;
+
+    std::vector<sim::LedcWrite> writes;
+    sim::setLedcSink([&writes](const sim::LedcWrite& w) { writes.push_back(w); });
+
+    sim::advance(1000);
+    TraceRecorder::start();
+    bus.send(Command(CommandType::START_STIM));
+    bus.receiveControl(cmd);
+    gen.start();
+    const StimProfile& p = DefaultStimProfile::value;
+    const uint64_t cycles = 20;
+    sim::runUntil(sim::now() + cycles * p.fullCycleUs - 1);
+    gen.stop();
+    TraceRecorder::stop();
+    sim::setLedcSink(nullptr);
+
+    // Запись остановлена - события не добавляются
+    const size_t n = TraceRecorder::count();
+    TRACE_INSTANT("after_stop", 0);
+    SIM_CHECK(TraceRecorder::count() == n && n < TraceRecorder::getCapacity(), "events %lu", (unsigned long)n);
+
+    TraceEvent e;
+    SIM_CHECK(TraceRecorder::getEvent(0, e) && e.type == TraceEvent::kSync, "sync first");
+    SIM_CHECK(e.cycles == (uint32_t)(e.arg * 240ULL), "sync pair %lu/%lu", (unsigned long)e.cycles,
+              (unsigned long)e.arg);
+
+    size_t ledc = 0, bursts = 0, begins = 0, ends = 0, sends = 0, receives = 0;
+    bool pairsNested = true, ledcExact = true;
+    int depth = 0;
+    for (size_t i = 1; i < n; ++i) {
+        TraceRecorder::getEvent(i, e);
+        if (e.type == TraceEvent::kCounter && traceName(e, "ledc0")) {
+            // Значение и такт - ровно те, что видел LEDC
+            ledcExact = ledcExact && ledc < writes.size() && writes[ledc].duty == e.arg &&
+                        (uint32_t)(writes[ledc].timeUs * 240ULL) == e.cycles;
+            ledc++;
+        } else if (e.type == TraceEvent::kInstant && traceName(e, "burst")) {
+            bursts++;
+        } else if (e.type == TraceEvent::kInstant && traceName(e, "cmd_send")) {
+            sends += (e.arg == (uint32_t)CommandType::START_STIM) ? 1 : 0;
+        } else if (e.type == TraceEvent::kInstant && traceName(e, "cmd_recv")) {
+            receives += (e.arg == (uint32_t)CommandType::START_STIM) ? 1 : 0;
+        } else if (traceName(e, "edge_timer")) {
+            depth += (e.type == TraceEvent::kBegin) ? 1 : -1;
+            pairsNested = pairsNested && depth >= 0 && depth <= 1;
+            begins += (e.type == TraceEvent::kBegin) ? 1 : 0;
+            ends += (e.type == TraceEvent::kEnd) ? 1 : 0;
+        }
+    }
+    SIM_CHECK(sends == 1 && receives == 1, "commands %lu/%lu", (unsigned long)sends, (unsigned long)receives);
+    SIM_CHECK(ledc == writes.size() && ledcExact, "ledc %lu of %lu", (unsigned long)ledc,
+              (unsigned long)writes.size());
+    SIM_CHECK(bursts == cycles, "bursts %lu", (unsigned long)bursts);
+    SIM_CHECK(pairsNested && depth == 0 && begins == ends && begins == profile.takeTotals().count,
+              "isr spans %lu/%lu", (unsigned long)begins, (unsigned long)ends);
+
+    // Переполнение: в кольце последние getCapacity() событий по порядку
+    // (первое записанное - пара синхронизации)
+    TraceRecorder::start();
+    const uint32_t kEvents = 2000;
+    for (uint32_t i = 0; i < kEvents; ++i) {
+        TRACE_INSTANT("fill", i);
+    }
+    const size_t cap = TraceRecorder::getCapacity();
+    SIM_CHECK(TraceRecorder::count() == cap, "full %lu", (unsigned long)TraceRecorder::count());
+    SIM_CHECK(TraceRecorder::getRecorded() == kEvents + 1, "recorded %lu",
+              (unsigned long)TraceRecorder::getRecorded());
+    SIM_CHECK(TraceRecorder::getEvent(0, e) && e.arg == kEvents - cap &&
+              TraceRecorder::getEvent(cap - 1, e) && e.arg == kEvents - 1, "oldest/newest");
+
+    // Дамп выводит все и продолжает запись
+    SIM_CHECK(TraceRecorder::dump() == cap && TraceRecorder::isRecording(), "dump");
+    TraceRecorder::stop();
+
+    // Тик каждого ядра - точка с ручкой прерванной задачи, на своем ядре
+    TraceRecorder::start();
+    sim::tick(0);
+    sim::tick(1);
+    TraceRecorder::stop();
+    const uint32_t self = (uint32_t)(uintptr_t)xTaskGetCurrentTaskHandle();
+    uint32_t tickCores = 0;
+    for (size_t i = 0; i < TraceRecorder::count(); ++i) {
+        TraceRecorder::getEvent(i, e);
+        if (e.type == TraceEvent::kInstant && e.name == TraceRecorder::kTickName && e.arg == self) {
+            tickCores |= 1u << e.core;
+        }
+    }
+    SIM_CHECK(tickCores == 3, "tick task per core %lx", (unsigned long)tickCores);
+
+    std::printf("  trace: %lu events for %llu cycles, %lu LEDC counters match edges to the cycle, "
+                "%lu ISR spans paired\n", (unsigned long)n, (unsigned long long)cycles,
+                (unsigned long)ledc, (unsigned long)begins);
+}
+
+} // namespace
+
+// --------------------------------------------
+// 20. PCNT: счет по модулю предела через +-32767 в обе стороны, пробуждение порогом шага
+// --------------------------------------------
+void pcntModulo() {
+    sim::reset();
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+    EncoderPCNT ec12(ENC_A_CLK_PIN, ENC_A_DT_PIN, PCNT_UNIT_0, 4, false, 10);
+    EncoderPCNT c14(ENC_B_CLK_PIN, ENC_B_DT_PIN, PCNT_UNIT_1, 1, true, 10);
+    int32_t ec12Sum = 0, c14Sum = 0;
+    ec12.onStep([&ec12Sum](int8_t d) { ec12Sum += d; });
+    c14.onStep([&c14Sum](int8_t d) { c14Sum += d; });
+    ec12.setWakeTask(self);
+    SIM_CHECK(ec12.begin() && c14.begin(), "begin");
+
+    // Пол-шага не будит; порог - ровно на границе шага с учетом остатка
+    sim::pcntCount(PCNT_UNIT_0, 3);
+    SIM_CHECK(sim::pcntInterrupts(PCNT_UNIT_0) == 0, "woke on a half step");
+    sim::pcntCount(PCNT_UNIT_0, 1);
+    SIM_CHECK(ulTaskNotifyTake(pdTRUE, 0) > 0, "step must wake");
+    ec12.update();
+    sim::pcntCount(PCNT_UNIT_0, 2);
+    ec12.update();
+    sim::pcntCount(PCNT_UNIT_0, -5);
+    SIM_CHECK(sim::pcntInterrupts(PCNT_UNIT_0) == 1, "wake before the step back");
+    sim::pcntCount(PCNT_UNIT_0, -1);
+    SIM_CHECK(ulTaskNotifyTake(pdTRUE, 0) > 0 && sim::pcntInterrupts(PCNT_UNIT_0) == 2,
+              "step back must wake");
+    ec12.update();
+    SIM_CHECK(ec12Sum == 0 && ec12.getCount() == 0, "steps %d, count %ld", ec12Sum,
+              (long)ec12.getCount());
+
+    // UI только по пробуждению: каждый шаг доходит через обнуление на пределах
+    int32_t position = 0;
+    auto turn = [&](int32_t counts) {
+        const int32_t dir = (counts > 0) ? 1 : -1;
+        for (int32_t n = 0; n != counts; n += dir) {
+            sim::pcntCount(PCNT_UNIT_0, dir);
+            position += dir;
+            if (ulTaskNotifyTake(pdTRUE, 0) > 0) {
+                ec12.update();
+            }
+        }
+    };
+    turn(33000);
+    SIM_CHECK(ec12Sum == 33000 / 4, "after +limit: steps %d", ec12Sum);
+    turn(-70000);
+    SIM_CHECK(ec12Sum == position / 4 && ec12.getCount() == position,
+              "after -limit: steps %d, count %ld, expected %ld", ec12Sum, (long)ec12.getCount(),
+              (long)position);
+    turn(40000);
+    SIM_CHECK(ec12Sum == position / 4, "back over -limit: steps %d", ec12Sum);
+
+    // Без пробуждения: опрос кусками меньше полупредела, обратный знак, шаг на отсчет
+    for (int i = 0; i < 7; ++i) {
+        sim::pcntCount(PCNT_UNIT_1, -10000);
+        c14.update();
+    }
+    SIM_CHECK(c14Sum == 70000, "C14 after -limit: steps %d", c14Sum);
+    for (int i = 0; i < 14; ++i) {
+        sim::pcntCount(PCNT_UNIT_1, 10000);
+        c14.update();
+    }
+    SIM_CHECK(c14Sum == -70000 && sim::pcntInterrupts(PCNT_UNIT_1) == 0,
+              "C14 after +limit: steps %d, irqs %lu", c14Sum,
+              (unsigned long)sim::pcntInterrupts(PCNT_UNIT_1));
+
+    std::printf("  pcnt: %ld counts across both limits -> %d steps, %lu wakeups\n",
+                (long)position, ec12Sum, (unsigned long)sim::pcntInterrupts(PCNT_UNIT_0));
+}
+
+// --------------------------------------------
+// 21. Profiler: окно задач и ISR через переполнение счетчиков run-time stats
+// --------------------------------------------
+void profilerWindows() {
+    sim::reset();
+    // Один на программу: тик-хуки держат указатель на экземпляр
+    static Profiler profiler;
+    static IsrProfile isr("sim_isr");
+
+    TaskHandle_t ui = sim::addTask("UI_Task", 0);
+    TaskHandle_t stim = sim::addTask("Stim_Task", 1);
+    TaskHandle_t idle0 = xTaskGetIdleTaskHandleForCPU(0);
+    TaskHandle_t idle1 = xTaskGetIdleTaskHandleForCPU(1);
+
+    // Все счетчики за 4096 единиц до переполнения uint32_t
+    const uint32_t base = 0xFFFFF000u;
+    sim::setTotalRunTime(base);
+    sim::setRunTime(idle0, base);
+    sim::setRunTime(idle1, base);
+    sim::setRunTime(ui, base);
+    sim::setRunTime(stim, base);
+    SIM_CHECK(profiler.begin() && profiler.addTask(ui) && profiler.addTask(stim) &&
+              profiler.addIsr(isr), "begin");
+    SIM_CHECK(Profiler::getSource() == Profiler::Source::RunTimeStats, "source %s",
+              Profiler::sourceName(Profiler::getSource()));
+
+    // Первое окно задачи, добавленной после begin(), - только отметка
+    Profiler::Snapshot snap;
+    sim::advance(1000);
+    SIM_CHECK(profiler.takeSnapshot(snap) && snap.taskCount == 2 && snap.isrCount == 1, "snapshot");
+    SIM_CHECK(snap.tasks[0].percent == 0.0f && snap.tasks[1].percent == 0.0f, "unprimed task");
+
+    // Окно 10000 единиц через 0: IDLE0 - 25%, IDLE1 - все, UI - 50%, Stim - 10%
+    sim::setTotalRunTime(base + 10000);
+    sim::setRunTime(idle0, base + 2500);
+    sim::setRunTime(idle1, base + 10000);
+    sim::setRunTime(ui, base + 5000);
+    sim::setRunTime(stim, base + 1000);
+    for (int i = 0; i < 10; ++i) {
+        isr.record(2400);           // 10 мкс на 240 МГц
+    }
+    sim::advance(10000);
+    SIM_CHECK(profiler.takeSnapshot(snap) && snap.windowUs == 10000, "window %lu us",
+              (unsigned long)snap.windowUs);
+    SIM_CHECK(snap.coreIdle[0] == 25.0f && snap.coreLoad[0] == 75.0f, "core0 idle %.2f load %.2f",
+              snap.coreIdle[0], snap.coreLoad[0]);
+    SIM_CHECK(snap.coreIdle[1] == 100.0f && snap.coreLoad[1] == 0.0f, "core1 idle %.2f",
+              snap.coreIdle[1]);
+    SIM_CHECK(snap.tasks[0].percent == 50.0f && snap.tasks[1].percent == 10.0f,
+              "UI %.2f%%, Stim %.2f%%", snap.tasks[0].percent, snap.tasks[1].percent);
+    SIM_CHECK(snap.isrs[0].count == 10 && snap.isrs[0].avgUs == 10.0f &&
+              snap.isrs[0].percent == 1.0f, "isr %lu calls, avg %.2f us, %.2f%%",
+              (unsigned long)snap.isrs[0].count, snap.isrs[0].avgUs, snap.isrs[0].percent);
+    const Profiler::Snapshot wrapped = snap;
+
+    // Пустое окно: ни делений на 0, ни остатков прошлого
+    sim::advance(5000);
+    SIM_CHECK(profiler.takeSnapshot(snap) && snap.coreIdle[0] == 0.0f &&
+              snap.tasks[0].percent == 0.0f && snap.isrs[0].count == 0, "idle window");
+
+    std::printf("  profiler: window across the uint32 wrap -> core0 %.0f%% load, UI %.0f%%, "
+                "ISR %.1f us avg\n", wrapped.coreLoad[0], wrapped.tasks[0].percent,
+                wrapped.isrs[0].avgUs);
+}
+
+int main() {
+    std::printf("stim_sim: stimulation engine on a virtual clock\n");
+
+    timerModeExact();
+    timerModeJitterNoDrift();
+    bankTwoProfiles();
+    pollingNoDrift();
+    programSegments();
+    softStartRamp();
+    encoders();
+    stateAndQueue(CommandQueue::Backend::Spsc, "spsc");
+    stateAndQueue(CommandQueue::Backend::FreeRtos, "xQueue");
+    commandBusLanes();
+    planAtBurstEnd(EMSPulseGenerator::DriveMode::Timer, "timer");
+    planAtBurstEnd(EMSPulseGenerator::DriveMode::Polling, "polling");
+    settingsCoalesce();
+    appStateSubscribe();
+    sampledEncoders();
+    staticEncoders();
+    gpioDispatcher();
+    encoderWakeups();
+    deferredLog();
+    latencyHistogram();
+    traceRecorder();
+    pcntModulo();
+    profilerWindows();
+
+    if (g_failures > 0) {
+        std::printf("stim_sim: %d check(s) FAILED\n", g_failures);
+        return 1;
+    }
+    std::printf("stim_sim: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,275 @@
+// Компилятор программ стимуляции: текст -> байткод StimProgram
+//
+// Сборка (из Code/ESP32_D):
+//   g++ -O2 -std=c++17 -Iinclude host/tools/stimc.cpp src/core/StimProgram.cpp -o stimc
+//
+// Запуск:
+//   ./stimc program.stim -o program.bin      двоичный байткод
+//   ./stimc program.stim -c kTherapyProgram  массив для вставки в прошивку
+//   ./stimc program.stim -x                  строка "p <hex>" для консоли прошивки
+//
+// Синтаксис (по команде на строку, '#' - комментарий, метки - "name:"):
+//   BURST <pulses> <rateHz> <widthUs>
+//   PAUSE <ms>
+//   RAMP  <amplitude%> <ms>
+//   LOOP  <count> <label>      вернуться на метку еще count раз
+//   JUMP  <label>
+//   END
+//
+// Готовый байткод проверяется тем же StimProgram::load(), что и в прошивке,
+// затем прогоняется интерпретатором для сводки по времени.
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "core/StimProgram.h"
+
+namespace {
+
+struct Line {
+    int number;
+    std::vector<std::string> tokens;
+};
+
+struct Fixup {
+    size_t offset;          // позиция байта target в байткоде
+    std::string label;
+    int line;
+};
+
+[[noreturn]] void fail(int line, const std::string& message) {
+    if (line > 0) {
+        std::fprintf(stderr, "stimc: line %d: %s\n", line, message.c_str());
+    } else {
+        std::fprintf(stderr, "stimc: %s\n", message.c_str());
+    }
+    std::exit(1);
+}
+
+std::string upper(std::string s) {
+    for (char& c : s) c = (char)std::toupper((unsigned char)c);
+    return s;
+}
+
+uint32_t number(const Line& line, size_t i, uint32_t maxValue) {
+    if (i >= line.tokens.size()) {
+        fail(line.number, "missing argument");
+    }
+    char* end = nullptr;
+    const unsigned long v = std::strtoul(line.tokens[i].c_str(), &end, 0);
+    if (*end != '\0' || v > maxValue) {
+        fail(line.number, "bad number '" + line.tokens[i] + "'");
+    }
+    return (uint32_t)v;
+}
+
+void put16(std::vector<uint8_t>& out, uint32_t v) {
+    out.push_back(v & 0xFF);
+    out.push_back((v >> 8) & 0xFF);
+}
+
+void put32(std::vector<uint8_t>& out, uint32_t v) {
+    put16(out, v & 0xFFFF);
+    put16(out, v >> 16);
+}
+
+std::vector<uint8_t> compile(std::istream& in) {
+    std::vector<Line> lines;
+    std::map<std::string, uint8_t> labels;
+
+    // Проход 1: метки -> индексы команд
+    std::string text;
+    int lineNo = 0;
+    while (std::getline(in, text)) {
+        ++lineNo;
+        const size_t hash = text.find('#');
+        if (hash != std::string::npos) text.resize(hash);
+
+        std::istringstream ss(text);
+        Line line{lineNo, {}};
+        std::string tok;
+        while (ss >> tok) {
+            if (line.tokens.empty() && tok.back() == ':') {
+                const std::string name = tok.substr(0, tok.size() - 1);
+                if (labels.count(name)) fail(lineNo, "duplicate label '" + name + "'");
+                labels[name] = (uint8_t)lines.size();
+                continue;
+            }
+            line.tokens.push_back(tok);
+        }
+        if (!line.tokens.empty()) {
+            lines.push_back(line);
+        }
+    }
+
+    if (lines.empty()) fail(0, "empty program");
+    if (lines.size() > StimProgram::kMaxInstrs) {
+        fail(0, "too many instructions (max " + std::to_string(StimProgram::kMaxInstrs) + ")");
+    }
+
+    // Проход 2: кодирование
+    std::vector<uint8_t> out = {StimProgram::kMagic0, StimProgram::kMagic1,
+                                StimProgram::kVersion, (uint8_t)lines.size()};
+    std::vector<Fixup> fixups;
+
+    for (const Line& line : lines) {
+        const std::string op = upper(line.tokens[0]);
+        size_t expected = 0;
+
+        if (op == "END") {
+            out.push_back((uint8_t)StimOp::End);
+        } else if (op == "BURST") {
+            out.push_back((uint8_t)StimOp::Burst);
+            put16(out, number(line, 1, 0xFFFF));
+            put16(out, number(line, 2, 0xFFFF));
+            put16(out, number(line, 3, 0xFFFF));
+            expected = 3;
+        } else if (op == "PAUSE") {
+            out.push_back((uint8_t)StimOp::Pause);
+            put32(out, number(line, 1, 0xFFFFFFFF));
+            expected = 1;
+        } else if (op == "RAMP") {
+            out.push_back((uint8_t)StimOp::Ramp);
+            out.push_back((uint8_t)number(line, 1, 100));
+            put32(out, number(line, 2, 0xFFFFFFFF));
+            expected = 2;
+        } else if (op == "LOOP") {
+            out.push_back((uint8_t)StimOp::Loop);
+            put16(out, number(line, 1, 0xFFFF));
+            if (line.tokens.size() < 3) fail(line.number, "missing label");
+            fixups.push_back({out.size(), line.tokens[2], line.number});
+            out.push_back(0);
+            expected = 2;
+        } else if (op == "JUMP") {
+            out.push_back((uint8_t)StimOp::Jump);
+            if (line.tokens.size() < 2) fail(line.number, "missing label");
+            fixups.push_back({out.size(), line.tokens[1], line.number});
+            out.push_back(0);
+            expected = 1;
+        } else {
+            fail(line.number, "unknown instruction '" + line.tokens[0] + "'");
+        }
+
+        if (line.tokens.size() != expected + 1) {
+            fail(line.number, "expected " + std::to_string(expected) + " argument(s)");
+        }
+    }
+
+    for (const Fixup& f : fixups) {
+        auto it = labels.find(f.label);
+        if (it == labels.end()) fail(f.line, "unknown label '" + f.label + "'");
+        out[f.offset] = it->second;
+    }
+
+    // Проверка тем же кодом, что и в прошивке
+    StimProgram program;
+    uint8_t errorIndex = 0;
+    const StimProgramError error = program.load(out.data(), out.size(), &errorIndex);
+    if (error != StimProgramError::None) {
+        const int line = (errorIndex < lines.size()) ? lines[errorIndex].number : 0;
+        fail(line, StimProgram::errorName(error));
+    }
+
+    return out;
+}
+
+void summarize(const std::vector<uint8_t>& code) {
+    StimProgram program;
+    program.load(code.data(), code.size());
+
+    StimSequencer seq;
+    seq.reset(&program);
+
+    // Прогон интерпретатора: до END или до лимита сегментов (бесконечный JUMP)
+    const uint32_t kMaxSegments = 100000;
+    uint64_t burstUs = 0, pauseUs = 0, pulses = 0;
+    uint32_t segments = 0;
+    bool ended = false;
+
+    while (segments < kMaxSegments) {
+        const StimInstr* instr = seq.next();
+        if (instr->op == StimOp::End) {
+            ended = true;
+            break;
+        }
+        if (instr->op == StimOp::Burst) {
+            burstUs += instr->durationUs;
+            pulses += instr->count;
+            ++segments;
+        } else if (instr->op == StimOp::Pause) {
+            pauseUs += instr->durationUs;
+            ++segments;
+        }
+    }
+
+    std::printf("stimc: %zu bytes, %u instructions\n", code.size(), program.size());
+    std::printf("  %s after %u segments: %llu pulses, burst %.3f s, pause %.3f s\n",
+                ended ? "ends" : "still running", segments,
+                (unsigned long long)pulses, burstUs / 1e6, pauseUs / 1e6);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* input = nullptr;
+    const char* binPath = nullptr;
+    const char* arrayName = nullptr;
+    bool consoleHex = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "-o") && i + 1 < argc) {
+            binPath = argv[++i];
+        } else if (!std::strcmp(argv[i], "-c") && i + 1 < argc) {
+            arrayName = argv[++i];
+        } else if (!std::strcmp(argv[i], "-x")) {
+            consoleHex = true;
+        } else if (input == nullptr) {
+            input = argv[i];
+        } else {
+            fail(0, std::string("unexpected argument '") + argv[i] + "'");
+        }
+    }
+
+    if (input == nullptr) {
+        std::fprintf(stderr, "usage: stimc <program.stim> [-o out.bin] [-c arrayName] [-x]\n");
+        return 2;
+    }
+
+    std::ifstream in(input);
+    if (!in) fail(0, std::string("cannot open ") + input);
+
+    const std::vector<uint8_t> code = compile(in);
+    summarize(code);
+
+    if (binPath != nullptr) {
+        std::ofstream out(binPath, std::ios::binary);
+        out.write((const char*)code.data(), (std::streamsize)code.size());
+        if (!out) fail(0, std::string("cannot write ") + binPath);
+    }
+
+    if (arrayName != nullptr) {
+        std::printf("\nstatic const uint8_t %s[] = {", arrayName);
+        for (size_t i = 0; i < code.size(); ++i) {
+            std::printf("%s0x%02X%s", (i % 12 == 0) ? "\n    " : " ", code[i],
+                        (i + 1 < code.size()) ? "," : "");
+        }
+        std::printf("\n};\n");
+    }
+
+    if (consoleHex) {
+        std::printf("\np ");
+        for (size_t i = 0; i < code.size(); ++i) {
+            std::printf("%02X", code[i]);
+        }
+        std::printf("\n");
+    }
+
+    return 0;
+}
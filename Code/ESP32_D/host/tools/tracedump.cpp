@@ -0,0 +1,383 @@
+// Дамп TraceRecorder (вывод Serial) -> JSON Chrome Trace Event Format
+//
+// Сборка (из Code/ESP32_D):
+//   g++ -O2 -std=c++17 host/tools/tracedump.cpp -o tracedump
+//
+// Запуск:
+//   ./tracedump monitor.log -o trace.json    открыть в ui.perfetto.dev или chrome://tracing
+//   ./tracedump - < monitor.log              JSON в stdout
+//
+// Лог монитора может содержать что угодно: берутся строки "@...", из
+// нескольких дампов - последний полный ("@trace" ... "@end"). Префикс
+// перед '@' (время монитора) отбрасывается.
+//
+// Время: CCOUNT каждого ядра переводится в мкс по ближайшей предыдущей
+// паре CCOUNT - esp_timer этого же ядра (события 'S'); события до первой
+// пары ядра - по первой паре, назад. Ядро - отдельная дорожка (tid),
+// отрезки B/E без пары (начало перезаписано кольцом) отбрасываются,
+// незакрытые закрываются последним временем трассы.
+//
+// Точки "tick" (хук тика, arg - ручка задачи) получают имя задачи из
+// таблицы "@task <ручка> <имя>" дампа: видно, чья задача держала ядро.
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr unsigned kMaxCores = 8;
+
+struct RawEvent {
+    unsigned core;
+    char     type;
+    uint32_t cycles;
+    unsigned nameId;
+    uint32_t arg;
+};
+
+struct Dump {
+    unsigned mhz = 0;
+    unsigned long overwritten = 0;
+    unsigned long skipped = 0;
+    std::map<unsigned, std::string> names;
+    std::map<uint32_t, std::string> tasks;     // ручка -> имя задачи
+    std::vector<RawEvent> events;
+};
+
+struct TimedEvent {
+    double   ts;                // мкс от начала трассы
+    unsigned core;
+    char     type;
+    unsigned nameId;
+    uint32_t arg;
+};
+
+struct Sync {
+    bool     valid = false;
+    uint32_t cycles = 0;
+    int64_t  us = 0;
+};
+
+[[noreturn]] void fail(const std::string& message) {
+    std::fprintf(stderr, "tracedump: %s\n", message.c_str());
+    std::exit(1);
+}
+
+unsigned long field(const std::string& line, const char* key) {
+    const size_t pos = line.find(key);
+    return (pos != std::string::npos) ? std::strtoul(line.c_str() + pos + std::strlen(key), nullptr, 10) : 0;
+}
+
+// Последний полный дамп из лога
+Dump parse(std::istream& in) {
+    Dump current;
+    Dump complete;
+    bool inDump = false;
+    bool haveComplete = false;
+    std::string line;
+
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        const size_t at = line.find('@');
+        if (at == std::string::npos) {
+            continue;
+        }
+        const std::string rec = line.substr(at);
+
+        if (rec.compare(0, 7, "@trace ") == 0) {
+            current = Dump();
+            current.mhz = (unsigned)field(rec, "mhz=");
+            current.overwritten = field(rec, "overwritten=");
+            current.skipped = field(rec, "skipped=");
+            inDump = true;
+        } else if (!inDump) {
+            continue;
+        } else if (rec.compare(0, 6, "@name ") == 0) {
+            char* end = nullptr;
+            const unsigned id = (unsigned)std::strtoul(rec.c_str() + 6, &end, 10);
+            if (end != nullptr && *end == ' ') {
+                current.names[id] = end + 1;
+            }
+        } else if (rec.compare(0, 6, "@task ") == 0) {
+            char* end = nullptr;
+            const unsigned long handle = std::strtoul(rec.c_str() + 6, &end, 16);
+            if (end != nullptr && *end == ' ') {
+                current.tasks[(uint32_t)handle] = end + 1;
+            }
+        } else if (rec.compare(0, 3, "@e ") == 0) {
+            RawEvent e;
+            char type = 0;
+            unsigned long cycles = 0;
+            unsigned long arg = 0;
+            if (std::sscanf(rec.c_str() + 3, "%u %c %lx %u %lx", &e.core, &type, &cycles, &e.nameId, &arg) == 5 &&
+                e.core < kMaxCores) {
+                e.type = type;
+                e.cycles = (uint32_t)cycles;
+                e.arg = (uint32_t)arg;
+                current.events.push_back(e);
+            }
+        } else if (rec.compare(0, 4, "@end") == 0) {
+            complete = current;
+            haveComplete = true;
+            inDump = false;
+        }
+    }
+
+    if (!haveComplete) {
+        fail("no complete dump (@trace ... @end) in input");
+    }
+    if (complete.mhz == 0) {
+        fail("dump header has no mhz=");
+    }
+    return complete;
+}
+
+// Такты -> мкс по парам синхронизации ядер
+std::vector<TimedEvent> toTimeline(const Dump& dump, size_t& unsynced) {
+    // Мкс esp_timer в дампе - младшие 32 бита: разворачиваем по порядку записи
+    std::vector<int64_t> syncUs(dump.events.size(), 0);
+    Sync first[kMaxCores];
+    bool haveLast = false;
+    int64_t lastUs = 0;
+    for (size_t i = 0; i < dump.events.size(); ++i) {
+        const RawEvent& e = dump.events[i];
+        if (e.type != 'S') {
+            continue;
+        }
+        lastUs = haveLast ? lastUs + (int32_t)(e.arg - (uint32_t)lastUs) : (int64_t)e.arg;
+        haveLast = true;
+        syncUs[i] = lastUs;
+        if (!first[e.core].valid) {
+            first[e.core].valid = true;
+            first[e.core].cycles = e.cycles;
+            first[e.core].us = lastUs;
+        }
+    }
+
+    const double cyclesPerUs = (double)dump.mhz;
+    Sync current[kMaxCores];
+    std::copy(first, first + kMaxCores, current);
+
+    std::vector<TimedEvent> out;
+    out.reserve(dump.events.size());
+    unsynced = 0;
+    for (size_t i = 0; i < dump.events.size(); ++i) {
+        const RawEvent& e = dump.events[i];
+        if (e.type == 'S') {
+            current[e.core].cycles = e.cycles;
+            current[e.core].us = syncUs[i];
+            continue;
+        }
+        const Sync& s = current[e.core];
+        if (!s.valid) {
+            unsynced++;
+            continue;
+        }
+        const double ts = (double)s.us + (double)(int32_t)(e.cycles - s.cycles) / cyclesPerUs;
+        out.push_back({ts, e.core, e.type, e.nameId, e.arg});
+    }
+
+    // Внутри ядра порядок записи может разойтись с тактами на десятки тактов
+    // (ISR между взятием слота и чтением CCOUNT)
+    std::stable_sort(out.begin(), out.end(),
+                     [](const TimedEvent& a, const TimedEvent& b) { return a.ts < b.ts; });
+    // Начало шкалы - первое событие, кроме конца отрезка (без начала он отбрасывается)
+    const auto origin = std::find_if(out.begin(), out.end(),
+                                     [](const TimedEvent& e) { return e.type != 'E'; });
+    if (origin != out.end()) {
+        const double originTs = origin->ts;
+        for (TimedEvent& e : out) {
+            e.ts -= originTs;
+        }
+    }
+    return out;
+}
+
+std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)c);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+class JsonWriter {
+public:
+    explicit JsonWriter(std::FILE* out) : out_(out) {
+        std::fprintf(out_, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    }
+
+    ~JsonWriter() {
+        std::fprintf(out_, "\n]}\n");
+    }
+
+    void event(const std::string& name, char phase, double ts, unsigned core, const char* extra = "") {
+        std::fprintf(out_, "%s{\"name\":%s,\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u%s}",
+                     first_ ? "" : ",\n", jsonString(name).c_str(), phase, ts, core, extra);
+        first_ = false;
+        count_++;
+    }
+
+    void threadName(unsigned core) {
+        std::fprintf(out_, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                     "\"args\":{\"name\":\"Core %u\"}}", first_ ? "" : ",\n", core, core);
+        first_ = false;
+    }
+
+    size_t count() const { return count_; }
+
+private:
+    std::FILE* out_;
+    bool first_ = true;
+    size_t count_ = 0;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* input = nullptr;
+    const char* outPath = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "-o") && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (input == nullptr) {
+            input = argv[i];
+        } else {
+            fail(std::string("unexpected argument '") + argv[i] + "'");
+        }
+    }
+
+    if (input == nullptr) {
+        std::fprintf(stderr, "usage: tracedump <monitor.log|-> [-o trace.json]\n");
+        return 2;
+    }
+
+    Dump dump;
+    if (!std::strcmp(input, "-")) {
+        dump = parse(std::cin);
+    } else {
+        std::ifstream in(input);
+        if (!in) fail(std::string("cannot open ") + input);
+        dump = parse(in);
+    }
+
+    size_t unsynced = 0;
+    const std::vector<TimedEvent> timeline = toTimeline(dump, unsynced);
+
+    std::FILE* out = stdout;
+    if (outPath != nullptr) {
+        out = std::fopen(outPath, "w");
+        if (out == nullptr) fail(std::string("cannot write ") + outPath);
+    }
+
+    auto nameOf = [&dump](unsigned id) {
+        const auto it = dump.names.find(id);
+        return (it != dump.names.end()) ? it->second : std::string("?");
+    };
+
+    size_t unmatched = 0;
+    size_t written = 0;
+    {
+        JsonWriter json(out);
+        bool seenCore[kMaxCores] = {};
+        for (const TimedEvent& e : timeline) {
+            if (!seenCore[e.core]) {
+                seenCore[e.core] = true;
+                json.threadName(e.core);
+            }
+        }
+
+        // Открытые отрезки по ядрам (ISR вложены в проход задачи того же ядра)
+        std::vector<unsigned> open[kMaxCores];
+        char extra[128];
+        for (const TimedEvent& e : timeline) {
+            std::vector<unsigned>& stack = open[e.core];
+            switch (e.type) {
+                case 'B':
+                    stack.push_back(e.nameId);
+                    json.event(nameOf(e.nameId), 'B', e.ts, e.core);
+                    break;
+
+                case 'E': {
+                    const auto it = std::find(stack.rbegin(), stack.rend(), e.nameId);
+                    if (it == stack.rend()) {
+                        unmatched++;
+                        break;
+                    }
+                    // Вложенные без конца (потерян в кольце) закрываются здесь же
+                    while (stack.back() != e.nameId) {
+                        json.event(nameOf(stack.back()), 'E', e.ts, e.core);
+                        stack.pop_back();
+                        unmatched++;
+                    }
+                    stack.pop_back();
+                    json.event(nameOf(e.nameId), 'E', e.ts, e.core);
+                    break;
+                }
+
+                case 'i': {
+                    const std::string name = nameOf(e.nameId);
+                    const auto task = (name == "tick") ? dump.tasks.find(e.arg) : dump.tasks.end();
+                    if (task != dump.tasks.end()) {
+                        std::snprintf(extra, sizeof(extra), ",\"s\":\"t\",\"args\":{\"task\":%s}",
+                                      jsonString(task->second).c_str());
+                    } else {
+                        std::snprintf(extra, sizeof(extra), ",\"s\":\"t\",\"args\":{\"arg\":%" PRIu32 "}", e.arg);
+                    }
+                    json.event(name, 'i', e.ts, e.core, extra);
+                    break;
+                }
+
+                case 'C':
+                    std::snprintf(extra, sizeof(extra), ",\"args\":{\"value\":%" PRIu32 "}", e.arg);
+                    json.event(nameOf(e.nameId), 'C', e.ts, e.core, extra);
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        const double endTs = timeline.empty() ? 0.0 : timeline.back().ts;
+        for (unsigned core = 0; core < kMaxCores; ++core) {
+            while (!open[core].empty()) {
+                json.event(nameOf(open[core].back()), 'E', endTs, core);
+                open[core].pop_back();
+            }
+        }
+        written = json.count();
+    }
+    if (out != stdout) {
+        std::fclose(out);
+    }
+
+    std::fprintf(stderr, "tracedump: %zu events, %.3f ms at %u MHz -> %zu trace events\n",
+                 dump.events.size(), timeline.empty() ? 0.0 : timeline.back().ts / 1000.0,
+                 dump.mhz, written);
+    if (dump.overwritten > 0 || dump.skipped > 0 || unsynced > 0 || unmatched > 0) {
+        std::fprintf(stderr, "tracedump: %lu overwritten in ring, %lu skipped (cache off), "
+                     "%zu without time sync, %zu unmatched B/E\n",
+                     dump.overwritten, dump.skipped, unsynced, unmatched);
+    }
+    return 0;
+}
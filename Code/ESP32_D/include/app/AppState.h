@@ -1,26 +1,50 @@
 #pragma once
 #include <Arduino.h>
 #include <freertos/FreeRTOS.h>
-#include <freertos/semphr.h>
+#include <freertos/task.h>
 #include <atomic>
+#include "core/SeqLock.h"
 
 /**
  * @brief POD структура параметров стимуляции
  * Plain Old Data - можно безопасно копировать между потоками
- * УПРОЩЕННАЯ ВЕРСИЯ: только амплитуда
+ *
+ * Полный набор параметров канала: из него UI собирает TimingPlan
+ * (см. EMSPulseGenerator::buildPlan) и публикует генератору целиком.
+ * Значения по умолчанию совпадают с DefaultStimProfile.
  */
 struct StimParams {
-    uint8_t stimDuty;  // Амплитуда 0-100%
+    uint8_t  stimDuty;         // Амплитуда 0-100%
+    uint16_t pulseWidthUs;     // Длительность импульса (мкс)
+    uint16_t rateHz;           // Частота импульсов в пачке (Гц)
+    uint16_t pulsesPerBurst;   // Импульсов в пачке
+    uint32_t pauseMs;          // Пауза между пачками (мс)
+    uint32_t carrierHz;        // Несущая LEDC (Гц), 0 - оставить как есть
     
     // Конструктор с безопасным значением по умолчанию
     StimParams() 
-        : stimDuty(10)
+        : StimParams(10)
     {}
     
     // Конструктор с параметром
     explicit StimParams(uint8_t duty)
         : stimDuty(duty)
+        , pulseWidthUs(200)
+        , rateHz(144)
+        , pulsesPerBurst(26)
+        , pauseMs(235)
+        , carrierHz(0)
     {}
+
+    bool operator==(const StimParams& other) const {
+        return stimDuty == other.stimDuty
+            && pulseWidthUs == other.pulseWidthUs
+            && rateHz == other.rateHz
+            && pulsesPerBurst == other.pulsesPerBurst
+            && pauseMs == other.pauseMs
+            && carrierHz == other.carrierHz;
+    }
+    bool operator!=(const StimParams& other) const { return !(*this == other); }
 };
 
 /**
@@ -35,30 +59,72 @@ struct EncoderState {
         : position(0)
         , value(10)
     {}
+
+    bool operator==(const EncoderState& other) const {
+        return position == other.position && value == other.value;
+    }
+};
+
+/**
+ * @brief Согласованный снимок всего состояния (одно чтение seqlock)
+ */
+struct AppStateSnapshot {
+    StimParams   params;
+    EncoderState encoderA;
+    EncoderState encoderB;
 };
 
 /**
  * @brief Thread-safe менеджер состояния приложения
  * 
  * Обеспечивает безопасный доступ к параметрам из разных ядер ESP32.
- * Использует мьютексы для защиты критических секций.
+ * Все поля - один снимок под seqlock: чтение (Core 1, стим-путь) никогда
+ * не блокируется, а лишь повторяет копию, если попало на запись; писатели
+ * (Core 0) сериализуются короткой критической секцией и не ждут читателей.
+ * 
+ * Подписка на изменения: потребитель (дисплей, телеметрия, сохранение)
+ * регистрирует задачу и маску полей (kField*). Писатель после записи
+ * выставляет подписчику биты изменившихся полей и будит его
+ * xTaskNotifyGive - опрашивать геттеры не нужно, читаются только поля
+ * из takeChanges(). Уведомление - счетчик, как у остальных ожиданий
+ * в прошивке, поэтому задача может ждать и другие события.
  * 
- * УПРОЩЕННАЯ ВЕРСИЯ:
- * - Только amplitude в StimParams
- * - Два независимых энкодера (A и B)
- * - Каждый энкодер управляет своим значением amplitude
+ * Состав:
+ * - StimParams - полный набор параметров канала (амплитуда, тайминги
+ *   пачки, несущая), из него собирается TimingPlan генератора
+ * - Два энкодера (A и B) со своими позицией и значением 0..100;
+ *   амплитуду StimParams задает энкодер A
  */
 class AppState {
 public:
+    // Биты полей для подписки и takeChanges()
+    static constexpr uint32_t kFieldParams      = 1U << 0;
+    static constexpr uint32_t kFieldEncoderA    = 1U << 1;
+    static constexpr uint32_t kFieldEncoderB    = 1U << 2;
+    static constexpr uint32_t kFieldStimRunning = 1U << 3;
+    static constexpr uint32_t kFieldAll         = 0x0F;
+
+    static constexpr uint8_t kMaxSubscribers = 4;
+
     AppState();
-    ~AppState();
     
-    // Запрет копирования (из-за мьютекса)
+    // Запрет копирования (seqlock и спинлок писателей)
     AppState(const AppState&) = delete;
     AppState& operator=(const AppState&) = delete;
     
     // === Thread-safe методы для работы с параметрами ===
     
+    /**
+     * @brief Согласованный снимок параметров и обоих энкодеров (wait-free)
+     */
+    AppStateSnapshot getSnapshot() const;
+    
+    /**
+     * @brief Восстановить состояние целиком (загрузка настроек, до старта задач)
+     * @param snapshot Сохраненный снимок; значения приводятся к 0-100
+     */
+    void restore(const AppStateSnapshot& snapshot);
+    
     /**
      * @brief Получить копию текущих параметров (thread-safe)
      * @return Копия структуры параметров
@@ -128,22 +194,61 @@ public:
     // === Atomic флаги состояния (быстрый доступ без мьютекса) ===
     
     bool isStimRunning() const { return stimRunning_.load(); }
-    void setStimRunning(bool running) { stimRunning_.store(running); }
+    void setStimRunning(bool running);
+    
+    // === Подписка на изменения ===
+    
+    /**
+     * @brief Подписать задачу на изменения полей
+     * @param task Кого будить (xTaskNotifyGive)
+     * @param fields Маска kField*
+     * @return Номер подписчика или -1, если мест нет
+     */
+    int8_t subscribe(TaskHandle_t task, uint32_t fields);
+    
+    /**
+     * @brief Забрать и сбросить биты изменившихся полей (задача-подписчик)
+     */
+    uint32_t takeChanges(int8_t subscriber);
+    
+    /**
+     * @brief Ждать изменений не дольше timeoutMs
+     * @return Биты изменившихся полей (0 - таймаут)
+     */
+    uint32_t waitChanges(int8_t subscriber, uint32_t timeoutMs);
+    
+    // Растет на каждом изменении любого поля
+    uint32_t getVersion() const { return version_.load(std::memory_order_acquire); }
     
     // === Отладка и диагностика ===
     
+    // Сколько раз читатели повторяли копию из-за одновременной записи
+    uint32_t getReadRetries() const { return readRetries_.load(std::memory_order_relaxed); }
+    
     /**
      * @brief Вывести текущее состояние в Serial
+     * @param fields Какие поля выводить (например, биты из takeChanges())
      */
-    void printCurrentState() const;
+    void printCurrentState(uint32_t fields = kFieldAll) const;
 
 private:
-    StimParams stimParams_;
-    EncoderState encoderAState_;  // Состояние энкодера A
-    EncoderState encoderBState_;  // Состояние энкодера B
-    mutable SemaphoreHandle_t mutex_;  // mutable для const методов
+    SeqLock<AppStateSnapshot> state_;
+    portMUX_TYPE writeMux_ = portMUX_INITIALIZER_UNLOCKED;   // только между писателями
     std::atomic<bool> stimRunning_{false};
+    mutable std::atomic<uint32_t> readRetries_{0};
+    
+    struct Subscriber {
+        std::atomic<TaskHandle_t> task;
+        std::atomic<uint32_t>     pending;   // изменившиеся поля с прошлого takeChanges()
+        uint32_t                  fields;
+    };
+    Subscriber subscribers_[kMaxSubscribers];
+    std::atomic<uint8_t> subscriberCount_{0};
+    std::atomic<uint32_t> version_{0};
     
     // Вспомогательные методы
+    void notify(uint32_t changed);
+    AppStateSnapshot read() const;
+    bool adjustEncoder(bool encoderA, int8_t delta);
     void applyConstraints(StimParams& params) const;
 };
\ No newline at end of file
@@ -2,7 +2,10 @@
 #include <Arduino.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
+#include <freertos/task.h>
+#include <atomic>
 #include "app/AppState.h"
+#include "core/SpscRing.h"
 
 /**
  * @brief Типы команд для межпроцессорного взаимодействия
@@ -32,11 +35,24 @@ struct Command {
 };
 
 /**
- * @brief Обертка над FreeRTOS очередью для type-safe работы
+ * @brief Очередь команд UI_Task (Core 0) -> Stim_Task (Core 1)
+ *
+ * Два бэкенда с одним API:
+ *  - Spsc: lock-free кольцо (SpscRing), без критических секций ядра.
+ *    Ровно один писатель и один читатель: send() - только из одной задачи
+ *    (UI_Task), receive()/clear() - только из другой (Stim_Task).
+ *    Блокирующий receive() спит на уведомлении задачи (ulTaskNotifyTake),
+ *    send() будит ждущего читателя через xTaskNotifyGive.
+ *  - FreeRtos: прежняя очередь xQueue (любое число писателей/читателей).
  */
 class CommandQueue {
 public:
-    CommandQueue(size_t queueSize = 10);
+    enum class Backend : uint8_t {
+        Spsc,
+        FreeRtos
+    };
+
+    CommandQueue(size_t queueSize = 10, Backend backend = Backend::Spsc);
     ~CommandQueue();
     
     /**
@@ -66,16 +82,27 @@ public:
     size_t getCount() const;
     
     /**
-     * @brief Очистить очередь
+     * @brief Очистить очередь (в режиме Spsc - только со стороны читателя)
      */
     void clear();
     
     /**
      * @brief Проверить, инициализирована ли очередь
      */
-    bool isValid() const { return queue_ != nullptr; }
+    bool isValid() const {
+        return backend_ == Backend::Spsc ? ring_.isValid() : queue_ != nullptr;
+    }
+
+    Backend getBackend() const { return backend_; }
 
 private:
+    bool receiveSpsc(Command& cmd, uint32_t timeoutMs);
+    bool sendSpsc(const Command& cmd, uint32_t timeoutMs);
+
+    Backend backend_;
     QueueHandle_t queue_;
     size_t queueSize_;
+
+    SpscRing<Command> ring_;
+    std::atomic<TaskHandle_t> waiter_;   // читатель, спящий в receive()
 };
\ No newline at end of file
@@ -0,0 +1,133 @@
+#pragma once
+#include <Arduino.h>
+#include <Preferences.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <atomic>
+#include "app/AppState.h"
+#include "core/SeqLock.h"
+
+/**
+ * @brief Все, что переживает перезагрузку (один blob в NVS)
+ */
+struct StoredSettings {
+    static constexpr uint8_t kChannels = 2;
+
+    AppStateSnapshot app;                  // энкодеры и параметры UI
+    StimParams       channels[kChannels];  // полные параметры каналов (профиль)
+    uint8_t          channelMask;          // бит i - channels[i] задан
+
+    StoredSettings() : channelMask(0) {}
+
+    bool operator==(const StoredSettings& other) const;
+    bool operator!=(const StoredSettings& other) const { return !(*this == other); }
+};
+
+/**
+ * @brief Хранилище настроек в NVS с объединением записей
+ *
+ * UI только кладет свежий снимок (save - seqlock, без флеша и без ожидания)
+ * или писатель сам берет его, подписавшись на поля AppState (watch).
+ * Во флеш пишет отдельная задача с низким приоритетом: не чаще одного
+ * коммита за kMinCommitIntervalMs, и только если содержимое отличается от
+ * записанного - минуты вращения ручки дают десятки коммитов, а не тысячи.
+ * commitNow() (STOP) будит писателя и пишет сразу, минуя интервал.
+ *
+ * Запись флеша останавливает кэш обоих ядер, поэтому писатель ждет, пока
+ * writeGate не разрешит (например, пауза между пачками), но не дольше
+ * kGateTimeoutMs.
+ *
+ * Загрузка - одно чтение blob'а в begin(), до создания задач.
+ */
+class SettingsStore {
+public:
+    static constexpr uint32_t kMinCommitIntervalMs = 3000;
+    static constexpr uint32_t kGateTimeoutMs = 1000;
+
+    // true - флеш можно писать сейчас (вызывается из задачи-писателя)
+    using WriteGate = bool (*)();
+    // Собрать настройки из текущего состояния (вызывается из задачи-писателя)
+    using Capture = StoredSettings (*)();
+
+    SettingsStore();
+
+    SettingsStore(const SettingsStore&) = delete;
+    SettingsStore& operator=(const SettingsStore&) = delete;
+
+    /**
+     * @brief Открыть NVS и прочитать сохраненные настройки
+     * @return true если настройки восстановлены (иначе - значения по умолчанию)
+     */
+    bool begin();
+
+    // Восстановленные настройки - читать до startWriter()
+    bool hasRestored() const { return restored_; }
+    const StoredSettings& restored() const { return lastWritten_; }
+
+    /**
+     * @brief Запустить задачу-писателя (после begin())
+     */
+    bool startWriter(UBaseType_t priority, BaseType_t core);
+
+    void setWriteGate(WriteGate gate) { writeGate_ = gate; }
+
+    /**
+     * @brief Следить за полями AppState вместо save() (до startWriter())
+     *
+     * Писатель подписывается на fields и спит, пока они не изменятся;
+     * по изменению снимок собирает capture.
+     */
+    void watch(AppState& state, uint32_t fields, Capture capture);
+
+    // === Писатели снимка (UI_Task, setup) ===
+
+    // Положить свежие настройки; флеш не трогает
+    void save(const StoredSettings& settings);
+
+    // === Любая задача ===
+
+    // Записать как можно скорее, минуя интервал (STOP)
+    void commitNow();
+
+    // === Задача-писатель (на хосте - напрямую) ===
+
+    /**
+     * @brief Записать снимок, если он изменился и пора (или force)
+     * @return true если был коммит во флеш
+     */
+    bool commit(bool force);
+
+    // Есть снимок новее записанного (только задача-писатель)
+    bool isDirty() const { return pending_.version() != committedVersion_; }
+
+    uint32_t getCommitCount() const { return commits_; }
+    uint32_t getSkippedCount() const { return skipped_; }
+
+private:
+    static void writerThunk(void* arg);
+    void writerLoop();
+    bool intervalElapsed(uint32_t nowMs) const;
+
+    Preferences prefs_;
+    bool opened_ = false;
+    bool restored_ = false;
+
+    SeqLock<StoredSettings> pending_;
+    portMUX_TYPE writeMux_ = portMUX_INITIALIZER_UNLOCKED;   // только между писателями
+
+    // Состояние задачи-писателя
+    StoredSettings lastWritten_;
+    uint32_t committedVersion_ = 0;
+    uint32_t lastCommitMs_ = 0;
+    bool     everCommitted_ = false;
+    uint32_t commits_ = 0;
+    uint32_t skipped_ = 0;
+
+    std::atomic<bool> forceCommit_;
+    TaskHandle_t writerTask_ = nullptr;
+    WriteGate writeGate_ = nullptr;
+
+    AppState* source_ = nullptr;
+    uint32_t  sourceFields_ = 0;
+    Capture   capture_ = nullptr;
+};
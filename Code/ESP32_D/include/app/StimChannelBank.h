@@ -0,0 +1,99 @@
+#pragma once
+#include <Arduino.h>
+#include <esp_timer.h>
+
+#include "core/EdgeScheduler.h"
+#include "core/IsrProfile.h"
+#include "drivers/EMSPulseGenerator.h"
+
+/**
+ * @brief Банк каналов стимуляции с единой шкалой фронтов
+ *
+ * Вместо N вызовов update(), каждый из которых читает micros() и проверяет
+ * свои таймеры, банк держит min-heap ближайших фронтов всех каналов
+ * (EdgeScheduler) и обрабатывает только наступившие. Стоимость холостого
+ * прохода - одно сравнение с вершиной кучи, стоимость фронта - O(log N).
+ *
+ * Режимы пробуждения:
+ *  - Polling: update() из задачи
+ *  - Timer:   один esp_timer на весь банк, взводится на вершину кучи
+ *
+ * Генераторы переводятся в EMSPulseGenerator::DriveMode::External.
+ */
+class StimChannelBank {
+public:
+    static constexpr uint8_t kMaxChannels = 8;   // все каналы LEDC ESP32-S3
+
+    enum class WakeMode : uint8_t {
+        Polling,
+        Timer
+    };
+
+    StimChannelBank() = default;
+
+    StimChannelBank(const StimChannelBank&) = delete;
+    StimChannelBank& operator=(const StimChannelBank&) = delete;
+
+    /**
+     * @brief Добавить канал (до begin())
+     * @return Индекс канала в банке или -1, если мест нет
+     */
+    int8_t addChannel(EMSPulseGenerator& generator);
+
+    // Выбор режима - вызывать ДО begin()
+    void setWakeMode(WakeMode mode) { wakeMode_ = mode; }
+    WakeMode getWakeMode() const { return wakeMode_; }
+
+    // Инициализация всех каналов
+    bool begin();
+
+    void start(uint8_t channel);
+    void stop(uint8_t channel);
+    void startAll();
+    void stopAll();
+
+    void setParams(uint8_t channel, uint8_t amplitudePercent);
+    void rampTo(uint8_t channel, uint8_t amplitudePercent, uint32_t rampMs);
+
+    // Режим Polling: обработать наступившие фронты
+    void update();
+
+    // Сколько осталось до ближайшего фронта (UINT32_MAX - если все каналы стоят)
+    uint32_t getTimeToNextEdgeUs() const;
+
+    // Ошибка фронтов канала (см. EMSPulseGenerator::getEdgeStats)
+    EdgeErrorStats::Snapshot getEdgeStats(uint8_t channel) const;
+
+    uint8_t  getChannelCount() const { return count_; }
+    uint32_t getEdgeCount() const { return edgeCount_; }
+    // Ошибки esp_timer_stop/start_once при перевзводе (в норме 0)
+    uint32_t getArmFailures() const { return armFailures_; }
+
+    // Учет времени колбэка таймера (режим Timer); nullptr - без замера
+    void setIsrProfile(IsrProfile* profile) { isrProfile_ = profile; }
+
+private:
+    // Обработать наступившие фронты; маска каналов, ждущих смены несущей
+    uint32_t serviceDueLocked(uint64_t now);
+    // Сменить несущую каналам из маски - вне mux_ (ledcChangeFrequency)
+    void applyCarriers(uint32_t mask);
+    uint32_t timeToNextEdgeLocked() const;
+    // Перевзвести таймер банка на вершину кучи (под mux_)
+    void armTimerLocked();
+
+    static void timerThunk(void* arg);
+    void onTimer();
+
+    EMSPulseGenerator* channels_[kMaxChannels] = {};
+    uint8_t count_ = 0;
+
+    EdgeScheduler<kMaxChannels> schedule_;
+    WakeMode wakeMode_ = WakeMode::Polling;
+    esp_timer_handle_t timer_ = nullptr;
+    uint32_t edgeCount_ = 0;
+    uint32_t armFailures_ = 0;
+    IsrProfile* isrProfile_ = nullptr;
+
+    // Куча общая для stim-задачи и колбэка esp_timer
+    mutable portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+};
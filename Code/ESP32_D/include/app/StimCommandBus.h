@@ -0,0 +1,104 @@
+#pragma once
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <atomic>
+#include "app/CommandQueue.h"
+#include "core/StimProgram.h"
+#include "core/TraceRecorder.h"
+
+/**
+ * @brief Полосы команд UI -> Stim_Task с разным приоритетом
+ *
+ *  1. Аварийная остановка - отдельный флаг, Stim_Task проверяет его первым.
+ *     Вызывать можно из любой задачи; остановка сбрасывает все, что было
+ *     поставлено в очередь до нее (старые START).
+ *  2. Управление (START/STOP) - маленькая FIFO-очередь, порядок сохраняется.
+ *  3. Программа стимуляции - одна ячейка с байткодом StimProgram. Новую
+ *     программу можно положить, только когда Stim_Task забрал предыдущую.
+ *
+ * Параметры каналов сюда не идут: UI публикует TimingPlan прямо в генератор
+ * (EMSPulseGenerator::publishPlan) - это и есть почтовый ящик "последнее
+ * значение" на канал, и Stim_Task для него просыпаться не нужно.
+ *
+ * Писатель полосы 2 - одна задача (UI_Task), полосы 3 - консоль loop(),
+ * читатель - Stim_Task.
+ * Любая публикация будит читателя, спящего в wait().
+ *
+ * Отправка и прием отмечаются в трассе (TRACE_INSTANT, аргумент - тип команды).
+ */
+class StimCommandBus {
+public:
+    static constexpr size_t kControlQueueSize = 4;
+    // Заголовок + kMaxInstrs самых длинных команд (BURST, 7 байт)
+    static constexpr size_t kProgramCapacity = StimProgram::kHeaderSize + StimProgram::kMaxInstrs * 7;
+
+    StimCommandBus();
+
+    // === Сторона писателя ===
+
+    /**
+     * @brief Поставить управляющую команду в очередь (START/STOP)
+     *
+     * EMERGENCY_STOP перенаправляется в аварийную полосу,
+     * UPDATE_STIM_1_PARAMS отклоняется - параметры идут через publishPlan().
+     * @return true если команда принята
+     */
+    bool send(const Command& cmd, uint32_t timeoutMs = 0);
+
+    /**
+     * @brief Аварийная остановка (любая задача)
+     */
+    void emergencyStop();
+
+    /**
+     * @brief Передать байткод программы (одна задача-писатель)
+     *
+     * Байткод копируется; проверяет и ставит его Stim_Task.
+     * size == 0 - вернуть фиксированный цикл.
+     * @return false если предыдущая программа еще не забрана или байткод длиннее kProgramCapacity
+     */
+    bool sendProgram(const uint8_t* code, size_t size);
+
+    // === Сторона читателя (Stim_Task) ===
+
+    /**
+     * @brief Ждать любую публикацию не дольше timeoutMs
+     * @return true если что-то ждет обработки
+     */
+    bool wait(uint32_t timeoutMs);
+
+    /**
+     * @brief Забрать аварийную остановку (проверять первой)
+     *
+     * Если остановка была, очередь управления очищается.
+     */
+    bool takeEmergencyStop();
+
+    bool receiveControl(Command& cmd);
+
+    /**
+     * @brief Забрать байткод программы
+     * @param out Буфер не меньше kProgramCapacity
+     * @param size Длина байткода (0 - фиксированный цикл)
+     * @return true если программа ждала обработки
+     */
+    bool takeProgram(uint8_t* out, size_t& size);
+
+    bool hasPending() const;
+
+    bool isValid() const { return control_.isValid(); }
+
+private:
+    void wakeReader();
+
+    std::atomic<bool> emergency_;
+    CommandQueue control_;
+
+    // Ячейка программы: писатель заполняет при false, читатель опустошает при true
+    std::atomic<bool> programReady_;
+    uint8_t program_[kProgramCapacity];
+    size_t  programSize_;
+
+    std::atomic<TaskHandle_t> waiter_;
+};
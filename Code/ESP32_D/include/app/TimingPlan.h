@@ -0,0 +1,25 @@
+#pragma once
+#include <stdint.h>
+#include "app/stimSettings.h"
+
+/**
+ * @brief Готовый к применению набор таймингов и амплитуды канала
+ *
+ * Собирается на стороне UI из StimParams (EMSPulseGenerator::buildPlan):
+ * все деления и проверки сделаны заранее, генератор на границе пачки только
+ * копирует поля. Публикуется целиком, поэтому амплитуда, длительности и
+ * несущая меняются одновременно, на одном и том же импульсе.
+ */
+struct TimingPlan {
+    StimProfile profile;      // период импульса, пачка, пауза, полный цикл
+    uint16_t    duty;         // скважность LEDC для amplitude
+    uint8_t     amplitude;    // 0..100%
+    uint32_t    carrierHz;    // 0 - несущая не меняется
+
+    TimingPlan()
+        : profile(DefaultStimProfile::value)
+        , duty(0)
+        , amplitude(0)
+        , carrierHz(0)
+    {}
+};
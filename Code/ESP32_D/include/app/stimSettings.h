@@ -5,3 +5,139 @@
 /*
  * @brief Настройки стимуляции и конфигурация оборудования
  */
+
+/**
+ * @brief Профиль стимуляции: исходные параметры и все производные тайминги
+ *
+ * Производные поля считаются constexpr-функциями, поэтому для фиксированных
+ * профилей (FixedStimProfile) все деления выполняет компилятор, а генератор
+ * получает готовые константы. Тот же тип подходит и для профилей, собранных
+ * во время работы - их проверяет isValid().
+ */
+struct StimProfile {
+    // Максимальный цикл. Шкала фронтов EMSPulseGenerator 64-битная и предела
+    // не дает; ограничивают остальные генераторы: MCPWM ведет фронты по
+    // 32-битному micros() со сравнением через разность, RMT складывает два
+    // цикла в uint32_t при расчете фазы подмены. Отсюда 2^31 - 1 мкс (~35 мин)
+    static constexpr uint32_t kMaxCycleUs = 0x7FFFFFFFUL;
+
+    // Исходные параметры
+    uint16_t rateHz;           // частота импульсов в пачке (Гц)
+    uint16_t pulsesPerBurst;   // импульсов в пачке
+    uint16_t pulseWidthUs;     // длительность импульса (мкс)
+
+    // Производные параметры (мкс)
+    uint32_t pulsePeriodUs;
+    uint32_t burstDurationUs;
+    uint32_t pauseDurationUs;
+    uint32_t fullCycleUs;
+
+    /**
+     * @brief Профиль через паузу между пачками (как в EMSPulseGenerator)
+     */
+    static constexpr StimProfile fromPause(uint16_t rateHz, uint16_t pulsesPerBurst,
+                                           uint32_t pauseMs, uint16_t pulseWidthUs) {
+        return StimProfile(rateHz, pulsesPerBurst, pulseWidthUs,
+                           clampCycleUs(burstUs(rateHz, pulsesPerBurst) + (uint64_t)pauseMs * 1000ULL));
+    }
+
+    /**
+     * @brief Профиль через период цикла: пауза = цикл - пачка
+     */
+    static constexpr StimProfile fromCycle(uint16_t rateHz, uint16_t pulsesPerBurst,
+                                           uint32_t cycleMs, uint16_t pulseWidthUs) {
+        return StimProfile(rateHz, pulsesPerBurst, pulseWidthUs, clampCycleUs((uint64_t)cycleMs * 1000ULL));
+    }
+
+    constexpr bool isValid() const {
+        return rateHz > 0 && pulsesPerBurst > 0 && pulseWidthUs > 0
+            && pulseWidthUs < pulsePeriodUs
+            && burstDurationUs <= fullCycleUs
+            && burstDurationUs <= kMaxCycleUs
+            && fullCycleUs <= kMaxCycleUs;
+    }
+
+    static constexpr uint32_t periodUs(uint16_t rateHz) {
+        return (rateHz > 0) ? 1000000UL / rateHz : 0;
+    }
+
+    // Пачка длиннее uint32_t (1 Гц x 5000 импульсов) не переполняется, а
+    // становится заведомо > kMaxCycleUs и не проходит isValid()
+    static constexpr uint32_t burstUs(uint16_t rateHz, uint16_t pulsesPerBurst) {
+        return clampCycleUs((uint64_t)pulsesPerBurst * periodUs(rateHz));
+    }
+
+    // Цикл длиннее uint32_t не переполняется, а становится заведомо > kMaxCycleUs
+    static constexpr uint32_t clampCycleUs(uint64_t cycleUs) {
+        return (cycleUs > UINT32_MAX) ? UINT32_MAX : (uint32_t)cycleUs;
+    }
+
+private:
+    constexpr StimProfile(uint16_t rate, uint16_t pulses, uint16_t pwUs, uint32_t cycleUs)
+        : rateHz(rate)
+        , pulsesPerBurst(pulses)
+        , pulseWidthUs(pwUs)
+        , pulsePeriodUs(periodUs(rate))
+        , burstDurationUs(burstUs(rate, pulses))
+        , pauseDurationUs((cycleUs >= burstUs(rate, pulses)) ? cycleUs - burstUs(rate, pulses) : 0)
+        , fullCycleUs(cycleUs)
+    {}
+};
+
+/**
+ * @brief Проверки фиксированного профиля на этапе компиляции
+ * Каждое условие - отдельный static_assert, чтобы ошибка указывала причину.
+ */
+template <uint16_t RateHz, uint16_t PulsesPerBurst, uint16_t PulseWidthUs, uint64_t CycleUs>
+struct StimProfileCheck {
+    static_assert(RateHz > 0, "StimProfile: pulse rate must be > 0");
+    static_assert(PulsesPerBurst > 0, "StimProfile: burst must contain at least one pulse");
+    static_assert(PulseWidthUs > 0, "StimProfile: pulse width must be > 0");
+    static_assert(PulseWidthUs < StimProfile::periodUs(RateHz),
+                  "StimProfile: pulse width must be shorter than the pulse period");
+    static_assert((uint64_t)PulsesPerBurst * StimProfile::periodUs(RateHz) <= StimProfile::kMaxCycleUs,
+                  "StimProfile: burst exceeds kMaxCycleUs");
+    static_assert(StimProfile::burstUs(RateHz, PulsesPerBurst) <= CycleUs,
+                  "StimProfile: burst is longer than the cycle");
+    static_assert(CycleUs <= StimProfile::kMaxCycleUs,
+                  "StimProfile: cycle exceeds kMaxCycleUs (MCPWM/RMT 32-bit arithmetic)");
+
+    static constexpr bool ok = true;
+};
+
+/**
+ * @brief Фиксированный профиль (через паузу), все тайминги - константы компиляции
+ *
+ *   using MyProfile = FixedStimProfile<144, 26, 235, 200>;
+ *   FixedProfileGenerator<MyProfile> stim(0, PWM_CH_1_PIN);
+ */
+template <uint16_t RateHz, uint16_t PulsesPerBurst, uint32_t PauseMs, uint16_t PulseWidthUs>
+struct FixedStimProfile {
+    static_assert(StimProfileCheck<RateHz, PulsesPerBurst, PulseWidthUs,
+                                   StimProfile::burstUs(RateHz, PulsesPerBurst) + PauseMs * 1000ULL>::ok,
+                  "StimProfile: invalid profile");
+
+    static constexpr StimProfile value =
+        StimProfile::fromPause(RateHz, PulsesPerBurst, PauseMs, PulseWidthUs);
+};
+
+template <uint16_t RateHz, uint16_t PulsesPerBurst, uint32_t PauseMs, uint16_t PulseWidthUs>
+constexpr StimProfile FixedStimProfile<RateHz, PulsesPerBurst, PauseMs, PulseWidthUs>::value;
+
+/**
+ * @brief Фиксированный профиль через период цикла
+ */
+template <uint16_t RateHz, uint16_t PulsesPerBurst, uint32_t CycleMs, uint16_t PulseWidthUs>
+struct FixedCycleStimProfile {
+    static_assert(StimProfileCheck<RateHz, PulsesPerBurst, PulseWidthUs, CycleMs * 1000ULL>::ok,
+                  "StimProfile: invalid profile");
+
+    static constexpr StimProfile value =
+        StimProfile::fromCycle(RateHz, PulsesPerBurst, CycleMs, PulseWidthUs);
+};
+
+template <uint16_t RateHz, uint16_t PulsesPerBurst, uint32_t CycleMs, uint16_t PulseWidthUs>
+constexpr StimProfile FixedCycleStimProfile<RateHz, PulsesPerBurst, CycleMs, PulseWidthUs>::value;
+
+// Профиль по умолчанию: 144 Гц, 26 импульсов по 200 мкс, пауза 235 мс
+using DefaultStimProfile = FixedStimProfile<144, 26, 235, 200>;
@@ -0,0 +1,153 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "core/MpscRing.h"
+
+// Запись лога: формат не разбирается на месте, а сохраняется указателем
+// вместе с сырыми аргументами; текст собирает задача вывода
+struct LogRecord {
+    static constexpr uint8_t kMaxArgs = 6;
+
+    enum ArgType : uint8_t {
+        kArgInt = 0,        // целые, enum, bool (32 бита со знаком или без)
+        kArgFloat = 1,      // float/double - хранится как float
+        kArgString = 2,     // const char* - только строки со статическим временем жизни
+        kArgPointer = 3
+    };
+
+    const char* format;     // литерал: его адрес - идентификатор формата
+    uint32_t    timestampUs;
+    uint16_t    argTypes;   // по 2 бита на аргумент
+    uint8_t     argCount;
+    uint8_t     core;
+    uintptr_t   args[kMaxArgs];
+};
+
+/**
+ * @brief Отложенный лог: printf без форматирования на горячем пути
+ *
+ * DeferredLog::printf() не форматирует и не ждет USB-CDC: он кладет
+ * запись (адрес формата, micros(), до 6 аргументов по слову) в кольцо
+ * своего ядра и возвращается - десятки-сотни тактов независимо от длины
+ * сообщения. Низкоприоритетная задача вывода (startDrain) раз в
+ * kDrainPeriodMs выбирает оба кольца, сливает пачки по времени и
+ * форматирует в Serial.
+ *
+ * Можно звать из задач и ISR (IRAM). Писатели одного кольца - задачи и
+ * прерывания своего ядра - занимают ячейки CAS (MpscRing): ни спинлока, ни
+ * запрета прерываний, ядра друг другу не мешают; читатель один - задача
+ * вывода. Кольцо заполнено - запись отбрасывается и считается (getDropped),
+ * писатель не ждет никогда.
+ *
+ * Ограничения формата: спецификаторы целых до 32 бит (%d %u %x %ld %lu
+ * %c), %f (точность float), %s - только со строками, живущими всю
+ * программу (литералы), %p. %lld и %n не поддерживаются.
+ */
+class DeferredLog {
+public:
+    static constexpr uint8_t  kCores = portNUM_PROCESSORS;
+    static constexpr size_t   kRingCapacity = 128;      // записей на ядро
+    static constexpr size_t   kDrainBatch = 16;
+    static constexpr uint32_t kDrainPeriodMs = 20;
+    static constexpr size_t   kLineLength = 192;        // строка после форматирования
+
+    // Записать сообщение; false - кольцо ядра заполнено (запись потеряна)
+    template <typename... Args>
+    static inline bool IRAM_ATTR printf(const char* format, Args... args) {
+        LogRecord record = makeRecord(format, args...);
+        return push(record);
+    }
+
+    // Собрать запись, не записывая ее (проверки, бенчмарки)
+    template <typename... Args>
+    static inline LogRecord IRAM_ATTR makeRecord(const char* format, Args... args) {
+        static_assert(sizeof...(Args) <= LogRecord::kMaxArgs, "DeferredLog: too many arguments");
+        LogRecord record;
+        record.format = format;
+        record.timestampUs = (uint32_t)micros();
+        record.argTypes = 0;
+        record.argCount = (uint8_t)sizeof...(Args);
+        record.core = 0;
+        pack(record, 0, args...);
+        return record;
+    }
+
+    // Запустить задачу вывода (один раз)
+    static bool startDrain(UBaseType_t priority, BaseType_t core);
+
+    // Вывести накопленное сейчас (задача вывода или код без нее); сколько записей
+    static size_t drain();
+
+    // Потеряно / записано с запуска (по ядрам - для кольца конкретного ядра)
+    static uint32_t getDropped();
+    static uint32_t getDropped(uint8_t core);
+    static uint32_t getWritten();
+
+    // Отформатировать запись без префикса времени (задача вывода, утилиты)
+    static size_t format(const LogRecord& record, char* out, size_t size);
+
+private:
+    struct CoreRing {
+        MpscRing<LogRecord>   ring;
+        std::atomic<uint32_t> written;
+        std::atomic<uint32_t> dropped;
+
+        CoreRing() : ring(kRingCapacity), written(0), dropped(0) {}
+    };
+
+    static bool IRAM_ATTR push(LogRecord& record);
+
+    static void drainTask(void* arg);
+    static void emit(const LogRecord& record);
+
+    // Аргументы -> слова записи
+    static inline void pack(LogRecord&, uint8_t) {}
+
+    template <typename T, typename... Rest>
+    static inline void pack(LogRecord& record, uint8_t i, T value, Rest... rest) {
+        store(record, i, value);
+        pack(record, (uint8_t)(i + 1), rest...);
+    }
+
+    template <typename T>
+    static inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+    store(LogRecord& record, uint8_t i, T value) {
+        // Знак расширяется до слова: %d и %u увидят те же 32 бита
+        record.args[i] = (uintptr_t)(intptr_t)(int32_t)value;
+        setType(record, i, LogRecord::kArgInt);
+    }
+
+    template <typename T>
+    static inline typename std::enable_if<std::is_floating_point<T>::value>::type
+    store(LogRecord& record, uint8_t i, T value) {
+        const float f = (float)value;
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        record.args[i] = bits;
+        setType(record, i, LogRecord::kArgFloat);
+    }
+
+    static inline void store(LogRecord& record, uint8_t i, const char* value) {
+        record.args[i] = (uintptr_t)value;
+        setType(record, i, LogRecord::kArgString);
+    }
+
+    static inline void store(LogRecord& record, uint8_t i, const void* value) {
+        record.args[i] = (uintptr_t)value;
+        setType(record, i, LogRecord::kArgPointer);
+    }
+
+    static inline void setType(LogRecord& record, uint8_t i, LogRecord::ArgType type) {
+        record.argTypes = (uint16_t)(record.argTypes | ((uint16_t)type << (2 * i)));
+    }
+
+    static CoreRing rings_[kCores];
+    static TaskHandle_t drainTask_;
+};
@@ -0,0 +1,90 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * @brief Статистика интервала в микросекундах: min/mean/p99/max
+ *
+ * record() - O(1) без деления: min/max/сумма и линейная гистограмма
+ * (BucketUs на корзину, последняя корзина - все что дальше), по которой
+ * snapshot() оценивает p99. Отрицательные значения попадают в min и
+ * среднее, в гистограмме считаются нулевой корзиной.
+ */
+template <uint16_t BucketUs, uint16_t Buckets>
+class TimingStats {
+public:
+    static constexpr uint16_t kBucketUs = BucketUs;
+    static constexpr uint16_t kBuckets = Buckets;
+
+    struct Snapshot {
+        uint32_t count;
+        int32_t  minUs;
+        int32_t  maxUs;
+        int32_t  meanUs;
+        int32_t  p99Us;     // верхняя граница корзины, в которую попал 99-й перцентиль
+    };
+
+    TimingStats() { reset(); }
+
+    void reset() {
+        count_ = 0;
+        sumUs_ = 0;
+        minUs_ = INT32_MAX;
+        maxUs_ = INT32_MIN;
+        for (uint16_t i = 0; i <= kBuckets; ++i) {
+            buckets_[i] = 0;
+        }
+    }
+
+    void record(int64_t errorUs) {
+        const int32_t e = (errorUs > INT32_MAX) ? INT32_MAX :
+                          (errorUs < INT32_MIN) ? INT32_MIN : (int32_t)errorUs;
+        count_++;
+        sumUs_ += e;
+        if (e < minUs_) minUs_ = e;
+        if (e > maxUs_) maxUs_ = e;
+
+        uint32_t bucket = (e > 0) ? (uint32_t)e / kBucketUs : 0;   // сдвиг: kBucketUs - степень 2
+        if (bucket > kBuckets) {
+            bucket = kBuckets;
+        }
+        buckets_[bucket]++;
+    }
+
+    Snapshot snapshot() const {
+        Snapshot s = {count_, 0, 0, 0, 0};
+        if (count_ == 0) {
+            return s;
+        }
+
+        s.minUs = minUs_;
+        s.maxUs = maxUs_;
+        s.meanUs = (int32_t)(sumUs_ / (int64_t)count_);
+
+        // 99-й перцентиль: первая корзина, где накопилось >= 99% отсчетов
+        const uint32_t rank = count_ - count_ / 100;
+        uint32_t seen = 0;
+        for (uint16_t i = 0; i <= kBuckets; ++i) {
+            seen += buckets_[i];
+            if (seen >= rank) {
+                s.p99Us = (i == kBuckets) ? maxUs_ : (int32_t)((i + 1) * kBucketUs - 1);
+                if (s.p99Us > maxUs_) {
+                    s.p99Us = maxUs_;
+                }
+                break;
+            }
+        }
+        return s;
+    }
+
+private:
+    static_assert((kBucketUs & (kBucketUs - 1)) == 0, "kBucketUs must be a power of two");
+
+    uint32_t count_;
+    int64_t  sumUs_;
+    int32_t  minUs_;
+    int32_t  maxUs_;
+    uint32_t buckets_[kBuckets + 1];
+};
+
+// Ошибка фронтов (факт - идеал): 4 мкс на корзину, 0..508 мкс + переполнение
+using EdgeErrorStats = TimingStats<4, 128>;
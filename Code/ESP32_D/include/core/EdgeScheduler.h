@@ -0,0 +1,139 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * @brief Min-heap ближайших фронтов для N каналов стимуляции
+ *
+ * Один элемент на канал: {время следующего фронта, номер канала}.
+ * Вершина кучи - ближайшее событие по всем каналам, поэтому планировщику
+ * достаточно просыпаться только к нему. Перепланирование канала - O(log N),
+ * чтение вершины - O(1). Без динамической памяти, пригодно для ISR/колбэков.
+ *
+ * Время в микросекундах на 64-битной шкале esp_timer_get_time(): переполнения
+ * за время работы нет, поэтому сравнение - обычное "меньше".
+ */
+template <uint8_t N>
+class EdgeScheduler {
+public:
+    static constexpr uint8_t kNone = 0xFF;
+
+    EdgeScheduler() { clear(); }
+
+    void clear() {
+        size_ = 0;
+        for (uint8_t i = 0; i < N; ++i) {
+            pos_[i] = kNone;
+        }
+    }
+
+    bool    empty() const { return size_ == 0; }
+    uint8_t size() const { return size_; }
+
+    // Ближайшее событие (вызывать только если !empty())
+    uint8_t  topChannel() const { return heap_[0].channel; }
+    uint64_t topDueUs() const { return heap_[0].dueUs; }
+
+    bool isScheduled(uint8_t channel) const {
+        return channel < N && pos_[channel] != kNone;
+    }
+
+    /**
+     * @brief Поставить канал в очередь или перенести его фронт
+     * @param channel Номер канала (0..N-1)
+     * @param dueUs Время следующего фронта
+     */
+    void schedule(uint8_t channel, uint64_t dueUs) {
+        if (channel >= N) {
+            return;
+        }
+
+        uint8_t i = pos_[channel];
+        if (i == kNone) {
+            i = size_++;
+            place(i, Entry{dueUs, channel});
+            siftUp(i);
+            return;
+        }
+
+        const uint64_t old = heap_[i].dueUs;
+        heap_[i].dueUs = dueUs;
+        if (earlier(dueUs, old)) {
+            siftUp(i);
+        } else {
+            siftDown(i);
+        }
+    }
+
+    // Убрать канал из очереди (остановка канала)
+    void cancel(uint8_t channel) {
+        if (!isScheduled(channel)) {
+            return;
+        }
+
+        const uint8_t i = pos_[channel];
+        pos_[channel] = kNone;
+        --size_;
+        if (i == size_) {
+            return;
+        }
+
+        // На место удаленного ставим последний элемент и восстанавливаем порядок
+        place(i, heap_[size_]);
+        if (i > 0 && earlier(heap_[i].dueUs, heap_[(i - 1) / 2].dueUs)) {
+            siftUp(i);
+        } else {
+            siftDown(i);
+        }
+    }
+
+    static bool earlier(uint64_t a, uint64_t b) {
+        return a < b;
+    }
+
+private:
+    struct Entry {
+        uint64_t dueUs;
+        uint8_t  channel;
+    };
+
+    void place(uint8_t i, const Entry& e) {
+        heap_[i] = e;
+        pos_[e.channel] = i;
+    }
+
+    void siftUp(uint8_t i) {
+        const Entry e = heap_[i];
+        while (i > 0) {
+            const uint8_t parent = (i - 1) / 2;
+            if (!earlier(e.dueUs, heap_[parent].dueUs)) {
+                break;
+            }
+            place(i, heap_[parent]);
+            i = parent;
+        }
+        place(i, e);
+    }
+
+    void siftDown(uint8_t i) {
+        const Entry e = heap_[i];
+        while (true) {
+            uint8_t child = 2 * i + 1;
+            if (child >= size_) {
+                break;
+            }
+            if (child + 1 < size_ && earlier(heap_[child + 1].dueUs, heap_[child].dueUs)) {
+                ++child;
+            }
+            if (!earlier(heap_[child].dueUs, e.dueUs)) {
+                break;
+            }
+            place(i, heap_[child]);
+            i = child;
+        }
+        place(i, e);
+    }
+
+    Entry   heap_[N];
+    uint8_t pos_[N];       // индекс канала в куче или kNone
+    uint8_t size_ = 0;
+};
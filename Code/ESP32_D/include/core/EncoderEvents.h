@@ -0,0 +1,123 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <algorithm>
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "core/SpscRing.h"
+#include "core/EdgeErrorStats.h"
+
+// Событие энкодера из ISR: когда и куда был щелчок
+struct EncoderEvent {
+    uint32_t timestampUs;   // micros() в ISR
+    int8_t   step;          // +1 / -1
+};
+
+/**
+ * @brief Очередь щелчков энкодера ISR -> задача с метриками
+ *
+ * ISR кладет (время, шаг) в lock-free кольцо (писатель - ISR, читатель -
+ * задача). drain() выбирает кольцо пачками и возвращает сумму шагов, а по
+ * меткам времени считает скорость вращения и задержку ISR -> обработчик.
+ * Если кольцо переполнено, шаг все равно не теряется - он копится в
+ * отдельном счетчике, пропадает только его метка времени.
+ *
+ * Задача-читатель может не опрашивать кольцо по таймеру: с setWakeTask()
+ * каждый push() (и wake() - для бэкендов без событий) будит ее прямым
+ * уведомлением (счетчик, ulTaskNotifyTake). Уведомление может прийти и без
+ * новых шагов - читатель просто выбирает то, что есть.
+ *
+ * Без виртуальных методов: общая часть IEncoder и StaticEncoder.
+ */
+class EncoderEvents {
+public:
+    static constexpr size_t   kCapacity = 64;
+    static constexpr size_t   kDrainBatch = 16;
+    // Нет щелчков дольше этого - скорость считается нулевой
+    static constexpr uint32_t kVelocityTimeoutUs = 250000;
+
+    // Задержка ISR -> обработчик: 256 мкс на корзину, до ~33 мс (цикл UI - 10 мс)
+    using LatencyStats = TimingStats<256, 128>;
+
+    EncoderEvents()
+        : ring_(kCapacity)
+        , overflowSteps_(0)
+        , droppedEvents_(0)
+    {}
+
+    EncoderEvents(const EncoderEvents&) = delete;
+    EncoderEvents& operator=(const EncoderEvents&) = delete;
+
+    bool isValid() const { return ring_.isValid(); }
+
+    // Кого будить из ISR (до включения прерываний); nullptr - никого
+    void setWakeTask(TaskHandle_t task) { wakeTask_ = task; }
+    TaskHandle_t getWakeTask() const { return wakeTask_; }
+
+    // === ISR ===
+
+    // Записать щелчок с меткой времени.
+    // Только из обработчиков без ESP_INTR_FLAG_IRAM: SpscRing::push() и
+    // micros() лежат во flash, а IRAM-обработчик работает и при выключенном
+    // кэше (запись NVS) - вызов туда падает. IRAM_ATTR здесь - лишь скорость
+    inline void IRAM_ATTR push(int8_t step) {
+        const EncoderEvent event = {(uint32_t)micros(), step};
+        if (!ring_.push(event)) {
+            // Кольцо полно (UI надолго задержался): шаг сохраняем без метки
+            overflowSteps_.fetch_add(step, std::memory_order_relaxed);
+            droppedEvents_.fetch_add(1, std::memory_order_relaxed);
+        }
+        wake();
+    }
+
+    // Разбудить читателя (активность без события в кольце)
+    inline void IRAM_ATTR wake() {
+        TaskHandle_t task = wakeTask_;
+        if (task != nullptr) {
+            BaseType_t woken = pdFALSE;
+            vTaskNotifyGiveFromISR(task, &woken);
+            if (woken == pdTRUE) {
+                portYIELD_FROM_ISR();
+            }
+        }
+    }
+
+    // === Задача-читатель ===
+
+    // Выбрать все события, обновить метрики; сумма шагов
+    int32_t drain();
+
+    // Отдать сумму шагов обработчику порциями int8_t (без усечения)
+    template <typename Fn>
+    static void dispatch(int32_t steps, Fn& handler) {
+        while (steps != 0) {
+            const int32_t delta = std::max<int32_t>(-127, std::min<int32_t>(127, steps));
+            handler(static_cast<int8_t>(delta));
+            steps -= delta;
+        }
+    }
+
+    // Сглаженная скорость, щелчков/с со знаком (0 - ручка стоит)
+    int32_t getVelocity() const { return velocity_; }
+
+    LatencyStats::Snapshot getLatencyStats() const { return latency_.snapshot(); }
+    void resetLatencyStats() { latency_.reset(); }
+
+    // Событий без метки времени (кольцо было заполнено)
+    uint32_t getDroppedEvents() const { return droppedEvents_.load(std::memory_order_relaxed); }
+
+private:
+    SpscRing<EncoderEvent> ring_;
+    // Шаги, не влезшие в кольцо (без меток времени)
+    std::atomic<int32_t>  overflowSteps_;
+    std::atomic<uint32_t> droppedEvents_;
+    TaskHandle_t wakeTask_ = nullptr;
+
+    // Метрики по меткам времени (только читатель)
+    LatencyStats latency_;
+    int32_t  velocity_ = 0;
+    uint32_t lastEventUs_ = 0;
+    bool     haveLastEvent_ = false;
+};
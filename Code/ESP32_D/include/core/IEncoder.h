@@ -1,12 +1,32 @@
 #pragma once
 #include <stdint.h>
 #include <functional>
+#include <atomic>
 #include <Arduino.h>
 
+#include "core/EncoderEvents.h"
+#include "core/IsrProfile.h"
+
+/**
+ * @brief Базовый энкодер на прерываниях
+ *
+ * ISR кладет щелчки в EncoderEvents, update() выбирает их пачками и отдает
+ * сумму обработчику без потерь (большие суммы - несколькими вызовами по
+ * ±127). Метрики (скорость, задержка ISR -> обработчик) - там же.
+ *
+ * Вызовы handleIsr() и обработчика здесь виртуальные / через std::function -
+ * выбор типа энкодера во время выполнения. Без косвенных вызовов на пути
+ * ISR - см. StaticEncoder.
+ */
 class IEncoder {
 public:
     using StepHandler = std::function<void(int8_t delta)>; // вызывается НЕ из ISR
 
+    static constexpr size_t   kEventCapacity = EncoderEvents::kCapacity;
+    static constexpr uint32_t kVelocityTimeoutUs = EncoderEvents::kVelocityTimeoutUs;
+
+    using LatencyStats = EncoderEvents::LatencyStats;
+
     // Общий конструктор для всех энкодеров
     IEncoder(uint8_t clkPin, uint8_t dtPin, uint32_t debounceUs = 1000)
         : clkPin_(clkPin)
@@ -25,11 +45,28 @@ public:
     // Регистрация обработчика шагов
     virtual void onStep(StepHandler h) { handler_ = std::move(h); }
 
+    // Будить задачу с update() уведомлением на каждый щелчок (до begin())
+    void setWakeTask(TaskHandle_t task) { events_.setWakeTask(task); }
+
+    // Учет времени ISR энкодера (до begin()); nullptr - без замера
+    void setIsrProfile(IsrProfile* profile) { isrProfile_ = profile; }
+
     // Геттеры
     uint8_t getClkPin() const { return clkPin_; }
     uint8_t getDtPin() const { return dtPin_; }
     uint32_t getDebounceUs() const { return debounceUs_; }
 
+    // === Метрики (поток update()) ===
+
+    // Сглаженная скорость, щелчков/с со знаком (0 - ручка стоит)
+    int32_t getVelocity() const { return events_.getVelocity(); }
+
+    LatencyStats::Snapshot getLatencyStats() const { return events_.getLatencyStats(); }
+    void resetLatencyStats() { events_.resetLatencyStats(); }
+
+    // Событий без метки времени (кольцо было заполнено)
+    uint32_t getDroppedEvents() const { return events_.getDroppedEvents(); }
+
 protected:
     // Виртуальный метод для обработки прерывания
     virtual void IRAM_ATTR handleIsr() = 0;
@@ -40,6 +77,12 @@ protected:
     // Статический thunk для вызова handleIsr из прерывания
     static void IRAM_ATTR isrThunk(void* arg);
 
+    // Из handleIsr: записать щелчок с меткой времени
+    void IRAM_ATTR pushStep(int8_t step) { events_.push(step); }
+
+    // Отдать обработчику сумму шагов порциями int8_t
+    void dispatchSteps(int32_t steps);
+
 protected:
     // Параметры энкодера
     uint8_t clkPin_;
@@ -51,11 +94,9 @@ protected:
     volatile int lastDt_{HIGH};
     volatile uint32_t lastDebounceUs_{0};
 
-    // Накопленные шаги из ISR
-    volatile int32_t pendingSteps_{0};
-
-    // Критическая секция для обмена с ISR
-    portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+    // События из ISR (писатель - ISR, читатель - update())
+    EncoderEvents events_;
+    IsrProfile* isrProfile_ = nullptr;
 
     // Обработчик шагов
     StepHandler handler_{};
@@ -0,0 +1,97 @@
+#pragma once
+#include <stdint.h>
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+
+#include "core/LatencyHistogram.h"
+#include "core/TraceRecorder.h"
+
+/**
+ * @brief Учет времени одного обработчика прерывания (такты CCOUNT)
+ *
+ * Обработчик оборачивает тело в IsrScope: на входе и выходе читается
+ * счетчик тактов своего ядра, разность копится в профиле. Счетчики -
+ * под спинлоком portMUX: обработчик и читатель (Profiler, другое ядро)
+ * не видят 64-битную сумму наполовину обновленной.
+ *
+ * Распределение длительностей (p50..p99.9) - в LatencyHistogram тактов:
+ * она без блокировок, ее окно сбрасывает читатель (Profiler).
+ *
+ * Драйверы получают профиль указателем (setIsrProfile); nullptr - замер
+ * выключен, цена - одна проверка. В сборке с трассой IsrScope еще пишет
+ * отрезок с именем профиля (TRACE_BEGIN/END) - вне замеренного интервала.
+ */
+class IsrProfile {
+public:
+    struct Totals {
+        uint32_t count;
+        uint64_t cycles;
+        uint32_t maxCycles;     // с предыдущего takeTotals()
+    };
+
+    explicit IsrProfile(const char* name) : name_(name) {}
+
+    IsrProfile(const IsrProfile&) = delete;
+    IsrProfile& operator=(const IsrProfile&) = delete;
+
+    const char* getName() const { return name_; }
+
+    inline void IRAM_ATTR record(uint32_t cycles) {
+        portENTER_CRITICAL_ISR(&mux_);
+        count_++;
+        cycles_ += cycles;
+        if (cycles > maxCycles_) {
+            maxCycles_ = cycles;
+        }
+        portEXIT_CRITICAL_ISR(&mux_);
+        histogram_.record(cycles);
+    }
+
+    // Длительности в тактах (читатель - одна задача)
+    LatencyHistogram& getHistogram() { return histogram_; }
+
+    // Накопленное с begin(); максимум сбрасывается (окно - между вызовами)
+    Totals takeTotals() {
+        portENTER_CRITICAL(&mux_);
+        const Totals totals = {count_, cycles_, maxCycles_};
+        maxCycles_ = 0;
+        portEXIT_CRITICAL(&mux_);
+        return totals;
+    }
+
+private:
+    const char* name_;
+    portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+    uint32_t count_ = 0;
+    uint64_t cycles_ = 0;
+    uint32_t maxCycles_ = 0;
+    LatencyHistogram histogram_;
+};
+
+// Замер от конструктора до деструктора (тело обработчика)
+class IsrScope {
+public:
+    inline explicit IRAM_ATTR IsrScope(IsrProfile* profile)
+        : profile_(profile)
+        , start_(0)
+    {
+        if (profile_ != nullptr) {
+            TRACE_BEGIN(profile_->getName());
+            start_ = ESP.getCycleCount();
+        }
+    }
+
+    inline IRAM_ATTR ~IsrScope() {
+        if (profile_ != nullptr) {
+            profile_->record(ESP.getCycleCount() - start_);
+            TRACE_END(profile_->getName());
+        }
+    }
+
+    IsrScope(const IsrScope&) = delete;
+    IsrScope& operator=(const IsrScope&) = delete;
+
+private:
+    IsrProfile* profile_;
+    uint32_t    start_;
+};
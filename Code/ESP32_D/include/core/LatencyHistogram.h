@@ -0,0 +1,192 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+
+/**
+ * @brief Гистограмма длительностей с логарифмическими корзинами (как HDR)
+ *
+ * Значения до 8 - точные корзины, дальше на каждую степень двойки по 8
+ * корзин: относительная ошибка перцентиля не больше 12.5% на всем
+ * диапазоне (0..kMaxValue, больше - в последнюю корзину). Единица - любая
+ * (мкс для циклов задач, такты для ISR), отчет в той же единице.
+ *
+ * record() - O(1): номер корзины через clz, инкремент без блокировок.
+ * Строка счетчиков своя у каждого ядра, и писатель на ядре один (задача
+ * или ISR) - RMW не пересекаются. Читатель (другое ядро) счетчики не
+ * пишет: reset() запоминает их текущие значения как базу, snapshot()
+ * считает разность, так что сброс не теряет и не портит записи писателя.
+ * Максимум окна писатель обнуляет сам, увидев новую эпоху reset().
+ */
+class LatencyHistogram {
+public:
+    static constexpr uint8_t  kCores = portNUM_PROCESSORS;
+    static constexpr uint8_t  kSubBucketBits = 3;
+    static constexpr uint8_t  kSubBuckets = 1 << kSubBucketBits;
+    static constexpr uint8_t  kMaxBits = 22;                 // до ~4.2e6 единиц
+    static constexpr uint32_t kMaxValue = (1UL << kMaxBits) - 1;
+    static constexpr uint16_t kBuckets = (kMaxBits - kSubBucketBits + 1) * kSubBuckets;
+
+    struct Snapshot {
+        uint32_t count;
+        uint32_t mean;
+        uint32_t p50;       // верхние границы корзин перцентилей (не больше max)
+        uint32_t p90;
+        uint32_t p99;
+        uint32_t p999;
+        uint32_t max;
+    };
+
+    LatencyHistogram() {
+        for (uint8_t c = 0; c < kCores; ++c) {
+            Row& row = rows_[c];
+            row.sum = 0;
+            row.max = 0;
+            row.epoch = 0;
+            base_[c].sum = 0;
+            for (uint16_t b = 0; b < kBuckets; ++b) {
+                row.counts[b] = 0;
+                base_[c].counts[b] = 0;
+            }
+        }
+    }
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    static inline uint16_t IRAM_ATTR bucketOf(uint32_t value) {
+        if (value > kMaxValue) {
+            value = kMaxValue;
+        }
+        if (value < kSubBuckets) {
+            return (uint16_t)value;
+        }
+        const uint8_t exponent = (uint8_t)(31 - __builtin_clz(value));    // >= kSubBucketBits
+        const uint8_t shift = exponent - kSubBucketBits;
+        return (uint16_t)(((shift + 1) << kSubBucketBits) + ((value >> shift) & (kSubBuckets - 1)));
+    }
+
+    // Наибольшее значение, попадающее в корзину
+    static uint32_t bucketUpper(uint16_t bucket) {
+        if (bucket < kSubBuckets) {
+            return bucket;
+        }
+        const uint8_t shift = (uint8_t)((bucket >> kSubBucketBits) - 1);
+        const uint32_t mantissa = (uint32_t)(kSubBuckets + (bucket & (kSubBuckets - 1)));
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+    // === Писатель (один на ядро) ===
+
+    inline void IRAM_ATTR record(uint32_t value) {
+        Row& row = rows_[xPortGetCoreID() & (kCores - 1)];
+        const uint32_t epoch = epoch_.load(std::memory_order_acquire);
+        if (row.epoch != epoch) {
+            row.max = 0;
+            row.epoch = epoch;
+        }
+        if (value > row.max) {
+            row.max = value;
+        }
+        row.sum = row.sum + value;
+        const uint16_t b = bucketOf(value);
+        row.counts[b] = row.counts[b] + 1;
+    }
+
+    // === Читатель (одна задача) ===
+
+    // Отсчеты с прошлого reset()
+    Snapshot snapshot() const {
+        Snapshot s = {0, 0, 0, 0, 0, 0, 0};
+        uint32_t counts[kBuckets];
+        uint32_t sum = 0;
+        uint16_t top = 0;
+
+        for (uint16_t b = 0; b < kBuckets; ++b) {
+            counts[b] = 0;
+        }
+        const uint32_t epoch = epoch_.load(std::memory_order_relaxed);
+        for (uint8_t c = 0; c < kCores; ++c) {
+            const Row& row = rows_[c];
+            for (uint16_t b = 0; b < kBuckets; ++b) {
+                const uint32_t n = row.counts[b] - base_[c].counts[b];
+                counts[b] += n;
+                s.count += n;
+                if (n > 0 && b > top) {
+                    top = b;
+                }
+            }
+            sum += row.sum - base_[c].sum;
+            if (row.epoch == epoch && row.max > s.max) {
+                s.max = row.max;
+            }
+        }
+        if (s.count == 0) {
+            return s;
+        }
+
+        // Писатель еще не видел новую эпоху - максимум по верхней корзине
+        if (s.max == 0 || bucketOf(s.max) < top) {
+            s.max = bucketUpper(top);
+        }
+        s.mean = sum / s.count;
+        s.p50 = percentile(counts, s.count, 500, s.max);
+        s.p90 = percentile(counts, s.count, 900, s.max);
+        s.p99 = percentile(counts, s.count, 990, s.max);
+        s.p999 = percentile(counts, s.count, 999, s.max);
+        return s;
+    }
+
+    // Начать новое окно (писатели не останавливаются)
+    void reset() {
+        for (uint8_t c = 0; c < kCores; ++c) {
+            for (uint16_t b = 0; b < kBuckets; ++b) {
+                base_[c].counts[b] = rows_[c].counts[b];
+            }
+            base_[c].sum = rows_[c].sum;
+        }
+        epoch_.fetch_add(1, std::memory_order_release);
+    }
+
+    // snapshot() и reset() одним вызовом
+    Snapshot take() {
+        const Snapshot s = snapshot();
+        reset();
+        return s;
+    }
+
+private:
+    struct Row {
+        volatile uint32_t counts[kBuckets];
+        volatile uint32_t sum;      // по модулю 2^32: окно должно быть короче переполнения
+        volatile uint32_t max;
+        volatile uint32_t epoch;
+    };
+
+    struct Base {
+        uint32_t counts[kBuckets];
+        uint32_t sum;
+    };
+
+    // Перцентиль в десятых процента: первая корзина, где накопилось >= доли
+    static uint32_t percentile(const uint32_t* counts, uint32_t total, uint16_t permille, uint32_t max) {
+        const uint64_t rank64 = ((uint64_t)total * permille + 999) / 1000;
+        const uint32_t rank = (rank64 > 0) ? (uint32_t)rank64 : 1;
+        uint32_t seen = 0;
+        for (uint16_t b = 0; b < kBuckets; ++b) {
+            seen += counts[b];
+            if (seen >= rank) {
+                const uint32_t upper = bucketUpper(b);
+                return (upper < max) ? upper : max;
+            }
+        }
+        return max;
+    }
+
+    static_assert((kCores & (kCores - 1)) == 0, "kCores must be a power of two");
+
+    Row  rows_[kCores];
+    Base base_[kCores];
+    std::atomic<uint32_t> epoch_{0};
+};
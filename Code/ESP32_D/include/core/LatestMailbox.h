@@ -0,0 +1,67 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * @brief Почтовый ящик "последнее значение" (тройной буфер)
+ *
+ * Писатель кладет значение в свой слот и обменивает его со "средним";
+ * читатель забирает средний слот, только если там есть новое значение.
+ * Промежуточные значения, которые читатель не успел забрать, просто
+ * перезаписываются - до него доходит самое свежее. Обе стороны wait-free:
+ * одна атомарная exchange на операцию, без блокировок и без переполнения.
+ *
+ * Один писатель и один читатель (как у SpscRing); T - копируемая POD-структура.
+ */
+template <typename T>
+class LatestMailbox {
+public:
+    LatestMailbox() : writeSlot_(0), readSlot_(1) {
+        middle_.store(2, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Опубликовать новое значение (только писатель)
+     */
+    void post(const T& value) {
+        slots_[writeSlot_] = value;
+        const uint32_t prev = middle_.exchange(writeSlot_ | kFresh, std::memory_order_acq_rel);
+        writeSlot_ = prev & kSlotMask;
+    }
+
+    /**
+     * @brief Забрать самое свежее значение (только читатель)
+     * @return false если с прошлого take() ничего нового не публиковалось
+     */
+    bool take(T& value) {
+        if ((middle_.load(std::memory_order_relaxed) & kFresh) == 0) {
+            return false;
+        }
+        const uint32_t prev = middle_.exchange(readSlot_, std::memory_order_acq_rel);
+        readSlot_ = prev & kSlotMask;
+        value = slots_[readSlot_];
+        return true;
+    }
+
+    // Есть ли непрочитанное значение (снимок, с любой стороны)
+    bool hasFresh() const {
+        return (middle_.load(std::memory_order_acquire) & kFresh) != 0;
+    }
+
+    /**
+     * @brief Сбросить непрочитанное значение (только читатель)
+     */
+    void discard() {
+        T dropped;
+        take(dropped);
+    }
+
+private:
+    static constexpr uint32_t kSlotMask = 0x3;
+    static constexpr uint32_t kFresh = 0x4;
+
+    T slots_[3];
+    uint32_t writeSlot_;                 // принадлежит писателю
+    uint32_t readSlot_;                  // принадлежит читателю
+    std::atomic<uint32_t> middle_;       // индекс среднего слота | kFresh
+};
@@ -0,0 +1,137 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * @brief Lock-free кольцо "много писателей - один читатель" (ячейки с номером)
+ *
+ * Писатель резервирует ячейку CAS по tail_, копирует элемент и публикует
+ * его номером ячейки (release). Ни критических секций, ни запрета
+ * прерываний: задача, вытесненная посреди записи, не мешает ни ISR своего
+ * ядра, ни другим задачам - они берут следующие ячейки. Читатель видит
+ * ячейку только после публикации и на недописанной останавливается (кольцо
+ * для него "пусто" до конца записи), не крутясь.
+ *
+ * Индексы растут монотонно (переполнение uint32_t безопасно), емкость -
+ * степень двойки. Хранилище выделяется один раз в конструкторе.
+ *
+ * push() - любой контекст; pop()/popBatch() - только читатель;
+ * все - только при isValid().
+ */
+template <typename T>
+class MpscRing {
+public:
+    static constexpr size_t kCacheLine = 64;
+
+    /**
+     * @param capacity Минимальная емкость (округляется вверх до степени двойки);
+     *                 0 - кольцо без хранилища (isValid() == false)
+     */
+    explicit MpscRing(size_t capacity) : cells_(nullptr), mask_(0) {
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+        if (capacity == 0) {
+            return;
+        }
+        size_t cap = 1;
+        while (cap < capacity) {
+            cap <<= 1;
+        }
+        cells_ = new Cell[cap];
+        mask_ = (uint32_t)(cap - 1);
+        // Ячейка i свободна для записи номер i
+        for (uint32_t i = 0; i <= mask_; ++i) {
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~MpscRing() { delete[] cells_; }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    bool   isValid() const { return cells_ != nullptr; }
+    size_t capacity() const { return cells_ ? (size_t)mask_ + 1 : 0; }
+
+    /**
+     * @brief Положить элемент (любая задача или ISR)
+     * @return false если кольцо заполнено
+     */
+    bool push(const T& item) {
+        uint32_t pos = tail_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells_[pos & mask_];
+            const int32_t diff = (int32_t)(cell->seq.load(std::memory_order_acquire) - pos);
+            if (diff == 0) {
+                // Ячейка свободна: занять ее, если хвост никто не сдвинул
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;   // круг назад ячейку еще не забрал читатель
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = item;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Забрать элемент (только читатель)
+     * @return false если кольцо пусто или ближайшая ячейка еще пишется
+     */
+    bool pop(T& item) {
+        return popBatch(&item, 1) == 1;
+    }
+
+    /**
+     * @brief Забрать до maxCount опубликованных элементов подряд (только читатель)
+     * @return Сколько элементов скопировано в out
+     */
+    size_t popBatch(T* out, size_t maxCount) {
+        const uint32_t head = head_.load(std::memory_order_relaxed);
+        size_t count = 0;
+        while (count < maxCount) {
+            const uint32_t pos = head + (uint32_t)count;
+            Cell& cell = cells_[pos & mask_];
+            if (cell.seq.load(std::memory_order_acquire) != pos + 1) {
+                break;
+            }
+            out[count++] = cell.value;
+            // Ячейка свободна для записи через круг
+            cell.seq.store(pos + mask_ + 1, std::memory_order_release);
+        }
+        if (count > 0) {
+            head_.store(head + (uint32_t)count, std::memory_order_relaxed);
+        }
+        return count;
+    }
+
+    // Снимок заполнения (с резервированными, но недописанными): может устареть сразу
+    size_t size() const {
+        const uint32_t head = head_.load(std::memory_order_relaxed);
+        const uint32_t tail = tail_.load(std::memory_order_relaxed);
+        return (size_t)(tail - head);
+    }
+
+    bool empty() const { return size() == 0; }
+
+private:
+    struct Cell {
+        std::atomic<uint32_t> seq;
+        T value;
+    };
+
+    Cell*    cells_;
+    uint32_t mask_;
+
+    // Сторона читателя
+    alignas(kCacheLine) std::atomic<uint32_t> head_;
+
+    // Сторона писателей
+    alignas(kCacheLine) std::atomic<uint32_t> tail_;
+};
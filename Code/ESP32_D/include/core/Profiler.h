@@ -0,0 +1,145 @@
+#pragma once
+#include <stdint.h>
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "core/IsrProfile.h"
+
+/**
+ * @brief Загрузка ядер, задач и обработчиков прерываний за окно
+ *
+ * Источник времени задач выбирается при сборке:
+ *  - RunTimeStats - счетчики времени выполнения FreeRTOS
+ *    (configGENERATE_RUN_TIME_STATS + configUSE_TRACE_FACILITY): точное
+ *    время каждой задачи, простой ядра - время его задачи IDLE;
+ *  - TickSampling - без них: хук тика каждого ядра (esp_register_freertos_
+ *    tick_hook_for_cpu) отмечает, кто был на ядре в момент тика. Это
+ *    выборка с шагом в тик (1 мс при 1000 Гц): доли точны в среднем за
+ *    окно в секунды, короткие всплески не видны.
+ *
+ * Хук простоя (idle hook) для этого не годится: после него ядро уходит в
+ * waiti, и время сна не отличить от времени вытеснившей IDLE задачи.
+ *
+ * Время обработчиков прерываний - точное в обоих режимах: IsrProfile
+ * считает такты CCOUNT от входа до выхода (см. IsrScope). Оно входит и в
+ * долю задачи, которую обработчик прервал.
+ *
+ * Счетчики в ISR - 32-битные, каждый пишет одно ядро; takeSnapshot()
+ * считает разности с прошлого вызова. Вызывать из одной задачи.
+ */
+class Profiler {
+public:
+    static constexpr uint8_t kCores = portNUM_PROCESSORS;
+    static constexpr uint8_t kMaxTasks = 8;
+    static constexpr uint8_t kMaxIsrs = 8;
+    // Размер снимка uxTaskGetSystemState() (все задачи системы)
+    static constexpr UBaseType_t kMaxSystemTasks = 32;
+
+    enum class Source : uint8_t {
+        RunTimeStats,
+        TickSampling
+    };
+
+    struct TaskLoad {
+        TaskHandle_t handle;
+        char     name[configMAX_TASK_NAME_LEN];
+        int8_t   core;              // -1 - без привязки
+        float    percent;           // от одного ядра
+        uint32_t stackFreeBytes;    // минимум свободного стека за все время
+    };
+
+    struct IsrLoad {
+        const char* name;
+        uint32_t count;             // входов за окно
+        float    avgUs;
+        float    p50Us;             // перцентили - с точностью корзины гистограммы
+        float    p90Us;
+        float    p99Us;
+        float    p999Us;
+        float    maxUs;
+        float    percent;           // от одного ядра
+    };
+
+    struct Snapshot {
+        Source   source;
+        uint32_t windowUs;
+        float    coreIdle[kCores];  // %
+        float    coreLoad[kCores];  // 100 - простой
+        uint8_t  taskCount;
+        TaskLoad tasks[kMaxTasks];
+        uint8_t  isrCount;
+        IsrLoad  isrs[kMaxIsrs];
+    };
+
+    Profiler() = default;
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    // Источник, выбранный при сборке
+    static Source getSource();
+    static const char* sourceName(Source source);
+
+    // Найти задачи IDLE, поставить хуки тика (без run-time stats); начало первого окна
+    bool begin();
+
+    /**
+     * @brief Следить за задачей / обработчиком (можно и после begin())
+     * @return false если мест нет
+     */
+    bool addTask(TaskHandle_t task);
+    bool addIsr(IsrProfile& profile);
+
+    // Загрузка с прошлого вызова (с begin() - для первого)
+    bool takeSnapshot(Snapshot& out);
+
+    // Снимок в Serial
+    static void print(const Snapshot& snapshot);
+
+private:
+    struct TaskSlot {
+        TaskHandle_t handle;
+        uint32_t     lastRunTime;           // RunTimeStats
+        bool         primed;                // lastRunTime уже снят
+        uint32_t     lastTicks[kCores];     // TickSampling
+    };
+
+    struct IsrSlot {
+        IsrProfile* profile;
+        uint32_t    lastCount;
+        uint64_t    lastCycles;
+    };
+
+    static void IRAM_ATTR tickHook0();
+    static void IRAM_ATTR tickHook1();
+    void IRAM_ATTR onTick(uint8_t core);
+
+    void resetWindow();
+    bool readRunTimeStats(Snapshot& out);
+    void readTickSamples(Snapshot& out);
+    void readIsrs(Snapshot& out, uint32_t windowUs);
+
+    static Profiler* instance_;
+
+    TaskHandle_t idleTask_[kCores] = {};
+    TaskSlot     tasks_[kMaxTasks] = {};
+    volatile uint8_t taskCount_ = 0;
+    IsrSlot      isrs_[kMaxIsrs] = {};
+    uint8_t      isrCount_ = 0;
+
+    bool     started_ = false;
+    uint64_t windowStartUs_ = 0;
+    uint32_t cpuMHz_ = 240;
+
+    // RunTimeStats: прошлые значения счетчиков
+    uint32_t lastTotalRunTime_ = 0;
+    uint32_t lastIdleRunTime_[kCores] = {};
+
+    // TickSampling: пишет только хук тика своего ядра
+    volatile uint32_t ticks_[kCores] = {};
+    volatile uint32_t idleTicks_[kCores] = {};
+    volatile uint32_t taskTicks_[kCores][kMaxTasks] = {};
+    uint32_t lastTicks_[kCores] = {};
+    uint32_t lastIdleTicks_[kCores] = {};
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include <stdint.h>
+#include <Arduino.h>
+
+/**
+ * @brief Логика декодирования энкодеров без привязки к ISR
+ *
+ * Одни и те же правила используют EncoderEC12/EncoderC14 (виртуальный путь)
+ * и StaticEncoder (шаблонный путь). Все методы - inline: в статическом
+ * энкодере декодер встраивается прямо в обработчик прерывания.
+ *
+ * step(clk, dt) получает текущие уровни и возвращает -1 / 0 / +1.
+ * kBothPins - нужны ли прерывания на DT.
+ */
+
+// EC12: шаг на спаде CLK, направление - по уровню DT
+struct EC12Decoder {
+    static constexpr bool kBothPins = false;
+
+    int lastClk = HIGH;
+
+    void reset(int clk, int /*dt*/) { lastClk = clk; }
+
+    inline int8_t IRAM_ATTR step(int clk, int dt) {
+        if (clk == lastClk) {
+            return 0;
+        }
+        lastClk = clk;
+        if (clk != LOW) {
+            return 0;
+        }
+        return (dt == HIGH) ? -1 : 1;
+    }
+};
+
+// C14: таблица переходов по обоим каналам
+struct C14Decoder {
+    static constexpr bool kBothPins = true;
+
+    uint8_t lastState = 0x03;   // биты [CLK, DT]
+
+    void reset(int clk, int dt) { lastState = (uint8_t)(((clk ? 1 : 0) << 1) | (dt ? 1 : 0)); }
+
+    inline int8_t IRAM_ATTR step(int clk, int dt) {
+        // Индекс: (prevState << 2) | currState
+        static const int8_t kTransitions[16] = {
+            0,  -1,  1,  0,   // 00 -> 00, 01, 10, 11
+            1,   0,  0, -1,   // 01 -> 00, 01, 10, 11
+           -1,   0,  0,  1,   // 10 -> 00, 01, 10, 11
+            0,   1, -1,  0    // 11 -> 00, 01, 10, 11
+        };
+        const uint8_t state = (uint8_t)(((clk ? 1 : 0) << 1) | (dt ? 1 : 0));
+        const int8_t result = kTransitions[(lastState << 2) | state];
+        lastState = state;
+        return result;
+    }
+};
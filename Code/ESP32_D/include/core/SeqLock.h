@@ -0,0 +1,88 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+
+/**
+ * @brief Seqlock: снимок небольшой POD-структуры без блокировки читателя
+ *
+ * Писатель делает счетчик нечетным, пишет данные и снова делает его четным.
+ * Читатель копирует данные между двумя чтениями счетчика и повторяет
+ * попытку, если счетчик был нечетным или изменился. Писатель никогда не
+ * ждет читателей; читатель не спит, а лишь повторяет копию (на ESP32 -
+ * несколько десятков тактов).
+ *
+ * Данные хранятся словами std::atomic<uint32_t> (relaxed), поэтому
+ * одновременное чтение и запись - не гонка данных в смысле C++.
+ *
+ * Писатели должны быть сериализованы снаружи (одна задача или критическая
+ * секция); иначе два store() перемешают слова.
+ */
+template <typename T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock<T> needs a trivially copyable T");
+
+public:
+    explicit SeqLock(const T& initial = T()) : seq_(0) {
+        storeWords(initial);
+    }
+
+    /**
+     * @brief Согласованный снимок (любой поток/ядро)
+     * @param retries Если не nullptr - сюда прибавляется число повторов
+     */
+    T load(uint32_t* retries = nullptr) const {
+        uint32_t words[kWords];
+        uint32_t attempts = 0;
+        while (true) {
+            const uint32_t s0 = seq_.load(std::memory_order_acquire);
+            if ((s0 & 1U) == 0) {
+                for (size_t i = 0; i < kWords; ++i) {
+                    words[i] = words_[i].load(std::memory_order_relaxed);
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (seq_.load(std::memory_order_relaxed) == s0) {
+                    break;
+                }
+            }
+            attempts++;
+        }
+        if (retries != nullptr) {
+            *retries += attempts;
+        }
+
+        T value;
+        memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+    /**
+     * @brief Опубликовать новое значение (только сериализованный писатель)
+     */
+    void store(const T& value) {
+        const uint32_t s = seq_.load(std::memory_order_relaxed);
+        seq_.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        storeWords(value);
+        seq_.store(s + 2, std::memory_order_release);
+    }
+
+    // Число опубликованных версий
+    uint32_t version() const { return seq_.load(std::memory_order_acquire) >> 1; }
+
+private:
+    static constexpr size_t kWords = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    void storeWords(const T& value) {
+        uint32_t words[kWords] = {};
+        memcpy(words, &value, sizeof(T));
+        for (size_t i = 0; i < kWords; ++i) {
+            words_[i].store(words[i], std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<uint32_t> seq_;
+    std::atomic<uint32_t> words_[kWords];
+};
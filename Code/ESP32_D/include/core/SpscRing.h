@@ -0,0 +1,137 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * @brief Lock-free кольцо "один писатель - один читатель"
+ *
+ * Писатель (UI_Task, Core 0) двигает только tail_, читатель (Stim_Task,
+ * Core 1) - только head_; индексы лежат в разных строках кэша и не
+ * "переезжают" между ядрами при каждой операции. Ни критических секций,
+ * ни вызовов ядра FreeRTOS: push/pop - копия элемента и один release-store.
+ *
+ * Индексы растут монотонно (переполнение uint32_t безопасно), емкость -
+ * степень двойки, позиция в буфере - (index & mask_). Хранилище выделяется
+ * один раз в конструкторе.
+ *
+ * Все методы, кроме size()/empty(), вызываются строго со "своей" стороны:
+ * push() - только писатель, pop()/popBatch()/clear() - только читатель;
+ * push/pop/clear - только при isValid().
+ */
+template <typename T>
+class SpscRing {
+public:
+    static constexpr size_t kCacheLine = 64;
+
+    /**
+     * @param capacity Минимальная емкость (округляется вверх до степени двойки);
+     *                 0 - кольцо без хранилища (isValid() == false)
+     */
+    explicit SpscRing(size_t capacity) : buffer_(nullptr), mask_(0) {
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+        if (capacity == 0) {
+            return;
+        }
+        size_t cap = 1;
+        while (cap < capacity) {
+            cap <<= 1;
+        }
+        buffer_ = new T[cap];
+        mask_ = (uint32_t)(cap - 1);
+    }
+
+    ~SpscRing() { delete[] buffer_; }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    bool   isValid() const { return buffer_ != nullptr; }
+    size_t capacity() const { return buffer_ ? (size_t)mask_ + 1 : 0; }
+
+    /**
+     * @brief Положить элемент (только писатель)
+     * @return false если кольцо заполнено
+     */
+    bool push(const T& item) {
+        const uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - headCache_ > mask_) {
+            headCache_ = head_.load(std::memory_order_acquire);
+            if (tail - headCache_ > mask_) {
+                return false;
+            }
+        }
+        buffer_[tail & mask_] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Забрать элемент (только читатель)
+     * @return false если кольцо пусто
+     */
+    bool pop(T& item) {
+        const uint32_t head = head_.load(std::memory_order_relaxed);
+        if (head == tailCache_) {
+            tailCache_ = tail_.load(std::memory_order_acquire);
+            if (head == tailCache_) {
+                return false;
+            }
+        }
+        item = buffer_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Забрать до maxCount элементов за раз (только читатель)
+     *
+     * Одно acquire-чтение tail_ и один release-store head_ на всю пачку.
+     * @return Сколько элементов скопировано в out
+     */
+    size_t popBatch(T* out, size_t maxCount) {
+        const uint32_t head = head_.load(std::memory_order_relaxed);
+        tailCache_ = tail_.load(std::memory_order_acquire);
+        size_t count = (size_t)(tailCache_ - head);
+        if (count > maxCount) {
+            count = maxCount;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = buffer_[(head + (uint32_t)i) & mask_];
+        }
+        if (count > 0) {
+            head_.store(head + (uint32_t)count, std::memory_order_release);
+        }
+        return count;
+    }
+
+    /**
+     * @brief Отбросить все элементы (только читатель)
+     */
+    void clear() {
+        tailCache_ = tail_.load(std::memory_order_acquire);
+        head_.store(tailCache_, std::memory_order_release);
+    }
+
+    // Снимок заполнения: с любой стороны, может устареть сразу после чтения
+    size_t size() const {
+        const uint32_t head = head_.load(std::memory_order_acquire);
+        const uint32_t tail = tail_.load(std::memory_order_acquire);
+        return (size_t)(tail - head);
+    }
+
+    bool empty() const { return size() == 0; }
+
+private:
+    T*       buffer_;
+    uint32_t mask_;
+
+    // Сторона читателя: свой индекс + кэш чужого (чтобы не читать tail_ на каждом pop)
+    alignas(kCacheLine) std::atomic<uint32_t> head_;
+    uint32_t tailCache_ = 0;
+
+    // Сторона писателя
+    alignas(kCacheLine) std::atomic<uint32_t> tail_;
+    uint32_t headCache_ = 0;
+};
@@ -0,0 +1,103 @@
+#pragma once
+#include <stdint.h>
+#include <Arduino.h>
+
+#include "core/EncoderEvents.h"
+#include "core/QuadratureDecoders.h"
+
+/**
+ * @brief Энкодер на прерываниях без косвенных вызовов на пути ISR
+ *
+ * Тот же конвейер, что у IEncoder (EncoderEvents, метрики, порции по ±127),
+ * но тип энкодера и обработчика известен при компиляции:
+ *  - Decoder (EC12Decoder / C14Decoder) встраивается в isrEntry() -
+ *    ни виртуального handleIsr(), ни вызова через vtable;
+ *  - Handler - любой вызываемый тип void(int8_t), хранится по значению:
+ *    функтор/лямбда встраиваются в update(), std::function и куча не нужны.
+ *
+ *   struct OnStepA { void operator()(int8_t d) { appState.adjustEncoderA(d); } };
+ *   static StaticEncoder<EC12Decoder, OnStepA> encA(ENC_A_CLK_PIN, ENC_A_DT_PIN);
+ *
+ * Полиморфизм остается только там, где выбирается, какой энкодер собрать.
+ * Единственный косвенный вызов - сам вектор прерывания -> isrEntry().
+ *
+ * Статус: не завершено до замера на железе. В прошивке не подключен -
+ * main.cpp собирает энкодеры IEncoder (PCNT / опрос по таймеру / диспетчер
+ * GPIO). Выигрыш измерен только на хосте (host/bench/encoder_isr_bench:
+ * шумно, от нуля до ~25%); такты CCOUNT до/после на устройстве
+ * (src/main_encoder_isr_bench.cpp_) не сняты, и подключать его в прошивку
+ * без них не стоит.
+ */
+template <class Decoder, class Handler = void (*)(int8_t)>
+class StaticEncoder {
+public:
+    StaticEncoder(uint8_t clkPin, uint8_t dtPin, Handler handler = Handler())
+        : clkPin_(clkPin)
+        , dtPin_(dtPin)
+        , handler_(handler)
+    {}
+
+    StaticEncoder(const StaticEncoder&) = delete;
+    StaticEncoder& operator=(const StaticEncoder&) = delete;
+
+    // Будить задачу с update() уведомлением на каждый щелчок (до begin())
+    void setWakeTask(TaskHandle_t task) { events_.setWakeTask(task); }
+
+    // Настройка пинов и прерываний
+    bool begin() {
+        if (!events_.isValid()) {
+            Serial.println("[Encoder] ERROR: Event ring allocation failed!");
+            return false;
+        }
+
+        pinMode(clkPin_, INPUT_PULLUP);
+        pinMode(dtPin_,  INPUT_PULLUP);
+        decoder_.reset(digitalRead(clkPin_), digitalRead(dtPin_));
+
+        attachInterruptArg(digitalPinToInterrupt(clkPin_), &StaticEncoder::isrEntry, this, CHANGE);
+        if (Decoder::kBothPins) {
+            attachInterruptArg(digitalPinToInterrupt(dtPin_), &StaticEncoder::isrEntry, this, CHANGE);
+        }
+        return true;
+    }
+
+    // Из задачи: выбрать щелчки и отдать обработчику
+    void update() {
+        const int32_t steps = events_.drain();
+        if (hasHandler(handler_)) {
+            EncoderEvents::dispatch(steps, handler_);
+        }
+    }
+
+    // Обработчик прерывания (arg - this); открыт для замеров
+    static void IRAM_ATTR isrEntry(void* arg) {
+        StaticEncoder* self = static_cast<StaticEncoder*>(arg);
+        const int8_t step = self->decoder_.step(digitalRead(self->clkPin_), digitalRead(self->dtPin_));
+        if (step != 0) {
+            self->events_.push(step);
+        }
+    }
+
+    Handler& handler() { return handler_; }
+
+    uint8_t getClkPin() const { return clkPin_; }
+    uint8_t getDtPin() const { return dtPin_; }
+
+    // === Метрики (поток update()) ===
+    int32_t getVelocity() const { return events_.getVelocity(); }
+    EncoderEvents::LatencyStats::Snapshot getLatencyStats() const { return events_.getLatencyStats(); }
+    void resetLatencyStats() { events_.resetLatencyStats(); }
+    uint32_t getDroppedEvents() const { return events_.getDroppedEvents(); }
+
+private:
+    // Пустым бывает только указатель на функцию
+    static bool hasHandler(void (*handler)(int8_t)) { return handler != nullptr; }
+    template <class H>
+    static bool hasHandler(const H&) { return true; }
+
+    uint8_t clkPin_;
+    uint8_t dtPin_;
+    Decoder decoder_;
+    EncoderEvents events_;
+    Handler handler_;
+};
@@ -0,0 +1,123 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Программа стимуляции: компактный байткод пачек/пауз/рамп
+ *
+ * Формат (little-endian):
+ *   заголовок: 'S' 'P' <версия=1> <число команд>
+ *   команды:
+ *     END                               0x00
+ *     BURST  u16 pulses, u16 rateHz, u16 widthUs   0x01
+ *     PAUSE  u32 ms                      0x02
+ *     RAMP   u8 amplitude%, u32 ms       0x03
+ *     LOOP   u16 count, u8 target        0x04  (вернуться на target еще count раз)
+ *     JUMP   u8 target                   0x05
+ *
+ * target - индекс команды, а не смещение в байтах. load() один раз
+ * декодирует байткод в плоский массив StimInstr с уже посчитанными
+ * длительностями, поэтому шаг интерпретатора - O(1) без деления.
+ *
+ * Без Arduino: тот же код собирается хостовым компилятором (host/tools/stimc).
+ */
+
+enum class StimOp : uint8_t {
+    End   = 0x00,
+    Burst = 0x01,
+    Pause = 0x02,
+    Ramp  = 0x03,
+    Loop  = 0x04,
+    Jump  = 0x05
+};
+
+/**
+ * @brief Декодированная команда
+ */
+struct StimInstr {
+    StimOp   op;
+    uint8_t  amplitude;    // RAMP: цель 0..100%
+    uint8_t  target;       // LOOP/JUMP: индекс команды
+    uint16_t count;        // BURST: импульсов; LOOP: повторов
+    uint16_t rateHz;       // BURST
+    uint16_t widthUs;      // BURST
+    uint32_t periodUs;     // BURST: период импульсов
+    uint32_t durationUs;   // BURST/PAUSE: длительность сегмента; RAMP: время выхода
+};
+
+enum class StimProgramError : uint8_t {
+    None,
+    BadHeader,
+    Truncated,
+    TooLong,
+    BadOpcode,
+    BadTarget,
+    BadBurst,           // ноль импульсов/частоты или ширина >= периода
+    BadAmplitude,
+    EmptyLoop,          // достижимый цикл без BURST/PAUSE на пути - интерпретатор зависнет
+    TrailingBytes
+};
+
+class StimProgram {
+public:
+    static constexpr uint8_t kMagic0 = 'S';
+    static constexpr uint8_t kMagic1 = 'P';
+    static constexpr uint8_t kVersion = 1;
+    static constexpr uint8_t kHeaderSize = 4;
+    static constexpr uint8_t kMaxInstrs = 64;
+
+    StimProgram() = default;
+
+    /**
+     * @brief Декодировать и проверить байткод
+     * @param errorIndex Индекс команды с ошибкой (может быть nullptr)
+     * @return None при успехе; иначе программа остается пустой
+     */
+    StimProgramError load(const uint8_t* data, size_t size, uint8_t* errorIndex = nullptr);
+
+    bool    isValid() const { return count_ > 0; }
+    uint8_t size() const { return count_; }
+    const StimInstr& at(uint8_t index) const { return instrs_[index]; }
+
+    static const char* errorName(StimProgramError error);
+
+private:
+    StimProgramError decode(const uint8_t* data, size_t size, uint8_t& index);
+    StimProgramError validate(uint8_t& index) const;
+
+    // Граф переходов для validate(): BURST и PAUSE > 0 - сегменты со временем
+    bool    isTimed(uint8_t i) const;
+    uint8_t successors(uint8_t i, uint8_t* out) const;
+    bool    untimedCycleFrom(uint8_t i, uint8_t* color, uint8_t& at) const;
+
+    StimInstr instrs_[kMaxInstrs];
+    uint8_t   count_ = 0;
+};
+
+/**
+ * @brief Интерпретатор программы
+ *
+ * next() выполняет управляющие команды (LOOP/JUMP) и возвращает ближайшую
+ * команду для генератора: BURST, PAUSE, RAMP или END. Счетчики циклов хранятся
+ * по индексу команды LOOP, поэтому вложенные циклы не требуют стека.
+ */
+class StimSequencer {
+public:
+    // Сколько управляющих команд подряд допускается за один next()
+    static constexpr uint8_t kMaxControlSteps = StimProgram::kMaxInstrs;
+
+    void reset(const StimProgram* program);
+
+    // nullptr - программа не задана
+    const StimInstr* next();
+
+    const StimProgram* program() const { return program_; }
+    uint8_t pc() const { return pc_; }
+
+private:
+    static const StimInstr kEnd;
+
+    const StimProgram* program_ = nullptr;
+    uint8_t  pc_ = 0;
+    uint32_t loopLeft_[StimProgram::kMaxInstrs] = {};   // по индексу команды LOOP
+};
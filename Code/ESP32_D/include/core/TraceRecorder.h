@@ -0,0 +1,152 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+
+// Запись трассы включается сборкой с -DTRACE_ENABLED=1 (build_flags);
+// без него макросы TRACE_* пустые и аргументы не вычисляются
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 0
+#endif
+
+#if TRACE_ENABLED
+#include <esp_timer.h>
+#include <esp_spi_flash.h>
+#endif
+
+// Событие трассы: 16 байт в кольце
+struct TraceEvent {
+    enum Type : uint8_t {
+        kBegin   = 'B',     // начало отрезка (ISR, проход задачи)
+        kEnd     = 'E',
+        kInstant = 'i',     // точка с аргументом (команда, начало пачки)
+        kCounter = 'C',     // значение во времени (duty LEDC)
+        kSync    = 'S'      // пара CCOUNT - esp_timer (мкс, младшие 32 бита) для ядра
+    };
+
+    uint32_t    cycles;     // CCOUNT ядра, записавшего событие
+    const char* name;       // литерал: его адрес - идентификатор события
+    uint32_t    arg;
+    uint8_t     type;
+    uint8_t     core;
+};
+
+/**
+ * @brief Трасса событий с точностью до такта (flight recorder)
+ *
+ * TRACE_BEGIN/END/INSTANT/COUNTER кладут в кольцо CCOUNT своего ядра,
+ * имя (адрес литерала) и слово аргумента - десятки тактов, без блокировок:
+ * слот выдает atomic fetch_add, писателей сколько угодно на обоих ядрах.
+ * Кольцо перезаписывается по кругу - в нем всегда последние события.
+ *
+ * Счетчики тактов ядер не синхронизированы и переполняются за ~18 с,
+ * поэтому ядро время от времени (хук тика, kSyncPeriodMs) пишет перед
+ * очередным событием пару CCOUNT - esp_timer; по ней host/tools/tracedump
+ * переводит такты каждого ядра в общую шкалу мкс.
+ *
+ * Хук тика каждого ядра пишет точку kTickName с ручкой прерванной задачи:
+ * видно, чья задача держала ядро. Это configTICK_RATE_HZ событий в секунду
+ * на ядро (1000 Гц: кольцо по умолчанию - ~30 с без других событий);
+ * dump() печатает таблицу ручка - имя задачи ("@task").
+ *
+ * Кольцо - в PSRAM (нет PSRAM - меньшее во внутренней RAM). Пока кэш
+ * выключен (запись во flash), IRAM-обработчики в PSRAM не пишут: событие
+ * пропускается и считается (getSkipped).
+ *
+ * dump() печатает кольцо в Serial текстом (строки "@..."), запись на это
+ * время останавливается. Имена - только строки со статическим временем жизни.
+ */
+class TraceRecorder {
+public:
+    static constexpr bool     kEnabled = TRACE_ENABLED;
+    static constexpr uint8_t  kCores = portNUM_PROCESSORS;
+    static constexpr size_t   kDefaultCapacity = 65536;     // событий, 1 МБ PSRAM
+    static constexpr size_t   kFallbackCapacity = 4096;     // во внутренней RAM
+    static constexpr uint32_t kSyncPeriodMs = 100;
+    static constexpr uint8_t  kMaxNames = 64;               // различных имен в дампе
+    static constexpr const char* kTickName = "tick";        // точка тика, arg - TaskHandle_t
+
+    // Выделить кольцо (емкость округляется вниз до степени двойки) и начать запись
+    static bool begin(size_t capacity = kDefaultCapacity);
+
+    static void start();
+    static void stop();
+    static bool isRecording() { return recording_.load(std::memory_order_relaxed); }
+
+    static inline void IRAM_ATTR record(uint8_t type, const char* name, uint32_t arg) {
+#if TRACE_ENABLED
+        if (!recording_.load(std::memory_order_relaxed)) {
+            return;
+        }
+        if (external_ && !spi_flash_cache_enabled()) {
+            skipped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        const uint8_t core = (uint8_t)(xPortGetCoreID() & (kCores - 1));
+        if (needSync_[core]) {
+            needSync_[core] = false;
+            write(TraceEvent::kSync, nullptr, (uint32_t)esp_timer_get_time(), core);
+        }
+        write(type, name, arg, core);
+#else
+        (void)type;
+        (void)name;
+        (void)arg;
+#endif
+    }
+
+    // Напечатать кольцо в Serial (запись на время вывода стоит); сколько событий
+    static size_t dump();
+
+    // События в кольце: 0 - самое старое (чтение - при остановленной записи)
+    static size_t count();
+    static bool getEvent(size_t index, TraceEvent& out);
+
+    // Записано с begin() (включая перезаписанные) / пропущено при выключенном кэше
+    static uint32_t getRecorded() { return head_.load(std::memory_order_relaxed); }
+    static uint32_t getSkipped() { return skipped_.load(std::memory_order_relaxed); }
+    static size_t getCapacity() { return mask_ + 1; }
+
+private:
+    static inline void IRAM_ATTR write(uint8_t type, const char* name, uint32_t arg, uint8_t core) {
+        const uint32_t i = head_.fetch_add(1, std::memory_order_relaxed);
+        TraceEvent& e = events_[i & mask_];
+        e.cycles = ESP.getCycleCount();
+        e.name = name;
+        e.arg = arg;
+        e.type = type;
+        e.core = core;
+    }
+
+    // Таблица ручка - имя задачи для точек kTickName
+    static void dumpTasks();
+
+    static void tickHook0();
+    static void tickHook1();
+    static void onTick(uint8_t core);
+
+    static_assert((kCores & (kCores - 1)) == 0, "kCores must be a power of two");
+
+    static TraceEvent*           events_;
+    static size_t                mask_;
+    static bool                  external_;
+    static std::atomic<bool>     recording_;
+    static std::atomic<uint32_t> head_;
+    static std::atomic<uint32_t> skipped_;
+    static volatile bool         needSync_[kCores];
+    static uint32_t              ticks_[kCores];
+};
+
+#if TRACE_ENABLED
+#define TRACE_BEGIN(name)          TraceRecorder::record(TraceEvent::kBegin, (name), 0)
+#define TRACE_END(name)            TraceRecorder::record(TraceEvent::kEnd, (name), 0)
+#define TRACE_INSTANT(name, arg)   TraceRecorder::record(TraceEvent::kInstant, (name), (uint32_t)(arg))
+#define TRACE_COUNTER(name, value) TraceRecorder::record(TraceEvent::kCounter, (name), (uint32_t)(value))
+#else
+#define TRACE_BEGIN(name)          ((void)0)
+#define TRACE_END(name)            ((void)0)
+#define TRACE_INSTANT(name, arg)   ((void)0)
+#define TRACE_COUNTER(name, value) ((void)0)
+#endif
@@ -1,33 +1,190 @@
 #pragma once
 #include <Arduino.h>
+#include <esp_timer.h>
 
-#include  ".\core\IStimGenerator.h"
+#include "core/IStimGenerator.h"
+#include "core/EdgeErrorStats.h"
+#include "core/IsrProfile.h"
+#include "core/StimProgram.h"
+#include "core/LatestMailbox.h"
+#include "app/AppState.h"
+#include "app/TimingPlan.h"
+#include "app/stimSettings.h"
 
 class EMSPulseGenerator : public IStimGenerator {
 public:
 
+    // Режим формирования фронтов:
+    //  Polling - конечный автомат крутится в update() из задачи (опрос micros())
+    //  Timer   - каждый фронт пачки/паузы взводит one-shot esp_timer, update() не нужен
+    //  External - фронты вызывает внешний планировщик (StimChannelBank) через serviceEdge()
+    enum class DriveMode : uint8_t {
+        Polling,
+        Timer,
+        External
+    };
+
     //using PulseCallback = std::function<void(uint16_t pulseNumber, uint32_t timestamp)>;
     //void onPulseEnd(PulseCallback callback) { pulseEndCallback_ = callback; }
 
         // 🔥 Конструктор с параметрами PWM канала, частоты и разрешения
+    // Тайминги пачки берутся из готового профиля - в конструкторе нет деления
     EMSPulseGenerator(uint8_t pwmChannel, 
                      uint8_t outputPin,
                      uint32_t pwmFreq = 144, 
                      uint8_t pwmResolution = 10,
-                    uint8_t  pwmDuty = 70);
+                    uint8_t  pwmDuty = 70,
+                     const StimProfile& profile = DefaultStimProfile::value);
 
+    // Канал 0 на PWM_CH_1_PIN с профилем по умолчанию
     EMSPulseGenerator();
-    
-    bool begin() override;
-    void start() override;
-    void stop() override;
 
-    void setParams(uint8_t amplitudePercent) override;
+    // final: вызовы через EMSPulseGenerator& (банк, задачи) - прямые, без vtable;
+    // IStimGenerator остается только для выбора генератора при конфигурации
+    bool begin() override final;
+    void start() override final;
+    void stop() override final;
+
+    // Новая цель амплитуды; при заданном setRampTimeMs() выход к ней плавный
+    void setParams(uint8_t amplitudePercent) override final;
+
+    void update() override final;
+
+    // === Плавное изменение амплитуды ===
+    //
+    // Скважность меняется ступенькой на каждой новой пачке (фикс. точка Q16),
+    // так что внутри пачки амплитуда постоянна, а шаг вычисляется один раз
+    // на цель. Аппаратный fade LEDC здесь не подходит: стробирование пачек
+    // само пишет скважность на каждом фронте и спорило бы с модулем fade.
+
+    /**
+     * @brief Выйти на амплитуду за заданное время
+     * @param amplitudePercent Целевая амплитуда 0..100%
+     * @param rampMs Время выхода (0 - сразу)
+     */
+    void rampTo(uint8_t amplitudePercent, uint32_t rampMs);
+
+    // Время выхода на новую цель для setParams() (0 - без ограничения скорости).
+    // Шаг - один на пачку: рампа в rampMs дает rampMs / полный цикл ступенек,
+    // рампа короче цикла - одна ступенька (скачок на первой же пачке)
+    void setRampTimeMs(uint32_t rampMs) { rampTimeMs_ = rampMs; }
+
+    // Плавный старт: start() начинает с нуля и выходит на цель за softStartMs
+    // (та же гранулярность - ступенька на пачку)
+    void setSoftStartMs(uint32_t softStartMs) { softStartMs_ = softStartMs; }
+
+    bool     isRamping() const { return dutyQ16_ != targetDutyQ16_; }
+    uint16_t getDuty() const { return pwmDuty_; }
+
+    // Выбор режима - вызывать ДО begin()
+    void setDriveMode(DriveMode mode) { driveMode_ = mode; }
+    DriveMode getDriveMode() const { return driveMode_; }
+
+    // === Внешний планировщик (DriveMode::External) ===
+
+    // Идеальное время следующего фронта, шкала esp_timer_get_time() (после start())
+    uint64_t getNextEdgeTs() const { return nextEdgeTs_; }
+
+    // Обработать наступивший фронт, вернуть время следующего. Несущую здесь
+    // не меняет (планировщик зовет под своим mux_): carrierPending = true -
+    // вызвать applyPendingCarrier() после выхода из критической секции
+    uint64_t serviceEdge(bool& carrierPending);
+
+    // Сменить несущую, если ее поменял план; вне любых mux_, пока выход в нуле
+    void applyPendingCarrier();
+
+    /**
+     * @brief Сменить профиль во время работы (например, собранный из настроек)
+     * Новые длительности вступают с ближайшего фронта.
+     * @return false если профиль некорректен (см. StimProfile::isValid)
+     */
+    bool setProfile(const StimProfile& profile);
+
+    /**
+     * @brief Выполнять программу стимуляции вместо фиксированного цикла
+     *
+     * Только режимы Timer/External: команды BURST/PAUSE становятся фронтами
+     * автомата, RAMP задает рампу амплитуды. BURST(count, rate, width):
+     * несущая LEDC = rate (меняется вне mux_, выход ждет ее в нуле), пачка -
+     * count периодов, скважность = width / период при 100% амплитуды,
+     * амплитуда (RAMP) масштабирует ее. Несущая из TimingPlan игнорируется.
+     * Программа должна жить, пока генератор ее использует; nullptr - вернуть
+     * фиксированный цикл. Работающему генератору программа не подменяется:
+     * она запоминается и ставится со следующего start() (остановленному -
+     * сразу), так что текущая пачка и цикл доигрываются по старой.
+     * @return false если программа пуста или режим Polling
+     */
+    bool setProgram(const StimProgram* program);
+
+    // Исполняемая программа (отложенная до start() здесь еще не видна)
+    const StimProgram* getProgram() const { return sequencer_.program(); }
+
+    // === Публикация параметров (TimingPlan) ===
+    //
+    // UI собирает план из StimParams (buildPlan - все деления здесь) и
+    // публикует его: план копируется в свободный слот тройного буфера, и
+    // слот атомарно меняется местами с "ожидающим". Генератор забирает
+    // ожидающий план только в конце пачки (выход уже в нуле): пауза, несущая
+    // и все следующие пачки идут по новому плану, текущая пачка - по старому.
+    // Ни блокировок, ни пересчета в пути импульса.
+
+    /**
+     * @brief Собрать план из полного набора параметров
+     * @return false если параметры не дают корректный профиль
+     */
+    static bool buildPlan(const StimParams& params, TimingPlan& plan);
+
+    /**
+     * @brief Опубликовать план (один писатель, например UI_Task)
+     * Непринятый предыдущий план перезаписывается.
+     */
+    void publishPlan(const TimingPlan& plan) { plans_.post(plan); }
 
-    void update() override;
+    bool     hasPendingPlan() const { return plans_.hasFresh(); }
+    uint32_t getPlansApplied() const { return plansApplied_; }
+    uint32_t getCarrierHz() const { return pwmFreq_; }
+
+    // Ошибка фронтов (факт - идеал), копится с начала работы или reset
+    EdgeErrorStats::Snapshot getEdgeStats() const;
+    void resetEdgeStats();
+
+    // Учет времени колбэка фронтов (DriveMode::Timer); nullptr - без замера
+    void setIsrProfile(IsrProfile* profile) { isrProfile_ = profile; }
+
+    bool isRunning() const { return running_; }
+    uint8_t getPwmChannel() const { return pwmChannel_; }
 
 private:
 
+    void applyProfileLocked(const StimProfile& profile);
+
+    // Забрать ожидающий план (граница пачки), вызывать под mux_
+    bool takePlanLocked();
+
+    // ledcWrite своего канала; в трассе - счетчик "ledcN" со скважностью
+    void writeDuty(uint32_t duty);
+
+    // Скважность LEDC для амплитуды 0..100%
+    static uint16_t dutyForAmplitude(uint8_t amplitudePercent);
+
+    // Пересчитать шаг рампы от текущей скважности до цели
+    void setRampLocked(uint64_t rampUs);
+    // Шаг рампы, вызывается в начале каждой пачки
+    void slewLocked();
+
+    // 🔥 Фронтовой автомат (режимы Timer/External), вызывать под mux_
+    void beginCycleLocked(uint64_t now);
+    void advanceEdgeLocked();
+    // Выполнить программу до ближайшего сегмента (BURST/PAUSE), начиная с момента at
+    void runProgramLocked(uint64_t at);
+
+    // 🔥 Режим таймера: один колбэк на каждый фронт (начало/конец пачки)
+    static void edgeTimerThunk(void* arg);
+    void onEdgeTimer();
+    // Перевзвести таймер на nextEdgeTs_ (под mux_: взвод и проверка в
+    // onEdgeTimer() не разойдутся с start()/stop())
+    void armNextEdgeLocked();
+
     // 🔥 PWM параметры (уникальные для каждого экземпляра)
     uint8_t  pwmChannel_;      // LEDC канал (0-15)
     uint8_t  outputPin_;       // GPIO пин
@@ -37,27 +194,73 @@ private:
 
 
     uint8_t  amp_ = 10;          // % (начальная амплитуда 10%)
-    uint16_t pwUs_ = 200;        // микросек (длительность импульса)
-    uint8_t  rateHz_ = 144;      // Гц (частота импульсов в пачке)
-    uint8_t  pulsesPerBurst_ = 26;  // количество импульсов в пачке
-    uint32_t pauseBetweenBurstsMs_ = 235;  // пауза между пачками в мс
-
+    uint16_t pwUs_ = 0;          // микросек (длительность импульса)
+    uint16_t rateHz_ = 0;        // Гц (частота импульсов в пачке)
+    uint16_t pulsesPerBurst_ = 0;   // количество импульсов в пачке
 
-    // Производные параметры
-    uint32_t pulsePeriodUs_ = 6944;     // 1/144 Гц = 6944 мкс
-    uint32_t burstDurationUs_ = 180556; // 26 × 6944 = 180556 мкс
-    uint32_t pauseDurationUs_ = 235000; // 235 мс = 235000 мкс
-    uint32_t fullCycleUs_ = 415556;     // 180556 + 235000 = 415556 мкс
+    // Производные параметры (копируются из StimProfile)
+    uint32_t pulsePeriodUs_ = 0;
+    uint32_t burstDurationUs_ = 0;
+    uint32_t pauseDurationUs_ = 0;
+    uint32_t fullCycleUs_ = 0;
     uint16_t pwmDuty_ = 0;              // 0..1023
 
-    // Состояние
+    // Рампа амплитуды (скважность в Q16)
+    uint32_t dutyQ16_ = 0;              // текущая
+    uint32_t targetDutyQ16_ = 0;        // цель
+    uint32_t slewStepQ16_ = 0;          // шаг за пачку
+    uint32_t rampTimeMs_ = 0;
+    uint32_t softStartMs_ = 0;
+
+    // Ожидающий план (писатель - UI) и несущая, отложенная до выхода из mux_
+    LatestMailbox<TimingPlan> plans_;
+    uint32_t plansApplied_ = 0;
+    uint32_t pendingCarrierHz_ = 0;
+    uint16_t gatedDuty_ = 0;            // скважность пачки, ждущей своей несущей
+
+    // Программа стимуляции (nullptr в sequencer_ - фиксированный цикл) и
+    // программа, ждущая следующего start()
+    StimSequencer      sequencer_;
+    const StimProgram* pendingProgram_ = nullptr;
+    bool               programPending_ = false;
+
+    // Состояние (64-битная шкала esp_timer_get_time(), без переполнения)
     bool     running_ = false;
     bool     pulseActive_ = false;
-    uint32_t lastPulseTs_ = 0;
-    uint32_t nextPulseTs_ = 0;
-    uint32_t burstStartTs_ = 0;
-    uint32_t cycleStartTs_ = 0;
+    uint64_t lastPulseTs_ = 0;
+    uint64_t nextPulseTs_ = 0;
+    uint64_t burstStartTs_ = 0;
+    uint64_t cycleStartTs_ = 0;
     uint16_t pulseCountInBurst_ = 0;
     bool     inBurst_ = false;
+
+    // Режим таймера
+    DriveMode          driveMode_ = DriveMode::Polling;
+    esp_timer_handle_t edgeTimer_ = nullptr;
+    uint64_t           nextEdgeTs_ = 0;   // идеальное время следующего фронта (мкс)
+    EdgeErrorStats     edgeStats_;
+    IsrProfile*        isrProfile_ = nullptr;
+
+    // Критическая секция: колбэк esp_timer и stim-задача работают в разных контекстах
+    mutable portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
 };
 
+/**
+ * @brief Генератор с профилем, зафиксированным на этапе компиляции
+ *
+ * Тайминги Profile::value считает и проверяет компилятор, некорректный
+ * профиль не соберется:
+ *   FixedProfileGenerator<FixedStimProfile<100, 20, 300, 250>> stim(0, PWM_CH_1_PIN);
+ * Путь фронтов тот же, что у EMSPulseGenerator: тайминги - поля экземпляра.
+ */
+template <class Profile>
+class FixedProfileGenerator : public EMSPulseGenerator {
+public:
+    FixedProfileGenerator(uint8_t  pwmChannel,
+                          uint8_t  outputPin,
+                          uint32_t pwmFreq = 144,
+                          uint8_t  pwmResolution = 10,
+                          uint8_t  pwmDuty = 70)
+        : EMSPulseGenerator(pwmChannel, outputPin, pwmFreq, pwmResolution, pwmDuty, Profile::value)
+    {}
+};
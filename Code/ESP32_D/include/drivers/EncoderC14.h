@@ -2,6 +2,7 @@
 #include <Arduino.h>
 
 #include "core/IEncoder.h"
+#include "core/QuadratureDecoders.h"
 
 // Реализация энкодера C14 с кастомной логикой обработки
 // Использует прерывания на обоих каналах (CLK и DT)
@@ -19,4 +20,7 @@ protected:
     
     // Переопределяем настройку прерываний - C14 нужны оба канала
     void setupInterrupts() override;
+
+private:
+    C14Decoder decoder_;
 };
\ No newline at end of file
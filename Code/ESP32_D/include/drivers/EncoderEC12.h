@@ -2,6 +2,7 @@
 #include <Arduino.h>
 
 #include "core/IEncoder.h"
+#include "core/QuadratureDecoders.h"
 
 // Реализация инкрементного энкодера EC12 (2 канала: CLK/DT)
 // Алгоритм: определение направления на фронтах/спадах CLK по уровню DT.
@@ -18,4 +19,7 @@ protected:
     void IRAM_ATTR handleIsr() override;
         
     void setupInterrupts() override;
+
+private:
+    EC12Decoder decoder_;
 };
\ No newline at end of file
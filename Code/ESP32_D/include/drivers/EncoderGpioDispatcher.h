@@ -0,0 +1,117 @@
+#pragma once
+#include <Arduino.h>
+#include <driver/gpio.h>
+#include <esp_intr_alloc.h>
+
+#include "core/IEncoder.h"
+
+/**
+ * @brief Энкодер, которого декодирует общий обработчик GPIO
+ *
+ * Своих прерываний нет: EncoderGpioDispatcher по фронту на CLK или DT
+ * передает уровни обоих пинов, энкодер прогоняет их через квадратурный
+ * автомат. Дребезг гасится переходами туда-обратно; фильтра, как у
+ * SampledEncoder, нет - каждый фронт дает вход в ISR.
+ *
+ *   countsPerStep = 4 - шаг на полный квадратурный цикл (как EncoderEC12)
+ *   countsPerStep = 1 - шаг на каждый переход (как EncoderC14)
+ *   reversed      - обратное направление (знак как у EncoderPCNT)
+ */
+class DispatchedEncoder : public IEncoder {
+public:
+    DispatchedEncoder(uint8_t clkPin,
+                      uint8_t dtPin,
+                      uint8_t countsPerStep = 4,
+                      bool reversed = false);
+
+    // Пины и начальное состояние автомата
+    bool begin() override;
+
+private:
+    friend class EncoderGpioDispatcher;
+
+    // Уровни после фронта (из ISR диспетчера, 0/1)
+    void IRAM_ATTR decode(uint8_t clk, uint8_t dt);
+
+    // Прерываний нет: фронты приносит EncoderGpioDispatcher
+    void IRAM_ATTR handleIsr() override {}
+    void setupInterrupts() override {}
+
+    uint8_t countsPerStep_;
+    int8_t  direction_;
+
+    uint8_t state_ = 0x03;          // биты [CLK, DT]
+    int8_t  quarters_ = 0;          // переходы, еще не сложившиеся в шаг
+
+    // Маски пина в регистрах GPIO (0 - пины 0-31, 1 - пины 32-48)
+    uint8_t  clkBank_ = 0;
+    uint32_t clkMask_ = 0;
+    uint8_t  dtBank_ = 0;
+    uint32_t dtMask_ = 0;
+};
+
+/**
+ * @brief Один обработчик прерываний GPIO на все энкодеры
+ *
+ * Вместо attachInterruptArg() на каждый пин (у C14 - два обработчика на
+ * энкодер) диспетчер регистрирует один обработчик на весь GPIO. За вход
+ * в ISR он читает регистр статуса прерываний один раз на банк пинов,
+ * сбрасывает прочитанное, читает уровни входов и по таблице
+ * "пин -> энкодер" декодирует только энкодеры с фронтами - каждый один
+ * раз, даже если сработали оба его пина. Фронты, пришедшие за время
+ * прохода, обрабатываются следующим проходом того же входа (до
+ * kMaxPasses), так что пачка фронтов - один вход в ISR, а не по одному на
+ * пин. Стоимость - O(фронтов + затронутых энкодеров), а не O(всех
+ * энкодеров): 8 и больше ручек почти не дороже двух.
+ *
+ * gpio_isr_register() занимает прерывание GPIO целиком: в той же прошивке
+ * нельзя пользоваться attachInterrupt() / gpio_install_isr_service().
+ * Прерывание попадает на ядро, вызвавшее begin() (UI_Task, Core 0), и
+ * регистрируется без ESP_INTR_FLAG_IRAM (см. EncoderEvents::push): пока
+ * кэш выключен, фронты копятся в статусе GPIO и разбираются после.
+ */
+class EncoderGpioDispatcher {
+public:
+    static constexpr uint8_t kMaxEncoders = 16;
+    static constexpr uint8_t kGpioCount = 49;       // GPIO 0-48 ESP32-S3
+    static constexpr uint8_t kMaxPasses = 4;        // ограничение длины ISR в шторм
+
+    EncoderGpioDispatcher();
+
+    EncoderGpioDispatcher(const EncoderGpioDispatcher&) = delete;
+    EncoderGpioDispatcher& operator=(const EncoderGpioDispatcher&) = delete;
+
+    /**
+     * @brief Добавить энкодер (до begin())
+     * @return false если мест нет или пин уже занят
+     */
+    bool add(DispatchedEncoder& encoder);
+
+    // Зарегистрировать обработчик и включить прерывания (энкодеры уже после begin())
+    bool begin();
+    void end();
+
+    // Входов в ISR и обработанных фронтов: фронтов на вход > 1 - пачки сливаются
+    uint32_t getIsrCount() const { return isrCount_; }
+    uint32_t getEdgeCount() const { return edgeCount_; }
+
+    // Учет времени общего ISR (до begin()); nullptr - без замера
+    void setIsrProfile(IsrProfile* profile) { isrProfile_ = profile; }
+
+private:
+    static void IRAM_ATTR isrThunk(void* arg);
+    void IRAM_ATTR dispatch();
+
+    DispatchedEncoder* encoders_[kMaxEncoders] = {};
+    uint8_t count_ = 0;
+
+    // Пин -> номер энкодера (-1 - пин не наш)
+    int8_t   slotOfPin_[kGpioCount];
+    // Пины энкодеров в регистрах статуса, по банкам
+    uint32_t pinMask_[2] = {0, 0};
+
+    intr_handle_t handle_ = nullptr;
+    volatile uint32_t isrCount_ = 0;
+    volatile uint32_t edgeCount_ = 0;
+    IsrProfile* isrProfile_ = nullptr;
+};
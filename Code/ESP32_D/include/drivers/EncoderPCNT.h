@@ -0,0 +1,71 @@
+#pragma once
+#include <Arduino.h>
+#include <driver/pcnt.h>
+
+#include "core/IEncoder.h"
+
+/**
+ * @brief Энкодер на аппаратном счетчике импульсов (PCNT), без прерываний
+ *
+ * Оба канала юнита PCNT считают фронты CLK и DT в квадратурном режиме x4,
+ * дребезг короче фильтра отсекается аппаратно (фильтр PCNT - до 1023 тактов
+ * APB, ~12.7 мкс; debounceUs ограничивается этим значением). Более длинный
+ * дребезг одного контакта при стоящем втором дает пары +1/-1, которые
+ * взаимно гасятся в квадратурном счете. update() только
+ * читает счетчик и переводит отсчеты в шаги - CPU на каждом фронте не нужен,
+ * с таймингом стимуляции энкодер больше не конкурирует.
+ *
+ * С setWakeTask() (до begin()) задачу будит сам юнит PCNT: пороги событий
+ * THRES0/THRES1 стоят на границах следующего шага вверх и вниз от текущего
+ * счета, update() переставляет их после каждого чтения. Прерывание - раз
+ * на шаг и уже после фильтра: дребезг задачу не будит, в покое прерываний
+ * нет. Обработчик идет через общий сервис pcnt_isr_service_install.
+ *
+ *   countsPerStep = 4 - шаг на полный квадратурный цикл (как EncoderEC12)
+ *   countsPerStep = 1 - шаг на каждый переход (как EncoderC14)
+ *   reversed      - обратное направление (у C14 знак противоположный EC12)
+ */
+class EncoderPCNT : public IEncoder {
+public:
+    EncoderPCNT(uint8_t clkPin,
+                uint8_t dtPin,
+                pcnt_unit_t unit,
+                uint8_t countsPerStep = 4,
+                bool reversed = false,
+                uint32_t debounceUs = 10);
+
+    // Настройка юнита PCNT вместо прерываний
+    bool begin() override;
+
+    // Прочитать счетчик, отдать целые шаги обработчику (остаток копится)
+    void update() override;
+
+    pcnt_unit_t getUnit() const { return unit_; }
+    int32_t     getCount() const { return total_; }
+
+protected:
+    // Счет достиг порога шага; считает по-прежнему PCNT, прерывание только будит задачу
+    void IRAM_ATTR handleIsr() override { events_.wake(); }
+    void setupInterrupts() override;
+
+private:
+    static constexpr uint32_t kApbMhz = 80;
+    static constexpr uint16_t kMaxFilterTicks = 1023;
+    // Счетчик 16-битный; на пределе аппаратно обнуляется - считаем по модулю
+    static constexpr int16_t  kCounterLimit = 32767;
+
+    // Прочитать счетчик и перевести новые отсчеты в шаги; false - счетчик не читается
+    bool consume(int16_t& count);
+    // Пороги пробуждения на границах следующего шага от count
+    void armThresholds(int16_t count);
+    static int16_t wrapCount(int32_t count);
+
+    pcnt_unit_t unit_;
+    uint8_t countsPerStep_;
+    bool reversed_;
+
+    int16_t lastCount_ = 0;     // последнее прочитанное значение счетчика
+    int32_t residual_ = 0;      // отсчеты, еще не сложившиеся в шаг
+    int32_t total_ = 0;         // все отсчеты с begin() (диагностика)
+    bool    thresholdWake_ = false;
+};
@@ -0,0 +1,114 @@
+#pragma once
+#include <Arduino.h>
+
+#include "core/IEncoder.h"
+
+/**
+ * @brief Энкодер, который декодирует EncoderSampler по таймеру
+ *
+ * Своих прерываний нет: на каждом тике таймера сэмплер передает уровни
+ * CLK/DT, энкодер прогоняет их через фильтр (уровень принимается после
+ * N одинаковых отсчетов подряд) и квадратурный автомат. Дребезг короче
+ * N отсчетов не доходит до автомата вовсе, более длинный - гасится
+ * переходами туда-обратно. Щелчки идут в кольцо событий IEncoder.
+ *
+ *   countsPerStep = 4 - шаг на полный квадратурный цикл (как EncoderEC12)
+ *   countsPerStep = 1 - шаг на каждый переход (как EncoderC14)
+ *   reversed      - обратное направление (знак как у EncoderPCNT)
+ */
+class SampledEncoder : public IEncoder {
+public:
+    SampledEncoder(uint8_t clkPin,
+                   uint8_t dtPin,
+                   uint8_t countsPerStep = 4,
+                   bool reversed = false,
+                   uint32_t debounceUs = 1000);
+
+    // Пины и начальное (уже "устоявшееся") состояние автомата
+    bool begin() override;
+
+private:
+    friend class EncoderSampler;
+
+    // Один отсчет из ISR таймера (уровни 0/1)
+    void IRAM_ATTR sample(uint8_t clk, uint8_t dt);
+
+    // Прерываний нет: уровни приносит EncoderSampler
+    void IRAM_ATTR handleIsr() override {}
+    void setupInterrupts() override {}
+
+    struct PinFilter {
+        uint8_t stable;     // принятый уровень
+        uint8_t count;      // сколько отсчетов подряд он отличается
+    };
+
+    uint8_t countsPerStep_;
+    int8_t  direction_;
+    uint8_t stableSamples_ = 2;     // задает сэмплер по своей частоте
+
+    PinFilter clk_ = {1, 0};
+    PinFilter dt_ = {1, 0};
+    int8_t    quarters_ = 0;        // переходы, еще не сложившиеся в шаг
+
+    // Маски пина в регистре входов GPIO (0 - GPIO_IN_REG, 1 - GPIO_IN1_REG)
+    uint8_t  clkBank_ = 0;
+    uint32_t clkMask_ = 0;
+    uint8_t  dtBank_ = 0;
+    uint32_t dtMask_ = 0;
+};
+
+/**
+ * @brief Опрос всех энкодеров одним аппаратным таймером
+ *
+ * Альтернатива прерываниям по фронтам: таймер с фиксированной частотой
+ * (2-5 кГц) читает регистры входов GPIO - по одному чтению на банк пинов
+ * (0-31 и 32-48), только те банки, где есть пины энкодеров, - и прогоняет
+ * фильтр и автомат каждого энкодера за один проход. Стоимость ISR
+ * постоянна и не зависит от дребезга: шторма прерываний быть не может,
+ * а время, отнятое у стимуляции, предсказуемо.
+ *
+ * Прерывание таймера попадает на ядро, вызвавшее begin() (UI_Task, Core 0).
+ * Сэмплер один на прошивку: у timerAttachInterrupt нет аргумента.
+ */
+class EncoderSampler {
+public:
+    static constexpr uint8_t  kMaxEncoders = 4;
+    static constexpr uint32_t kTimerTickHz = 1000000;   // APB 80 МГц / 80
+
+    explicit EncoderSampler(uint32_t sampleHz = 4000, uint8_t timerNum = 0);
+
+    EncoderSampler(const EncoderSampler&) = delete;
+    EncoderSampler& operator=(const EncoderSampler&) = delete;
+
+    /**
+     * @brief Добавить энкодер (до begin())
+     * @return false если мест нет
+     */
+    bool add(SampledEncoder& encoder);
+
+    // Запустить таймер (энкодеры уже после begin())
+    bool begin();
+    void end();
+
+    uint32_t getSampleHz() const { return sampleHz_; }
+    uint32_t getSampleCount() const { return samples_; }
+
+    // Учет времени ISR таймера (до begin()); nullptr - без замера
+    void setIsrProfile(IsrProfile* profile) { isrProfile_ = profile; }
+
+private:
+    static void IRAM_ATTR timerIsr();
+    void IRAM_ATTR sampleAll();
+
+    static EncoderSampler* instance_;
+
+    SampledEncoder* encoders_[kMaxEncoders] = {};
+    uint8_t  count_ = 0;
+    bool     readBank_[2] = {false, false};
+
+    uint32_t sampleHz_;
+    uint8_t  timerNum_;
+    hw_timer_t* timer_ = nullptr;
+    volatile uint32_t samples_ = 0;
+    IsrProfile* isrProfile_ = nullptr;
+};
@@ -0,0 +1,109 @@
+#pragma once
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <driver/mcpwm.h>
+
+#include "core/IStimGenerator.h"
+#include "app/stimSettings.h"
+
+/**
+ * @brief Генератор импульсов на MCPWM с точной шириной (моно/бифазный)
+ *
+ * Импульсы формирует таймер MCPWM с периодом 1/rateHz и разрешением 1 мкс,
+ * CPU в каждом импульсе не участвует. Бифазная пара строится на одном
+ * таймере без рассинхронизации:
+ *  - фаза 1 (генератор B): HIGH на [0, pw)
+ *  - фаза 2 (генератор A): сырой HIGH на [0, 2*pw + gap), затем модуль
+ *    dead-time задерживает передний фронт на (pw + gap) -> HIGH на [pw + gap, 2*pw + gap)
+ *
+ * Пачки/паузы стробирует esp_timer: два колбэка на цикл (открыть/закрыть),
+ * независимо от числа импульсов в пачке.
+ *
+ * Ширина фазы всегда pwUs (setPulseShape), амплитуда ее не меняет.
+ * Амплитуда (setParams) - отдельный выход опорного уровня для токового
+ * каскада: скважность LEDC через RC-фильтр (setAmplitudeOutput до begin()).
+ * Без этого выхода импульсы идут полной ширины, а 0% только закрывает
+ * строб со следующей пачки.
+ */
+class MCPWMPulseGenerator : public IStimGenerator {
+public:
+    MCPWMPulseGenerator(mcpwm_unit_t unit,
+                        mcpwm_timer_t timer,
+                        uint8_t  phase1Pin,
+                        int8_t   phase2Pin = -1,      // -1 = монофазный режим
+                        uint16_t pulseWidthUs = 200,
+                        uint16_t interPhaseUs = 100,
+                        const StimProfile& profile = DefaultStimProfile::value);
+
+    bool begin() override;
+    void start() override;
+    void stop() override;
+
+    void setParams(uint8_t amplitudePercent) override;
+
+    // Импульсы формирует MCPWM - опрашивать нечего
+    void update() override {}
+
+    /**
+     * @brief Изменить форму импульса (можно на ходу, применяется с нового периода)
+     * @param pulseWidthUs Ширина фазы при амплитуде 100%
+     * @param interPhaseUs Пауза между фазами (только бифазный режим)
+     * @return false если пара не помещается в период
+     */
+    bool setPulseShape(uint16_t pulseWidthUs, uint16_t interPhaseUs);
+
+    /**
+     * @brief Выход опорного уровня амплитуды (вызывать до begin())
+     * @param pin Пин уровня (через RC-фильтр на вход токового каскада)
+     * @param ledcChannel Свободный канал LEDC
+     */
+    void setAmplitudeOutput(uint8_t pin, uint8_t ledcChannel);
+
+    bool     isBiphasic() const { return phase2Pin_ >= 0; }
+    uint16_t getPhaseWidthUs() const { return pwUs_; }
+    uint8_t  getAmplitude() const { return amp_; }
+
+private:
+    // Разрешение dead-time = разрешение группы MCPWM (10 МГц по умолчанию)
+    static constexpr uint32_t kDeadtimeTicksPerUs = 10;
+    static constexpr uint32_t kMaxDeadtimeTicks = 65535;
+    // Опорный уровень: частота далеко выше полосы RC-фильтра
+    static constexpr uint32_t kAmplitudeFreqHz = 20000;
+    static constexpr uint8_t  kAmplitudeBits = 8;
+
+    void applyShape();
+    void writeAmplitude();
+    void openGate();
+    void closeGate();
+
+    static void gateTimerThunk(void* arg);
+    void onGateTimer();
+    void scheduleNextEdge();
+
+    // Параметры канала
+    mcpwm_unit_t  unit_;
+    mcpwm_timer_t timer_;
+    uint8_t  phase1Pin_;
+    int8_t   phase2Pin_;
+    uint16_t pwUs_;
+    uint16_t interPhaseUs_;
+
+    uint8_t  amp_ = 10;
+    int8_t   ampPin_ = -1;             // -1 - выхода уровня нет
+    uint8_t  ampChannel_ = 0;
+
+    // Параметры пачки (из StimProfile, как в EMSPulseGenerator)
+    uint16_t rateHz_ = 0;
+    uint16_t pulsesPerBurst_ = 0;
+    uint32_t pulsePeriodUs_ = 0;
+    uint32_t fullCycleUs_ = 0;
+    uint32_t gateOpenUs_ = 0;          // от начала пачки до закрытия строба
+    uint32_t gateClosedUs_ = 0;        // от закрытия строба до следующей пачки
+
+    // Состояние
+    bool     running_ = false;
+    bool     gateOpen_ = false;
+    uint32_t nextEdgeTs_ = 0;
+    esp_timer_handle_t gateTimer_ = nullptr;
+    portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+};
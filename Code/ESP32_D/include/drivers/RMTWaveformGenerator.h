@@ -0,0 +1,113 @@
+#pragma once
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <driver/rmt.h>
+
+#include "core/IStimGenerator.h"
+#include "app/stimSettings.h"
+
+/**
+ * @brief Генератор пачек на RMT TX в режиме loop ("скомпилированная" форма)
+ *
+ * Цикл пачка/пауза один раз рендерится в буфер RMT-символов и дальше
+ * проигрывается периферией по кругу без участия CPU. Выход совпадает с
+ * EMSPulseGenerator: несущая LEDC с заданной скважностью во время пачки,
+ * ноль во время паузы.
+ *
+ * Несущая формируется одним из двух способов:
+ *  - аппаратным модулятором RMT (если период влезает в 16-битные счетчики
+ *    APB, т.е. несущая >= ~611 Гц) - тогда в буфере только огибающая;
+ *  - явными периодами в буфере (низкие несущие, например 144 Гц).
+ *
+ * setParams() перекомпилирует форму в свободный буфер, а подмена в памяти
+ * RMT выполняется в середине паузы (один колбэк esp_timer на обновление).
+ * Новая форма для этого рендерится со сдвигом: начинается с второй половины
+ * паузы, и перезапуск RMT в середине паузы продолжает цикл без разрыва.
+ * Задержка колбэка (задача esp_timer) только удлиняет эту паузу; если до
+ * пачки осталось меньше SWAP_GUARD_US, подмена переносится на следующий
+ * цикл - пачка никогда не обрезается и цикл не смешивает две формы.
+ */
+class RMTWaveformGenerator : public IStimGenerator {
+public:
+    RMTWaveformGenerator(rmt_channel_t rmtChannel,
+                         uint8_t  outputPin,
+                         uint32_t carrierFreq = 144,
+                         uint8_t  pwmResolution = 10,
+                         uint16_t pwmDuty = 70,
+                         uint8_t  memBlocks = 1,
+                         const StimProfile& profile = DefaultStimProfile::value);
+
+    bool begin() override;
+    void start() override;
+    void stop() override;
+
+    void setParams(uint8_t amplitudePercent) override;
+
+    // Форму проигрывает RMT - опрашивать нечего
+    void update() override {}
+
+    // Диагностика: сколько RMT-символов занимает текущая форма
+    uint16_t getItemCount() const { return active_->count; }
+    bool     usesHwCarrier() const { return active_->hwCarrier; }
+
+private:
+    // Тактирование RMT: APB 80 МГц / 80 = 1 тик на микросекунду
+    static constexpr uint32_t kApbHz        = 80000000UL;
+    static constexpr uint8_t  kClkDiv       = 80;
+    static constexpr uint32_t kMaxRunTicks  = 32767;   // 15-битная длительность символа
+    static constexpr uint32_t kMaxCarrierTicks = 65535; // 16-битные счетчики модулятора
+    static constexpr uint16_t kMaxItems     = SOC_RMT_MEM_WORDS_PER_CHANNEL * SOC_RMT_TX_CANDIDATES_PER_GROUP;
+
+    struct Waveform {
+        rmt_item32_t items[kMaxItems];
+        uint16_t count = 0;             // включая завершающий нулевой символ
+        bool     hwCarrier = false;
+        uint16_t carrierHighTicks = 0;
+        uint16_t carrierLowTicks = 0;
+        uint32_t leadPauseUs = 0;       // пауза перед пачкой в начале буфера
+    };
+
+    // Сборщик символов: склеивает соседние одинаковые уровни и режет длинные
+    class ItemWriter;
+
+    bool compile(uint16_t duty, uint32_t leadPauseUs, Waveform& wf) const;
+    // Под mux_: запустить форму с начала буфера, отсчет цикла - от нее
+    void loadLocked(const Waveform& wf);
+
+    // Фаза цикла (0 - начало пачки) в момент nowUs
+    uint32_t phaseAt(int64_t nowUs) const;
+    // Взвести подмену на ближайшее начало буфера pending_ в паузе
+    void armSwap();
+
+    static void swapTimerThunk(void* arg);
+    void onSwapTimer();
+
+    // Параметры канала
+    rmt_channel_t rmtChannel_;
+    uint8_t  outputPin_;
+    uint32_t carrierFreq_;
+    uint8_t  pwmResolution_;
+    uint16_t maxDuty_;
+    uint16_t pwmDuty_;
+    uint8_t  memBlocks_;
+    uint16_t capacity_;                 // символов в выделенных блоках памяти
+
+    // Параметры пачки (из StimProfile, как в EMSPulseGenerator)
+    uint32_t burstDurationUs_ = 0;
+    uint32_t pauseDurationUs_ = 0;
+    uint32_t fullCycleUs_ = 0;
+
+    // Три буфера, меняются указателями под mux_: active_ - в памяти RMT,
+    // pending_ - ждет подмены (hasPending_), free_ - пишут только setParams()
+    // и start() (задача-владелец генератора)
+    Waveform  waveforms_[3];
+    Waveform* active_ = &waveforms_[0];
+    Waveform* pending_ = &waveforms_[1];
+    Waveform* free_ = &waveforms_[2];
+    bool      hasPending_ = false;
+
+    bool     running_ = false;
+    int64_t  cycleOriginUs_ = 0;        // начало пачки текущей формы (esp_timer)
+    esp_timer_handle_t swapTimer_ = nullptr;
+    portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+};
@@ -1,194 +1,262 @@
 #include "app/AppState.h"
 
-AppState::AppState() 
+AppState::AppState()
     : stimRunning_(false)
 {
-    mutex_ = xSemaphoreCreateMutex();
-    if (mutex_ == nullptr) {
-        Serial.println("[AppState] ERROR: Failed to create mutex!");
-    }
-    
     // Инициализация начальных значений
-    encoderAState_.value = 10;
-    encoderAState_.position = 0;
+    AppStateSnapshot initial;
+    initial.encoderA.value = 10;
+    initial.encoderA.position = 0;
+
+    initial.encoderB.value = 10;
+    initial.encoderB.position = 0;
 
-    encoderBState_.value = 10;
-    encoderBState_.position = 0;
+    initial.params.stimDuty = 10;
+    state_.store(initial);
 
-    stimParams_.stimDuty = 10;
+    for (uint8_t i = 0; i < kMaxSubscribers; ++i) {
+        subscribers_[i].task.store(nullptr, std::memory_order_relaxed);
+        subscribers_[i].pending.store(0, std::memory_order_relaxed);
+        subscribers_[i].fields = 0;
+    }
 }
 
-AppState::~AppState() {
-    if (mutex_ != nullptr) {
-        vSemaphoreDelete(mutex_);
+AppStateSnapshot AppState::read() const {
+    uint32_t retries = 0;
+    AppStateSnapshot snapshot = state_.load(&retries);
+    if (retries != 0) {
+        readRetries_.fetch_add(retries, std::memory_order_relaxed);
     }
+    return snapshot;
+}
+
+AppStateSnapshot AppState::getSnapshot() const {
+    return read();
+}
+
+void AppState::restore(const AppStateSnapshot& snapshot) {
+    AppStateSnapshot s = snapshot;
+    applyConstraints(s.params);
+    s.encoderA.value = constrain(s.encoderA.value, 0, 100);
+    s.encoderB.value = constrain(s.encoderB.value, 0, 100);
+
+    portENTER_CRITICAL(&writeMux_);
+    state_.store(s);
+    portEXIT_CRITICAL(&writeMux_);
+
+    notify(kFieldParams | kFieldEncoderA | kFieldEncoderB);
 }
 
 StimParams AppState::getStimParams() const {
-    StimParams params;
-    if (xSemaphoreTake(mutex_, pdMS_TO_TICKS(100)) == pdTRUE) {
-        params = stimParams_;
-        xSemaphoreGive(mutex_);
-    }
-    return params;
+    return read().params;
 }
 
 void AppState::setStimParams(const StimParams& params) {
-    if (xSemaphoreTake(mutex_, pdMS_TO_TICKS(100)) == pdTRUE) {
-        stimParams_ = params;
-        applyConstraints(stimParams_);
-        xSemaphoreGive(mutex_);
+    StimParams constrained = params;
+    applyConstraints(constrained);
+
+    portENTER_CRITICAL(&writeMux_);
+    AppStateSnapshot s = state_.load();
+    const bool changed = (s.params != constrained);
+    if (changed) {
+        s.params = constrained;
+        state_.store(s);
+    }
+    portEXIT_CRITICAL(&writeMux_);
+
+    if (changed) {
+        notify(kFieldParams);
     }
 }
 
 uint8_t AppState::getAmplitude() const {
-    uint8_t amp = 0;
-    if (xSemaphoreTake(mutex_, pdMS_TO_TICKS(100)) == pdTRUE) {
-        amp = stimParams_.stimDuty;
-        xSemaphoreGive(mutex_);
-    }
-    return amp;
+    return read().params.stimDuty;
 }
 
 void AppState::setAmplitude(uint8_t amp) {
-    if (xSemaphoreTake(mutex_, pdMS_TO_TICKS(100)) == pdTRUE) {
-        stimParams_.stimDuty = constrain(amp, 0, 100);
-        xSemaphoreGive(mutex_);
+    const uint8_t constrained = constrain(amp, 0, 100);
+
+    portENTER_CRITICAL(&writeMux_);
+    AppStateSnapshot s = state_.load();
+    const bool changed = (s.params.stimDuty != constrained);
+    if (changed) {
+        s.params.stimDuty = constrained;
+        state_.store(s);
+    }
+    portEXIT_CRITICAL(&writeMux_);
+
+    if (changed) {
+        notify(kFieldParams);
     }
 }
 
-// === Методы для Энкодера A ===
+// === Методы для энкодеров ===
 
-bool AppState::adjustEncoderA(int8_t delta) {
+bool AppState::adjustEncoder(bool encoderA, int8_t delta) {
     bool changed = false;
-    
-    if (xSemaphoreTake(mutex_, pdMS_TO_TICKS(100)) == pdTRUE) {
-        encoderAState_.position += delta;
-        
-        // Изменяем значение с ограничением 0-100
-        int newValue = (int)encoderAState_.value + delta;
-        newValue = constrain(newValue, 0, 100);
-        
-        if (newValue != encoderAState_.value) {
-            encoderAState_.value = newValue;
-            // Обновляем общий amplitude
-            stimParams_.stimDuty = encoderAState_.value;
-            changed = true;
+
+    // Писатели сериализованы спинлоком: внутри него load() не повторяется
+    portENTER_CRITICAL(&writeMux_);
+    AppStateSnapshot s = state_.load();
+    EncoderState& enc = encoderA ? s.encoderA : s.encoderB;
+
+    enc.position += delta;
+
+    // Изменяем значение с ограничением 0-100
+    int newValue = (int)enc.value + delta;
+    newValue = constrain(newValue, 0, 100);
+
+    if (newValue != enc.value) {
+        enc.value = newValue;
+        // Общий amplitude задает только энкодер A
+        if (encoderA) {
+            s.params.stimDuty = enc.value;
         }
-        
-        xSemaphoreGive(mutex_);
-    } else {
-        // Таймаут - не логируем каждый раз, чтобы не забивать Serial
-        static uint32_t lastWarnTime = 0;
-        uint32_t now = millis();
-        if (now - lastWarnTime > 1000) {
-            lastWarnTime = now;
-            Serial.println("[AppState] WARN: Mutex timeout in adjustEncoderA");
+        changed = true;
+    }
+    state_.store(s);
+    portEXIT_CRITICAL(&writeMux_);
+
+    // Позиция меняется и на упоре - подписчикам она тоже нужна
+    if (delta != 0) {
+        uint32_t fields = encoderA ? kFieldEncoderA : kFieldEncoderB;
+        if (changed && encoderA) {
+            fields |= kFieldParams;
         }
+        notify(fields);
     }
-    
+
     return changed;
 }
 
+bool AppState::adjustEncoderA(int8_t delta) {
+    return adjustEncoder(true, delta);
+}
+
 EncoderState AppState::getEncoderAState() const {
-    EncoderState state;
-    if (xSemaphoreTake(mutex_, pdMS_TO_TICKS(100)) == pdTRUE) {
-        state = encoderAState_;
-        xSemaphoreGive(mutex_);
-    }
-    return state;
+    return read().encoderA;
 }
 
 uint8_t AppState::getEncoderAValue() const {
-    uint8_t value = 0;
-    if (xSemaphoreTake(mutex_, pdMS_TO_TICKS(100)) == pdTRUE) {
-        value = encoderAState_.value;
-        xSemaphoreGive(mutex_);
+    return read().encoderA.value;
+}
+
+bool AppState::adjustEncoderB(int8_t delta) {
+    return adjustEncoder(false, delta);
+}
+
+EncoderState AppState::getEncoderBState() const {
+    return read().encoderB;
+}
+
+uint8_t AppState::getEncoderBValue() const {
+    return read().encoderB.value;
+}
+
+void AppState::setStimRunning(bool running) {
+    if (stimRunning_.exchange(running) != running) {
+        notify(kFieldStimRunning);
     }
-    return value;
 }
 
-// === Методы для Энкодера B ===
+// === Подписка на изменения ===
 
-bool AppState::adjustEncoderB(int8_t delta) {
-    bool changed = false;
-    
-    if (xSemaphoreTake(mutex_, pdMS_TO_TICKS(100)) == pdTRUE) {
-        encoderBState_.position += delta;
-        
-        // Изменяем значение с ограничением 0-100
-        int newValue = (int)encoderBState_.value + delta;
-        newValue = constrain(newValue, 0, 100);
-        
-        if (newValue != encoderBState_.value) {
-            encoderBState_.value = newValue;
-            // Обновляем общий amplitude
-            //stimParams_.amplitude = encoderBState_.value;
-            changed = true;
-        }
-        
-        xSemaphoreGive(mutex_);
-    } else {
-        // Таймаут - не логируем каждый раз
-        static uint32_t lastWarnTime = 0;
-        uint32_t now = millis();
-        if (now - lastWarnTime > 1000) {
-            lastWarnTime = now;
-            Serial.println("[AppState] WARN: Mutex timeout in adjustEncoderB");
-        }
+int8_t AppState::subscribe(TaskHandle_t task, uint32_t fields) {
+    if (task == nullptr || (fields & kFieldAll) == 0) {
+        Serial.println("[AppState] ERROR: Invalid subscriber");
+        return -1;
     }
-    
-    return changed;
+
+    portENTER_CRITICAL(&writeMux_);
+    const uint8_t index = subscriberCount_.load(std::memory_order_relaxed);
+    if (index < kMaxSubscribers) {
+        Subscriber& sub = subscribers_[index];
+        sub.fields = fields & kFieldAll;
+        sub.pending.store(0, std::memory_order_relaxed);
+        sub.task.store(task, std::memory_order_relaxed);
+        // Публикуем слот целиком: notify() читает count с acquire
+        subscriberCount_.store(index + 1, std::memory_order_release);
+    }
+    portEXIT_CRITICAL(&writeMux_);
+
+    if (index >= kMaxSubscribers) {
+        Serial.println("[AppState] ERROR: Too many subscribers");
+        return -1;
+    }
+    return (int8_t)index;
 }
 
-EncoderState AppState::getEncoderBState() const {
-    EncoderState state;
-    if (xSemaphoreTake(mutex_, pdMS_TO_TICKS(100)) == pdTRUE) {
-        state = encoderBState_;
-        xSemaphoreGive(mutex_);
+uint32_t AppState::takeChanges(int8_t subscriber) {
+    if (subscriber < 0 || subscriber >= (int8_t)subscriberCount_.load(std::memory_order_acquire)) {
+        return 0;
     }
-    return state;
+    return subscribers_[subscriber].pending.exchange(0, std::memory_order_acq_rel);
 }
 
-uint8_t AppState::getEncoderBValue() const {
-    uint8_t value = 0;
-    if (xSemaphoreTake(mutex_, pdMS_TO_TICKS(100)) == pdTRUE) {
-        value = encoderBState_.value;
-        xSemaphoreGive(mutex_);
+uint32_t AppState::waitChanges(int8_t subscriber, uint32_t timeoutMs) {
+    uint32_t changes = takeChanges(subscriber);
+    if (changes != 0 || timeoutMs == 0) {
+        return changes;
+    }
+
+    // Биты выставляются до уведомления: после пробуждения они уже видны.
+    // Чужие уведомления той же задачи просто дают пустой проход
+    const TickType_t start = xTaskGetTickCount();
+    const TickType_t ticks = pdMS_TO_TICKS(timeoutMs);
+    while (changes == 0) {
+        const TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= ticks) {
+            break;
+        }
+        ulTaskNotifyTake(pdTRUE, ticks - elapsed);
+        changes = takeChanges(subscriber);
+    }
+    return changes;
+}
+
+void AppState::notify(uint32_t changed) {
+    version_.fetch_add(1, std::memory_order_release);
+
+    const uint8_t count = subscriberCount_.load(std::memory_order_acquire);
+    for (uint8_t i = 0; i < count; ++i) {
+        Subscriber& sub = subscribers_[i];
+        const uint32_t bits = changed & sub.fields;
+        if (bits == 0) {
+            continue;
+        }
+        sub.pending.fetch_or(bits, std::memory_order_release);
+        xTaskNotifyGive(sub.task.load(std::memory_order_relaxed));
     }
-    return value;
 }
 
 // === Вспомогательные методы ===
 
-void AppState::printCurrentState() const {
-    // ✅ КРИТИЧНО: Захватываем мьютекс ОДИН РАЗ для всех данных
-    StimParams params;
-    EncoderState encA;
-    EncoderState encB;
+void AppState::printCurrentState(uint32_t fields) const {
+    // ✅ Один согласованный снимок для всех данных
+    const AppStateSnapshot s = read();
     bool running = isStimRunning();
-    
-    if (xSemaphoreTake(mutex_, pdMS_TO_TICKS(100)) == pdTRUE) {
-        params = stimParams_;
-        encA = encoderAState_;
-        encB = encoderBState_;
-        xSemaphoreGive(mutex_);
-        
-        // Вывод ПОСЛЕ освобождения мьютекса
-        Serial.println("╔════════════════════════════════════════════════════╗");
-        Serial.printf( "║ Encoder A: value=%3d  position=%6ld          ║\n", 
-                       encA.value, encA.position);
-        Serial.printf( "║ Encoder B: value=%3d  position=%6ld          ║\n", 
-                       encB.value, encB.position);
-        Serial.println("╠════════════════════════════════════════════════════╣");
-        Serial.printf( "║ Final Amplitude: %3d%%                            ║\n", 
-                       params.stimDuty);
-        Serial.printf( "║ Stim Running: %s                                 ║\n", 
+
+    Serial.println("╔════════════════════════════════════════════════════╗");
+    if (fields & kFieldEncoderA) {
+        Serial.printf( "║ Encoder A: value=%3d  position=%6ld          ║\n",
+                       s.encoderA.value, s.encoderA.position);
+    }
+    if (fields & kFieldEncoderB) {
+        Serial.printf( "║ Encoder B: value=%3d  position=%6ld          ║\n",
+                       s.encoderB.value, s.encoderB.position);
+    }
+    Serial.println("╠════════════════════════════════════════════════════╣");
+    if (fields & kFieldParams) {
+        Serial.printf( "║ Final Amplitude: %3d%%                            ║\n",
+                       s.params.stimDuty);
+    }
+    if (fields & kFieldStimRunning) {
+        Serial.printf( "║ Stim Running: %s                                 ║\n",
                        running ? "YES" : "NO ");
-        Serial.println("╚════════════════════════════════════════════════════╝");
     }
+    Serial.println("╚════════════════════════════════════════════════════╝");
 }
 
 void AppState::applyConstraints(StimParams& params) const {
     params.stimDuty = constrain(params.stimDuty, 0, 100);
-}
\ No newline at end of file
+}
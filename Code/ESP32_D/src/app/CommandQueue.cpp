@@ -1,8 +1,19 @@
 #include "app/CommandQueue.h"
 
-CommandQueue::CommandQueue(size_t queueSize) 
-    : queueSize_(queueSize)
+CommandQueue::CommandQueue(size_t queueSize, Backend backend)
+    : backend_(backend)
+    , queue_(nullptr)
+    , queueSize_(queueSize)
+    , ring_(backend == Backend::Spsc ? queueSize : 0)
+    , waiter_(nullptr)
 {
+    if (backend_ == Backend::Spsc) {
+        if (!ring_.isValid()) {
+            Serial.println("[CommandQueue] ERROR: Failed to create ring!");
+        }
+        return;
+    }
+
     queue_ = xQueueCreate(queueSize, sizeof(Command));
     if (queue_ == nullptr) {
         Serial.println("[CommandQueue] ERROR: Failed to create queue!");
@@ -16,31 +27,99 @@ CommandQueue::~CommandQueue() {
 }
 
 bool CommandQueue::send(const Command& cmd, uint32_t timeoutMs) {
+    if (backend_ == Backend::Spsc) {
+        return sendSpsc(cmd, timeoutMs);
+    }
     if (queue_ == nullptr) {
         return false;
     }
-    
+
     TickType_t ticks = (timeoutMs == 0) ? 0 : pdMS_TO_TICKS(timeoutMs);
     return xQueueSend(queue_, &cmd, ticks) == pdTRUE;
 }
 
 bool CommandQueue::receive(Command& cmd, uint32_t timeoutMs) {
+    if (backend_ == Backend::Spsc) {
+        return receiveSpsc(cmd, timeoutMs);
+    }
     if (queue_ == nullptr) {
         return false;
     }
-    
+
     TickType_t ticks = (timeoutMs == 0) ? 0 : pdMS_TO_TICKS(timeoutMs);
     return xQueueReceive(queue_, &cmd, ticks) == pdTRUE;
 }
 
-bool CommandQueue::hasCommands() const {
-    if (queue_ == nullptr) {
+bool CommandQueue::sendSpsc(const Command& cmd, uint32_t timeoutMs) {
+    if (!ring_.isValid()) {
+        return false;
+    }
+
+    // Переполнение - редкий случай (читатель разбирает очередь пачкой),
+    // поэтому писатель просто досыпает по тику до таймаута
+    const TickType_t start = xTaskGetTickCount();
+    const TickType_t ticks = pdMS_TO_TICKS(timeoutMs);
+    while (!ring_.push(cmd)) {
+        if (xTaskGetTickCount() - start >= ticks) {
+            return false;
+        }
+        vTaskDelay(1);
+    }
+
+    // Публикация tail_ должна быть видна до чтения waiter_ (пара с fence в
+    // receiveSpsc): иначе читатель может уснуть, не увидев команду
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    TaskHandle_t waiter = waiter_.load(std::memory_order_relaxed);
+    if (waiter != nullptr) {
+        xTaskNotifyGive(waiter);
+    }
+    return true;
+}
+
+bool CommandQueue::receiveSpsc(Command& cmd, uint32_t timeoutMs) {
+    if (!ring_.isValid()) {
+        return false;
+    }
+    if (ring_.pop(cmd)) {
+        return true;
+    }
+    if (timeoutMs == 0) {
         return false;
     }
-    return uxQueueMessagesWaiting(queue_) > 0;
+
+    const TickType_t start = xTaskGetTickCount();
+    const TickType_t ticks = pdMS_TO_TICKS(timeoutMs);
+
+    waiter_.store(xTaskGetCurrentTaskHandle(), std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // Повторная проверка после регистрации: команда могла прийти раньше.
+    // Лишнее уведомление (команда уже забрана) дает один холостой виток.
+    bool received = false;
+    while (true) {
+        if (ring_.pop(cmd)) {
+            received = true;
+            break;
+        }
+        const TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= ticks) {
+            break;
+        }
+        ulTaskNotifyTake(pdTRUE, ticks - elapsed);
+    }
+
+    waiter_.store(nullptr, std::memory_order_relaxed);
+    return received;
+}
+
+bool CommandQueue::hasCommands() const {
+    return getCount() > 0;
 }
 
 size_t CommandQueue::getCount() const {
+    if (backend_ == Backend::Spsc) {
+        return ring_.isValid() ? ring_.size() : 0;
+    }
     if (queue_ == nullptr) {
         return 0;
     }
@@ -48,8 +127,14 @@ size_t CommandQueue::getCount() const {
 }
 
 void CommandQueue::clear() {
+    if (backend_ == Backend::Spsc) {
+        if (ring_.isValid()) {
+            ring_.clear();
+        }
+        return;
+    }
     if (queue_ == nullptr) {
         return;
     }
     xQueueReset(queue_);
-}
\ No newline at end of file
+}
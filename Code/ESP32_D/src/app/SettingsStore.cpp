@@ -0,0 +1,201 @@
+#include "app/SettingsStore.h"
+
+namespace {
+
+constexpr const char* kNamespace = "stim";
+constexpr const char* kKey = "settings";
+
+constexpr uint16_t kMagic = 0x5354;   // "ST"
+constexpr uint8_t  kVersion = 1;      // менять при любом изменении StoredSettings
+
+// Образ во флеше: заголовок + данные + контрольная сумма
+struct SettingsBlob {
+    uint16_t       magic;
+    uint8_t        version;
+    uint8_t        reserved;
+    StoredSettings data;
+    uint32_t       checksum;
+};
+
+// FNV-1a по всем байтам до checksum
+uint32_t blobChecksum(const SettingsBlob& blob) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&blob);
+    uint32_t hash = 2166136261UL;
+    for (size_t i = 0; i < offsetof(SettingsBlob, checksum); ++i) {
+        hash ^= bytes[i];
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+} // namespace
+
+bool StoredSettings::operator==(const StoredSettings& other) const {
+    if (channelMask != other.channelMask ||
+        app.params != other.app.params ||
+        !(app.encoderA == other.app.encoderA) ||
+        !(app.encoderB == other.app.encoderB)) {
+        return false;
+    }
+    for (uint8_t i = 0; i < kChannels; ++i) {
+        if (channels[i] != other.channels[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+SettingsStore::SettingsStore()
+    : forceCommit_(false)
+{
+}
+
+bool SettingsStore::begin() {
+    if (!prefs_.begin(kNamespace, false)) {
+        Serial.println("[Settings] ERROR: NVS open failed");
+        return false;
+    }
+    opened_ = true;
+
+    // Одно чтение blob'а целиком; любая несостыковка - значения по умолчанию
+    SettingsBlob blob;
+    const size_t read = prefs_.getBytes(kKey, &blob, sizeof(blob));
+    if (read == 0) {
+        Serial.println("[Settings] No saved settings, using defaults");
+        return false;
+    }
+    if (read != sizeof(blob) || blob.magic != kMagic || blob.version != kVersion ||
+        blob.checksum != blobChecksum(blob)) {
+        Serial.println("[Settings] WARN: Saved settings invalid, using defaults");
+        return false;
+    }
+
+    lastWritten_ = blob.data;
+    portENTER_CRITICAL(&writeMux_);
+    pending_.store(blob.data);
+    portEXIT_CRITICAL(&writeMux_);
+
+    // Восстановленное уже во флеше - писать нечего
+    committedVersion_ = pending_.version();
+    restored_ = true;
+    return true;
+}
+
+bool SettingsStore::startWriter(UBaseType_t priority, BaseType_t core) {
+    if (!opened_) {
+        Serial.println("[Settings] ERROR: begin() first");
+        return false;
+    }
+    const BaseType_t result = xTaskCreatePinnedToCore(
+        writerThunk, "Settings_Task", 3072, this, priority, &writerTask_, core);
+    if (result != pdPASS) {
+        Serial.println("[Settings] ERROR: Failed to create writer task!");
+        writerTask_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void SettingsStore::watch(AppState& state, uint32_t fields, Capture capture) {
+    source_ = &state;
+    sourceFields_ = fields;
+    capture_ = capture;
+}
+
+void SettingsStore::save(const StoredSettings& settings) {
+    portENTER_CRITICAL(&writeMux_);
+    pending_.store(settings);
+    portEXIT_CRITICAL(&writeMux_);
+}
+
+void SettingsStore::commitNow() {
+    forceCommit_.store(true, std::memory_order_release);
+    if (writerTask_ != nullptr) {
+        xTaskNotifyGive(writerTask_);
+    }
+}
+
+bool SettingsStore::commit(bool force) {
+    if (!opened_ || !isDirty()) {
+        return false;
+    }
+
+    const uint32_t now = millis();
+    if (!force && !intervalElapsed(now)) {
+        return false;
+    }
+
+    const uint32_t version = pending_.version();
+    const StoredSettings settings = pending_.load();
+
+    // Ручку покрутили и вернули - флеш не трогаем
+    if (settings == lastWritten_) {
+        committedVersion_ = version;
+        skipped_++;
+        return false;
+    }
+
+    // Value-init обнуляет и выравнивание: контрольная сумма детерминирована
+    SettingsBlob blob = SettingsBlob();
+    blob.magic = kMagic;
+    blob.version = kVersion;
+    blob.data = settings;
+    blob.checksum = blobChecksum(blob);
+
+    // При ошибке версия не отмечается записанной - повтор на следующем пробуждении
+    if (prefs_.putBytes(kKey, &blob, sizeof(blob)) != sizeof(blob)) {
+        Serial.println("[Settings] ERROR: NVS write failed");
+        return false;
+    }
+
+    committedVersion_ = version;
+    lastWritten_ = settings;
+    lastCommitMs_ = now;
+    everCommitted_ = true;
+    commits_++;
+    return true;
+}
+
+bool SettingsStore::intervalElapsed(uint32_t nowMs) const {
+    return !everCommitted_ || (nowMs - lastCommitMs_ >= kMinCommitIntervalMs);
+}
+
+void SettingsStore::writerThunk(void* arg) {
+    static_cast<SettingsStore*>(arg)->writerLoop();
+}
+
+void SettingsStore::writerLoop() {
+    int8_t subscriber = -1;
+    if (source_ != nullptr && capture_ != nullptr) {
+        subscriber = source_->subscribe(xTaskGetCurrentTaskHandle(), sourceFields_);
+        // Что успело измениться до подписки
+        save(capture_());
+    }
+
+    while (true) {
+        // С подпиской чистое хранилище спит до изменения полей,
+        // иначе - просыпаемся раз в интервал или по commitNow()
+        const TickType_t wait = (subscriber >= 0 && !isDirty())
+                                    ? portMAX_DELAY
+                                    : pdMS_TO_TICKS(kMinCommitIntervalMs);
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        if (subscriber >= 0 && source_->takeChanges(subscriber) != 0) {
+            save(capture_());
+        }
+
+        const bool force = forceCommit_.exchange(false, std::memory_order_acq_rel);
+        if (!isDirty() || (!force && !intervalElapsed(millis()))) {
+            continue;
+        }
+
+        // Запись флеша останавливает кэш обоих ядер - ждем окна
+        const uint32_t waitStart = millis();
+        while (writeGate_ != nullptr && !writeGate_() &&
+               millis() - waitStart < kGateTimeoutMs) {
+            vTaskDelay(1);
+        }
+
+        commit(force);
+    }
+}
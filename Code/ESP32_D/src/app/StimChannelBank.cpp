@@ -0,0 +1,198 @@
+#include "app/StimChannelBank.h"
+
+int8_t StimChannelBank::addChannel(EMSPulseGenerator& generator) {
+    if (count_ >= kMaxChannels) {
+        Serial.println("[Bank] ERROR: No free channel slots!");
+        return -1;
+    }
+
+    generator.setDriveMode(EMSPulseGenerator::DriveMode::External);
+    channels_[count_] = &generator;
+    return count_++;
+}
+
+bool StimChannelBank::begin() {
+    for (uint8_t i = 0; i < count_; ++i) {
+        if (!channels_[i]->begin()) {
+            Serial.printf("[Bank] ERROR: Channel %d init failed!\n", i);
+            return false;
+        }
+    }
+
+    if (wakeMode_ == WakeMode::Timer && timer_ == nullptr) {
+        esp_timer_create_args_t args = {};
+        args.callback = &StimChannelBank::timerThunk;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "stim_bank";
+
+        if (esp_timer_create(&args, &timer_) != ESP_OK) {
+            Serial.println("[Bank] ERROR: Failed to create timer!");
+            timer_ = nullptr;
+            return false;
+        }
+    }
+
+    Serial.printf("[Bank] Initialized: %d channels, wake mode: %s\n", count_,
+                  (wakeMode_ == WakeMode::Timer) ? "timer" : "polling");
+    return true;
+}
+
+void StimChannelBank::start(uint8_t channel) {
+    if (channel >= count_) {
+        return;
+    }
+
+    channels_[channel]->start();
+
+    portENTER_CRITICAL(&mux_);
+    schedule_.schedule(channel, channels_[channel]->getNextEdgeTs());
+    armTimerLocked();
+    portEXIT_CRITICAL(&mux_);
+}
+
+void StimChannelBank::stop(uint8_t channel) {
+    if (channel >= count_) {
+        return;
+    }
+
+    portENTER_CRITICAL(&mux_);
+    schedule_.cancel(channel);
+    armTimerLocked();
+    portEXIT_CRITICAL(&mux_);
+
+    channels_[channel]->stop();
+}
+
+void StimChannelBank::startAll() {
+    for (uint8_t i = 0; i < count_; ++i) {
+        start(i);
+    }
+}
+
+void StimChannelBank::stopAll() {
+    for (uint8_t i = 0; i < count_; ++i) {
+        stop(i);
+    }
+}
+
+void StimChannelBank::setParams(uint8_t channel, uint8_t amplitudePercent) {
+    if (channel < count_) {
+        channels_[channel]->setParams(amplitudePercent);
+    }
+}
+
+void StimChannelBank::rampTo(uint8_t channel, uint8_t amplitudePercent, uint32_t rampMs) {
+    if (channel < count_) {
+        channels_[channel]->rampTo(amplitudePercent, rampMs);
+    }
+}
+
+void StimChannelBank::update() {
+    if (wakeMode_ != WakeMode::Polling) {
+        return;
+    }
+
+    portENTER_CRITICAL(&mux_);
+    const uint32_t carriers = serviceDueLocked(esp_timer_get_time());
+    portEXIT_CRITICAL(&mux_);
+
+    applyCarriers(carriers);
+}
+
+uint32_t StimChannelBank::getTimeToNextEdgeUs() const {
+    portENTER_CRITICAL(&mux_);
+    const uint32_t result = timeToNextEdgeLocked();
+    portEXIT_CRITICAL(&mux_);
+    return result;
+}
+
+uint32_t StimChannelBank::timeToNextEdgeLocked() const {
+    if (schedule_.empty()) {
+        return UINT32_MAX;
+    }
+    const int64_t delta = (int64_t)(schedule_.topDueUs() - (uint64_t)esp_timer_get_time());
+    return (delta <= 0) ? 0 : (delta >= UINT32_MAX) ? UINT32_MAX - 1 : (uint32_t)delta;
+}
+
+EdgeErrorStats::Snapshot StimChannelBank::getEdgeStats(uint8_t channel) const {
+    if (channel >= count_) {
+        return EdgeErrorStats::Snapshot{0, 0, 0, 0, 0};
+    }
+    return channels_[channel]->getEdgeStats();
+}
+
+uint32_t StimChannelBank::serviceDueLocked(uint64_t now) {
+    // Ограничение на случай долгого простоя: за один вызов не более
+    // нескольких фронтов на канал, остальное догоним следующим проходом
+    uint16_t budget = 4 * count_;
+    uint32_t carriers = 0;
+
+    while (!schedule_.empty() && budget-- > 0) {
+        if (EdgeScheduler<kMaxChannels>::earlier(now, schedule_.topDueUs())) {
+            break;
+        }
+
+        const uint8_t channel = schedule_.topChannel();
+        EMSPulseGenerator* generator = channels_[channel];
+        if (!generator->isRunning()) {
+            schedule_.cancel(channel);
+            continue;
+        }
+
+        bool carrierPending = false;
+        schedule_.schedule(channel, generator->serviceEdge(carrierPending));
+        if (carrierPending) {
+            carriers |= 1UL << channel;
+        }
+        edgeCount_++;
+    }
+    return carriers;
+}
+
+void StimChannelBank::applyCarriers(uint32_t mask) {
+    for (uint8_t i = 0; i < count_ && mask != 0; ++i) {
+        if (mask & (1UL << i)) {
+            mask &= ~(1UL << i);
+            channels_[i]->applyPendingCarrier();
+        }
+    }
+}
+
+void StimChannelBank::armTimerLocked() {
+    if (wakeMode_ != WakeMode::Timer || timer_ == nullptr) {
+        return;
+    }
+
+    // Куча и таймер меняются под одним mux_: взвод из колбэка не может
+    // посчитать задержку по куче, которую задача уже поменяла, и наоборот.
+    // INVALID_STATE у stop - таймер и так не взведен
+    const esp_err_t stopErr = esp_timer_stop(timer_);
+    if (stopErr != ESP_OK && stopErr != ESP_ERR_INVALID_STATE) {
+        armFailures_++;
+    }
+
+    const uint32_t delayUs = timeToNextEdgeLocked();
+    if (delayUs != UINT32_MAX &&
+        esp_timer_start_once(timer_, (delayUs > 0) ? delayUs : 1) != ESP_OK) {
+        armFailures_++;
+    }
+}
+
+void StimChannelBank::timerThunk(void* arg) {
+    StimChannelBank* self = static_cast<StimChannelBank*>(arg);
+    IsrScope scope(self->isrProfile_);
+    self->onTimer();
+}
+
+void StimChannelBank::onTimer() {
+    // Один таймер на весь банк - перевзводим на ближайший фронт любого канала.
+    // Колбэк мог уже стоять в очереди задачи esp_timer, когда start()/stop()
+    // перевзвели таймер: тогда фронтов к сроку нет, а взвод лишь повторится
+    portENTER_CRITICAL(&mux_);
+    const uint32_t carriers = serviceDueLocked(esp_timer_get_time());
+    armTimerLocked();
+    portEXIT_CRITICAL(&mux_);
+
+    applyCarriers(carriers);
+}
@@ -0,0 +1,133 @@
+#include "app/StimCommandBus.h"
+
+StimCommandBus::StimCommandBus()
+    : emergency_(false)
+    , control_(kControlQueueSize, CommandQueue::Backend::Spsc)
+    , programReady_(false)
+    , programSize_(0)
+    , waiter_(nullptr)
+{
+}
+
+bool StimCommandBus::send(const Command& cmd, uint32_t timeoutMs) {
+    switch (cmd.type) {
+        case CommandType::EMERGENCY_STOP:
+            emergencyStop();
+            return true;
+
+        case CommandType::UPDATE_STIM_1_PARAMS:
+            Serial.println("[CommandBus] ERROR: params go through publishPlan()");
+            return false;
+
+        default:
+            break;
+    }
+
+    if (!control_.send(cmd, timeoutMs)) {
+        return false;
+    }
+    TRACE_INSTANT("cmd_send", cmd.type);
+    wakeReader();
+    return true;
+}
+
+void StimCommandBus::emergencyStop() {
+    TRACE_INSTANT("cmd_send", CommandType::EMERGENCY_STOP);
+    emergency_.store(true, std::memory_order_release);
+    wakeReader();
+}
+
+bool StimCommandBus::sendProgram(const uint8_t* code, size_t size) {
+    if (size > kProgramCapacity) {
+        Serial.printf("[CommandBus] ERROR: program too long (%u bytes)\n", (unsigned)size);
+        return false;
+    }
+    if (programReady_.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    if (size > 0) {
+        memcpy(program_, code, size);
+    }
+    programSize_ = size;
+    programReady_.store(true, std::memory_order_release);
+    TRACE_INSTANT("cmd_send_program", size);
+    wakeReader();
+    return true;
+}
+
+void StimCommandBus::wakeReader() {
+    // Пара с fence в wait(): публикация видна до чтения waiter_
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    TaskHandle_t waiter = waiter_.load(std::memory_order_relaxed);
+    if (waiter != nullptr) {
+        xTaskNotifyGive(waiter);
+    }
+}
+
+bool StimCommandBus::wait(uint32_t timeoutMs) {
+    if (hasPending() || timeoutMs == 0) {
+        return hasPending();
+    }
+
+    const TickType_t start = xTaskGetTickCount();
+    const TickType_t ticks = pdMS_TO_TICKS(timeoutMs);
+
+    waiter_.store(xTaskGetCurrentTaskHandle(), std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    bool pending = false;
+    while (true) {
+        if (hasPending()) {
+            pending = true;
+            break;
+        }
+        const TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= ticks) {
+            break;
+        }
+        ulTaskNotifyTake(pdTRUE, ticks - elapsed);
+    }
+
+    waiter_.store(nullptr, std::memory_order_relaxed);
+    return pending;
+}
+
+bool StimCommandBus::takeEmergencyStop() {
+    if (!emergency_.exchange(false, std::memory_order_acq_rel)) {
+        return false;
+    }
+
+    // Все, что стояло в очереди до остановки, устарело
+    control_.clear();
+    TRACE_INSTANT("cmd_recv", CommandType::EMERGENCY_STOP);
+    return true;
+}
+
+bool StimCommandBus::receiveControl(Command& cmd) {
+    if (!control_.receive(cmd, 0)) {
+        return false;
+    }
+    TRACE_INSTANT("cmd_recv", cmd.type);
+    return true;
+}
+
+bool StimCommandBus::takeProgram(uint8_t* out, size_t& size) {
+    if (!programReady_.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    size = programSize_;
+    if (size > 0) {
+        memcpy(out, program_, size);
+    }
+    // Ячейка свободна только после копии: писатель ее не перезапишет
+    programReady_.store(false, std::memory_order_release);
+    TRACE_INSTANT("cmd_recv_program", size);
+    return true;
+}
+
+bool StimCommandBus::hasPending() const {
+    return emergency_.load(std::memory_order_acquire) || control_.hasCommands() ||
+           programReady_.load(std::memory_order_acquire);
+}
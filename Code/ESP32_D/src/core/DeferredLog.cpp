@@ -0,0 +1,229 @@
+#include "core/DeferredLog.h"
+
+#include <stdio.h>
+
+DeferredLog::CoreRing DeferredLog::rings_[DeferredLog::kCores];
+TaskHandle_t DeferredLog::drainTask_ = nullptr;
+
+bool IRAM_ATTR DeferredLog::push(LogRecord& record) {
+    // Задача могла переехать на другое ядро после чтения - не страшно:
+    // писателей у кольца может быть сколько угодно, чужое лишь менее "свое"
+    const uint8_t core = (uint8_t)xPortGetCoreID();
+    CoreRing& target = rings_[core < kCores ? core : 0];
+    record.core = core;
+
+    if (!target.ring.isValid()) {
+        target.dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    const bool ok = target.ring.push(record);
+    if (ok) {
+        target.written.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        target.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    return ok;
+}
+
+bool DeferredLog::startDrain(UBaseType_t priority, BaseType_t core) {
+    if (drainTask_ != nullptr) {
+        return true;
+    }
+    if (xTaskCreatePinnedToCore(&DeferredLog::drainTask, "Log_Drain", 4096, nullptr,
+                                priority, &drainTask_, core) != pdPASS) {
+        Serial.println("[Log] ERROR: Failed to create drain task!");
+        drainTask_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void DeferredLog::drainTask(void* arg) {
+    (void)arg;
+    uint32_t reportedDrops = 0;
+    while (true) {
+        drain();
+
+        const uint32_t dropped = getDropped();
+        if (dropped != reportedDrops) {
+            Serial.printf("[Log] WARN: %lu records dropped (ring full)\n",
+                          (unsigned long)(dropped - reportedDrops));
+            reportedDrops = dropped;
+        }
+        vTaskDelay(pdMS_TO_TICKS(kDrainPeriodMs));
+    }
+}
+
+size_t DeferredLog::drain() {
+    LogRecord batch[kCores][kDrainBatch];
+    size_t count[kCores];
+    size_t total = 0;
+
+    while (true) {
+        size_t taken = 0;
+        for (uint8_t core = 0; core < kCores; ++core) {
+            count[core] = rings_[core].ring.isValid()
+                ? rings_[core].ring.popBatch(batch[core], kDrainBatch)
+                : 0;
+            taken += count[core];
+        }
+        if (taken == 0) {
+            return total;
+        }
+
+        // Слияние пачек ядер по времени (внутри кольца порядок уже верный)
+        size_t pos[kCores] = {};
+        for (size_t n = 0; n < taken; ++n) {
+            int8_t next = -1;
+            for (uint8_t core = 0; core < kCores; ++core) {
+                if (pos[core] >= count[core]) {
+                    continue;
+                }
+                if (next < 0 ||
+                    (int32_t)(batch[core][pos[core]].timestampUs -
+                              batch[next][pos[next]].timestampUs) < 0) {
+                    next = (int8_t)core;
+                }
+            }
+            emit(batch[next][pos[next]++]);
+        }
+        total += taken;
+    }
+}
+
+void DeferredLog::emit(const LogRecord& record) {
+    char line[kLineLength];
+    const uint32_t us = record.timestampUs;
+    int prefix = snprintf(line, sizeof(line), "[%5lu.%03lu C%u] ",
+                          (unsigned long)(us / 1000000UL),
+                          (unsigned long)((us / 1000UL) % 1000UL), record.core);
+    if (prefix < 0) {
+        prefix = 0;
+    }
+    format(record, line + prefix, sizeof(line) - (size_t)prefix);
+    Serial.print(line);
+}
+
+uint32_t DeferredLog::getDropped() {
+    uint32_t dropped = 0;
+    for (uint8_t core = 0; core < kCores; ++core) {
+        dropped += getDropped(core);
+    }
+    return dropped;
+}
+
+uint32_t DeferredLog::getDropped(uint8_t core) {
+    return (core < kCores) ? rings_[core].dropped.load(std::memory_order_relaxed) : 0;
+}
+
+uint32_t DeferredLog::getWritten() {
+    uint32_t written = 0;
+    for (uint8_t core = 0; core < kCores; ++core) {
+        written += rings_[core].written.load(std::memory_order_relaxed);
+    }
+    return written;
+}
+
+// Форматирование по одному спецификатору: каждый аргумент уходит в snprintf
+// своего настоящего типа, размер слова и модификатор длины сводятся здесь
+size_t DeferredLog::format(const LogRecord& record, char* out, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+
+    size_t len = 0;
+    uint8_t arg = 0;
+    const char* p = record.format;
+
+    auto append = [&](int written) {
+        if (written > 0) {
+            len += (size_t)written;
+            if (len >= size) {
+                len = size - 1;
+            }
+        }
+    };
+
+    while (*p != '\0' && len < size - 1) {
+        if (*p != '%') {
+            out[len++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[len++] = '%';
+            p += 2;
+            continue;
+        }
+
+        // Спецификатор целиком: флаги, ширина, точность, длина, преобразование
+        char spec[16];
+        size_t specLen = 0;
+        bool isLong = false;
+        spec[specLen++] = *p++;
+        while (*p != '\0' && strchr("-+ #0123456789.", *p) != nullptr && specLen < sizeof(spec) - 4) {
+            spec[specLen++] = *p++;
+        }
+        while (*p == 'l' || *p == 'h' || *p == 'z') {
+            isLong = isLong || (*p == 'l') || (*p == 'z');
+            p++;
+        }
+        const char conv = *p;
+        if (conv == '\0') {
+            break;
+        }
+        p++;
+
+        if (arg >= record.argCount) {
+            append(snprintf(out + len, size - len, "<?>"));
+            continue;
+        }
+        const uintptr_t word = record.args[arg];
+        const uint8_t type = (uint8_t)((record.argTypes >> (2 * arg)) & 0x3);
+        arg++;
+
+        const bool isSigned = (conv == 'd' || conv == 'i');
+        const bool isFloat = (conv == 'f' || conv == 'F' || conv == 'e' || conv == 'E' ||
+                              conv == 'g' || conv == 'G');
+
+        if (conv == 's') {
+            spec[specLen++] = 's';
+            spec[specLen] = '\0';
+            const char* text = (type == LogRecord::kArgString) ? (const char*)word : "<?>";
+            append(snprintf(out + len, size - len, spec, text != nullptr ? text : "(null)"));
+        } else if (conv == 'p') {
+            spec[specLen++] = 'p';
+            spec[specLen] = '\0';
+            append(snprintf(out + len, size - len, spec, (const void*)word));
+        } else if (isFloat) {
+            float f = 0.0f;
+            if (type == LogRecord::kArgFloat) {
+                const uint32_t bits = (uint32_t)word;
+                memcpy(&f, &bits, sizeof(f));
+            } else {
+                f = isSigned ? (float)(int32_t)word : (float)(uint32_t)word;
+            }
+            spec[specLen++] = conv;
+            spec[specLen] = '\0';
+            append(snprintf(out + len, size - len, spec, (double)f));
+        } else {
+            // Целое: 32 бита; "l" передаем как long - на хосте он шире
+            if (isLong) {
+                spec[specLen++] = 'l';
+            }
+            spec[specLen++] = conv;
+            spec[specLen] = '\0';
+            const int32_t value = (type == LogRecord::kArgFloat) ? 0 : (int32_t)word;
+            if (isLong) {
+                append(isSigned ? snprintf(out + len, size - len, spec, (long)value)
+                                : snprintf(out + len, size - len, spec, (unsigned long)(uint32_t)value));
+            } else {
+                append(isSigned ? snprintf(out + len, size - len, spec, (int)value)
+                                : snprintf(out + len, size - len, spec, (unsigned int)(uint32_t)value));
+            }
+        }
+    }
+
+    out[len] = '\0';
+    return len;
+}
@@ -0,0 +1,38 @@
+#include "core/EncoderEvents.h"
+
+int32_t EncoderEvents::drain() {
+    EncoderEvent batch[kDrainBatch];
+    int32_t steps = 0;
+    uint32_t now = micros();
+
+    size_t count;
+    do {
+        count = ring_.popBatch(batch, kDrainBatch);
+        // Время берем после выборки: события пачки точно не "из будущего"
+        now = micros();
+        for (size_t i = 0; i < count; ++i) {
+            const EncoderEvent& e = batch[i];
+            steps += e.step;
+            latency_.record((int32_t)(now - e.timestampUs));
+
+            // Мгновенная скорость по интервалу между щелчками, сглаживание 1/4
+            if (haveLastEvent_ && e.timestampUs != lastEventUs_ &&
+                e.timestampUs - lastEventUs_ < kVelocityTimeoutUs) {
+                const int32_t instant = (int32_t)(1000000L / (int32_t)(e.timestampUs - lastEventUs_)) * e.step;
+                velocity_ += (instant - velocity_) / 4;
+            } else {
+                velocity_ = 0;
+            }
+            lastEventUs_ = e.timestampUs;
+            haveLastEvent_ = true;
+        }
+    } while (count == kDrainBatch);
+
+    steps += overflowSteps_.exchange(0, std::memory_order_relaxed);
+
+    if (haveLastEvent_ && now - lastEventUs_ >= kVelocityTimeoutUs) {
+        velocity_ = 0;
+    }
+
+    return steps;
+}
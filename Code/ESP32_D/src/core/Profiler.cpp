@@ -0,0 +1,311 @@
+#include "core/Profiler.h"
+
+#include <string.h>
+#include <algorithm>
+#include <esp_timer.h>
+#include <esp_freertos_hooks.h>
+
+#if (configUSE_TRACE_FACILITY == 1) && (configGENERATE_RUN_TIME_STATS == 1)
+#define PROFILER_RUN_TIME_STATS 1
+#else
+#define PROFILER_RUN_TIME_STATS 0
+#endif
+
+#ifdef configRUN_TIME_COUNTER_TYPE
+typedef configRUN_TIME_COUNTER_TYPE RunTimeCounter;
+#else
+typedef uint32_t RunTimeCounter;
+#endif
+
+Profiler* Profiler::instance_ = nullptr;
+
+#if PROFILER_RUN_TIME_STATS
+// Снимок всех задач: ~40 байт на задачу, не на стеке вызывающего
+static TaskStatus_t s_systemState[Profiler::kMaxSystemTasks];
+#endif
+
+static float percentOf(uint32_t part, uint32_t whole) {
+    if (whole == 0) {
+        return 0.0f;
+    }
+    const float percent = (float)part * 100.0f / (float)whole;
+    return (percent > 100.0f) ? 100.0f : percent;
+}
+
+Profiler::Source Profiler::getSource() {
+    return PROFILER_RUN_TIME_STATS ? Source::RunTimeStats : Source::TickSampling;
+}
+
+const char* Profiler::sourceName(Source source) {
+    return (source == Source::RunTimeStats) ? "run-time stats" : "tick sampling";
+}
+
+bool Profiler::begin() {
+    if (instance_ != nullptr && instance_ != this) {
+        Serial.println("[Profiler] ERROR: Only one profiler is supported");
+        return false;
+    }
+    if (started_) {
+        return true;
+    }
+
+    for (uint8_t core = 0; core < kCores; ++core) {
+        idleTask_[core] = xTaskGetIdleTaskHandleForCPU(core);
+    }
+    cpuMHz_ = ESP.getCpuFreqMHz();
+    instance_ = this;
+
+#if !PROFILER_RUN_TIME_STATS
+    void (*const hooks[2])() = {&Profiler::tickHook0, &Profiler::tickHook1};
+    for (uint8_t core = 0; core < kCores && core < 2; ++core) {
+        if (esp_register_freertos_tick_hook_for_cpu(hooks[core], core) != ESP_OK) {
+            Serial.printf("[Profiler] ERROR: Tick hook on core %u failed!\n", core);
+            instance_ = nullptr;
+            return false;
+        }
+    }
+#endif
+
+    resetWindow();
+    started_ = true;
+    Serial.printf("[Profiler] Started, source: %s\n", sourceName(getSource()));
+    return true;
+}
+
+bool Profiler::addTask(TaskHandle_t task) {
+    if (task == nullptr || taskCount_ >= kMaxTasks) {
+        Serial.println("[Profiler] ERROR: Cannot add task");
+        return false;
+    }
+
+    TaskSlot& slot = tasks_[taskCount_];
+    slot.handle = task;
+    slot.lastRunTime = 0;
+    slot.primed = false;
+    for (uint8_t core = 0; core < kCores; ++core) {
+        taskTicks_[core][taskCount_] = 0;
+        slot.lastTicks[core] = 0;
+    }
+    // Хук тика видит задачу только после записи слота
+    taskCount_ = taskCount_ + 1;
+    return true;
+}
+
+bool Profiler::addIsr(IsrProfile& profile) {
+    if (isrCount_ >= kMaxIsrs) {
+        Serial.println("[Profiler] ERROR: Cannot add ISR profile");
+        return false;
+    }
+
+    const IsrProfile::Totals totals = profile.takeTotals();
+    IsrSlot& slot = isrs_[isrCount_++];
+    slot.profile = &profile;
+    slot.lastCount = totals.count;
+    slot.lastCycles = totals.cycles;
+    return true;
+}
+
+void Profiler::resetWindow() {
+    windowStartUs_ = esp_timer_get_time();
+
+    Snapshot scratch;
+#if PROFILER_RUN_TIME_STATS
+    readRunTimeStats(scratch);
+#else
+    readTickSamples(scratch);
+#endif
+    readIsrs(scratch, 0);
+}
+
+bool Profiler::takeSnapshot(Snapshot& out) {
+    if (!started_) {
+        Serial.println("[Profiler] ERROR: Not started");
+        return false;
+    }
+
+    const uint64_t now = esp_timer_get_time();
+    memset(&out, 0, sizeof(out));
+    out.source = getSource();
+    out.windowUs = (uint32_t)(now - windowStartUs_);
+    windowStartUs_ = now;
+
+    bool ok = true;
+#if PROFILER_RUN_TIME_STATS
+    ok = readRunTimeStats(out);
+#else
+    readTickSamples(out);
+#endif
+    readIsrs(out, out.windowUs);
+    return ok;
+}
+
+bool Profiler::readRunTimeStats(Snapshot& out) {
+#if PROFILER_RUN_TIME_STATS
+    RunTimeCounter totalRunTime = 0;
+    const UBaseType_t n = uxTaskGetSystemState(s_systemState, kMaxSystemTasks, &totalRunTime);
+    if (n == 0) {
+        Serial.println("[Profiler] ERROR: More tasks than kMaxSystemTasks");
+        return false;
+    }
+
+    // Счетчики - время одного ядра (esp_timer или CCOUNT): доля задачи -
+    // ее прирост к приросту общего счетчика; переполнение uint32 безвредно
+    const uint32_t total = (uint32_t)totalRunTime - lastTotalRunTime_;
+    lastTotalRunTime_ = (uint32_t)totalRunTime;
+
+    for (uint8_t core = 0; core < kCores; ++core) {
+        for (UBaseType_t i = 0; i < n; ++i) {
+            if (s_systemState[i].xHandle != idleTask_[core]) {
+                continue;
+            }
+            const uint32_t runTime = (uint32_t)s_systemState[i].ulRunTimeCounter;
+            out.coreIdle[core] = percentOf(runTime - lastIdleRunTime_[core], total);
+            lastIdleRunTime_[core] = runTime;
+        }
+        out.coreLoad[core] = 100.0f - out.coreIdle[core];
+    }
+
+    const uint8_t count = taskCount_;
+    for (uint8_t t = 0; t < count; ++t) {
+        TaskSlot& slot = tasks_[t];
+        TaskLoad& load = out.tasks[out.taskCount++];
+        load.handle = slot.handle;
+        strncpy(load.name, pcTaskGetName(slot.handle), sizeof(load.name) - 1);
+        const BaseType_t core = xTaskGetAffinity(slot.handle);
+        load.core = (core == tskNO_AFFINITY) ? -1 : (int8_t)core;
+        load.stackFreeBytes = uxTaskGetStackHighWaterMark(slot.handle) * sizeof(StackType_t);
+
+        for (UBaseType_t i = 0; i < n; ++i) {
+            if (s_systemState[i].xHandle == slot.handle) {
+                // Задача добавлена посреди окна: первое окно - только отметка
+                const uint32_t runTime = (uint32_t)s_systemState[i].ulRunTimeCounter;
+                load.percent = slot.primed ? percentOf(runTime - slot.lastRunTime, total) : 0.0f;
+                slot.lastRunTime = runTime;
+                slot.primed = true;
+                break;
+            }
+        }
+    }
+    return true;
+#else
+    (void)out;
+    return false;
+#endif
+}
+
+void Profiler::readTickSamples(Snapshot& out) {
+    uint32_t ticks[kCores];
+    uint32_t maxTicks = 0;
+    for (uint8_t core = 0; core < kCores; ++core) {
+        // Сначала все тики, потом IDLE: доля простоя не выйдет за 100%
+        const uint32_t nowTicks = ticks_[core];
+        const uint32_t nowIdle = idleTicks_[core];
+        ticks[core] = nowTicks - lastTicks_[core];
+        lastTicks_[core] = nowTicks;
+
+        out.coreIdle[core] = percentOf(nowIdle - lastIdleTicks_[core], ticks[core]);
+        out.coreLoad[core] = (ticks[core] > 0) ? 100.0f - out.coreIdle[core] : 0.0f;
+        lastIdleTicks_[core] = nowIdle;
+        maxTicks = std::max(maxTicks, ticks[core]);
+    }
+
+    const uint8_t count = taskCount_;
+    for (uint8_t t = 0; t < count; ++t) {
+        TaskSlot& slot = tasks_[t];
+        TaskLoad& load = out.tasks[out.taskCount++];
+        load.handle = slot.handle;
+        strncpy(load.name, pcTaskGetName(slot.handle), sizeof(load.name) - 1);
+        const BaseType_t core = xTaskGetAffinity(slot.handle);
+        load.core = (core == tskNO_AFFINITY) ? -1 : (int8_t)core;
+        load.stackFreeBytes = uxTaskGetStackHighWaterMark(slot.handle) * sizeof(StackType_t);
+
+        // Задача без привязки могла побывать на обоих ядрах
+        uint32_t taskTicks = 0;
+        for (uint8_t c = 0; c < kCores; ++c) {
+            const uint32_t now = taskTicks_[c][t];
+            taskTicks += now - slot.lastTicks[c];
+            slot.lastTicks[c] = now;
+        }
+        load.percent = percentOf(taskTicks, maxTicks);
+    }
+}
+
+void Profiler::readIsrs(Snapshot& out, uint32_t windowUs) {
+    const float cyclesPerUs = (float)cpuMHz_;
+
+    for (uint8_t i = 0; i < isrCount_; ++i) {
+        IsrSlot& slot = isrs_[i];
+        const IsrProfile::Totals totals = slot.profile->takeTotals();
+        const LatencyHistogram::Snapshot h = slot.profile->getHistogram().take();
+        const uint32_t count = totals.count - slot.lastCount;
+        const uint64_t cycles = totals.cycles - slot.lastCycles;
+        slot.lastCount = totals.count;
+        slot.lastCycles = totals.cycles;
+
+        IsrLoad& load = out.isrs[out.isrCount++];
+        load.name = slot.profile->getName();
+        load.count = count;
+        load.avgUs = (count > 0) ? (float)cycles / (float)count / cyclesPerUs : 0.0f;
+        load.p50Us = (float)h.p50 / cyclesPerUs;
+        load.p90Us = (float)h.p90 / cyclesPerUs;
+        load.p99Us = (float)h.p99 / cyclesPerUs;
+        load.p999Us = (float)h.p999 / cyclesPerUs;
+        load.maxUs = (float)totals.maxCycles / cyclesPerUs;
+        load.percent = (windowUs > 0)
+            ? (float)cycles * 100.0f / ((float)windowUs * cyclesPerUs)
+            : 0.0f;
+    }
+}
+
+void IRAM_ATTR Profiler::tickHook0() {
+    Profiler* self = instance_;
+    if (self != nullptr) {
+        self->onTick(0);
+    }
+}
+
+void IRAM_ATTR Profiler::tickHook1() {
+    Profiler* self = instance_;
+    if (self != nullptr) {
+        self->onTick(1);
+    }
+}
+
+void IRAM_ATTR Profiler::onTick(uint8_t core) {
+    // Хук тика ядра core: текущая задача - та, что была на нем до тика
+    const TaskHandle_t current = xTaskGetCurrentTaskHandle();
+    ticks_[core] = ticks_[core] + 1;
+
+    if (current == idleTask_[core]) {
+        idleTicks_[core] = idleTicks_[core] + 1;
+        return;
+    }
+    const uint8_t count = taskCount_;
+    for (uint8_t t = 0; t < count; ++t) {
+        if (tasks_[t].handle == current) {
+            taskTicks_[core][t] = taskTicks_[core][t] + 1;
+            return;
+        }
+    }
+}
+
+void Profiler::print(const Snapshot& snapshot) {
+    Serial.printf("║ CPU load (%s, %lu ms window):\n",
+                  sourceName(snapshot.source), (unsigned long)(snapshot.windowUs / 1000));
+    for (uint8_t core = 0; core < kCores; ++core) {
+        Serial.printf("║   Core %u: %5.1f%% busy, %5.1f%% idle\n",
+                      core, snapshot.coreLoad[core], snapshot.coreIdle[core]);
+    }
+    for (uint8_t i = 0; i < snapshot.taskCount; ++i) {
+        const TaskLoad& t = snapshot.tasks[i];
+        Serial.printf("║   %-16s core %2d %5.1f%%  stack free %lu B\n",
+                      t.name, t.core, t.percent, (unsigned long)t.stackFreeBytes);
+    }
+    for (uint8_t i = 0; i < snapshot.isrCount; ++i) {
+        const IsrLoad& r = snapshot.isrs[i];
+        Serial.printf("║   ISR %-12s %7lu calls %5.2f%%  µs avg/p50/p90/p99/p99.9/max: "
+                      "%.2f/%.2f/%.2f/%.2f/%.2f/%.2f\n",
+                      r.name, (unsigned long)r.count, r.percent,
+                      r.avgUs, r.p50Us, r.p90Us, r.p99Us, r.p999Us, r.maxUs);
+    }
+}
@@ -0,0 +1,330 @@
+#include "core/StimProgram.h"
+
+// Предел длительности сегмента: программу исполняет только EMSPulseGenerator,
+// его шкала фронтов 64-битная - предел задает ширина StimInstr::durationUs
+static constexpr uint32_t MAX_SEGMENT_US = UINT32_MAX;
+
+namespace {
+
+class Reader {
+public:
+    Reader(const uint8_t* data, size_t size)
+        : data_(data)
+        , size_(size)
+    {}
+
+    bool u8(uint8_t& v) {
+        if (pos_ + 1 > size_) return false;
+        v = data_[pos_++];
+        return true;
+    }
+
+    bool u16(uint16_t& v) {
+        if (pos_ + 2 > size_) return false;
+        v = (uint16_t)(data_[pos_] | (data_[pos_ + 1] << 8));
+        pos_ += 2;
+        return true;
+    }
+
+    bool u32(uint32_t& v) {
+        if (pos_ + 4 > size_) return false;
+        v = (uint32_t)data_[pos_]
+          | ((uint32_t)data_[pos_ + 1] << 8)
+          | ((uint32_t)data_[pos_ + 2] << 16)
+          | ((uint32_t)data_[pos_ + 3] << 24);
+        pos_ += 4;
+        return true;
+    }
+
+    bool atEnd() const { return pos_ == size_; }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_ = 0;
+};
+
+} // namespace
+
+// ============================================
+// Загрузка
+// ============================================
+
+StimProgramError StimProgram::load(const uint8_t* data, size_t size, uint8_t* errorIndex) {
+    uint8_t index = 0;
+    count_ = 0;
+
+    StimProgramError error = decode(data, size, index);
+    if (error == StimProgramError::None) {
+        error = validate(index);
+    }
+
+    if (error != StimProgramError::None) {
+        count_ = 0;
+        if (errorIndex != nullptr) {
+            *errorIndex = index;
+        }
+    }
+    return error;
+}
+
+StimProgramError StimProgram::decode(const uint8_t* data, size_t size, uint8_t& index) {
+    if (data == nullptr || size < kHeaderSize ||
+        data[0] != kMagic0 || data[1] != kMagic1 || data[2] != kVersion) {
+        return StimProgramError::BadHeader;
+    }
+
+    const uint8_t total = data[3];
+    if (total == 0) {
+        return StimProgramError::BadHeader;
+    }
+    if (total > kMaxInstrs) {
+        return StimProgramError::TooLong;
+    }
+
+    Reader in(data + kHeaderSize, size - kHeaderSize);
+
+    for (index = 0; index < total; ++index) {
+        StimInstr& instr = instrs_[index];
+        instr = StimInstr();
+
+        uint8_t op = 0;
+        if (!in.u8(op)) {
+            return StimProgramError::Truncated;
+        }
+
+        bool ok = true;
+        switch ((StimOp)op) {
+            case StimOp::End:
+                break;
+
+            case StimOp::Burst:
+                ok = in.u16(instr.count) && in.u16(instr.rateHz) && in.u16(instr.widthUs);
+                if (ok && instr.rateHz > 0) {
+                    // Единственное деление - здесь, при загрузке
+                    instr.periodUs = 1000000UL / instr.rateHz;
+                    const uint64_t burstUs = (uint64_t)instr.count * instr.periodUs;
+                    instr.durationUs = (burstUs > MAX_SEGMENT_US) ? 0 : (uint32_t)burstUs;
+                }
+                break;
+
+            case StimOp::Pause: {
+                uint32_t ms = 0;
+                ok = in.u32(ms);
+                const uint64_t pauseUs = (uint64_t)ms * 1000ULL;
+                instr.durationUs = (pauseUs > MAX_SEGMENT_US) ? 0 : (uint32_t)pauseUs;
+                if (ok && ms > 0 && instr.durationUs == 0) {
+                    return StimProgramError::TooLong;
+                }
+                break;
+            }
+
+            case StimOp::Ramp: {
+                uint32_t ms = 0;
+                ok = in.u8(instr.amplitude) && in.u32(ms);
+                instr.durationUs = (ms > MAX_SEGMENT_US / 1000UL) ? MAX_SEGMENT_US : ms * 1000UL;
+                break;
+            }
+
+            case StimOp::Loop:
+                ok = in.u16(instr.count) && in.u8(instr.target);
+                break;
+
+            case StimOp::Jump:
+                ok = in.u8(instr.target);
+                break;
+
+            default:
+                return StimProgramError::BadOpcode;
+        }
+
+        if (!ok) {
+            return StimProgramError::Truncated;
+        }
+        instr.op = (StimOp)op;
+        count_ = index + 1;
+    }
+
+    if (!in.atEnd()) {
+        return StimProgramError::TrailingBytes;
+    }
+    return StimProgramError::None;
+}
+
+StimProgramError StimProgram::validate(uint8_t& index) const {
+    for (index = 0; index < count_; ++index) {
+        const StimInstr& instr = instrs_[index];
+
+        switch (instr.op) {
+            case StimOp::Burst:
+                if (instr.count == 0 || instr.rateHz == 0 || instr.widthUs == 0 ||
+                    instr.widthUs >= instr.periodUs || instr.durationUs == 0) {
+                    return StimProgramError::BadBurst;
+                }
+                break;
+
+            case StimOp::Ramp:
+                if (instr.amplitude > 100) {
+                    return StimProgramError::BadAmplitude;
+                }
+                break;
+
+            case StimOp::Loop:
+            case StimOp::Jump:
+                if (instr.target >= count_) {
+                    return StimProgramError::BadTarget;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    // Диапазон индексов между целью и переходом ничего не говорит о том, что
+    // реально выполняется ([JUMP 2][BURST][JUMP 0] обходит BURST). Поэтому
+    // ищем по графу переходов достижимый цикл из одних команд без времени
+    if (count_ == 0) {
+        return StimProgramError::None;
+    }
+    bool reachable[kMaxInstrs] = {};
+    uint8_t stack[kMaxInstrs];
+    uint8_t depth = 0;
+    reachable[0] = true;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        uint8_t next[2];
+        const uint8_t n = successors(stack[--depth], next);
+        for (uint8_t k = 0; k < n; ++k) {
+            if (!reachable[next[k]]) {
+                reachable[next[k]] = true;
+                stack[depth++] = next[k];
+            }
+        }
+    }
+
+    uint8_t color[kMaxInstrs] = {};
+    for (uint8_t i = 0; i < count_; ++i) {
+        if (reachable[i] && color[i] == 0 && !isTimed(i) && untimedCycleFrom(i, color, index)) {
+            return StimProgramError::EmptyLoop;
+        }
+    }
+    return StimProgramError::None;
+}
+
+bool StimProgram::isTimed(uint8_t i) const {
+    const StimInstr& instr = instrs_[i];
+    return instr.op == StimOp::Burst || (instr.op == StimOp::Pause && instr.durationUs > 0);
+}
+
+uint8_t StimProgram::successors(uint8_t i, uint8_t* out) const {
+    // Выход за конец - END, у END преемников нет; LOOP идет по обоим путям
+    const StimInstr& instr = instrs_[i];
+    uint8_t n = 0;
+    if (instr.op == StimOp::End) {
+        return 0;
+    }
+    if (instr.op == StimOp::Loop || instr.op == StimOp::Jump) {
+        out[n++] = instr.target;
+    }
+    if (instr.op != StimOp::Jump && i + 1 < count_) {
+        out[n++] = (uint8_t)(i + 1);
+    }
+    return n;
+}
+
+bool StimProgram::untimedCycleFrom(uint8_t i, uint8_t* color, uint8_t& at) const {
+    // Поиск в глубину по командам без времени: 1 - на пути, 2 - проверена.
+    // Глубина не больше kMaxInstrs
+    color[i] = 1;
+    uint8_t next[2];
+    const uint8_t n = successors(i, next);
+    for (uint8_t k = 0; k < n; ++k) {
+        const uint8_t j = next[k];
+        if (isTimed(j)) {
+            continue;
+        }
+        if (color[j] == 1) {
+            at = i;     // обратный переход, замыкающий цикл
+            return true;
+        }
+        if (color[j] == 0 && untimedCycleFrom(j, color, at)) {
+            return true;
+        }
+    }
+    color[i] = 2;
+    return false;
+}
+
+const char* StimProgram::errorName(StimProgramError error) {
+    switch (error) {
+        case StimProgramError::None:          return "ok";
+        case StimProgramError::BadHeader:     return "bad header";
+        case StimProgramError::Truncated:     return "truncated";
+        case StimProgramError::TooLong:       return "too long";
+        case StimProgramError::BadOpcode:     return "bad opcode";
+        case StimProgramError::BadTarget:     return "jump target out of range";
+        case StimProgramError::BadBurst:      return "invalid burst";
+        case StimProgramError::BadAmplitude:  return "amplitude > 100%";
+        case StimProgramError::EmptyLoop:     return "loop without burst/pause on its path";
+        case StimProgramError::TrailingBytes: return "trailing bytes";
+    }
+    return "?";
+}
+
+// ============================================
+// Интерпретатор
+// ============================================
+
+const StimInstr StimSequencer::kEnd = StimInstr();
+
+void StimSequencer::reset(const StimProgram* program) {
+    program_ = (program != nullptr && program->isValid()) ? program : nullptr;
+    pc_ = 0;
+    for (uint8_t i = 0; i < StimProgram::kMaxInstrs; ++i) {
+        loopLeft_[i] = 0;
+    }
+}
+
+const StimInstr* StimSequencer::next() {
+    if (program_ == nullptr) {
+        return nullptr;
+    }
+
+    for (uint8_t steps = 0; steps < kMaxControlSteps; ++steps) {
+        if (pc_ >= program_->size()) {
+            return &kEnd;   // выход за конец = END
+        }
+
+        const uint8_t index = pc_;
+        const StimInstr& instr = program_->at(index);
+
+        switch (instr.op) {
+            case StimOp::Loop:
+                // 0 - цикл не активен, иначе (осталось повторов + 1)
+                if (loopLeft_[index] == 0) {
+                    loopLeft_[index] = (uint32_t)instr.count + 1;
+                }
+                if (--loopLeft_[index] > 0) {
+                    pc_ = instr.target;
+                } else {
+                    pc_++;
+                }
+                break;
+
+            case StimOp::Jump:
+                pc_ = instr.target;
+                break;
+
+            case StimOp::End:
+                return &instr;
+
+            default:
+                pc_++;
+                return &instr;
+        }
+    }
+
+    // Управляющие команды без сегментов - считаем программу завершенной
+    return &kEnd;
+}
@@ -0,0 +1,199 @@
+#include "core/TraceRecorder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <esp_heap_caps.h>
+#include <esp_freertos_hooks.h>
+#include <freertos/task.h>
+
+TraceEvent*           TraceRecorder::events_ = nullptr;
+size_t                TraceRecorder::mask_ = 0;
+bool                  TraceRecorder::external_ = false;
+constexpr const char* TraceRecorder::kTickName;
+std::atomic<bool>     TraceRecorder::recording_(false);
+std::atomic<uint32_t> TraceRecorder::head_(0);
+std::atomic<uint32_t> TraceRecorder::skipped_(0);
+volatile bool         TraceRecorder::needSync_[TraceRecorder::kCores] = {};
+uint32_t              TraceRecorder::ticks_[TraceRecorder::kCores] = {};
+
+static size_t floorPowerOfTwo(size_t n) {
+    size_t p = 1;
+    while (p <= n / 2) {
+        p <<= 1;
+    }
+    return p;
+}
+
+bool TraceRecorder::begin(size_t capacity) {
+#if TRACE_ENABLED
+    if (events_ != nullptr) {
+        return true;
+    }
+    if (capacity < 2) {
+        Serial.println("[Trace] ERROR: Capacity too small");
+        return false;
+    }
+
+    size_t n = floorPowerOfTwo(capacity);
+    events_ = static_cast<TraceEvent*>(heap_caps_malloc(n * sizeof(TraceEvent),
+                                                        MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    external_ = (events_ != nullptr);
+    if (events_ == nullptr) {
+        n = floorPowerOfTwo(n < kFallbackCapacity ? n : kFallbackCapacity);
+        events_ = static_cast<TraceEvent*>(heap_caps_malloc(n * sizeof(TraceEvent),
+                                                            MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+    }
+    if (events_ == nullptr) {
+        Serial.println("[Trace] ERROR: Failed to allocate event ring!");
+        return false;
+    }
+    mask_ = n - 1;
+
+    void (*const hooks[2])() = {&TraceRecorder::tickHook0, &TraceRecorder::tickHook1};
+    for (uint8_t core = 0; core < kCores && core < 2; ++core) {
+        if (esp_register_freertos_tick_hook_for_cpu(hooks[core], core) != ESP_OK) {
+            // Без хука пара времени пишется только после start(): трасса
+            // длиннее переполнения CCOUNT (~18 с) собьется
+            Serial.printf("[Trace] WARN: Tick hook on core %u failed\n", core);
+        }
+    }
+
+    start();
+    Serial.printf("[Trace] Recording %u events in %s\n", (unsigned)n,
+                  external_ ? "PSRAM" : "internal RAM");
+    return true;
+#else
+    (void)capacity;
+    Serial.println("[Trace] Disabled (build with -DTRACE_ENABLED=1)");
+    return false;
+#endif
+}
+
+void TraceRecorder::start() {
+    if (events_ == nullptr) {
+        return;
+    }
+    // Запись стоит: писателей нет, кольцо начинается заново
+    recording_.store(false, std::memory_order_relaxed);
+    head_.store(0, std::memory_order_relaxed);
+    for (uint8_t core = 0; core < kCores; ++core) {
+        needSync_[core] = true;
+    }
+    recording_.store(true, std::memory_order_release);
+}
+
+void TraceRecorder::stop() {
+    recording_.store(false, std::memory_order_release);
+}
+
+size_t TraceRecorder::count() {
+    if (events_ == nullptr) {
+        return 0;
+    }
+    const uint32_t head = head_.load(std::memory_order_acquire);
+    return (head > mask_) ? mask_ + 1 : head;
+}
+
+bool TraceRecorder::getEvent(size_t index, TraceEvent& out) {
+    const size_t n = count();
+    if (index >= n) {
+        return false;
+    }
+    const uint32_t head = head_.load(std::memory_order_acquire);
+    out = events_[(head - n + index) & mask_];
+    return true;
+}
+
+size_t TraceRecorder::dump() {
+    if (events_ == nullptr) {
+        Serial.println("[Trace] ERROR: Not started");
+        return 0;
+    }
+
+    const bool wasRecording = isRecording();
+    stop();
+    // Писатель, взявший слот до stop(), успевает его дописать
+    vTaskDelay(1);
+
+    const uint32_t recorded = getRecorded();
+    const size_t n = count();
+    Serial.printf("@trace v1 mhz=%lu capacity=%u events=%u overwritten=%lu skipped=%lu\n",
+                  (unsigned long)ESP.getCpuFreqMHz(), (unsigned)getCapacity(), (unsigned)n,
+                  (unsigned long)(recorded - (uint32_t)n), (unsigned long)getSkipped());
+
+    dumpTasks();
+
+    // Имена нумеруются по первому появлению; 0 - без имени или таблица полна
+    const char* names[kMaxNames];
+    uint8_t nameCount = 0;
+    char line[64];
+
+    for (size_t i = 0; i < n; ++i) {
+        TraceEvent e;
+        if (!getEvent(i, e)) {
+            break;
+        }
+
+        uint8_t id = 0;
+        if (e.name != nullptr) {
+            for (uint8_t k = 0; k < nameCount; ++k) {
+                if (names[k] == e.name) {
+                    id = (uint8_t)(k + 1);
+                    break;
+                }
+            }
+            if (id == 0 && nameCount < kMaxNames) {
+                names[nameCount++] = e.name;
+                id = nameCount;
+                Serial.printf("@name %u %s\n", id, e.name);
+            }
+        }
+        snprintf(line, sizeof(line), "@e %u %c %08lx %u %lx\n", e.core, (char)e.type,
+                 (unsigned long)e.cycles, id, (unsigned long)e.arg);
+        Serial.print(line);
+    }
+    Serial.println("@end");
+
+    if (wasRecording) {
+        start();
+    }
+    return n;
+}
+
+void TraceRecorder::dumpTasks() {
+#if configUSE_TRACE_FACILITY == 1
+    // Задачи, созданные между снимком и выделением, не попадут - запас
+    const UBaseType_t capacity = uxTaskGetNumberOfTasks() + 4;
+    TaskStatus_t* tasks = static_cast<TaskStatus_t*>(malloc(capacity * sizeof(TaskStatus_t)));
+    if (tasks == nullptr) {
+        Serial.println("[Trace] WARN: No memory for task names");
+        return;
+    }
+    const UBaseType_t n = uxTaskGetSystemState(tasks, capacity, nullptr);
+    for (UBaseType_t i = 0; i < n; ++i) {
+        Serial.printf("@task %lx %s\n", (unsigned long)(uintptr_t)tasks[i].xHandle,
+                      tasks[i].pcTaskName);
+    }
+    free(tasks);
+#endif
+}
+
+void IRAM_ATTR TraceRecorder::tickHook0() {
+    onTick(0);
+}
+
+void IRAM_ATTR TraceRecorder::tickHook1() {
+    onTick(1);
+}
+
+void IRAM_ATTR TraceRecorder::onTick(uint8_t core) {
+    const uint32_t period = (kSyncPeriodMs * configTICK_RATE_HZ) / 1000;
+    ticks_[core] = ticks_[core] + 1;
+    if (ticks_[core] >= period) {
+        ticks_[core] = 0;
+        needSync_[core] = true;
+    }
+    // Хук вызывается на ядре core: текущая задача - та, что была на нем до тика
+    record(TraceEvent::kInstant, kTickName, (uint32_t)(uintptr_t)xTaskGetCurrentTaskHandle());
+}
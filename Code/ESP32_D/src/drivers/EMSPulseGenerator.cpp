@@ -1,7 +1,9 @@
 #include <Arduino.h>
 
-#include ".\app\pins.h"
-#include "..\include\drivers\EMSPulseGenerator.h"
+#include "app/pins.h"
+#include "drivers/EMSPulseGenerator.h"
+#include "core/DeferredLog.h"
+#include "core/TraceRecorder.h"
 
 // ====== Настройки вывода для стимуляции ======
 //static const int PWM1_CH      = 0;     // ledc канал
@@ -15,7 +17,8 @@ EMSPulseGenerator::EMSPulseGenerator(uint8_t pwmChannel,
                                      uint8_t outputPin,
                                      uint32_t pwmFreq, 
                                      uint8_t pwmResolution,
-                                     uint8_t pwmDuty
+                                     uint8_t pwmDuty,
+                                     const StimProfile& profile
                                     )
     : pwmChannel_(pwmChannel),
       outputPin_(outputPin),
@@ -25,44 +28,132 @@ EMSPulseGenerator::EMSPulseGenerator(uint8_t pwmChannel,
 {
     // Вычисляем максимальное значение duty cycle
     maxDuty_ = (1 << pwmResolution_) - 1;  // 2^resolution - 1
-    
-    // Инициализация с вашими параметрами
-    amp_ = 10;
-    pwUs_ = 200;
-    rateHz_ = 144;
-    pulsesPerBurst_ = 26;
-    pauseBetweenBurstsMs_ = 235;
-    
-    // Расчет производных параметров
-    pulsePeriodUs_ = 1000000UL / rateHz_;  // 6944 мкс
-    burstDurationUs_ = pulsesPerBurst_ * pulsePeriodUs_;  // 180556 мкс
-    pauseDurationUs_ = pauseBetweenBurstsMs_ * 1000UL;    // 235000 мкс
-    fullCycleUs_ = burstDurationUs_ + pauseDurationUs_;   // 415556 мкс
-    
-    //pwmDuty_ = map(amp_, 0, 100, 0, maxDuty_);
-   // pwmDutypwmDuty_ = 70;
+    dutyQ16_ = (uint32_t)pwmDuty_ << 16;
+    targetDutyQ16_ = dutyQ16_;
+
+    // Производные параметры уже посчитаны в профиле
+    if (profile.isValid()) {
+        applyProfileLocked(profile);
+    } else {
+        applyProfileLocked(DefaultStimProfile::value);
+    }
     
     Serial.printf("[EMS] Constructor: CH=%d, Pin=%d, Freq=%lu Hz, Res=%d bit (max duty=%d)\n",
                   pwmChannel_, outputPin_, pwmFreq_, pwmResolution_, maxDuty_);
 }
 
-EMSPulseGenerator::EMSPulseGenerator() {
-    // Инициализация с вашими параметрами
-    amp_ = 10;
-    pwUs_ = 200;
-    rateHz_ = 144;
-    pulsesPerBurst_ = 26;
-    pauseBetweenBurstsMs_ = 235;
-    
-    // Расчет производных параметров
-    pulsePeriodUs_ = 1000000UL / rateHz_;  // 6944 мкс
-    burstDurationUs_ = pulsesPerBurst_ * pulsePeriodUs_;  // 180556 мкс
-    pauseDurationUs_ = pauseBetweenBurstsMs_ * 1000UL;    // 235000 мкс
-    fullCycleUs_ = burstDurationUs_ + pauseDurationUs_;   // 415556 мкс
-    
-    //pwmDuty_ = map(amp_, 0, 100, 0, 1023);
+EMSPulseGenerator::EMSPulseGenerator()
+    : EMSPulseGenerator(0, PWM_CH_1_PIN)
+{
+}
+
+bool EMSPulseGenerator::setProfile(const StimProfile& profile) {
+    if (!profile.isValid()) {
+        Serial.printf("[EMS CH%d] WARN: Invalid stim profile (%u Hz, %u pulses, %u us), ignored\n",
+                      pwmChannel_, profile.rateHz, profile.pulsesPerBurst, profile.pulseWidthUs);
+        return false;
+    }
+
+    portENTER_CRITICAL(&mux_);
+    applyProfileLocked(profile);
+    portEXIT_CRITICAL(&mux_);
+    return true;
+}
+
+void EMSPulseGenerator::applyProfileLocked(const StimProfile& profile) {
+    pwUs_ = profile.pulseWidthUs;
+    rateHz_ = profile.rateHz;
+    pulsesPerBurst_ = profile.pulsesPerBurst;
+    pulsePeriodUs_ = profile.pulsePeriodUs;
+    burstDurationUs_ = profile.burstDurationUs;
+    pauseDurationUs_ = profile.pauseDurationUs;
+    fullCycleUs_ = profile.fullCycleUs;
+}
+
+bool EMSPulseGenerator::buildPlan(const StimParams& params, TimingPlan& plan) {
+    const StimProfile profile = StimProfile::fromPause(params.rateHz, params.pulsesPerBurst,
+                                                       params.pauseMs, params.pulseWidthUs);
+    if (!profile.isValid()) {
+        Serial.printf("[EMS] WARN: Invalid stim params (%u Hz, %u pulses, %u us, %lu ms pause)\n",
+                      params.rateHz, params.pulsesPerBurst, params.pulseWidthUs, params.pauseMs);
+        return false;
+    }
+
+    plan.profile = profile;
+    plan.amplitude = constrain(params.stimDuty, 0, 100);
+    plan.duty = dutyForAmplitude(plan.amplitude);
+    plan.carrierHz = params.carrierHz;
+    return true;
+}
+
+bool EMSPulseGenerator::takePlanLocked() {
+    TimingPlan plan;
+    if (!plans_.take(plan)) {
+        return false;
+    }
+    plansApplied_++;
+
+    // Программа сама задает длительности пачек и пауз - из плана берем
+    // только амплитуду и несущую
+    if (sequencer_.program() == nullptr) {
+        applyProfileLocked(plan.profile);
+    }
+
+    amp_ = plan.amplitude;
+    targetDutyQ16_ = (uint32_t)plan.duty << 16;
+    if (!running_ || rampTimeMs_ == 0) {
+        dutyQ16_ = targetDutyQ16_;
+        pwmDuty_ = plan.duty;
+        slewStepQ16_ = 0;
+    } else {
+        setRampLocked((uint64_t)rampTimeMs_ * 1000ULL);
+    }
+
+    // В программе несущую задает частота BURST
+    if (sequencer_.program() == nullptr && plan.carrierHz != 0 && plan.carrierHz != pwmFreq_) {
+        pendingCarrierHz_ = plan.carrierHz;
+    }
+    return true;
+}
+
+void EMSPulseGenerator::applyPendingCarrier() {
+    // Перенастройка таймера LEDC не для критической секции; выход сейчас в
+    // нуле (пауза или еще не начатая пачка), так что смена незаметна
+    portENTER_CRITICAL(&mux_);
+    const uint32_t freq = pendingCarrierHz_;
+    pendingCarrierHz_ = 0;
+    portEXIT_CRITICAL(&mux_);
+
+    if (freq == 0) {
+        return;
+    }
+    if (ledcChangeFrequency(pwmChannel_, freq, pwmResolution_) != 0) {
+        pwmFreq_ = freq;
+    } else {
+        DeferredLog::printf("[EMS CH%d] WARN: Carrier %lu Hz not supported by LEDC\n",
+                            pwmChannel_, (unsigned long)freq);
+    }
 
-   // pwmDuty_ = 6;
+    // Пачка программы, ждавшая своей несущей, включается только теперь
+    portENTER_CRITICAL(&mux_);
+    if (gatedDuty_ != 0 && running_ && inBurst_) {
+        writeDuty(gatedDuty_);
+    }
+    gatedDuty_ = 0;
+    portEXIT_CRITICAL(&mux_);
+}
+
+#if TRACE_ENABLED
+// Имена счетчиков трассы по каналам LEDC (литералы - адрес и есть имя)
+static const char* const kLedcTraceNames[] = {
+    "ledc0", "ledc1", "ledc2", "ledc3", "ledc4", "ledc5", "ledc6", "ledc7",
+    "ledc8", "ledc9", "ledc10", "ledc11", "ledc12", "ledc13", "ledc14", "ledc15"
+};
+#endif
+
+void EMSPulseGenerator::writeDuty(uint32_t duty) {
+    ledcWrite(pwmChannel_, duty);
+    TRACE_COUNTER(kLedcTraceNames[pwmChannel_ & 15], duty);
 }
 
 bool EMSPulseGenerator::begin() {
@@ -70,25 +161,93 @@ bool EMSPulseGenerator::begin() {
     // 🔥 Настройка LEDC для этого конкретного канала
     ledcSetup(pwmChannel_, pwmFreq_, pwmResolution_);
     ledcAttachPin(outputPin_, pwmChannel_);
-    ledcWrite(pwmChannel_, 0);
+    writeDuty(0);
     
     // Инициализация временных меток
-    lastPulseTs_ = micros();
+    lastPulseTs_ = esp_timer_get_time();
     burstStartTs_ = lastPulseTs_;
     cycleStartTs_ = lastPulseTs_;
     running_ = false;
+
+    // 🔥 Режим таймера: один one-shot таймер на генератор, перевзводится на каждом фронте
+    if (driveMode_ == DriveMode::Timer && edgeTimer_ == nullptr) {
+        esp_timer_create_args_t args = {};
+        args.callback = &EMSPulseGenerator::edgeTimerThunk;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "ems_edge";
+
+        if (esp_timer_create(&args, &edgeTimer_) != ESP_OK) {
+            Serial.printf("[EMS CH%d] ERROR: Failed to create edge timer!\n", pwmChannel_);
+            edgeTimer_ = nullptr;
+            return false;
+        }
+    }
     
     Serial.println("[EMS] Initialized with parameters:");
     Serial.printf("  Pulse rate: %d Hz\n", pwmFreq_);
     Serial.printf("  Pulse Duty: %d\n", pwmDuty_);
+    Serial.printf("  Drive mode: %s\n", (driveMode_ == DriveMode::Timer)    ? "timer" :
+                                         (driveMode_ == DriveMode::External) ? "external" : "polling");
 
     return true;
 }
 
 void EMSPulseGenerator::start() {
+    // Старт - тоже граница пачки: отложенная программа и ожидающий план
+    // вступают сразу (программа первой - от нее зависит, что берется из плана)
+    portENTER_CRITICAL(&mux_);
+    if (programPending_) {
+        sequencer_.reset(pendingProgram_);
+        programPending_ = false;
+    }
+    takePlanLocked();
+    portEXIT_CRITICAL(&mux_);
+    applyPendingCarrier();
+
+    if (driveMode_ != DriveMode::Polling) {
+        if (driveMode_ == DriveMode::Timer && edgeTimer_ == nullptr) {
+            return;
+        }
+
+        // Первый фронт (начало пачки) выдаем сразу, дальше - таймер или планировщик
+        portENTER_CRITICAL(&mux_);
+        running_ = true;
+        if (softStartMs_ > 0) {
+            dutyQ16_ = 0;
+            setRampLocked((uint64_t)softStartMs_ * 1000ULL);
+        }
+        if (sequencer_.program() != nullptr) {
+            sequencer_.reset(sequencer_.program());
+            runProgramLocked(esp_timer_get_time());
+        } else {
+            beginCycleLocked(esp_timer_get_time());
+        }
+        // Таймер перевзводится под тем же mux_, что проверяет onEdgeTimer():
+        // колбэк прошлого запуска его уже не перевзведет
+        if (driveMode_ == DriveMode::Timer) {
+            armNextEdgeLocked();
+        }
+        portEXIT_CRITICAL(&mux_);
+        // Первая BURST программы могла запросить свою несущую
+        applyPendingCarrier();
+
+        DeferredLog::printf("[EMS CH%d] ✅ Started on pin %d (%s)\n", pwmChannel_, outputPin_,
+                      (driveMode_ == DriveMode::Timer) ? "timer" : "external");
+        return;
+    }
+
+    portENTER_CRITICAL(&mux_);
     running_ = true;
+    if (softStartMs_ > 0) {
+        dutyQ16_ = 0;
+        setRampLocked((uint64_t)softStartMs_ * 1000ULL);
+    }
+    slewLocked();
+    portEXIT_CRITICAL(&mux_);
+
     // Сброс таймеров для корректного старта
-    uint32_t now = micros();
+    const uint64_t now = esp_timer_get_time();
     lastPulseTs_ = now;
     burstStartTs_ = now;
     cycleStartTs_ = now;
@@ -97,54 +256,115 @@ void EMSPulseGenerator::start() {
     pulseCountInBurst_ = 0;
     inBurst_ = true;
     
-    Serial.printf("[EMS CH%d] ✅ Started on pin %d\n", pwmChannel_, outputPin_);
+    DeferredLog::printf("[EMS CH%d] ✅ Started on pin %d\n", pwmChannel_, outputPin_);
 }
 
 void EMSPulseGenerator::stop() {
+    // Под мьютексом: колбэк таймера мог уже начать выполняться на другом ядре.
+    // Снятый здесь таймер он не перевзведет - running_ уже false
+    portENTER_CRITICAL(&mux_);
+    if (edgeTimer_ != nullptr) {
+        esp_timer_stop(edgeTimer_);
+    }
     running_ = false;
     pulseActive_ = false;
     inBurst_ = false;
     
     // 🔥 Выключаем PWM этого канала
-    ledcWrite(pwmChannel_, 0);
+    writeDuty(0);
+    portEXIT_CRITICAL(&mux_);
     
-    Serial.printf("[EMS CH%d] ⛔ Stopped\n", pwmChannel_);
+    DeferredLog::printf("[EMS CH%d] ⛔ Stopped\n", pwmChannel_);
 }
 
 void EMSPulseGenerator::setParams(uint8_t amplitudePercent) {
-    // Применяем только амплитуду и длительность импульса
-    amp_   = constrain(amplitudePercent, 0, 100);
-    //pwUs_  = constrain(pulseWidthUs, 50, 500);
-    
+    // Применяем только амплитуду - с ограничением скорости, если оно задано
+    rampTo(amplitudePercent, rampTimeMs_);
+}
+
+void EMSPulseGenerator::rampTo(uint8_t amplitudePercent, uint32_t rampMs) {
+    const uint8_t amp = constrain(amplitudePercent, 0, 100);
+
+    const uint16_t duty = dutyForAmplitude(amp);
+
+    portENTER_CRITICAL(&mux_);
+    amp_ = amp;
+    targetDutyQ16_ = (uint32_t)duty << 16;
+    if (!running_ || rampMs == 0) {
+        // Остановленный канал просто запоминает цель
+        dutyQ16_ = targetDutyQ16_;
+        pwmDuty_ = duty;
+        slewStepQ16_ = 0;
+    } else {
+        setRampLocked((uint64_t)rampMs * 1000ULL);
+    }
+    portEXIT_CRITICAL(&mux_);
+}
+
+uint16_t EMSPulseGenerator::dutyForAmplitude(uint8_t amplitudePercent) {
     // Преобразование амплитуды в значение ШИМ (0..1023)
-    pwmDuty_ = map(amp_, 0, 100, 0, (1 << PWM1_RES) - 1);
-    if (amp_ <= 0) pwmDuty_ = 0;
+    return (amplitudePercent > 0) ? map(amplitudePercent, 0, 100, 0, (1 << PWM1_RES) - 1) : 0;
+}
 
-    
+void EMSPulseGenerator::setRampLocked(uint64_t rampUs) {
+    // Одно деление на цель: число пачек за время рампы и шаг на пачку
+    // (в программе пачки разной длины - шаг оцениваем по циклу профиля)
+    uint32_t cycles = (uint32_t)(rampUs / fullCycleUs_);
+    if (cycles == 0) {
+        cycles = 1;
+    }
 
-    Serial.printf("income = %d , pwmDuty_ = %d ", amplitudePercent, pwmDuty_);
-    // ❌ УБРАЛИ Serial.printf отсюда - он вызывается слишком часто!
+    const uint32_t span = (dutyQ16_ > targetDutyQ16_) ? dutyQ16_ - targetDutyQ16_
+                                                      : targetDutyQ16_ - dutyQ16_;
+    slewStepQ16_ = span / cycles;
+    if (slewStepQ16_ == 0) {
+        slewStepQ16_ = 1;
+    }
+}
+
+void EMSPulseGenerator::slewLocked() {
+    if (dutyQ16_ < targetDutyQ16_) {
+        dutyQ16_ = (targetDutyQ16_ - dutyQ16_ > slewStepQ16_) ? dutyQ16_ + slewStepQ16_ : targetDutyQ16_;
+    } else if (dutyQ16_ > targetDutyQ16_) {
+        dutyQ16_ = (dutyQ16_ - targetDutyQ16_ > slewStepQ16_) ? dutyQ16_ - slewStepQ16_ : targetDutyQ16_;
+    }
+    pwmDuty_ = dutyQ16_ >> 16;
 }
 
 void EMSPulseGenerator::update() {
+    // В режимах Timer/External фронты формирует автомат фронтов, опрашивать нечего
+    if (driveMode_ != DriveMode::Polling) return;
     if (!running_) return;
 
-    const uint32_t now = micros();
+    const uint64_t now = esp_timer_get_time();
     
     // Определяем положение в полном цикле
-    const uint32_t cycleElapsed = now - cycleStartTs_;
+    const uint64_t cycleElapsed = now - cycleStartTs_;
     
     // Проверка завершения полного цикла
-    //fullCycleUs_ = 415556;     // 180556 + 235000 = 415556 мкс
     if (cycleElapsed >= fullCycleUs_) {
-        // Начинаем новый цикл
-        cycleStartTs_ = now;
-        burstStartTs_ = now;
-        nextPulseTs_ = now;
+        // Новый цикл начинается с ИДЕАЛЬНОЙ границы, а не с now:
+        // опоздание опроса не накапливается и частота не плывет от нагрузки
+        cycleStartTs_ += fullCycleUs_;
+        const uint64_t lateUs = now - cycleStartTs_;
+
+        if (lateUs >= fullCycleUs_) {
+            // Отстали больше чем на цикл (задачу долго не пускали) - пропускаем
+            // целые циклы, сохраняя фазу
+            cycleStartTs_ += (lateUs / fullCycleUs_) * fullCycleUs_;
+        }
+
+        burstStartTs_ = cycleStartTs_;
+        nextPulseTs_ = cycleStartTs_;
         pulseCountInBurst_ = 0;
         inBurst_ = true;
         pulseActive_ = false;
-        ledcWrite(pwmChannel_, 0);
+        TRACE_INSTANT("burst", pwmChannel_);
+        portENTER_CRITICAL(&mux_);
+        edgeStats_.record((int64_t)lateUs);
+        slewLocked();
+        portEXIT_CRITICAL(&mux_);
+        writeDuty(0);
        // digitalWrite(PWM_STATE_PIN, LOW);
         
        // Serial.printf("[EMS] 🔄 New cycle at %lu µs\n", now);
@@ -152,7 +372,7 @@ void EMSPulseGenerator::update() {
     }
     
     // Определяем, находимся ли мы в пачке или в паузе
-    const uint32_t burstElapsed = now - burstStartTs_;
+    const uint64_t burstElapsed = now - burstStartTs_;
     
     //burstDurationUs_ = 180556; // 26 × 6944 = 180556 мкс
     if (burstElapsed >= burstDurationUs_) {
@@ -160,7 +380,18 @@ void EMSPulseGenerator::update() {
         if (inBurst_) {
             inBurst_ = false;
             pulseActive_ = false;
-            ledcWrite(pwmChannel_, 0);
+            writeDuty(0);
+            portENTER_CRITICAL(&mux_);
+            const uint64_t burstEndTs = burstStartTs_ + burstDurationUs_;
+            edgeStats_.record((int64_t)(now - burstEndTs));
+            if (takePlanLocked()) {
+                // Цикл перепривязываем к концу этой пачки: пауза и дальше -
+                // по новому плану (разности по модулю 2^64, знак не важен)
+                cycleStartTs_ = burstEndTs - burstDurationUs_;
+                burstStartTs_ = cycleStartTs_;
+            }
+            portEXIT_CRITICAL(&mux_);
+            applyPendingCarrier();
             //digitalWrite(PWM_STATE_PIN, LOW);
            // Serial.printf("[EMS] 💤 Pause (sent %d pulses)\n", pulseCountInBurst_);
         }
@@ -198,7 +429,7 @@ void EMSPulseGenerator::update() {
             nextPulseTs_ += pulsePeriodUs_;  // Планируем следующий импульс
             
             // ✅ Включаем PWM - ОДИН РАЗ!
-            ledcWrite(pwmChannel_, pwmDuty_);
+            writeDuty(pwmDuty_);
             //digitalWrite(PWM_STATE_PIN, HIGH);
 
             //digitalWrite(PWM_STATE_PIN, !digitalRead(PWM_STATE_PIN));  // Toggle
@@ -212,7 +443,6 @@ void EMSPulseGenerator::update() {
         // ✅ Если now < nextPulseTs_, просто ждем - ничего не делаем
     } else {
         // ✅ ИМПУЛЬС УЖЕ АКТИВЕН - проверяем не пора ли его выключить
-        const uint32_t sincePulse = now - lastPulseTs_;
         //if (sincePulse >= pwUs_) {
             // ✅ ВЫКЛЮЧАЕМ ИМПУЛЬС - ОДИН РАЗ!
         //    pulseActive_ = false;
@@ -227,4 +457,191 @@ void EMSPulseGenerator::update() {
        // }
         // ✅ Если sincePulse < pwUs_, импульс еще активен - ничего не делаем
     }
-}
\ No newline at end of file
+}
+
+// ============================================
+// Фронтовой автомат (режимы Timer/External)
+// ============================================
+
+void EMSPulseGenerator::beginCycleLocked(uint64_t now) {
+    cycleStartTs_ = now;
+    burstStartTs_ = now;
+    lastPulseTs_ = now;
+    nextEdgeTs_ = now + burstDurationUs_;
+    pulseCountInBurst_ = 1;
+    pulseActive_ = true;
+    inBurst_ = true;
+    slewLocked();
+    TRACE_INSTANT("burst", pwmChannel_);
+    writeDuty(pwmDuty_);
+}
+
+void EMSPulseGenerator::advanceEdgeLocked() {
+    if (sequencer_.program() != nullptr) {
+        runProgramLocked(nextEdgeTs_);
+        return;
+    }
+
+    if (inBurst_) {
+        // Конец пачки -> пауза; ожидающий план вступает с этой паузы
+        inBurst_ = false;
+        pulseActive_ = false;
+        writeDuty(0);
+        takePlanLocked();
+        nextEdgeTs_ += pauseDurationUs_;
+    } else {
+        // Конец паузы -> новый цикл, начало пачки
+        beginCycleLocked(nextEdgeTs_);
+    }
+}
+
+bool EMSPulseGenerator::setProgram(const StimProgram* program) {
+    if (program != nullptr && (!program->isValid() || driveMode_ == DriveMode::Polling)) {
+        Serial.printf("[EMS CH%d] WARN: Program rejected (%s)\n", pwmChannel_,
+                      program->isValid() ? "polling mode" : "empty program");
+        return false;
+    }
+
+    // Посреди цикла автомат уже ведет фронты по текущей программе
+    portENTER_CRITICAL(&mux_);
+    if (running_) {
+        pendingProgram_ = program;
+        programPending_ = true;
+    } else {
+        sequencer_.reset(program);
+        programPending_ = false;
+    }
+    portEXIT_CRITICAL(&mux_);
+    return true;
+}
+
+void EMSPulseGenerator::runProgramLocked(uint64_t at) {
+    // RAMP выполняется мгновенно, поэтому идем до первой команды со временем
+    for (uint8_t steps = 0; steps < StimSequencer::kMaxControlSteps; ++steps) {
+        const StimInstr* instr = sequencer_.next();
+
+        if (instr->op == StimOp::Ramp) {
+            amp_ = instr->amplitude;
+            targetDutyQ16_ = (uint32_t)dutyForAmplitude(amp_) << 16;
+            if (instr->durationUs == 0) {
+                dutyQ16_ = targetDutyQ16_;
+            } else {
+                setRampLocked(instr->durationUs);
+            }
+            continue;
+        }
+
+        if (instr->op == StimOp::Burst) {
+            cycleStartTs_ = at;
+            burstStartTs_ = at;
+            lastPulseTs_ = at;
+            pulseCountInBurst_ = 1;
+            pulseActive_ = true;
+            inBurst_ = true;
+            slewLocked();
+            TRACE_INSTANT("burst", pwmChannel_);
+            nextEdgeTs_ = at + instr->durationUs;
+
+            // Импульс - период несущей: частота BURST - это несущая, ширина -
+            // доля периода при 100% амплитуды, амплитуда масштабирует ее
+            const uint32_t widthDuty = (uint32_t)(((uint64_t)instr->widthUs * (maxDuty_ + 1U)) / instr->periodUs);
+            const uint16_t duty = (uint16_t)(((uint32_t)pwmDuty_ * widthDuty) / maxDuty_);
+            if (instr->rateHz != pwmFreq_) {
+                // Несущая меняется вне mux_ (applyPendingCarrier), выход до
+                // того остается в нуле - пачка начнется уже на новой частоте
+                pendingCarrierHz_ = instr->rateHz;
+                gatedDuty_ = duty;
+            } else {
+                writeDuty(duty);
+            }
+            return;
+        }
+
+        if (instr->op == StimOp::Pause) {
+            inBurst_ = false;
+            pulseActive_ = false;
+            gatedDuty_ = 0;
+            writeDuty(0);
+            takePlanLocked();
+            nextEdgeTs_ = at + instr->durationUs;
+            return;
+        }
+
+        break;  // END
+    }
+
+    // Программа закончилась - канал останавливается сам
+    running_ = false;
+    inBurst_ = false;
+    pulseActive_ = false;
+    writeDuty(0);
+    nextEdgeTs_ = at;
+}
+
+uint64_t EMSPulseGenerator::serviceEdge(bool& carrierPending) {
+    const uint64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&mux_);
+    if (running_) {
+        edgeStats_.record((int64_t)(now - nextEdgeTs_));
+        advanceEdgeLocked();
+    }
+    const uint64_t next = nextEdgeTs_;
+    carrierPending = (pendingCarrierHz_ != 0);
+    portEXIT_CRITICAL(&mux_);
+
+    return next;
+}
+
+EdgeErrorStats::Snapshot EMSPulseGenerator::getEdgeStats() const {
+    portENTER_CRITICAL(&mux_);
+    const EdgeErrorStats::Snapshot snapshot = edgeStats_.snapshot();
+    portEXIT_CRITICAL(&mux_);
+    return snapshot;
+}
+
+void EMSPulseGenerator::resetEdgeStats() {
+    portENTER_CRITICAL(&mux_);
+    edgeStats_.reset();
+    portEXIT_CRITICAL(&mux_);
+}
+
+// ============================================
+// Режим таймера
+// ============================================
+
+void EMSPulseGenerator::edgeTimerThunk(void* arg) {
+    EMSPulseGenerator* self = static_cast<EMSPulseGenerator*>(arg);
+    IsrScope scope(self->isrProfile_);
+    self->onEdgeTimer();
+}
+
+void EMSPulseGenerator::onEdgeTimer() {
+    const uint64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&mux_);
+    // Таймер не срабатывает раньше срока. Фронт еще впереди - колбэк от
+    // взвода до stop()/start(), который уже шел в задаче esp_timer: новый
+    // запуск взвел свой фронт, этот колбэк ничего не трогает
+    if (!running_ || (int64_t)(now - nextEdgeTs_) < 0) {
+        portEXIT_CRITICAL(&mux_);
+        return;
+    }
+    edgeStats_.record((int64_t)(now - nextEdgeTs_));
+    advanceEdgeLocked();
+    armNextEdgeLocked();
+    portEXIT_CRITICAL(&mux_);
+
+    applyPendingCarrier();
+}
+
+void EMSPulseGenerator::armNextEdgeLocked() {
+    // Задержка считается от ИДЕАЛЬНОГО времени фронта, а не от момента вызова,
+    // поэтому задержка колбэка не накапливается от цикла к циклу
+    esp_timer_stop(edgeTimer_);  // ошибка "не запущен" здесь не важна
+    if (!running_) {
+        return;
+    }
+    const int64_t delayUs = (int64_t)(nextEdgeTs_ - (uint64_t)esp_timer_get_time());
+    esp_timer_start_once(edgeTimer_, (delayUs > 0) ? (uint64_t)delayUs : 1);
+}
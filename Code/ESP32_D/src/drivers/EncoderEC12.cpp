@@ -1,6 +1,8 @@
 #include "drivers/EncoderEC12.h"
 
 void EncoderEC12::setupInterrupts() {
+    decoder_.reset(lastClk_, lastDt_);
+
     // Базовая реализация: только CLK (для EC12)
     attachInterruptArg(digitalPinToInterrupt(clkPin_), &IEncoder::isrThunk, this, CHANGE);
 }
@@ -12,25 +14,9 @@ void IRAM_ATTR EncoderEC12::handleIsr() {
     // }
     // lastDebounceUs_ = now;
 
-    const int currentCLK = digitalRead(clkPin_);
-    const int currentDT  = digitalRead(dtPin_);
-
-    // ========================================
-    // СТАНДАРТНАЯ ЛОГИКА ДЛЯ EC12
-    // Обрабатываем только изменения CLK
-    // ========================================
-    if (currentCLK != lastClk_) {
-        if (currentCLK == LOW) {
-            // Стандартная логика EC12: проверяем DT при падении CLK
-            const int step = (currentDT == HIGH) ? -1 : 1;
-            
-            portENTER_CRITICAL_ISR(&mux_);
-            pendingSteps_ += step;
-            portEXIT_CRITICAL_ISR(&mux_);
-        }
-        lastClk_ = currentCLK;
+    // Стандартная логика EC12: шаг на спаде CLK по уровню DT (EC12Decoder)
+    const int8_t step = decoder_.step(digitalRead(clkPin_), digitalRead(dtPin_));
+    if (step != 0) {
+        pushStep(step);
     }
-    
-    // Обновляем lastDt_ для совместимости
-    lastDt_ = currentDT;
 }
\ No newline at end of file
@@ -0,0 +1,185 @@
+#include "drivers/EncoderGpioDispatcher.h"
+
+#include <soc/soc.h>
+#include <soc/gpio_reg.h>
+
+// Переходы (CLK,DT) "было -> стало": направление в четвертях шага.
+// Знак как у EncoderPCNT и SampledEncoder: спад CLK при DT = 1 - минус
+static const int8_t DRAM_ATTR kQuadratureTable[16] = {
+     0,  1, -1,  0,   // 00 -> 00, 01, 10, 11
+    -1,  0,  0,  1,   // 01 -> 00, 01, 10, 11
+     1,  0,  0, -1,   // 10 -> 00, 01, 10, 11
+     0, -1,  1,  0    // 11 -> 00, 01, 10, 11
+};
+
+// ============================================
+// DispatchedEncoder
+// ============================================
+
+DispatchedEncoder::DispatchedEncoder(uint8_t clkPin,
+                                     uint8_t dtPin,
+                                     uint8_t countsPerStep,
+                                     bool reversed)
+    : IEncoder(clkPin, dtPin, 0)
+    , countsPerStep_(countsPerStep > 0 ? countsPerStep : 1)
+    , direction_(reversed ? -1 : 1)
+    , clkBank_(clkPin >= 32 ? 1 : 0)
+    , clkMask_(1UL << (clkPin & 31))
+    , dtBank_(dtPin >= 32 ? 1 : 0)
+    , dtMask_(1UL << (dtPin & 31))
+{
+}
+
+bool DispatchedEncoder::begin() {
+    if (!IEncoder::begin()) {
+        return false;
+    }
+    state_ = (uint8_t)(((lastClk_ ? 1 : 0) << 1) | (lastDt_ ? 1 : 0));
+    quarters_ = 0;
+    return true;
+}
+
+void IRAM_ATTR DispatchedEncoder::decode(uint8_t clk, uint8_t dt) {
+    const uint8_t curr = (uint8_t)((clk << 1) | dt);
+    if (curr == state_) {
+        return;
+    }
+
+    // Оба пина сменились (пропущен фронт) - в таблице 0, шаг не придумываем
+    quarters_ += kQuadratureTable[(state_ << 2) | curr];
+    state_ = curr;
+    if (quarters_ >= (int8_t)countsPerStep_) {
+        quarters_ -= countsPerStep_;
+        pushStep(direction_);
+    } else if (quarters_ <= -(int8_t)countsPerStep_) {
+        quarters_ += countsPerStep_;
+        pushStep((int8_t)-direction_);
+    }
+}
+
+// ============================================
+// EncoderGpioDispatcher
+// ============================================
+
+EncoderGpioDispatcher::EncoderGpioDispatcher() {
+    for (uint8_t pin = 0; pin < kGpioCount; ++pin) {
+        slotOfPin_[pin] = -1;
+    }
+}
+
+bool EncoderGpioDispatcher::add(DispatchedEncoder& encoder) {
+    const uint8_t clk = encoder.getClkPin();
+    const uint8_t dt = encoder.getDtPin();
+    if (handle_ != nullptr || count_ >= kMaxEncoders ||
+        clk >= kGpioCount || dt >= kGpioCount || clk == dt ||
+        slotOfPin_[clk] >= 0 || slotOfPin_[dt] >= 0) {
+        Serial.println("[GpioDispatch] ERROR: Cannot add encoder");
+        return false;
+    }
+
+    slotOfPin_[clk] = (int8_t)count_;
+    slotOfPin_[dt] = (int8_t)count_;
+    pinMask_[encoder.clkBank_] |= encoder.clkMask_;
+    pinMask_[encoder.dtBank_] |= encoder.dtMask_;
+    encoders_[count_++] = &encoder;
+    return true;
+}
+
+bool EncoderGpioDispatcher::begin() {
+    if (count_ == 0) {
+        Serial.println("[GpioDispatch] ERROR: No encoders");
+        return false;
+    }
+
+    // Один обработчик на все прерывания GPIO (занимает его у gpio_install_isr_service).
+    // Без ESP_INTR_FLAG_IRAM: путь до EncoderEvents::push не весь в IRAM, и на
+    // время записи во flash (NVS) прерывание откладывается - фронты ждут в статусе
+    const esp_err_t err = gpio_isr_register(&EncoderGpioDispatcher::isrThunk, this,
+                                            0, &handle_);
+    if (err != ESP_OK) {
+        Serial.printf("[GpioDispatch] ERROR: gpio_isr_register failed (%d)!\n", (int)err);
+        handle_ = nullptr;
+        return false;
+    }
+
+    for (uint8_t pin = 0; pin < kGpioCount; ++pin) {
+        if (slotOfPin_[pin] < 0) {
+            continue;
+        }
+        gpio_set_intr_type((gpio_num_t)pin, GPIO_INTR_ANYEDGE);
+        gpio_intr_enable((gpio_num_t)pin);
+    }
+    return true;
+}
+
+void EncoderGpioDispatcher::end() {
+    if (handle_ == nullptr) {
+        return;
+    }
+    for (uint8_t pin = 0; pin < kGpioCount; ++pin) {
+        if (slotOfPin_[pin] >= 0) {
+            gpio_intr_disable((gpio_num_t)pin);
+        }
+    }
+    esp_intr_free(handle_);
+    handle_ = nullptr;
+}
+
+void IRAM_ATTR EncoderGpioDispatcher::isrThunk(void* arg) {
+    EncoderGpioDispatcher* self = static_cast<EncoderGpioDispatcher*>(arg);
+    IsrScope scope(self->isrProfile_);
+    self->dispatch();
+}
+
+void IRAM_ATTR EncoderGpioDispatcher::dispatch() {
+    uint32_t edges = 0;
+
+    for (uint8_t pass = 0; pass < kMaxPasses; ++pass) {
+        const uint32_t pending0 = pinMask_[0] ? (REG_READ(GPIO_STATUS_REG) & pinMask_[0]) : 0;
+        const uint32_t pending1 = pinMask_[1] ? (REG_READ(GPIO_STATUS1_REG) & pinMask_[1]) : 0;
+        if ((pending0 | pending1) == 0) {
+            break;
+        }
+
+        // Сначала сброс, потом уровни: фронт после сброса снова поднимет статус,
+        // а уровни ниже его уже учтут
+        if (pending0) {
+            REG_WRITE(GPIO_STATUS_W1TC_REG, pending0);
+        }
+        if (pending1) {
+            REG_WRITE(GPIO_STATUS1_W1TC_REG, pending1);
+        }
+        uint32_t in[2] = {0, 0};
+        if (pinMask_[0]) {
+            in[0] = REG_READ(GPIO_IN_REG);
+        }
+        if (pinMask_[1]) {
+            in[1] = REG_READ(GPIO_IN1_REG);
+        }
+
+        // Пины с фронтами -> энкодеры (каждый один раз за проход)
+        uint32_t dirty = 0;
+        uint32_t bits = pending0;
+        while (bits) {
+            dirty |= 1UL << slotOfPin_[__builtin_ctz(bits)];
+            bits &= bits - 1;
+            edges++;
+        }
+        bits = pending1;
+        while (bits) {
+            dirty |= 1UL << slotOfPin_[32 + __builtin_ctz(bits)];
+            bits &= bits - 1;
+            edges++;
+        }
+
+        while (dirty) {
+            DispatchedEncoder* e = encoders_[__builtin_ctz(dirty)];
+            e->decode((in[e->clkBank_] & e->clkMask_) ? 1 : 0,
+                      (in[e->dtBank_] & e->dtMask_) ? 1 : 0);
+            dirty &= dirty - 1;
+        }
+    }
+
+    isrCount_++;
+    edgeCount_ += edges;
+}
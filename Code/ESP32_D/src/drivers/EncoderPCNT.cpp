@@ -0,0 +1,168 @@
+#include "drivers/EncoderPCNT.h"
+
+EncoderPCNT::EncoderPCNT(uint8_t clkPin,
+                         uint8_t dtPin,
+                         pcnt_unit_t unit,
+                         uint8_t countsPerStep,
+                         bool reversed,
+                         uint32_t debounceUs)
+    : IEncoder(clkPin, dtPin, debounceUs)
+    , unit_(unit)
+    , countsPerStep_(countsPerStep > 0 ? countsPerStep : 1)
+    , reversed_(reversed)
+{
+}
+
+bool EncoderPCNT::begin() {
+    // Квадратура x4: канал 0 считает фронты CLK, направление по DT,
+    // канал 1 - фронты DT, направление по CLK. Подтяжки входов включает
+    // сам pcnt_unit_config (pinMode здесь сбросил бы маршрутизацию GPIO)
+    pcnt_config_t config = {};
+    config.unit = unit_;
+    config.counter_h_lim = kCounterLimit;
+    config.counter_l_lim = -kCounterLimit;
+
+    config.channel = PCNT_CHANNEL_0;
+    config.pulse_gpio_num = clkPin_;
+    config.ctrl_gpio_num = dtPin_;
+    config.pos_mode = PCNT_COUNT_INC;
+    config.neg_mode = PCNT_COUNT_DEC;
+    config.lctrl_mode = PCNT_MODE_REVERSE;
+    config.hctrl_mode = PCNT_MODE_KEEP;
+    if (pcnt_unit_config(&config) != ESP_OK) {
+        Serial.printf("[PCNT U%d] ERROR: Channel 0 config failed!\n", unit_);
+        return false;
+    }
+
+    config.channel = PCNT_CHANNEL_1;
+    config.pulse_gpio_num = dtPin_;
+    config.ctrl_gpio_num = clkPin_;
+    config.pos_mode = PCNT_COUNT_DEC;
+    config.neg_mode = PCNT_COUNT_INC;
+    if (pcnt_unit_config(&config) != ESP_OK) {
+        Serial.printf("[PCNT U%d] ERROR: Channel 1 config failed!\n", unit_);
+        return false;
+    }
+
+    // Аппаратный фильтр дребезга, такты APB
+    const uint32_t filterTicks = std::min<uint32_t>(debounceUs_ * kApbMhz, kMaxFilterTicks);
+    if (filterTicks > 0) {
+        pcnt_set_filter_value(unit_, (uint16_t)filterTicks);
+        pcnt_filter_enable(unit_);
+    } else {
+        pcnt_filter_disable(unit_);
+    }
+
+    pcnt_counter_pause(unit_);
+    pcnt_counter_clear(unit_);
+    pcnt_counter_resume(unit_);
+
+    lastCount_ = 0;
+    residual_ = 0;
+    total_ = 0;
+
+    if (events_.getWakeTask() != nullptr) {
+        setupInterrupts();
+    }
+    return true;
+}
+
+void EncoderPCNT::setupInterrupts() {
+    // Сервис один на все юниты: второй энкодер получит ESP_ERR_INVALID_STATE
+    const esp_err_t err = pcnt_isr_service_install(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        Serial.printf("[PCNT U%d] ERROR: ISR service install failed: %s\n", unit_, esp_err_to_name(err));
+        return;
+    }
+
+    armThresholds(lastCount_);
+    pcnt_event_enable(unit_, PCNT_EVT_THRES_0);
+    pcnt_event_enable(unit_, PCNT_EVT_THRES_1);
+    // Порог на самом пределе совпадает с обнулением счетчика - его ловят события пределов
+    pcnt_event_enable(unit_, PCNT_EVT_H_LIM);
+    pcnt_event_enable(unit_, PCNT_EVT_L_LIM);
+
+    if (pcnt_isr_handler_add(unit_, &IEncoder::isrThunk, this) != ESP_OK) {
+        Serial.printf("[PCNT U%d] ERROR: ISR handler add failed!\n", unit_);
+        return;
+    }
+    thresholdWake_ = true;
+}
+
+int16_t EncoderPCNT::wrapCount(int32_t count) {
+    // Значения счетчика - (-limit, limit), limit эквивалентен нулю
+    while (count >= kCounterLimit) {
+        count -= kCounterLimit;
+    }
+    while (count <= -kCounterLimit) {
+        count += kCounterLimit;
+    }
+    return (int16_t)count;
+}
+
+void EncoderPCNT::armThresholds(int16_t count) {
+    // Шаг складывается, когда residual_ доходит до ±countsPerStep_;
+    // в сырых отсчетах направление зависит от reversed_
+    const int32_t toPositive = (int32_t)countsPerStep_ - residual_;
+    const int32_t toNegative = (int32_t)countsPerStep_ + residual_;
+    const int32_t up = reversed_ ? toNegative : toPositive;
+    const int32_t down = reversed_ ? toPositive : toNegative;
+
+    pcnt_set_event_value(unit_, PCNT_EVT_THRES_0, wrapCount((int32_t)count + up));
+    pcnt_set_event_value(unit_, PCNT_EVT_THRES_1, wrapCount((int32_t)count - down));
+}
+
+void EncoderPCNT::update() {
+    int16_t count = 0;
+    if (!consume(count) || !thresholdWake_) {
+        return;
+    }
+
+    // Отсчет между чтением и установкой порога мог проскочить новый порог:
+    // перечитываем, пока счетчик не устоит за время перестановки
+    while (true) {
+        armThresholds(count);
+        int16_t now = 0;
+        if (pcnt_get_counter_value(unit_, &now) != ESP_OK || now == count) {
+            return;
+        }
+        if (!consume(count)) {
+            return;
+        }
+    }
+}
+
+bool EncoderPCNT::consume(int16_t& count) {
+    if (pcnt_get_counter_value(unit_, &count) != ESP_OK) {
+        return false;
+    }
+
+    // Счетчик не сбрасываем (отсчеты между чтением и сбросом терялись бы):
+    // на h_lim/l_lim он сам обнуляется, т.е. идет по модулю kCounterLimit.
+    // Разность приводим к (-limit/2, limit/2] - верно, пока между вызовами
+    // меньше ~16к отсчетов
+    int32_t counts = (int32_t)count - lastCount_;
+    lastCount_ = count;
+    while (counts > kCounterLimit / 2) {
+        counts -= kCounterLimit;
+    }
+    while (counts <= -kCounterLimit / 2) {
+        counts += kCounterLimit;
+    }
+
+    if (counts == 0) {
+        return true;
+    }
+    if (reversed_) {
+        counts = -counts;
+    }
+    total_ += counts;
+    residual_ += counts;
+
+    // Целые шаги; остаток (пол-щелчка) ждет следующего вызова
+    const int32_t steps = residual_ / countsPerStep_;
+    residual_ -= steps * countsPerStep_;
+
+    dispatchSteps(steps);
+    return true;
+}
@@ -0,0 +1,168 @@
+#include "drivers/EncoderSampler.h"
+
+#include <soc/soc.h>
+#include <soc/gpio_reg.h>
+
+// Переходы (CLK,DT) "было -> стало": направление в четвертях шага.
+// Знак как у EncoderPCNT: спад CLK при DT = 1 - минус
+static const int8_t DRAM_ATTR kQuadratureTable[16] = {
+     0,  1, -1,  0,   // 00 -> 00, 01, 10, 11
+    -1,  0,  0,  1,   // 01 -> 00, 01, 10, 11
+     1,  0,  0, -1,   // 10 -> 00, 01, 10, 11
+     0, -1,  1,  0    // 11 -> 00, 01, 10, 11
+};
+
+// ============================================
+// SampledEncoder
+// ============================================
+
+SampledEncoder::SampledEncoder(uint8_t clkPin,
+                               uint8_t dtPin,
+                               uint8_t countsPerStep,
+                               bool reversed,
+                               uint32_t debounceUs)
+    : IEncoder(clkPin, dtPin, debounceUs)
+    , countsPerStep_(countsPerStep > 0 ? countsPerStep : 1)
+    , direction_(reversed ? -1 : 1)
+    , clkBank_(clkPin >= 32 ? 1 : 0)
+    , clkMask_(1UL << (clkPin & 31))
+    , dtBank_(dtPin >= 32 ? 1 : 0)
+    , dtMask_(1UL << (dtPin & 31))
+{
+}
+
+bool SampledEncoder::begin() {
+    if (!IEncoder::begin()) {
+        return false;
+    }
+    clk_.stable = lastClk_ ? 1 : 0;
+    clk_.count = 0;
+    dt_.stable = lastDt_ ? 1 : 0;
+    dt_.count = 0;
+    quarters_ = 0;
+    return true;
+}
+
+void IRAM_ATTR SampledEncoder::sample(uint8_t clk, uint8_t dt) {
+    const uint8_t prev = (uint8_t)((clk_.stable << 1) | dt_.stable);
+
+    // Уровень принимается только после stableSamples_ отсчетов подряд
+    if (clk != clk_.stable) {
+        if (++clk_.count >= stableSamples_) {
+            clk_.stable = clk;
+            clk_.count = 0;
+        }
+    } else {
+        clk_.count = 0;
+    }
+    if (dt != dt_.stable) {
+        if (++dt_.count >= stableSamples_) {
+            dt_.stable = dt;
+            dt_.count = 0;
+        }
+    } else {
+        dt_.count = 0;
+    }
+
+    const uint8_t curr = (uint8_t)((clk_.stable << 1) | dt_.stable);
+    if (curr == prev) {
+        return;
+    }
+
+    quarters_ += kQuadratureTable[(prev << 2) | curr];
+    if (quarters_ >= (int8_t)countsPerStep_) {
+        quarters_ -= countsPerStep_;
+        pushStep(direction_);
+    } else if (quarters_ <= -(int8_t)countsPerStep_) {
+        quarters_ += countsPerStep_;
+        pushStep((int8_t)-direction_);
+    }
+}
+
+// ============================================
+// EncoderSampler
+// ============================================
+
+EncoderSampler* EncoderSampler::instance_ = nullptr;
+
+EncoderSampler::EncoderSampler(uint32_t sampleHz, uint8_t timerNum)
+    : sampleHz_(sampleHz > 0 ? sampleHz : 1)
+    , timerNum_(timerNum)
+{
+}
+
+bool EncoderSampler::add(SampledEncoder& encoder) {
+    if (timer_ != nullptr || count_ >= kMaxEncoders) {
+        Serial.println("[Sampler] ERROR: Cannot add encoder");
+        return false;
+    }
+
+    // Фильтр: столько отсчетов, сколько помещается в debounceUs (не меньше 2)
+    const uint32_t periodUs = kTimerTickHz / sampleHz_;
+    uint32_t samples = (encoder.getDebounceUs() + periodUs - 1) / (periodUs > 0 ? periodUs : 1);
+    samples = std::max<uint32_t>(2, std::min<uint32_t>(samples, 255));
+    encoder.stableSamples_ = (uint8_t)samples;
+
+    readBank_[encoder.clkBank_] = true;
+    readBank_[encoder.dtBank_] = true;
+    encoders_[count_++] = &encoder;
+    return true;
+}
+
+bool EncoderSampler::begin() {
+    if (instance_ != nullptr && instance_ != this) {
+        Serial.println("[Sampler] ERROR: Only one sampler is supported");
+        return false;
+    }
+    if (count_ == 0) {
+        Serial.println("[Sampler] ERROR: No encoders");
+        return false;
+    }
+
+    timer_ = timerBegin(timerNum_, 80, true);
+    if (timer_ == nullptr) {
+        Serial.printf("[Sampler] ERROR: Timer %u init failed!\n", timerNum_);
+        return false;
+    }
+    instance_ = this;
+    timerAttachInterrupt(timer_, &EncoderSampler::timerIsr, true);
+    timerAlarmWrite(timer_, kTimerTickHz / sampleHz_, true);
+    timerAlarmEnable(timer_);
+    return true;
+}
+
+void EncoderSampler::end() {
+    if (timer_ == nullptr) {
+        return;
+    }
+    timerAlarmDisable(timer_);
+    timerEnd(timer_);
+    timer_ = nullptr;
+    instance_ = nullptr;
+}
+
+void IRAM_ATTR EncoderSampler::timerIsr() {
+    EncoderSampler* self = instance_;
+    if (self != nullptr) {
+        IsrScope scope(self->isrProfile_);
+        self->sampleAll();
+    }
+}
+
+void IRAM_ATTR EncoderSampler::sampleAll() {
+    // Один снимок входов на банк: все энкодеры видят один и тот же момент
+    uint32_t in[2] = {0, 0};
+    if (readBank_[0]) {
+        in[0] = REG_READ(GPIO_IN_REG);
+    }
+    if (readBank_[1]) {
+        in[1] = REG_READ(GPIO_IN1_REG);
+    }
+
+    for (uint8_t i = 0; i < count_; ++i) {
+        SampledEncoder* e = encoders_[i];
+        e->sample((in[e->clkBank_] & e->clkMask_) ? 1 : 0,
+                  (in[e->dtBank_] & e->dtMask_) ? 1 : 0);
+    }
+    samples_++;
+}
@@ -2,6 +2,11 @@
 #include "app/pins.h"
 
 bool IEncoder::begin() {
+    if (!events_.isValid()) {
+        Serial.println("[Encoder] ERROR: Event ring allocation failed!");
+        return false;
+    }
+
     pinMode(clkPin_, INPUT_PULLUP);
     pinMode(dtPin_,  INPUT_PULLUP);
 
@@ -16,20 +21,19 @@ bool IEncoder::begin() {
 }
 
 void IRAM_ATTR IEncoder::isrThunk(void* arg) {
-    static_cast<IEncoder*>(arg)->handleIsr();
+    IEncoder* self = static_cast<IEncoder*>(arg);
+    IsrScope scope(self->isrProfile_);
+    self->handleIsr();
 }
 
 void IEncoder::update() {
-    int32_t delta = 0;
-    taskENTER_CRITICAL(&mux_);
-    delta = pendingSteps_;
-    pendingSteps_ = 0;
-    taskEXIT_CRITICAL(&mux_);
+    dispatchSteps(events_.drain());
+}
 
-    if (delta != 0 && handler_) {
-        // Склеенный вызов: один колбэк с суммарным сдвигом
-        // Ограничиваем диапазон int8_t (-127..127)
-        delta = std::max<int32_t>(-127, std::min<int32_t>(127, delta));
-        handler_(static_cast<int8_t>(delta));
+void IEncoder::dispatchSteps(int32_t steps) {
+    if (!handler_) {
+        return;
     }
-}
\ No newline at end of file
+    // Без усечения: сумма больше int8_t уходит несколькими вызовами
+    EncoderEvents::dispatch(steps, handler_);
+}
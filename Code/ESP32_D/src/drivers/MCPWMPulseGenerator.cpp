@@ -0,0 +1,240 @@
+#include "drivers/MCPWMPulseGenerator.h"
+
+MCPWMPulseGenerator::MCPWMPulseGenerator(mcpwm_unit_t unit,
+                                         mcpwm_timer_t timer,
+                                         uint8_t  phase1Pin,
+                                         int8_t   phase2Pin,
+                                         uint16_t pulseWidthUs,
+                                         uint16_t interPhaseUs,
+                                         const StimProfile& profile)
+    : unit_(unit),
+      timer_(timer),
+      phase1Pin_(phase1Pin),
+      phase2Pin_(phase2Pin),
+      pwUs_(pulseWidthUs),
+      interPhaseUs_(interPhaseUs)
+{
+    // Производные параметры уже посчитаны в профиле
+    const StimProfile& p = profile.isValid() ? profile : DefaultStimProfile::value;
+    rateHz_ = p.rateHz;
+    pulsesPerBurst_ = p.pulsesPerBurst;
+    pulsePeriodUs_ = p.pulsePeriodUs;
+    fullCycleUs_ = p.fullCycleUs;
+
+    if (!setPulseShape(pwUs_, interPhaseUs_)) {
+        Serial.printf("[MCPWM] WARN: Pulse shape %u/%u us does not fit period, using 200/100\n",
+                      pulseWidthUs, interPhaseUs);
+        setPulseShape(200, 100);
+    }
+}
+
+bool MCPWMPulseGenerator::setPulseShape(uint16_t pulseWidthUs, uint16_t interPhaseUs) {
+    const uint32_t pairUs = isBiphasic() ? (2UL * pulseWidthUs + interPhaseUs) : pulseWidthUs;
+    const uint32_t delayTicks = (uint32_t)(pulseWidthUs + interPhaseUs) * kDeadtimeTicksPerUs;
+
+    if (pulseWidthUs == 0 || pairUs >= pulsePeriodUs_ ||
+        (isBiphasic() && delayTicks > kMaxDeadtimeTicks)) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&mux_);
+    pwUs_ = pulseWidthUs;
+    interPhaseUs_ = interPhaseUs;
+
+    // Строб закрываем посередине тишины после последней пары пачки,
+    // чтобы не отрезать импульс и не пропустить лишний
+    gateOpenUs_ = (pulsesPerBurst_ - 1) * pulsePeriodUs_ + pairUs + (pulsePeriodUs_ - pairUs) / 2;
+    gateClosedUs_ = fullCycleUs_ - gateOpenUs_;
+    portEXIT_CRITICAL(&mux_);
+
+    if (gateTimer_ != nullptr) {
+        applyShape();
+    }
+    return true;
+}
+
+void MCPWMPulseGenerator::setAmplitudeOutput(uint8_t pin, uint8_t ledcChannel) {
+    ampPin_ = (int8_t)pin;
+    ampChannel_ = ledcChannel;
+}
+
+bool MCPWMPulseGenerator::begin() {
+    const mcpwm_io_signals_t sigA = (mcpwm_io_signals_t)(MCPWM0A + 2 * timer_);
+    const mcpwm_io_signals_t sigB = (mcpwm_io_signals_t)(MCPWM0B + 2 * timer_);
+
+    mcpwm_gpio_init(unit_, sigB, phase1Pin_);
+    if (isBiphasic()) {
+        mcpwm_gpio_init(unit_, sigA, phase2Pin_);
+    }
+
+    mcpwm_config_t config = {};
+    config.frequency = rateHz_;            // период таймера = период импульсов
+    config.cmpr_a = 0;
+    config.cmpr_b = 0;
+    config.counter_mode = MCPWM_UP_COUNTER;
+    config.duty_mode = MCPWM_DUTY_MODE_0;
+
+    if (mcpwm_init(unit_, timer_, &config) != ESP_OK) {
+        Serial.printf("[MCPWM%d T%d] ERROR: Failed to init MCPWM!\n", unit_, timer_);
+        return false;
+    }
+
+    // mcpwm_init сразу запускает таймер - держим выходы в LOW до start()
+    closeGate();
+
+    if (ampPin_ >= 0) {
+        ledcSetup(ampChannel_, kAmplitudeFreqHz, kAmplitudeBits);
+        ledcAttachPin(ampPin_, ampChannel_);
+        writeAmplitude();
+    }
+
+    if (gateTimer_ == nullptr) {
+        esp_timer_create_args_t args = {};
+        args.callback = &MCPWMPulseGenerator::gateTimerThunk;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "mcpwm_gate";
+
+        if (esp_timer_create(&args, &gateTimer_) != ESP_OK) {
+            Serial.printf("[MCPWM%d T%d] ERROR: Failed to create gate timer!\n", unit_, timer_);
+            gateTimer_ = nullptr;
+            return false;
+        }
+    }
+
+    applyShape();
+    running_ = false;
+
+    Serial.println("[MCPWM] Initialized with parameters:");
+    Serial.printf("  Pulse rate: %d Hz, width: %u us\n", rateHz_, pwUs_);
+    Serial.printf("  Mode: %s (inter-phase %u us)\n",
+                  isBiphasic() ? "biphasic" : "monophasic", interPhaseUs_);
+    if (ampPin_ >= 0) {
+        Serial.printf("  Amplitude level: pin %d (LEDC %u)\n", ampPin_, ampChannel_);
+    }
+
+    return true;
+}
+
+void MCPWMPulseGenerator::start() {
+    if (gateTimer_ == nullptr) {
+        return;
+    }
+    esp_timer_stop(gateTimer_);
+
+    portENTER_CRITICAL(&mux_);
+    running_ = true;
+    nextEdgeTs_ = micros() + gateOpenUs_;
+    openGate();
+    portEXIT_CRITICAL(&mux_);
+
+    scheduleNextEdge();
+
+    Serial.printf("[MCPWM%d T%d] ✅ Started on pin %d\n", unit_, timer_, phase1Pin_);
+}
+
+void MCPWMPulseGenerator::stop() {
+    if (gateTimer_ != nullptr) {
+        esp_timer_stop(gateTimer_);
+    }
+
+    portENTER_CRITICAL(&mux_);
+    running_ = false;
+    closeGate();
+    portEXIT_CRITICAL(&mux_);
+
+    Serial.printf("[MCPWM%d T%d] ⛔ Stopped\n", unit_, timer_);
+}
+
+void MCPWMPulseGenerator::setParams(uint8_t amplitudePercent) {
+    // Форма импульса не меняется - только уровень; 0% проверит openGate()
+    portENTER_CRITICAL(&mux_);
+    amp_ = constrain(amplitudePercent, 0, 100);
+    portEXIT_CRITICAL(&mux_);
+
+    writeAmplitude();
+}
+
+void MCPWMPulseGenerator::writeAmplitude() {
+    if (ampPin_ < 0) {
+        return;
+    }
+    const uint32_t maxLevel = (1UL << kAmplitudeBits) - 1;
+    ledcWrite(ampChannel_, (uint32_t)amp_ * maxLevel / 100);
+}
+
+void MCPWMPulseGenerator::applyShape() {
+    // Компараторы/dead-time теневые - новые значения вступают с ближайшего TEZ
+    portENTER_CRITICAL(&mux_);
+    const uint32_t phaseUs = pwUs_;
+    const uint32_t gapUs = interPhaseUs_;
+    portEXIT_CRITICAL(&mux_);
+
+    mcpwm_set_duty_in_us(unit_, timer_, MCPWM_GEN_B, phaseUs);
+
+    if (isBiphasic()) {
+        mcpwm_set_duty_in_us(unit_, timer_, MCPWM_GEN_A, 2 * phaseUs + gapUs);
+        mcpwm_deadtime_enable(unit_, timer_, MCPWM_BYPASS_FED,
+                              (phaseUs + gapUs) * kDeadtimeTicksPerUs, 0);
+    }
+}
+
+void MCPWMPulseGenerator::openGate() {
+    // Нулевая амплитуда - пачка не выходит (строб отрабатывает вхолостую)
+    if (amp_ == 0) {
+        gateOpen_ = true;
+        return;
+    }
+
+    mcpwm_set_duty_type(unit_, timer_, MCPWM_GEN_B, MCPWM_DUTY_MODE_0);
+    if (isBiphasic()) {
+        mcpwm_set_duty_type(unit_, timer_, MCPWM_GEN_A, MCPWM_DUTY_MODE_0);
+    }
+    // Таймер стоит в нуле (остановлен на TEZ) - первый импульс выходит сразу
+    mcpwm_start(unit_, timer_);
+    gateOpen_ = true;
+}
+
+void MCPWMPulseGenerator::closeGate() {
+    mcpwm_set_signal_low(unit_, timer_, MCPWM_GEN_B);
+    if (isBiphasic()) {
+        mcpwm_set_signal_low(unit_, timer_, MCPWM_GEN_A);
+    }
+    mcpwm_stop(unit_, timer_);
+    gateOpen_ = false;
+}
+
+void MCPWMPulseGenerator::gateTimerThunk(void* arg) {
+    static_cast<MCPWMPulseGenerator*>(arg)->onGateTimer();
+}
+
+void MCPWMPulseGenerator::onGateTimer() {
+    portENTER_CRITICAL(&mux_);
+    if (!running_) {
+        portEXIT_CRITICAL(&mux_);
+        return;
+    }
+
+    if (gateOpen_) {
+        closeGate();
+        nextEdgeTs_ += gateClosedUs_;
+    } else {
+        openGate();
+        nextEdgeTs_ += gateOpenUs_;
+    }
+    portEXIT_CRITICAL(&mux_);
+
+    scheduleNextEdge();
+}
+
+void MCPWMPulseGenerator::scheduleNextEdge() {
+    // Как в EMSPulseGenerator: задержка от идеального времени фронта
+    portENTER_CRITICAL(&mux_);
+    const bool running = running_;
+    const int32_t delayUs = (int32_t)(nextEdgeTs_ - micros());
+    portEXIT_CRITICAL(&mux_);
+
+    if (running) {
+        esp_timer_start_once(gateTimer_, (delayUs > 0) ? (uint64_t)delayUs : 1);
+    }
+}
@@ -0,0 +1,372 @@
+#include "drivers/RMTWaveformGenerator.h"
+
+// Перезапуск RMT (stop + заполнение памяти + start) должен закончиться до
+// начала пачки: ближе к ней подмена переносится на следующий цикл
+static constexpr uint32_t SWAP_GUARD_US = 500;
+
+// ============================================
+// Сборщик RMT-символов
+// ============================================
+class RMTWaveformGenerator::ItemWriter {
+public:
+    ItemWriter(rmt_item32_t* items, uint16_t capacity)
+        : items_(items)
+        , capacity_(capacity)
+    {}
+
+    // Добавить участок уровня level длительностью ticks (соседние склеиваются)
+    bool add(uint32_t level, uint32_t ticks) {
+        if (ticks == 0) {
+            return ok_;
+        }
+        if (runTicks_ > 0 && level == runLevel_) {
+            runTicks_ += ticks;
+            return ok_;
+        }
+        flush(0);
+        runLevel_ = level;
+        runTicks_ = ticks;
+        return ok_;
+    }
+
+    // Дописать последний участок и нулевой символ-терминатор
+    bool finish(uint16_t& count) {
+        // Символ содержит две половины: общее число половин должно быть четным,
+        // иначе последний участок режем на одну часть больше
+        const uint32_t pieces = piecesFor(runTicks_);
+        flush(((halves_ + pieces) & 1u) ? 1 : 0);
+
+        if (halves_ & 1u) {
+            // Последний участок длиной 1 тик - делить нечего, дополняем тиком
+            items_[halves_ / 2].duration1 = 1;
+            items_[halves_ / 2].level1 = items_[halves_ / 2].level0;
+            halves_++;
+        }
+
+        const uint16_t used = halves_ / 2;
+        if (!ok_ || used + 1 > capacity_) {
+            return false;
+        }
+        items_[used].val = 0;
+        count = used + 1;
+        return true;
+    }
+
+private:
+    static uint32_t piecesFor(uint32_t ticks) {
+        return (ticks + kMaxRunTicks - 1) / kMaxRunTicks;
+    }
+
+    void flush(uint32_t extraPieces) {
+        if (runTicks_ == 0) {
+            return;
+        }
+        uint32_t pieces = piecesFor(runTicks_) + extraPieces;
+        if (pieces > runTicks_) {
+            pieces = runTicks_;
+        }
+
+        // Делим участок на pieces почти равных частей (каждая <= kMaxRunTicks)
+        uint32_t left = runTicks_;
+        for (uint32_t i = pieces; i > 0; --i) {
+            const uint32_t part = left / i;
+            emitHalf(runLevel_, part);
+            left -= part;
+        }
+        runTicks_ = 0;
+    }
+
+    void emitHalf(uint32_t level, uint32_t ticks) {
+        const uint16_t idx = halves_ / 2;
+        if (idx >= capacity_) {
+            ok_ = false;
+            halves_ += 1;
+            return;
+        }
+        if ((halves_ & 1u) == 0) {
+            items_[idx].val = 0;
+            items_[idx].duration0 = ticks;
+            items_[idx].level0 = level;
+        } else {
+            items_[idx].duration1 = ticks;
+            items_[idx].level1 = level;
+        }
+        halves_++;
+    }
+
+    rmt_item32_t* items_;
+    uint16_t capacity_;
+    uint32_t halves_ = 0;
+    uint32_t runLevel_ = 0;
+    uint32_t runTicks_ = 0;
+    bool     ok_ = true;
+};
+
+// ============================================
+// Генератор
+// ============================================
+
+RMTWaveformGenerator::RMTWaveformGenerator(rmt_channel_t rmtChannel,
+                                           uint8_t  outputPin,
+                                           uint32_t carrierFreq,
+                                           uint8_t  pwmResolution,
+                                           uint16_t pwmDuty,
+                                           uint8_t  memBlocks,
+                                           const StimProfile& profile)
+    : rmtChannel_(rmtChannel),
+      outputPin_(outputPin),
+      carrierFreq_(carrierFreq),
+      pwmResolution_(pwmResolution),
+      pwmDuty_(pwmDuty),
+      memBlocks_(memBlocks)
+{
+    maxDuty_ = (1 << pwmResolution_) - 1;
+    if (pwmDuty_ > maxDuty_) {
+        pwmDuty_ = maxDuty_;
+    }
+
+    // TX-каналы S3 могут занимать блоки памяти соседних каналов (0..3)
+    const uint8_t maxBlocks = SOC_RMT_TX_CANDIDATES_PER_GROUP - (uint8_t)rmtChannel_;
+    memBlocks_ = constrain(memBlocks_, 1, maxBlocks);
+    capacity_ = memBlocks_ * SOC_RMT_MEM_WORDS_PER_CHANNEL;
+
+    // Производные параметры уже посчитаны в профиле
+    const StimProfile& p = profile.isValid() ? profile : DefaultStimProfile::value;
+    burstDurationUs_ = p.burstDurationUs;
+    pauseDurationUs_ = p.pauseDurationUs;
+    fullCycleUs_ = p.fullCycleUs;
+}
+
+bool RMTWaveformGenerator::begin() {
+    rmt_config_t config = {};
+    config.rmt_mode = RMT_MODE_TX;
+    config.channel = rmtChannel_;
+    config.gpio_num = outputPin_;
+    config.clk_div = kClkDiv;
+    config.mem_block_num = memBlocks_;
+    config.tx_config.loop_en = true;
+    config.tx_config.carrier_en = false;
+    config.tx_config.carrier_level = RMT_CARRIER_LEVEL_HIGH;
+    config.tx_config.idle_output_en = true;
+    config.tx_config.idle_level = RMT_IDLE_LEVEL_LOW;
+
+    if (rmt_config(&config) != ESP_OK || rmt_driver_install(rmtChannel_, 0, 0) != ESP_OK) {
+        Serial.printf("[RMT CH%d] ERROR: Failed to configure RMT!\n", rmtChannel_);
+        return false;
+    }
+
+    if (!compile(pwmDuty_, 0, *active_)) {
+        Serial.printf("[RMT CH%d] ERROR: Waveform does not fit %u items!\n", rmtChannel_, capacity_);
+        return false;
+    }
+
+    if (swapTimer_ == nullptr) {
+        esp_timer_create_args_t args = {};
+        args.callback = &RMTWaveformGenerator::swapTimerThunk;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "rmt_swap";
+
+        if (esp_timer_create(&args, &swapTimer_) != ESP_OK) {
+            Serial.printf("[RMT CH%d] ERROR: Failed to create swap timer!\n", rmtChannel_);
+            swapTimer_ = nullptr;
+            return false;
+        }
+    }
+
+    running_ = false;
+
+    Serial.println("[RMT] Initialized with parameters:");
+    Serial.printf("  Carrier: %lu Hz (%s)\n", carrierFreq_,
+                  active_->hwCarrier ? "hw modulator" : "rendered");
+    Serial.printf("  Items: %u / %u\n", active_->count, capacity_);
+
+    return true;
+}
+
+void RMTWaveformGenerator::start() {
+    if (swapTimer_ == nullptr) {
+        return;
+    }
+    esp_timer_stop(swapTimer_);
+
+    // Ждущая форма (а без нее - текущая, подмененная до stop()) рендерилась
+    // для подмены в середине паузы; со старта нужна пачка сразу -
+    // перерисовываем ее без сдвига и ставим как ждущую
+    portENTER_CRITICAL(&mux_);
+    const Waveform* const next = hasPending_ ? pending_ : active_;
+    const bool restage = next->leadPauseUs != 0;
+    const uint16_t duty = pwmDuty_;
+    portEXIT_CRITICAL(&mux_);
+    if (restage && compile(duty, 0, *free_)) {
+        portENTER_CRITICAL(&mux_);
+        Waveform* const staged = free_;
+        free_ = pending_;
+        pending_ = staged;
+        hasPending_ = true;
+        portEXIT_CRITICAL(&mux_);
+    }
+
+    portENTER_CRITICAL(&mux_);
+    if (hasPending_) {
+        Waveform* const loaded = pending_;
+        pending_ = active_;
+        active_ = loaded;
+        hasPending_ = false;
+    }
+    loadLocked(*active_);
+    running_ = true;
+    portEXIT_CRITICAL(&mux_);
+
+    Serial.printf("[RMT CH%d] ✅ Started on pin %d\n", rmtChannel_, outputPin_);
+}
+
+void RMTWaveformGenerator::stop() {
+    if (swapTimer_ != nullptr) {
+        esp_timer_stop(swapTimer_);
+    }
+
+    portENTER_CRITICAL(&mux_);
+    running_ = false;
+    rmt_tx_stop(rmtChannel_);  // выход уходит в idle (LOW)
+    portEXIT_CRITICAL(&mux_);
+
+    Serial.printf("[RMT CH%d] ⛔ Stopped\n", rmtChannel_);
+}
+
+void RMTWaveformGenerator::setParams(uint8_t amplitudePercent) {
+    const uint8_t amp = constrain(amplitudePercent, 0, 100);
+    const uint16_t duty = map(amp, 0, 100, 0, maxDuty_);
+
+    // Компиляция вне критической секции в свободный буфер (его не читает
+    // никто, кроме setParams); под mux_ - только обмен указателями.
+    // Буфер начинается с середины паузы - там его и подменят
+    if (!compile(duty, pauseDurationUs_ / 2, *free_)) {
+        Serial.printf("[RMT CH%d] WARN: Waveform does not fit %u items, ignored\n",
+                      rmtChannel_, capacity_);
+        return;
+    }
+
+    portENTER_CRITICAL(&mux_);
+    Waveform* const staged = free_;
+    free_ = pending_;
+    pending_ = staged;
+    hasPending_ = true;
+    pwmDuty_ = duty;
+    const bool running = running_;
+    portEXIT_CRITICAL(&mux_);
+
+    if (running) {
+        armSwap();  // иначе подхватится в start()
+    }
+}
+
+uint32_t RMTWaveformGenerator::phaseAt(int64_t nowUs) const {
+    const int64_t cycle = (int64_t)fullCycleUs_;
+    const int64_t phase = (nowUs - cycleOriginUs_) % cycle;
+    return (uint32_t)((phase < 0) ? phase + cycle : phase);
+}
+
+void RMTWaveformGenerator::armSwap() {
+    // Начало буфера pending_ - за leadPauseUs до пачки, т.е. фаза cycle - lead
+    portENTER_CRITICAL(&mux_);
+    const uint32_t target = fullCycleUs_ - pending_->leadPauseUs;
+    const uint32_t phase = phaseAt(esp_timer_get_time());
+    portEXIT_CRITICAL(&mux_);
+
+    uint32_t delayUs = (target + fullCycleUs_ - phase) % fullCycleUs_;
+    if (delayUs == 0) {
+        delayUs = 1;
+    }
+    esp_timer_stop(swapTimer_);
+    esp_timer_start_once(swapTimer_, delayUs);
+}
+
+bool RMTWaveformGenerator::compile(uint16_t duty, uint32_t leadPauseUs, Waveform& wf) const {
+    ItemWriter writer(wf.items, capacity_);
+    wf.hwCarrier = false;
+    wf.carrierHighTicks = 1;
+    wf.carrierLowTicks = 1;
+    wf.leadPauseUs = (leadPauseUs < pauseDurationUs_) ? leadPauseUs : pauseDurationUs_;
+
+    // Цикл в буфере: [часть паузы][пачка][остаток паузы] - тот же цикл,
+    // начатый с другой фазы (проигрывается по кругу)
+    writer.add(0, wf.leadPauseUs);
+
+    if (duty == 0) {
+        writer.add(0, fullCycleUs_ - wf.leadPauseUs);
+        return writer.finish(wf.count);
+    }
+
+    // Период несущей в тактах APB (для аппаратного модулятора)
+    const uint32_t periodApb = kApbHz / carrierFreq_;
+    const uint32_t highApb = (uint64_t)periodApb * duty / maxDuty_;
+    const uint32_t lowApb = periodApb - highApb;
+
+    if (duty >= maxDuty_) {
+        // 100% - сплошная огибающая
+        writer.add(1, burstDurationUs_);
+    } else if (highApb >= 1 && lowApb >= 1 &&
+               highApb <= kMaxCarrierTicks && lowApb <= kMaxCarrierTicks) {
+        // Несущую делает модулятор RMT, в буфере только огибающая
+        wf.hwCarrier = true;
+        wf.carrierHighTicks = highApb;
+        wf.carrierLowTicks = lowApb;
+        writer.add(1, burstDurationUs_);
+    } else {
+        // Низкая несущая: явные периоды, как их выдал бы LEDC
+        const uint32_t periodUs = 1000000UL / carrierFreq_;
+        const uint32_t highUs = (uint64_t)periodUs * duty / maxDuty_;
+        const uint32_t periods = burstDurationUs_ / periodUs;
+
+        for (uint32_t i = 0; i < periods; ++i) {
+            writer.add(1, highUs);
+            writer.add(0, periodUs - highUs);
+        }
+        writer.add(0, burstDurationUs_ - periods * periodUs);
+    }
+
+    writer.add(0, pauseDurationUs_ - wf.leadPauseUs);
+    return writer.finish(wf.count);
+}
+
+void RMTWaveformGenerator::loadLocked(const Waveform& wf) {
+    rmt_tx_stop(rmtChannel_);
+    rmt_set_tx_carrier(rmtChannel_, wf.hwCarrier,
+                       wf.carrierHighTicks, wf.carrierLowTicks,
+                       RMT_CARRIER_LEVEL_HIGH);
+    rmt_fill_tx_items(rmtChannel_, wf.items, wf.count, 0);
+    rmt_tx_start(rmtChannel_, true);
+    cycleOriginUs_ = esp_timer_get_time() + wf.leadPauseUs;
+}
+
+void RMTWaveformGenerator::swapTimerThunk(void* arg) {
+    static_cast<RMTWaveformGenerator*>(arg)->onSwapTimer();
+}
+
+void RMTWaveformGenerator::onSwapTimer() {
+    portENTER_CRITICAL(&mux_);
+    if (!running_ || !hasPending_) {
+        portEXIT_CRITICAL(&mux_);
+        return;
+    }
+
+    // Колбэк мог прийти с задержкой: до пачки старой формы должно остаться
+    // больше SWAP_GUARD_US, иначе перезапуск ее обрежет. Пауза короче
+    // 2 * SWAP_GUARD_US этого запаса не дает - там подмена сразу
+    const uint32_t phase = phaseAt(esp_timer_get_time());
+    const uint32_t untilBurst = (phase < burstDurationUs_) ? 0 : fullCycleUs_ - phase;
+    const bool safe = untilBurst > SWAP_GUARD_US || pending_->leadPauseUs <= SWAP_GUARD_US;
+    if (safe) {
+        Waveform* const loaded = pending_;
+        pending_ = active_;
+        active_ = loaded;
+        hasPending_ = false;
+        loadLocked(*active_);
+    }
+    portEXIT_CRITICAL(&mux_);
+
+    if (!safe) {
+        armSwap();  // следующая пауза
+    }
+}
@@ -1,19 +1,58 @@
 #include <Arduino.h>
 #include <esp_task_wdt.h>
-#include "drivers/EncoderEC12.h"
-#include "drivers/EncoderC14.h"
+#include "drivers/EncoderPCNT.h"
+#include "drivers/EncoderSampler.h"
+#include "drivers/EncoderGpioDispatcher.h"
 #include "drivers/EMSPulseGenerator.h"
 #include "app/pins.h"
+#include "app/StimChannelBank.h"
 #include "app/AppState.h"
-#include "app/CommandQueue.h"
+#include "app/StimCommandBus.h"
+#include "app/SettingsStore.h"
+#include "core/Profiler.h"
+#include "core/DeferredLog.h"
+#include "core/LatencyHistogram.h"
+#include "core/TraceRecorder.h"
 
 // ============================================
 // Глобальные объекты
 // ============================================
 static AppState appState;
-static CommandQueue commandQueue(10);
-static EncoderEC12 encoderA(ENC_A_CLK_PIN, ENC_A_DT_PIN, 1000);
-static EncoderC14  encoderB(ENC_B_CLK_PIN, ENC_B_DT_PIN, 50);
+// UI_Task -> Stim_Task: аварийная полоса и START/STOP
+// (параметры UI публикует прямо в генератор готовым TimingPlan)
+static StimCommandBus commandBus;
+// Энкодеры и параметры каналов в NVS (фоновая запись с объединением)
+static SettingsStore settingsStore;
+// Декодирование энкодеров:
+//  Pcnt           - аппаратные счетчики PCNT с фильтром: одно прерывание порога на шаг
+//  TimerSampled   - опрос таймером 4 кГц с программным фильтром: ISR по часам, а не по фронтам
+//  GpioDispatched - один обработчик GPIO на все ручки: пачка фронтов - один вход в ISR
+// A считает как EC12 (шаг на цикл), B - как C14 (шаг на переход, знак обратный)
+enum class EncoderInput : uint8_t {
+    Pcnt,
+    TimerSampled,
+    GpioDispatched
+};
+constexpr EncoderInput ENCODER_INPUT = EncoderInput::Pcnt;
+constexpr uint32_t ENCODER_SAMPLE_HZ = 4000;
+
+static EncoderPCNT    pcntEncoderA(ENC_A_CLK_PIN, ENC_A_DT_PIN, PCNT_UNIT_0, 4, false, 10);
+static EncoderPCNT    pcntEncoderB(ENC_B_CLK_PIN, ENC_B_DT_PIN, PCNT_UNIT_1, 1, true, 10);
+static SampledEncoder sampledEncoderA(ENC_A_CLK_PIN, ENC_A_DT_PIN, 4, false, 1000);
+static SampledEncoder sampledEncoderB(ENC_B_CLK_PIN, ENC_B_DT_PIN, 1, true, 1000);
+static EncoderSampler encoderSampler(ENCODER_SAMPLE_HZ);
+static DispatchedEncoder dispatchedEncoderA(ENC_A_CLK_PIN, ENC_A_DT_PIN, 4, false);
+static DispatchedEncoder dispatchedEncoderB(ENC_B_CLK_PIN, ENC_B_DT_PIN, 1, true);
+static EncoderGpioDispatcher encoderDispatcher;
+
+static IEncoder& encoderA =
+    ENCODER_INPUT == EncoderInput::TimerSampled   ? static_cast<IEncoder&>(sampledEncoderA) :
+    ENCODER_INPUT == EncoderInput::GpioDispatched ? static_cast<IEncoder&>(dispatchedEncoderA) :
+                                                    static_cast<IEncoder&>(pcntEncoderA);
+static IEncoder& encoderB =
+    ENCODER_INPUT == EncoderInput::TimerSampled   ? static_cast<IEncoder&>(sampledEncoderB) :
+    ENCODER_INPUT == EncoderInput::GpioDispatched ? static_cast<IEncoder&>(dispatchedEncoderB) :
+                                                    static_cast<IEncoder&>(pcntEncoderB);
 //static EMSPulseGenerator stim;
 
 // 🔥 ДВА НЕЗАВИСИМЫХ ГЕНЕРАТОРА
@@ -23,6 +62,22 @@ EMSPulseGenerator pwm_stim_1(0, PWM_CH_1_PIN, 144, 10, 70);
 // Генератор 2: PWM канал 1, пин 2, частота 144 Гц, разрешение 10 бит
 EMSPulseGenerator pwm_stim_2(1, PWM_CH_2_PIN, 1245, 10, 110);
 
+// Все генераторы обслуживает один банк с общей шкалой фронтов
+static StimChannelBank stimBank;
+static int8_t stimCh1 = -1;
+static int8_t stimCh2 = -1;
+
+// Порядок совпадает с StoredSettings::channels
+static EMSPulseGenerator* const stimGenerators[StoredSettings::kChannels] = {
+    &pwm_stim_1, &pwm_stim_2
+};
+
+// Программа стимуляции, загруженная из консоли (общая для обоих каналов).
+// Генераторы читают ее на каждом фронте, поэтому перезаписывает ее только
+// Stim_Task и только при остановленных каналах
+static StimProgram stimProgram;
+static uint8_t     stimProgramCode[StimCommandBus::kProgramCapacity];
+
 // ============================================
 // Константы
 // ============================================
@@ -30,10 +85,47 @@ constexpr int STEPS_PER_REV = 20;
 constexpr uint32_t WDT_TIMEOUT_SEC = 5;
 
 // Настройки производительности
-constexpr uint32_t UI_TASK_DELAY_MS = 10;
+// UI_Task спит до щелчка энкодера (уведомление из ISR) и просыпается сам
+// только на обслуживание (WDT, статистика)
+constexpr uint32_t UI_HOUSEKEEPING_MS = 1000;
 constexpr uint32_t STIM_TASK_DELAY_MS = 0;
+// Статистику печатает консоль loop() (Core 1, ниже Stim_Task), а не UI_Task:
+// вывод в Serial не задерживает щелчки. 0 - только по команде 's'
 constexpr uint32_t STATS_INTERVAL_MS = 10000;
 
+// Фронты пачек формирует один esp_timer банка каналов: Stim_Task не крутится
+// в опросе, а спит в очереди команд (таймаут нужен только для счетчика циклов)
+constexpr bool     STIM_TIMER_DRIVEN = true;
+constexpr uint32_t STIM_CMD_WAIT_MS = 100;
+
+// Плавность амплитуды: выход на новую цель энкодера и мягкий старт.
+// Скважность меняется раз в пачку, цикл профилей ~415 мс: 2500 мс - ~6
+// ступенек на шаг энкодера, 6000 мс - ~14 ступенек от нуля при старте
+constexpr uint32_t STIM_SLEW_RAMP_MS = 2500;
+constexpr uint32_t STIM_SOFT_START_MS = 6000;
+
+// Настройки: каналом управляет UI (индекс в StoredSettings::channels);
+// флеш пишем, только если до ближайшего фронта не меньше окна
+constexpr uint8_t  SETTINGS_UI_CHANNEL = 1;
+constexpr uint32_t SETTINGS_FLASH_WINDOW_US = 20000;
+constexpr UBaseType_t SETTINGS_TASK_PRIORITY = 0;   // ниже UI_Task
+
+// Вывод отложенного лога (DeferredLog): ниже всех рабочих задач, на Core 0
+constexpr UBaseType_t LOG_TASK_PRIORITY = 0;
+constexpr BaseType_t  LOG_TASK_CORE = 0;
+
+// Трасса событий (сборка с -DTRACE_ENABLED=1): емкость кольца в PSRAM
+constexpr size_t   TRACE_CAPACITY_EVENTS = TraceRecorder::kDefaultCapacity;
+
+// Построчная консоль loop() (Serial, строка до '\n'):
+//   t          - дамп трассы (host/tools/tracedump -> Chrome JSON)
+//   r          - начать запись трассы заново
+//   s / d      - статистика системы / подробно по задачам (окно - с прошлого вывода)
+//   p <hex>    - загрузить программу стимуляции (байткод: host/tools/stimc -x)
+//   p          - вернуть фиксированный цикл
+constexpr uint32_t CONSOLE_POLL_MS = 100;
+constexpr size_t   CONSOLE_LINE_MAX = 2 * StimCommandBus::kProgramCapacity + 16;
+
 // Размеры стека
 constexpr uint32_t UI_TASK_STACK_SIZE = 8192;
 constexpr uint32_t STIM_TASK_STACK_SIZE = 8192;
@@ -52,66 +144,29 @@ struct TaskStats {
     uint32_t lastPrintTime = 0;
     uint32_t commandsSent = 0;
     uint32_t commandsReceived = 0;
-    uint32_t maxLoopTime = 0;
+    // Длительность прохода цикла, мкс (пишет только сама задача)
+    LatencyHistogram loopUs;
     int8_t coreId = -1;
-    float cpuUsage = 0.0f;
-    
-    // НОВОЕ: Накопительное время выполнения
-    uint64_t totalActiveTimeUs = 0;  // Общее активное время в микросекундах
 };
 
 static TaskStats uiStats;
 static TaskStats stimStats;
-
-// Статистика для расчета загрузки CPU
-struct CpuStats {
-    uint32_t lastUpdateTime = 0;
-    uint64_t lastUiActiveTime = 0;   // ИЗМЕНЕНО: uint64_t
-    uint64_t lastStimActiveTime = 0; // ИЗМЕНЕНО: uint64_t
-    float core0Usage = 0.0f;
-    float core1Usage = 0.0f;
-};
-static CpuStats cpuStats;
-
-// ============================================
-// ИСПРАВЛЕННАЯ функция расчета загрузки CPU
-// ============================================
-static void updateCpuUsage() {
-    uint32_t currentTime = millis();
-    uint32_t deltaTime = currentTime - cpuStats.lastUpdateTime;
-
-    if (deltaTime == 0 || cpuStats.lastUpdateTime == 0) {
-        cpuStats.lastUpdateTime = currentTime;
-        cpuStats.lastUiActiveTime = uiStats.totalActiveTimeUs;
-        cpuStats.lastStimActiveTime = stimStats.totalActiveTimeUs;
-        return;
+static uint32_t  lastStatsTime = 0;
+
+// Загрузка ядер и задач - из FreeRTOS (run-time stats или выборка по тикам),
+// время обработчиков - по тактам CCOUNT (см. Profiler)
+static Profiler profiler;
+static IsrProfile encoderIsrProfile("encoders");
+static IsrProfile stimTimerProfile("stim_bank");
+
+// Загрузка задачи из снимка профайлера (-1 - задача не отслеживается)
+static float taskLoad(const Profiler::Snapshot& snapshot, TaskHandle_t task) {
+    for (uint8_t i = 0; i < snapshot.taskCount; ++i) {
+        if (task != nullptr && snapshot.tasks[i].handle == task) {
+            return snapshot.tasks[i].percent;
+        }
     }
-
-    // Рассчитываем активное время за период
-    uint64_t uiActiveUs = uiStats.totalActiveTimeUs - cpuStats.lastUiActiveTime;
-    uint64_t stimActiveUs = stimStats.totalActiveTimeUs - cpuStats.lastStimActiveTime;
-
-    // Переводим deltaTime в микросекунды
-    uint64_t deltaTimeUs = (uint64_t)deltaTime * 1000ULL;
-
-    // Процент загрузки = (активное время / общее время) * 100
-    uiStats.cpuUsage = ((float)uiActiveUs / (float)deltaTimeUs) * 100.0f;
-    stimStats.cpuUsage = ((float)stimActiveUs / (float)deltaTimeUs) * 100.0f;
-
-    // Ограничиваем значения
-    if (uiStats.cpuUsage > 100.0f) uiStats.cpuUsage = 100.0f;
-    if (uiStats.cpuUsage < 0.0f) uiStats.cpuUsage = 0.0f;
-    if (stimStats.cpuUsage > 100.0f) stimStats.cpuUsage = 100.0f;
-    if (stimStats.cpuUsage < 0.0f) stimStats.cpuUsage = 0.0f;
-
-    // Обновляем для следующего расчета
-    cpuStats.lastUpdateTime = currentTime;
-    cpuStats.lastUiActiveTime = uiStats.totalActiveTimeUs;
-    cpuStats.lastStimActiveTime = stimStats.totalActiveTimeUs;
-
-    // Загрузка по ядрам
-    cpuStats.core0Usage = uiStats.cpuUsage;
-    cpuStats.core1Usage = stimStats.cpuUsage;
+    return -1.0f;
 }
 
 static void printCoreInfo() {
@@ -142,27 +197,35 @@ static float wrapDegrees(float degrees) {
     return degrees;
 }
 
-static void printTaskInfo(const char* taskName, const TaskStats& stats) {
-    Serial.printf("[%s] Core:%d Loops:%lu Cmds:%lu MaxLoop:%lu µs CPU:%.1f%%\n",
+static void printTaskInfo(const char* taskName, const TaskStats& stats, float cpuUsage,
+                          const LatencyHistogram::Snapshot& loop) {
+    Serial.printf("[%s] Core:%d Loops:%lu Cmds:%lu CPU:%.1f%%\n",
                   taskName,
                   stats.coreId,
                   stats.loopCount,
                   (taskName[0] == 'U') ? stats.commandsSent : stats.commandsReceived,
-                  stats.maxLoopTime,
-                  stats.cpuUsage);
+                  cpuUsage);
+    Serial.printf("[%s] Loop µs p50/p90/p99/p99.9/max: %lu/%lu/%lu/%lu/%lu (%lu loops)\n",
+                  taskName,
+                  (unsigned long)loop.p50, (unsigned long)loop.p90, (unsigned long)loop.p99,
+                  (unsigned long)loop.p999, (unsigned long)loop.max, (unsigned long)loop.count);
 }
 
+// Снимки профайлера и окна гистограмм берет только консоль loop()
 static void printSystemStats() {
-    // Обновляем статистику загрузки CPU
-    updateCpuUsage();
+    // Загрузка за окно с прошлого вывода
+    lastStatsTime = millis();
+    Profiler::Snapshot load;
+    profiler.takeSnapshot(load);
 
     Serial.println("\n╔════════════════════════════════════════════╗");
     Serial.println("║          System Statistics                 ║");
     Serial.println("╠════════════════════════════════════════════╣");
 
     // Информация о задачах
-    printTaskInfo("UI_Task  ", uiStats);
-    printTaskInfo("Stim_Task", stimStats);
+    // Окно гистограмм циклов - с прошлого вывода (take() сбрасывает)
+    printTaskInfo("UI_Task  ", uiStats, taskLoad(load, uiTaskHandle), uiStats.loopUs.take());
+    printTaskInfo("Stim_Task", stimStats, taskLoad(load, stimTaskHandle), stimStats.loopUs.take());
 
     // Информация о стеке
     if (uiTaskHandle != nullptr) {
@@ -190,18 +253,33 @@ static void printSystemStats() {
 
     // Загрузка ядер CPU
     Serial.println("║                                            ║");
-    Serial.printf("║ Core 0 Usage: %.1f%%                      ║\n", cpuStats.core0Usage);
-    Serial.printf("║ Core 1 Usage: %.1f%%                      ║\n", cpuStats.core1Usage);
+    Serial.printf("║ Core 0 Usage: %.1f%%                      ║\n", load.coreLoad[0]);
+    Serial.printf("║ Core 1 Usage: %.1f%%                      ║\n", load.coreLoad[1]);
+
+    // Обработчики прерываний за то же окно (IsrProfile, такты CCOUNT -> мкс)
+    for (uint8_t i = 0; i < load.isrCount; ++i) {
+        const Profiler::IsrLoad& r = load.isrs[i];
+        Serial.printf("║ ISR %s: %lu calls %.2f%% µs p50/p90/p99/p99.9/max: %.2f/%.2f/%.2f/%.2f/%.2f\n",
+                      r.name, (unsigned long)r.count, r.percent,
+                      r.p50Us, r.p90Us, r.p99Us, r.p999Us, r.maxUs);
+    }
+
+    // Точность фронтов стимуляции (факт - идеал)
+    for (uint8_t ch = 0; ch < stimBank.getChannelCount(); ++ch) {
+        const EdgeErrorStats::Snapshot e = stimBank.getEdgeStats(ch);
+        Serial.printf("║ Stim CH%u edges: %lu err min/mean/p99/max: %ld/%ld/%ld/%ld µs\n",
+                      ch, e.count, e.minUs, e.meanUs, e.p99Us, e.maxUs);
+    }
+
+    // Отложенный лог: потери - кольцо ядра переполнилось
+    Serial.printf("║ Log records: %lu written, %lu dropped\n",
+                  (unsigned long)DeferredLog::getWritten(), (unsigned long)DeferredLog::getDropped());
 
     // Проверка dual-core
     Serial.printf("║ Dual-Core: %s                          ║\n",
                   (uiStats.coreId != stimStats.coreId) ? "✅ YES" : "❌ NO");
 
     Serial.println("╚════════════════════════════════════════════╝\n");
-
-    // Сброс статистики
-    uiStats.maxLoopTime = 0;
-    stimStats.maxLoopTime = 0;
 }
 
  // Функция для вывода детальной информации о задачах
@@ -212,23 +290,15 @@ static void printDetailedTaskStats() {
 
     // Информация о наших задачах
     Serial.println("║ Our Tasks:                                                     ║");
-    Serial.printf("║   UI_Task:   Core %d, Loops: %lu, CPU: %.1f%%\n",
-                  uiStats.coreId, uiStats.loopCount, uiStats.cpuUsage);
-    Serial.printf("║   Stim_Task: Core %d, Loops: %lu, CPU: %.1f%%\n",
-                  stimStats.coreId, stimStats.loopCount, stimStats.cpuUsage);
+    Serial.printf("║   UI_Task:   Core %d, Loops: %lu\n", uiStats.coreId, uiStats.loopCount);
+    Serial.printf("║   Stim_Task: Core %d, Loops: %lu\n", stimStats.coreId, stimStats.loopCount);
 
     Serial.println("║                                                                ║");
 
-    // Информация о стеке
-    if (uiTaskHandle != nullptr) {
-        UBaseType_t waterMark = uxTaskGetStackHighWaterMark(uiTaskHandle);
-        Serial.printf("║   UI Stack Free: %u bytes\n", waterMark * 4);
-    }
-
-    if (stimTaskHandle != nullptr) {
-        UBaseType_t waterMark = uxTaskGetStackHighWaterMark(stimTaskHandle);
-        Serial.printf("║   Stim Stack Free: %u bytes\n", waterMark * 4);
-    }
+    // Ядра, задачи (со стеком) и обработчики прерываний за окно
+    Profiler::Snapshot load;
+    profiler.takeSnapshot(load);
+    Profiler::print(load);
 
     Serial.println("║                                                                ║");
 
@@ -238,17 +308,33 @@ static void printDetailedTaskStats() {
     Serial.printf("║ Min Free Heap: %u bytes\n", ESP.getMinFreeHeap());
     Serial.printf("║ CPU Freq: %u MHz\n", ESP.getCpuFreqMHz());
 
-    Serial.println("║                                                                ║");
-    Serial.println("║ Note: CPU usage is approximate, based on loop counters        ║");
     Serial.println("╚════════════════════════════════════════════════════════════════╝\n");
 }
 
 // ============================================
 // CORE 0: UI Task
 // ============================================
+static StoredSettings captureSettings() {
+    StoredSettings settings;
+    settings.app = appState.getSnapshot();
+    settings.channels[SETTINGS_UI_CHANNEL] = settings.app.params;
+    settings.channelMask = 1U << SETTINGS_UI_CHANNEL;
+    return settings;
+}
+
+// План собирается здесь, на Core 0: генератор на границе пачки только
+// подменяет его целиком (амплитуда, тайминги и несущая - одновременно).
+// Сохранение в NVS UI не касается: SettingsStore подписан на AppState
+static void publishStimParams() {
+    TimingPlan plan;
+    if (EMSPulseGenerator::buildPlan(appState.getStimParams(), plan)) {
+        stimGenerators[SETTINGS_UI_CHANNEL]->publishPlan(plan);
+        uiStats.commandsSent++;
+    }
+}
+
 void uiTask(void* parameter) {
     uiStats.coreId = xPortGetCoreID();
-    uint32_t lastStatsTime = millis();
 
     Serial.printf("[UI_Task] Started on Core %d\n", uiStats.coreId);
     Serial.printf("[UI_Task] Stack size: %u bytes\n", UI_TASK_STACK_SIZE);
@@ -256,35 +342,29 @@ void uiTask(void* parameter) {
     // ✅ ЭНКОДЕР A - ИСПРАВЛЕНО: НЕ вызываем getEncoderAState() внутри lambda
     encoderA.onStep([](int8_t delta) {
         if (appState.adjustEncoderA(delta)) {
-            Command cmd(CommandType::UPDATE_STIM_1_PARAMS, appState.getStimParams());
+            publishStimParams();
 
-            if (commandQueue.send(cmd, 10)) {
-                uiStats.commandsSent++;
-                
-                // ✅ КРИТИЧНО: Простой вывод без дополнительных вызовов AppState
-                Serial.printf("[UI] Enc A: Δ=%d\n", delta);
-            } else {
-                Serial.println("[UI] WARN: Queue full!");
-            }
+            // Вывод отложенный: форматирует и ждет USB-CDC задача лога
+            DeferredLog::printf("[UI] Enc A: Δ=%d\n", delta);
         }
     });
 
     // ✅ ЭНКОДЕР B - ИСПРАВЛЕНО: НЕ вызываем getEncoderBState() внутри lambda
     encoderB.onStep([](int8_t delta) {
         if (appState.adjustEncoderB(delta)) {
-            Command cmd(CommandType::UPDATE_STIM_1_PARAMS, appState.getStimParams());
+            publishStimParams();
 
-             if (commandQueue.send(cmd, 10)) {
-                 uiStats.commandsSent++;
-                
-                // ✅ КРИТИЧНО: Простой вывод без дополнительных вызовов AppState
-                Serial.printf("[UI] Enc B: Δ=%d\n", delta);
-            } else {
-                 Serial.println("[UI] WARN: Queue full!");
-            }
+            // Вывод отложенный: форматирует и ждет USB-CDC задача лога
+            DeferredLog::printf("[UI] Enc B: Δ=%d\n", delta);
         }
     });
 
+    // Щелчок будит эту задачу сразу из ISR - опроса по таймеру нет
+    encoderA.setWakeTask(xTaskGetCurrentTaskHandle());
+    encoderB.setWakeTask(xTaskGetCurrentTaskHandle());
+    encoderA.setIsrProfile(&encoderIsrProfile);
+    encoderB.setIsrProfile(&encoderIsrProfile);
+
     // ✅ ИНИЦИАЛИЗАЦИЯ ЭНКОДЕРОВ
     if (!encoderA.begin()) {
         Serial.println("[UI] ERROR: Encoder A init failed!");
@@ -298,14 +378,41 @@ void uiTask(void* parameter) {
         return;
     }
 
+    // Таймер опроса и обработчик GPIO запускаются отсюда: их прерывания попадут на Core 0
+    if (ENCODER_INPUT == EncoderInput::TimerSampled) {
+        encoderSampler.setIsrProfile(&encoderIsrProfile);
+        if (!encoderSampler.add(sampledEncoderA) || !encoderSampler.add(sampledEncoderB) ||
+            !encoderSampler.begin()) {
+            Serial.println("[UI] ERROR: Encoder sampler init failed!");
+            vTaskDelete(nullptr);
+            return;
+        }
+        Serial.printf("[UI] ✓ Encoder sampler at %lu Hz\n",
+                      (unsigned long)encoderSampler.getSampleHz());
+    } else if (ENCODER_INPUT == EncoderInput::GpioDispatched) {
+        encoderDispatcher.setIsrProfile(&encoderIsrProfile);
+        if (!encoderDispatcher.add(dispatchedEncoderA) || !encoderDispatcher.add(dispatchedEncoderB) ||
+            !encoderDispatcher.begin()) {
+            Serial.println("[UI] ERROR: Encoder GPIO dispatcher init failed!");
+            vTaskDelete(nullptr);
+            return;
+        }
+        Serial.println("[UI] ✓ Encoder GPIO dispatcher: one ISR for all encoders");
+    }
+
     Serial.println("[UI] ✓ Encoders initialized");
     
     // ✅ Вывод начальных значений ВНЕ lambda
     Serial.printf("[UI] Encoder A initial value: %d\n", appState.getEncoderAValue());
     Serial.printf("[UI] Encoder B initial value: %d\n", appState.getEncoderBValue());
 
-    // Основной цикл
+    // Основной цикл: ждем щелчка, работы от других задач (xTaskNotifyGive(uiTaskHandle))
+    // или срока обслуживания. Уведомлений может накопиться несколько - один проход
+    // выбирает все
     while (true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(UI_HOUSEKEEPING_MS));
+
+        TRACE_BEGIN("UI_Task");
         uint32_t loopStart = micros();
         uiStats.loopCount++;
 
@@ -313,23 +420,10 @@ void uiTask(void* parameter) {
         encoderA.update();
         encoderB.update();
 
-        // Периодическая статистика
-        uint32_t now = millis();
-        // if (now - lastStatsTime >= STATS_INTERVAL_MS) {
-        //     lastStatsTime = now;
-        //     printSystemStats();
-        //     appState.printCurrentState();
-        // }
-
         // Измерение времени
-        uint32_t loopTime = micros() - loopStart;
-        if (loopTime > uiStats.maxLoopTime) {
-            uiStats.maxLoopTime = loopTime;
-        }
-
-        uiStats.totalActiveTimeUs += loopTime;
+        uiStats.loopUs.record(micros() - loopStart);
+        TRACE_END("UI_Task");
 
-        vTaskDelay(pdMS_TO_TICKS(UI_TASK_DELAY_MS));
         esp_task_wdt_reset();
     }
 }
@@ -338,20 +432,65 @@ void uiTask(void* parameter) {
 // CORE 1: Stimulation Task
 // ============================================
 
+// Поставить программу из консоли: каналы останавливаются, чтобы ни один
+// генератор не читал stimProgram во время load(), и запускаются заново
+// (с мягким стартом), если работали
+static void applyProgram(const uint8_t* code, size_t size) {
+    const bool wasRunning = appState.isStimRunning();
+    stimBank.stopAll();
+
+    const StimProgram* program = nullptr;
+    if (size > 0) {
+        uint8_t errorIndex = 0;
+        const StimProgramError error = stimProgram.load(code, size, &errorIndex);
+        if (error != StimProgramError::None) {
+            DeferredLog::printf("[Stim] ERROR: Program rejected: %s at %u\n",
+                                StimProgram::errorName(error), (unsigned)errorIndex);
+        } else {
+            program = &stimProgram;
+        }
+    }
+
+    for (uint8_t i = 0; i < StoredSettings::kChannels; ++i) {
+        stimGenerators[i]->setProgram(program);
+    }
+
+    if (wasRunning) {
+        stimBank.startAll();
+    }
+
+    if (program != nullptr) {
+        DeferredLog::printf("[Stim] Program loaded: %u instructions\n", (unsigned)program->size());
+    } else {
+        DeferredLog::printf("[Stim] Fixed cycle\n");
+    }
+}
+
 void stimTask(void* parameter) {
     stimStats.coreId = xPortGetCoreID();
     
     Serial.printf("[Stim_Task] Started on Core %d\n", stimStats.coreId);
     Serial.printf("[Stim_Task] Stack size: %u bytes\n", STIM_TASK_STACK_SIZE);
 
-    if (!pwm_stim_1.begin()) {
-        Serial.println("[Stim1] ERROR: Init failed!");
-        vTaskDelete(nullptr);
-        return;
-    }
+    pwm_stim_1.setRampTimeMs(STIM_SLEW_RAMP_MS);
+    pwm_stim_2.setRampTimeMs(STIM_SLEW_RAMP_MS);
+    pwm_stim_1.setSoftStartMs(STIM_SOFT_START_MS);
+    pwm_stim_2.setSoftStartMs(STIM_SOFT_START_MS);
 
-    if (!pwm_stim_2.begin()) {
-        Serial.println("[Stim2] ERROR: Init failed!");
+    stimCh1 = stimBank.addChannel(pwm_stim_1);
+    stimCh2 = stimBank.addChannel(pwm_stim_2);
+    if (stimCh1 < 0 || stimCh2 < 0) {
+        Serial.println("[Stim] WARN: Channel bank is full!");
+    }
+    stimBank.setWakeMode(STIM_TIMER_DRIVEN ? StimChannelBank::WakeMode::Timer
+                                           : StimChannelBank::WakeMode::Polling);
+    // Колбэк фронтов: в банке - его таймер, в DriveMode::Timer - таймеры генераторов
+    stimBank.setIsrProfile(&stimTimerProfile);
+    pwm_stim_1.setIsrProfile(&stimTimerProfile);
+    pwm_stim_2.setIsrProfile(&stimTimerProfile);
+
+    if (!stimBank.begin()) {
+        Serial.println("[Stim] ERROR: Init failed!");
         vTaskDelete(nullptr);
         return;
     }
@@ -361,51 +500,48 @@ void stimTask(void* parameter) {
     // ✅ АВТОЗАПУСК ПРЯМО ЗДЕСЬ
     delay(100);  // Небольшая задержка
     
-    Serial.println("[Stim1] Auto-starting pwm_stim_1...");
-    pwm_stim_1.start();    
-    Serial.println("[Stim1] ✅ STARTED");
-
-    Serial.println("[Stim2] Auto-starting pwm_stim_2...");
-    pwm_stim_2.start();    
-    Serial.println("[Stim2] ✅ STARTED");
+    Serial.println("[Stim] Auto-starting all channels...");
+    stimBank.startAll();
+    Serial.println("[Stim] ✅ STARTED");
 
     appState.setStimRunning(true);
 
     while (true) {
+        // Обработка команд
+        // В режиме таймера спим до любой публикации: ядро свободно до прихода команды
+        commandBus.wait(STIM_TIMER_DRIVEN ? STIM_CMD_WAIT_MS : 0);
+
+        TRACE_BEGIN("Stim_Task");
         uint32_t loopStart = micros();
         
         stimStats.loopCount++;
 
-        // Обработка команд
+        // Аварийная остановка - раньше всего остального; сбрасывает очередь
+        // и уставки, поставленные до нее
+        if (commandBus.takeEmergencyStop()) {
+            stimStats.commandsReceived++;
+            stimBank.stopAll();
+            appState.setStimRunning(false);
+            settingsStore.commitNow();
+            DeferredLog::printf("[Stim] 🚨 EMERGENCY STOP!\n");
+        }
+
         Command cmd;
-        while (commandQueue.receive(cmd, 0)) {
+        while (commandBus.receiveControl(cmd)) {
             stimStats.commandsReceived++;
             
             switch (cmd.type) {
-                case CommandType::UPDATE_STIM_1_PARAMS:
-                    pwm_stim_2.setParams(cmd.params.stimDuty);                                 
-                    Serial.println("[Stim] Parameters updated");
-                    break;
-                
                 case CommandType::START_STIM:
-                    pwm_stim_1.start();
-                    pwm_stim_2.start();
+                    stimBank.startAll();
                     appState.setStimRunning(true);
-                    Serial.println("[Stim] ✅ STARTED");
+                    DeferredLog::printf("[Stim] ✅ STARTED\n");
                     break;
                 
                 case CommandType::STOP_STIM:
-                    pwm_stim_1.stop();
-                    pwm_stim_2.stop();
+                    stimBank.stopAll();
                     appState.setStimRunning(false);
-                    Serial.println("[Stim] ⛔ STOPPED");
-                    break;
-                
-                case CommandType::EMERGENCY_STOP:
-                    pwm_stim_1.stop();
-                    pwm_stim_2.stop();
-                    appState.setStimRunning(false);
-                    Serial.println("[Stim] 🚨 EMERGENCY STOP!");
+                    settingsStore.commitNow();
+                    DeferredLog::printf("[Stim] ⛔ STOPPED\n");
                     break;
                 
                 default:
@@ -413,15 +549,22 @@ void stimTask(void* parameter) {
             }
         }
 
-        // Обновление генератора
-        if (appState.isStimRunning()) {
-            pwm_stim_1.update();
-            pwm_stim_2.update();
+        size_t programSize = 0;
+        if (commandBus.takeProgram(stimProgramCode, programSize)) {
+            stimStats.commandsReceived++;
+            applyProgram(stimProgramCode, programSize);
+        }
+
+        // Обновление генераторов (только в режиме опроса)
+        if (!STIM_TIMER_DRIVEN && appState.isStimRunning()) {
+            stimBank.update();
         }
 
-        uint32_t loopTime = micros() - loopStart;
-        if (loopTime > stimStats.maxLoopTime) {
-            stimStats.maxLoopTime = loopTime;
+        stimStats.loopUs.record(micros() - loopStart);
+        TRACE_END("Stim_Task");
+
+        if (STIM_TIMER_DRIVEN) {
+            continue;
         }
 
         if (STIM_TASK_DELAY_MS > 0) {
@@ -432,6 +575,31 @@ void stimTask(void* parameter) {
     }
 }
 
+// ============================================
+// Settings
+// ============================================
+
+// Восстановление до создания задач: генераторы заберут планы в start(),
+// UI_Task начнет с сохраненных значений энкодеров
+static void restoreSettings(const StoredSettings& settings) {
+    appState.restore(settings.app);
+
+    for (uint8_t i = 0; i < StoredSettings::kChannels; ++i) {
+        if ((settings.channelMask & (1U << i)) == 0) {
+            continue;
+        }
+        TimingPlan plan;
+        if (EMSPulseGenerator::buildPlan(settings.channels[i], plan)) {
+            stimGenerators[i]->publishPlan(plan);
+        }
+    }
+}
+
+// Запись флеша на время останавливает кэш обоих ядер - только в паузе фронтов
+static bool flashWindowOpen() {
+    return stimBank.getTimeToNextEdgeUs() >= SETTINGS_FLASH_WINDOW_US;
+}
+
 // ============================================
 // Setup
 // ============================================
@@ -461,12 +629,47 @@ void setup() {
     digitalWrite(PWM_STATE_PIN, LOW);
     Serial.println("✓ GPIO initialized");
 
-    // Command Queue
-    if (!commandQueue.isValid()) {
+    // Отложенный лог: горячие пути (энкодеры, Stim_Task, генераторы) не ждут Serial
+    if (DeferredLog::startDrain(LOG_TASK_PRIORITY, LOG_TASK_CORE)) {
+        Serial.printf("✓ Log drain on Core %d (every %lu ms)\n", (int)LOG_TASK_CORE,
+                      (unsigned long)DeferredLog::kDrainPeriodMs);
+    }
+
+    // Трасса - до команд и задач: в нее попадет и автозапуск
+    if (TraceRecorder::kEnabled) {
+        TraceRecorder::begin(TRACE_CAPACITY_EVENTS);
+    }
+
+    // Command Bus
+    if (!commandBus.isValid()) {
         Serial.println("✗ ERROR: Failed to create command queue!");
         return;
     }
-    Serial.println("✓ Command queue created");
+    Serial.println("✓ Command bus created");
+
+    // Настройки: одно чтение из NVS до старта задач
+    if (settingsStore.begin() && settingsStore.hasRestored()) {
+        restoreSettings(settingsStore.restored());
+        Serial.println("✓ Settings restored from NVS");
+    }
+    settingsStore.setWriteGate(flashWindowOpen);
+    settingsStore.watch(appState,
+                        AppState::kFieldParams | AppState::kFieldEncoderA | AppState::kFieldEncoderB,
+                        captureSettings);
+    if (settingsStore.startWriter(SETTINGS_TASK_PRIORITY, 0)) {
+        Serial.printf("✓ Settings writer on Core 0 (commit every >= %lu ms)\n",
+                      (unsigned long)SettingsStore::kMinCommitIntervalMs);
+    }
+
+    // Автоматически запускаем стимуляцию: команда ложится в очередь до
+    // создания задач - у SPSC-кольца единственный писатель, и после старта
+    // UI_Task им должна быть только она
+    Command startCmd(CommandType::START_STIM);
+    if (commandBus.send(startCmd)) {
+        Serial.println("[Setup] ✓ Stimulation AUTO-STARTED");
+    } else {
+        Serial.println("[Setup] ✗ Failed to send START!");
+    }
 
     // Watchdog
     esp_task_wdt_init(WDT_TIMEOUT_SEC, true);
@@ -508,6 +711,12 @@ void setup() {
     Serial.printf("✓ Stim Task created on Core 1 (Stack: %u bytes, Priority: 2)\n",
                   STIM_TASK_STACK_SIZE);
 
+    // Профайлер: загрузка ядер, обеих задач и обработчиков прерываний
+    if (profiler.begin() && profiler.addTask(uiTaskHandle) && profiler.addTask(stimTaskHandle) &&
+        profiler.addIsr(encoderIsrProfile) && profiler.addIsr(stimTimerProfile)) {
+        Serial.printf("✓ Profiler: %s\n", Profiler::sourceName(Profiler::getSource()));
+    }
+
     // Задержка для инициализации задач
     delay(200);
 
@@ -532,26 +741,142 @@ void setup() {
     //     Serial.println("[Setup] ✗ Failed to send parameters!");
     // }
     
-    // Задержка для обработки
-    delay(50);
-    
-    // Автоматически запускаем стимуляцию
-    Command startCmd(CommandType::START_STIM);
-    if (commandQueue.send(startCmd, 100)) {
-        Serial.println("[Setup] ✓ Stimulation AUTO-STARTED");
-    } else {
-        Serial.println("[Setup] ✗ Failed to send START!");
-    }
-    
     Serial.println("\n🎛️  Rotate encoder to adjust parameters");
-    Serial.println("📊 Statistics every 10 seconds\n");
+    Serial.printf("📊 Statistics every %lu seconds ('s' - now, 'd' - per task)\n\n",
+                  (unsigned long)(STATS_INTERVAL_MS / 1000));
+}
+
+// ============================================
+// Serial Console
+// ============================================
+
+static int hexNibble(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Пары hex-цифр, пробелы между байтами допускаются
+static bool parseHex(const char* text, uint8_t* out, size_t capacity, size_t& size) {
+    size = 0;
+    while (*text != '\0') {
+        if (*text == ' ' || *text == '\t') {
+            ++text;
+            continue;
+        }
+        const int hi = hexNibble(text[0]);
+        const int lo = (hi < 0) ? -1 : hexNibble(text[1]);
+        if (lo < 0 || size >= capacity) {
+            return false;
+        }
+        out[size++] = (uint8_t)((hi << 4) | lo);
+        text += 2;
+    }
+    return true;
+}
+
+// Байткод проверяется здесь же, чтобы ошибка ушла в консоль;
+// Stim_Task загрузит его еще раз в собственное хранилище
+static void loadProgramCommand(const char* hex) {
+    static uint8_t code[StimCommandBus::kProgramCapacity];
+    static StimProgram check;   // ~1.3 КБ - не на стеке loopTask
+    size_t size = 0;
+
+    if (!parseHex(hex, code, sizeof(code), size)) {
+        Serial.println("[Program] ERROR: Bad hex or program too long");
+        return;
+    }
+
+    if (size > 0) {
+        uint8_t errorIndex = 0;
+        const StimProgramError error = check.load(code, size, &errorIndex);
+        if (error != StimProgramError::None) {
+            Serial.printf("[Program] ERROR: %s at instruction %u\n",
+                          StimProgram::errorName(error), (unsigned)errorIndex);
+            return;
+        }
+    }
+
+    if (!commandBus.sendProgram(code, size)) {
+        Serial.println("[Program] ERROR: Previous program not applied yet");
+        return;
+    }
+    Serial.printf("[Program] Sent %u bytes\n", (unsigned)size);
+}
+
+static void handleConsoleLine(const char* line) {
+    switch (line[0]) {
+        case '\0':
+            break;
+
+        case 't':
+        case 'r':
+            if (!TraceRecorder::kEnabled) {
+                Serial.println("[Trace] Disabled (build with -DTRACE_ENABLED=1)");
+            } else if (line[0] == 't') {
+                TraceRecorder::dump();
+            } else {
+                TraceRecorder::start();
+                Serial.println("[Trace] Restarted");
+            }
+            break;
+
+        case 's':
+            printSystemStats();
+            appState.printCurrentState();
+            break;
+
+        case 'd':
+            printDetailedTaskStats();
+            break;
+
+        case 'p':
+            loadProgramCommand(line + 1);
+            break;
+
+        default:
+            Serial.printf("[Console] Unknown command: %s\n", line);
+            break;
+    }
 }
 
 // ============================================
 // Loop
 // ============================================
 void loop() {
-    // loop() работает на Core 1, но мы его не используем
-    // Спим, чтобы не нагружать CPU
-    vTaskDelay(pdMS_TO_TICKS(1000));
+    // loop() работает на Core 1: консоль, строка копится между проходами
+    static char line[CONSOLE_LINE_MAX];
+    static size_t length = 0;
+    static bool overflow = false;
+
+    while (Serial.available() > 0) {
+        const int c = Serial.read();
+        if (c == '\r') {
+            continue;
+        }
+        if (c != '\n') {
+            if (length + 1 < sizeof(line)) {
+                line[length++] = (char)c;
+            } else {
+                overflow = true;
+            }
+            continue;
+        }
+
+        line[length] = '\0';
+        if (overflow) {
+            Serial.println("[Console] ERROR: Line too long");
+        } else {
+            handleConsoleLine(line);
+        }
+        length = 0;
+        overflow = false;
+    }
+
+    if (STATS_INTERVAL_MS > 0 && millis() - lastStatsTime >= STATS_INTERVAL_MS) {
+        printSystemStats();
+        appState.printCurrentState();
+    }
+    vTaskDelay(pdMS_TO_TICKS(CONSOLE_POLL_MS));
 }
\ No newline at end of file